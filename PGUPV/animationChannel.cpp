@@ -37,10 +37,26 @@ uint32_t AnimationChannel::getNumFrames() const
 	return static_cast<uint32_t>(std::max({ positions.size(), scalings.size(), rotations.size() }));
 }
 
+/*
+Returns the index i of the keyframe such that keyframes[i-1].tick < t <= keyframes[i].tick.
+First tries the interval stored in cursor and the next one, and if t is not there, 
+uses a binary search.
+*/
 template <typename T>
+uint32_t findKeyFrame(const std::vector<KeyFrameValue<T>> &keyframes, float t, uint32_t cursor) {
+	const auto n = keyframes.size();
+	for (auto i = cursor; i < cursor + 2 && i < n; i++) {
+		if (i > 0 && keyframes[i - 1].tick < t && t <= keyframes[i].tick)
+			return i;
+	}
+	auto it = std::lower_bound(keyframes.begin(), keyframes.end(), t, 
+		[](const KeyFrameValue<T> &kf, float v) { return kf.tick < v; });
+	return static_cast<uint32_t>(it - keyframes.begin());
+}
+
+template <typename T, typename Lerp>
 T linearInterpolation(const std::vector<KeyFrameValue<T>> &keyframes, 
-	float t, std::function<T (const T &x, const T &y, float a)> lerpFunc, 
-	const T &identity) {
+	float t, uint32_t &cursor, Lerp lerpFunc, const T &identity) {
 	if (keyframes.empty()) {
 		return identity;
 	}
@@ -51,44 +67,60 @@ T linearInterpolation(const std::vector<KeyFrameValue<T>> &keyframes,
 	else if (t >= keyframes.back().tick) {
 		return keyframes.back().value;
 	}
-	uint32_t i = 0;
-	while (t > keyframes[i].tick) {
-		i++;
-	}
+	uint32_t i = findKeyFrame(keyframes, t, cursor);
+	cursor = i;
 
 	// keyframes[i-1].tick < t <= keyframes[i].tick 
-	auto start = keyframes[i - 1];
-	auto end = keyframes[i];
+	const auto &start = keyframes[i - 1];
+	const auto &end = keyframes[i];
 
-//	return (t - start.tick)*(end.value - start.value) / static_cast<float>(end.tick - start.tick) + start.value;
 	return lerpFunc(start.value, end.value, (t - start.tick) / static_cast<float>(end.tick - start.tick));
 }
 
+struct Mix {
+	template <typename T>
+	T operator()(const T &x, const T &y, float a) const {
+		return glm::mix(x, y, a);
+	}
+};
+
+struct Slerp {
+	glm::quat operator()(const glm::quat &x, const glm::quat &y, float a) const {
+		return glm::slerp(x, y, a);
+	}
+};
+
+static const glm::vec3 noTranslation(0.0f), noScaling(1.0f);
+static const glm::quat noRotation(1.0f, 0.0f, 0.0f, 0.0f);
+
 glm::vec3 AnimationChannel::interpolatePosition(float t) const
 {
-	return linearInterpolation<glm::vec3>(positions, t, [](const glm::vec3 &x, const glm::vec3 &y, float t) {
-		return glm::mix(x, y, t);
-	}, glm::vec3(0.0f));
+	uint32_t cursor = 0;
+	return linearInterpolation(positions, t, cursor, Mix(), noTranslation);
 }
 
 glm::quat AnimationChannel::interpolateRotation(float t) const 
 {
-	return linearInterpolation<glm::quat>(rotations, t, [](const glm::quat &x, const glm::quat &y, float t) {
-		return glm::slerp(x, y, t);
-	}, glm::quat(1.0f, 0.0f, 0.0f, 0.0f));
+	uint32_t cursor = 0;
+	return linearInterpolation(rotations, t, cursor, Slerp(), noRotation);
 }
 
 glm::vec3 AnimationChannel::interpolateScaling(float t) const 
 {
-	return linearInterpolation<glm::vec3>(scalings, t, [](const glm::vec3 &x, const glm::vec3 &y, float t) {
-		return glm::mix(x, y, t);
-	}, glm::vec3(1.0f));
+	uint32_t cursor = 0;
+	return linearInterpolation(scalings, t, cursor, Mix(), noScaling);
 }
 
 glm::mat4 AnimationChannel::interpolate(float t) const
+{
+	KeyFrameCursor cursor;
+	return interpolate(t, cursor);
+}
+
+glm::mat4 AnimationChannel::interpolate(float t, KeyFrameCursor &cursor) const
 {
 	return 
-		glm::translate(glm::mat4(1.0f), interpolatePosition(t)) *
-		glm::mat4_cast(interpolateRotation(t)) *
-		glm::scale(glm::mat4(1.0f), interpolateScaling(t));
+		glm::translate(glm::mat4(1.0f), linearInterpolation(positions, t, cursor.position, Mix(), noTranslation)) *
+		glm::mat4_cast(linearInterpolation(rotations, t, cursor.rotation, Slerp(), noRotation)) *
+		glm::scale(glm::mat4(1.0f), linearInterpolation(scalings, t, cursor.scaling, Mix(), noScaling));
 }
@@ -3,6 +3,7 @@
 #include "utils.h"
 
 #include <cmath>
+#include <gsl/gsl>
 
 using PGUPV::AnimationClip;
 using PGUPV::AnimationChannel;
@@ -15,7 +16,13 @@ AnimationClip::AnimationClip(const std::string & name, float durationInTicks, fl
 
 void AnimationClip::addChannel(std::shared_ptr<AnimationChannel> channel)
 {
-	channels[channel->getNodeName()] = channel;
+	auto it = channelIndex.find(channel->getNodeName());
+	if (it != channelIndex.end()) {
+		channels[it->second] = channel;
+		return;
+	}
+	channelIndex[channel->getNodeName()] = gsl::narrow<uint32_t>(channels.size());
+	channels.push_back(channel);
 }
 
 std::string AnimationClip::getName() const {
@@ -59,7 +66,7 @@ void AnimationClip::setWrapMode(WrapMode mode)
 }
 
 const std::vector<std::shared_ptr<AnimationChannel>> AnimationClip::getAnimationChannels() const {
-	return PGUPV::getValuesFromMap(channels);
+	return channels;
 }
 
 float wrapAnimationTime(float t, AnimationClip::WrapMode wrapMode, float durationInTicks) {
@@ -87,21 +94,33 @@ float wrapAnimationTime(float t, AnimationClip::WrapMode wrapMode, float duratio
 }
 
 
+float AnimationClip::toTicks(const float t) const
+{
+	return wrapAnimationTime(t * ticksPerSec, wrapMode, getDurationInTicks());
+}
+
 bool AnimationClip::interpolate(const float t, const std::string & boneId, glm::mat4 & mat) const
 {
-	float theTime = wrapAnimationTime(t * ticksPerSec, wrapMode, getDurationInTicks());
 	auto ac = getAnimationChannel(boneId);
 	if (ac) {
-		mat = ac->interpolate(theTime);
+		mat = ac->interpolate(toTicks(t));
 		return true;
 	}
 	return false;
 }
 
+uint32_t AnimationClip::getChannelIndex(const std::string &name) const {
+	const auto it = channelIndex.find(name);
+	if (it != channelIndex.end()) {
+		return it->second;
+	}
+	return NOCHANNEL;
+}
+
 const std::shared_ptr<AnimationChannel> AnimationClip::getAnimationChannel(const std::string &name) const {
-	const auto ac = channels.find(name);
-	if (ac != channels.end()) {
-		return ac->second;
+	auto index = getChannelIndex(name);
+	if (index != NOCHANNEL) {
+		return channels[index];
 	}
 	return std::shared_ptr<AnimationChannel>();
 }
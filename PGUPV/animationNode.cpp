@@ -1,5 +1,8 @@
 #include "animationNode.h"
 #include "animatorController.h"
+#include "animationClip.h"
+#include "boundAnimationClip.h"
+#include "bakedAnimationClip.h"
 #include "nodeVisitor.h"
 #include "transform.h"
 #include "geode.h"
@@ -11,6 +14,8 @@
 #include "bone.h"
 #include "nodeCallback.h"
 #include "app.h"
+#include "threadPool.h"
+#include "profiler.h"
 
 #include <glm/gtc/matrix_inverse.hpp>
 
@@ -22,6 +27,7 @@ using PGUPV::NodeVisitor;
 using PGUPV::Mesh;
 using PGUPV::Skeleton;
 using PGUPV::Bone;
+using PGUPV::BoundAnimationClip;
 
 class Updater : public PGUPV::NodeCallback {
 public:
@@ -37,13 +43,14 @@ void Updater::operator()(Node & node, NodeVisitor & nv)
 }
 
 
-AnimationNode::AnimationNode(std::shared_ptr<Node> root) : subScene(root)
+AnimationNode::AnimationNode(std::shared_ptr<Node> root) : subScene(root), bonesFrame(0), bonesValid(false)
 {
 	build();
 	
 	addUpdateCallback(std::make_shared<Updater>());
 }
 
+AnimationNode::~AnimationNode() = default;
 
 
 class AnimatedMeshRenderer : public NodeVisitor {
@@ -52,65 +59,66 @@ class AnimatedMeshRenderer : public NodeVisitor {
 };
 
 
-class BoneMatricesUpdater : public PGUPV::NodeVisitor {
-public:
-	BoneMatricesUpdater(
-		const glm::mat4 &currentWCS,
-		std::shared_ptr<AnimatorState> anim,
-		std::vector<glm::mat4> &boneMatrices,
-		PGUPV::Skeleton &skeleton
-	) : animation(anim), boneMats(boneMatrices), skel(skeleton) {
-		matstack.setMatrix(currentWCS);
-	};
-
-	void apply(PGUPV::Transform &transform) override {
-		matstack.pushMatrix();
-		glm::mat4 mat;
-		if (animation && animation->interpolate(transform.getName(), mat))
-			matstack.multMatrix(mat);
-		else
-			matstack.multMatrix(transform.getTransform());
-
-		auto b = skel.getBoneIndex(transform.getName());
-		if (b != PGUPV::Skeleton::NOBONE) {
-			boneMats[b] = matstack.getMatrix() * skel.getBone(b)->getMatrix();
+void AnimationNode::updateBoneMatrices()
+{
+	auto state = animController ? animController->currentState() : std::shared_ptr<AnimatorState>();
+	auto clip = state ? state->getAnimationClip() : std::shared_ptr<PGUPV::AnimationClip>();
+	// El estado puede haber cambiado de clip desde el último enlace
+	if (!boundClip || boundClip->getAnimationClip() != clip)
+		bindAnimationClip();
+	if (state)
+		boundClip->sample(*state);
+	else
+		boundClip->sample(0.0f);
+
+	for (size_t i = 0; i < meshes.size(); i++) {
+		if (!bonePalettes[i].empty())
+			boundClip->getBoneMatrices(i, bonePalettes[i]);
+	}
+	bonesFrame = PGUPV::App::getInstance().getCurrentFrame();
+	bonesValid = true;
+}
 
+void AnimationNode::updateBoneMatrices(const std::vector<AnimationNode*>& nodes)
+{
+	// Los cursores de los keyframes están en el AnimatorState, así que los nodos que comparten
+	// controlador no se pueden calcular a la vez
+	std::vector<std::vector<AnimationNode *>> batches;
+	std::map<AnimatorController *, size_t> batchOfController;
+	for (auto n : nodes) {
+		auto controller = n->animController.get();
+		auto it = batchOfController.find(controller);
+		if (controller == nullptr || it == batchOfController.end()) {
+			batchOfController[controller] = batches.size();
+			batches.push_back(std::vector<AnimationNode *>{n});
+		}
+		else {
+			batches[it->second].push_back(n);
 		}
-		traverse(transform);
-
-		matstack.popMatrix();
 	}
-private:
-	PGUPV::MatrixStack matstack;
-	std::shared_ptr<AnimatorState> animation;
-	std::vector<glm::mat4> &boneMats;
-	PGUPV::Skeleton &skel;
-};
+
+	PGUPV::ThreadPool::getInstance().parallelFor(batches.size(), [&batches](size_t i) {
+		for (auto n : batches[i])
+			n->updateBoneMatrices();
+	});
+}
 
 void AnimationNode::render()
 {
-	std::vector<glm::mat4> boneMatrices(UBOBones::MAX_BONES, glm::mat4(1.0f));
+	PGUPV_PROFILE_ZONE("AnimationNode::render");
+	if (!bonesValid || bonesFrame != PGUPV::App::getInstance().getCurrentFrame())
+		updateBoneMatrices();
 
 	auto mats = std::dynamic_pointer_cast<GLMatrices>(gl_uniform_buffer.getBound(UBO_GL_MATRICES_BINDING_INDEX));
 
-	for (auto m : meshes) {
-		std::shared_ptr<Skeleton> skeleton = m->getSkeleton();
-		if (!skeleton)
-			continue;
-
-		BoneMatricesUpdater updater(
-			//mats->getMatrix(GLMatrices::MODEL_MATRIX), 
-			glm::mat4(1.0f),
-			animController->currentState(), 
-			boneMatrices, 
-			*skeleton);
-		subScene->accept(updater);
-
-		auto nBones = skeleton->getNBones();
+	for (size_t i = 0; i < meshes.size(); i++) {
+		auto m = meshes[i];
+		const auto &boneMatrices = bonePalettes[i];
 		std::shared_ptr<UBOBones> ubobones = m->getBones();
-		if (nBones == 0 || !ubobones) {
+		if (boneMatrices.empty() || !ubobones) {
 			continue;
 		}
+		auto nBones = boneMatrices.size();
 		gl_uniform_buffer.bindBufferBase(ubobones, UBO_BONES_BINDING_INDEX);
 		gl_uniform_buffer.write((void *)&boneMatrices[0], nBones * sizeof(glm::mat4), 0);
 
@@ -195,6 +203,23 @@ private:
 
 void AnimationNode::setAnimatorController(std::shared_ptr<AnimatorController> animatorController) {
 	animController = animatorController;
+	bindAnimationClip();
+}
+
+void AnimationNode::bindAnimationClip()
+{
+	std::shared_ptr<PGUPV::AnimationClip> clip;
+	if (animController && animController->currentState())
+		clip = animController->currentState()->getAnimationClip();
+	boundClip.reset(new BoundAnimationClip(clip, *subScene, meshes));
+	if (bakedClip && bakedClip->getAnimationClip() == clip)
+		boundClip->setBakedAnimationClip(bakedClip);
+}
+
+void AnimationNode::setBakedAnimationClip(std::shared_ptr<BakedAnimationClip> baked)
+{
+	bakedClip = baked;
+	bindAnimationClip();
 }
 
 void AnimationNode::build()
@@ -202,5 +227,12 @@ void AnimationNode::build()
 	// Calcular inversas
 	ComputeWorldMatrices ci(meshes, worldMatrix, inverseWorldMatrix);
 	subScene->accept(ci);
+
+	bonePalettes.clear();
+	for (auto m : meshes) {
+		auto skeleton = m->getSkeleton();
+		auto nBones = skeleton ? skeleton->getNBones() : 0;
+		bonePalettes.emplace_back(nBones, glm::mat4(1.0f));
+	}
 }
 
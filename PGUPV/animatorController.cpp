@@ -14,6 +14,7 @@ using PGUPV::Group;
 
 void AnimatorState::setAnimationClip(std::shared_ptr<AnimationClip> clip) {
 	animationClip = clip;
+	cursors.clear();
 }
 
 void AnimatorState::setSpeed(float speed) {
@@ -29,11 +30,19 @@ void AnimatorState::update(uint32_t ms)
 bool AnimatorState::interpolate(const std::string & boneId, glm::mat4 & mat) const
 {
 	if (animationClip) {
-		return animationClip->interpolate(animationTime / 1000.f, boneId, mat);
+		return animationClip->interpolate(getTime(), boneId, mat);
 	}
 	return false;
 }
 
+std::vector<PGUPV::KeyFrameCursor> &AnimatorState::getKeyFrameCursors()
+{
+	// Se pueden haber aadido canales al clip despus de asignarlo
+	if (animationClip && cursors.size() != animationClip->getNumChannels())
+		cursors.resize(animationClip->getNumChannels());
+	return cursors;
+}
+
 void AnimatorState::reset()
 {
 	animationTime = 0;
@@ -19,6 +19,8 @@
 #include "image.h"
 #include "guipg.h"
 #include "lifetimeManager.h"
+#include "profiler.h"
+#include "frameCapture.h"
 
 using std::string;
 using PGUPV::App;
@@ -29,6 +31,7 @@ using PGUPV::Log;
 using PGUPV::Renderer;
 using PGUPV::Keyboard;
 using PGUPV::StatsClass;
+using PGUPV::Profiler;
 using PGUPV::StopWatch;
 using PGUPV::CommandLineProcessor;
 using PGUPV::GLVersion;
@@ -75,7 +78,7 @@ App &App::getInstance(void) {
 App::App()
 	: _errorCode(0), _appDone(false), _paused(false), _show_fps(false), _take_snapshot(false), _destroyed(false),
 	_current_frame(0U), _running_time(0.0), initX(50U), initY(50), initWidth(800U), initHeight(600U),
-	ftl(-1), preferredMajorGLVer(DEFAULT_MAJOR_GL_VERSION), preferredMinorGLVer(-1),
+	ftl(-1), snapshotsVideoFps(30), snapshotsVideoStarted(false), preferredMajorGLVer(DEFAULT_MAJOR_GL_VERSION), preferredMinorGLVer(-1),
 	minimumGLVer(DEFAULT_MINIMUM_MINOR_GL_VERSION), stats(std::make_shared<StatsClass>()),
 	eventSource(std::unique_ptr<EventSource>(new EventSourceHW())),
 	eventProcessor(std::unique_ptr<EventProcessor>(new AppEventProcessor(*this))),
@@ -525,6 +528,7 @@ int App::getWindowIndex(const Window * w) const
 }
 
 void App::processEvents() {
+	PGUPV_PROFILE_CPU_ZONE("Events");
 	auto sw = stats->makeStopWatch();
 	eventProcessor->dispatchPendingEvents();
 	stats->pushValue(std::to_string(sw->getElapsed()));
@@ -534,6 +538,7 @@ void App::update(uint elapsedMs) {
 	_running_time += elapsedMs / 1000.0;
 	_elapsed = elapsedMs;
 	if (elapsedMs > 0) {
+		PGUPV_PROFILE_CPU_ZONE("Update");
 		auto sw = stats->makeStopWatch();
 		for (auto w : m_windows)
 			w->update(elapsedMs);
@@ -547,12 +552,18 @@ void App::render() {
 		p.second();
 	}
 	// TODO: si hay varias ventanas, habría que cambiar el contexto aquí y dibujar cada una en orden
-	m_windows[0]->draw();
+	{
+		PGUPV_PROFILE_ZONE("Render");
+		m_windows[0]->draw();
+	}
 	stats->pushValue(std::to_string(sw->getElapsedAndRestart()));
 	for (auto p : postRenderCallbacks) {
 		p.second();
 	}
-	m_windows[0]->swapBuffers();
+	{
+		PGUPV_PROFILE_ZONE("Swap buffers");
+		m_windows[0]->swapBuffers();
+	}
 	stats->pushValue(std::to_string(sw->getElapsed()));
 }
 
@@ -570,6 +581,7 @@ int App::run() {
 			FRAME("Empezando a dibujar el frame " + std::to_string(_current_frame));
 			stats->pushValue(std::to_string(_current_frame));
 			frameStopWatch->restart();
+			Profiler::getInstance().beginFrame();
 			processEvents();
 			uint now = hw->currentMillis();
 			if (!_paused) {
@@ -584,8 +596,20 @@ int App::run() {
 			}
 			if (snapshots.popValue(_current_frame)) {
 				// TODO ¿qué pasa cuando hay varias ventanas?
-				m_windows[0]->saveColorBuffer(buildFrameName("frame", _current_frame));
+				// Las capturas son asíncronas: se leen y se guardan mientras se dibujan los siguientes fotogramas
+				auto &capture = m_windows[0]->getFrameCapture();
+				if (!snapshotsVideo.empty() && !snapshotsVideoStarted) {
+					snapshotsVideoStarted = capture.startVideo(snapshotsVideo, snapshotsVideoFps);
+					if (!snapshotsVideoStarted)
+						snapshotsVideo.clear();
+				}
+				if (snapshotsVideo.empty())
+					m_windows[0]->captureColorBuffer(buildFrameName("frame", _current_frame));
+				else if (capture.isRecordingVideo())
+					capture.captureVideoFrame();
 			}
+			m_windows[0]->pollFrameCapture();
+			Profiler::getInstance().endFrame();
 			stats->pushValue(std::to_string(frameStopWatch->getElapsed())).endFrame();
 			if (ftl == static_cast<int64_t>(_current_frame)) {
 				return 0;
@@ -610,13 +634,13 @@ void App::takeSnapshot() {
 	// TODO: ¿Qué pasa cuando hay varias ventanas?
 	switch (m_windows[0]->getShownBuffer()) {
 	case Window::COLOR_BUFFER:
-		m_windows[0]->saveColorBuffer("color" + getTimeStamp() + ".png");
+		m_windows[0]->captureColorBuffer("color" + getTimeStamp() + ".png");
 		break;
 	case Window::DEPTH_BUFFER:
-		m_windows[0]->saveColorBuffer("depth" + getTimeStamp() + ".png");
+		m_windows[0]->captureColorBuffer("depth" + getTimeStamp() + ".png");
 		break;
 	case Window::STENCIL_BUFFER:
-		m_windows[0]->saveColorBuffer("stencil" + getTimeStamp() + ".png");
+		m_windows[0]->captureColorBuffer("stencil" + getTimeStamp() + ".png");
 		break;
 	}
 }
@@ -648,6 +672,12 @@ void App::captureSnapshots(PGUPV::Intervals ints) {
 	snapshots.addIntervals(ints);
 }
 
+void App::captureSnapshotsToVideo(const std::string &path, unsigned int fps) {
+	snapshotsVideo = path;
+	snapshotsVideoFps = fps;
+	snapshotsVideoStarted = false;
+}
+
 void App::setMinimumGLVersion(uint minor) {
 	minimumGLVer = minor;
 }
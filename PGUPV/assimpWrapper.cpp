@@ -1,6 +1,7 @@
 
 #include <fstream>
 #include <bitset>
+#include <mutex>
 
 #include <assimp/postprocess.h>
 #include <assimp/scene.h>
@@ -11,6 +12,7 @@
 #include <glm/gtc/type_ptr.hpp>
 
 #include "assimpWrapper.h"
+#include "meshBuilder.h"
 #include "uboBones.h"
 #include "textureGenerator.h"
 #include "transform.h"
@@ -25,6 +27,9 @@
 #include "skeleton.h"
 #include "material.h"
 #include "pbrMaterial.h"
+#include "image.h"
+#include "threadPool.h"
+#include "textureCache.h"
 
 using PGUPV::AssimpWrapper;
 using PGUPV::Node;
@@ -32,6 +37,7 @@ using PGUPV::Texture2D;
 using PGUPV::Material;
 using PGUPV::PBRMaterial;
 using PGUPV::Mesh;
+using PGUPV::MeshBuilder;
 using PGUPV::Group;
 using PGUPV::Geode;
 using PGUPV::Transform;
@@ -45,8 +51,6 @@ using std::string;
 using std::endl;
 
 
-Assimp::Importer AssimpWrapper::importer;
-
 static std::string printMaterialInfo(const aiMaterial* mat);
 static std::string printMeshInfo(const aiScene* scene, size_t n);
 static std::string printMetadataInfo(const aiNode* nd);
@@ -55,9 +59,20 @@ AssimpWrapper::AssimpWrapper() :
 	scene(nullptr) {
 }
 
-std::shared_ptr<Scene> AssimpWrapper::load(const string& filename, LoadOptions options) {
-	result = std::make_shared<Scene>();
+AssimpWrapper::~AssimpWrapper() {
+}
+
+std::shared_ptr<Scene> AssimpWrapper::load(const string& filename, LoadOptions options, VertexLayout layout) {
+	try {
+		prepare(filename, options, layout);
+	}
+	catch (std::runtime_error& e) {
+		ERRT(e.what());
+	}
+	return finish();
+}
 
+void AssimpWrapper::prepare(const string& filename, LoadOptions options, VertexLayout layout) {
 	unsigned int flags = aiProcess_TransformUVCoords;
 	switch (options) {
 	case LoadOptions::FAST:
@@ -75,32 +90,57 @@ std::shared_ptr<Scene> AssimpWrapper::load(const string& filename, LoadOptions o
 
 	importer.SetPropertyBool(AI_CONFIG_IMPORT_MD5_NO_ANIM_AUTOLOAD, true);
 
+	// Este método se puede ejecutar en un hilo trabajador: los errores no se muestran aquí
+	// (ERRT abre un diálogo), sino que se lanzan para que los muestre el hilo principal
 	scene = importer.ReadFile(filename, flags);
 	if (!scene) {
-		ERRT(importer.GetErrorString());
+		throw std::runtime_error(importer.GetErrorString());
 	}
 
 	_filename = filename;
 
 	if (scene->HasTextures()) {
-		ERRT("El modelo " + filename + " tiene las texturas embebidas. Por el momento no "
+		throw std::runtime_error("El modelo " + filename + " tiene las texturas embebidas. Por el momento no "
 			"podemos trabajar con este tipo de ficheros");
 	}
 
+	prepared = std::make_unique<Prepared>();
+	prepared->layout = layout;
+	prepareMeshes();
+	prepareTextures();
+}
+
+std::shared_ptr<Scene> AssimpWrapper::finish() {
+	if (!prepared) {
+		ERRT("Hay que llamar a AssimpWrapper::prepare antes que a AssimpWrapper::finish");
+	}
+	result = std::make_shared<Scene>();
+	tempMeshes.clear();
+
 	if (!scene->HasMaterials()) {
-		WARN("El modelo " + filename + " no tiene materiales. El modelo podría no verse correctamente");
+		WARN("El modelo " + _filename + " no tiene materiales. El modelo podría no verse correctamente");
 	}
 
 	if (!scene->HasAnimations()) {
-		INFO("El modelo " + filename + " no tiene animaciones");
+		INFO("El modelo " + _filename + " no tiene animaciones");
+	}
+
+	for (size_t n = 0; n < prepared->ignoredBoneWeights.size(); n++) {
+		if (prepared->ignoredBoneWeights[n] > 0)
+			WARN("La malla " + std::to_string(n) + " de " + _filename + " tiene vértices con más de 4 huesos. Se ignoran " +
+				std::to_string(prepared->ignoredBoneWeights[n]) + " pesos");
 	}
 
 	loadMaterials();
-	loadMeshes();
+	if (prepared->layout == VertexLayout::SEPARATE)
+		loadMeshes();
+	else
+		loadInterleavedMeshes();
 	loadAnimations();
 
 	result->setRoot(recursive_load(scene->mRootNode));
-	tempMeshes.clear();
+	// Los datos preparados y las mallas se conservan hasta que se destruya el cargador, por
+	// si se quiere guardar la escena con SceneCache::save
 	return result;
 }
 
@@ -184,49 +224,117 @@ std::map<aiTextureType, std::string> aiTextureTypes{
 };
 #undef P
 
+// Número de vértices por primitiva de la malla
+static size_t getNumVertPerFace(const aiMesh* mesh) {
+	switch (mesh->mPrimitiveTypes) {
+	case aiPrimitiveType_TRIANGLE:
+		return 3;
+	case aiPrimitiveType_LINE:
+		return 2;
+	case aiPrimitiveType_POINT:
+		return 1;
+	default:
+		// Se llama desde AssimpWrapper::prepare, que puede estar en un hilo trabajador
+		throw std::runtime_error("Tipo de primitiva no soportada (" + std::to_string(mesh->mPrimitiveTypes) + ")");
+	}
+}
+
+static void addDrawCommand(Mesh& mymesh, const aiMesh* mesh, GLenum indicesType) {
+	switch (getNumVertPerFace(mesh)) {
+	case 3:
+		mymesh.addDrawCommand(
+			new PGUPV::DrawElements(GL_TRIANGLES, static_cast<GLsizei>(mesh->mNumFaces * 3), indicesType, 0));
+		break;
+	case 2:
+		mymesh.addDrawCommand(
+			new PGUPV::DrawElements(GL_LINES, static_cast<GLsizei>(mesh->mNumFaces * 2), indicesType, 0));
+		break;
+	default:
+		mymesh.addDrawCommand(new PGUPV::DrawArrays(GL_POINTS, 0, mesh->mNumVertices));
+	}
+}
+
+static std::vector<unsigned int> getFaceIndices(const aiMesh* mesh) {
+	// create array with indices
+	// have to convert from Assimp format to array
+	const size_t numVertPerFace = getNumVertPerFace(mesh);
+	std::vector<unsigned int> faceArray(mesh->mNumFaces * numVertPerFace);
+	size_t faceIndex = 0;
+	for (unsigned int t = 0; t < mesh->mNumFaces; ++t) {
+		const struct aiFace* face = &mesh->mFaces[t];
+		memcpy(&faceArray[faceIndex], face->mIndices, numVertPerFace * sizeof(unsigned int));
+		faceIndex += numVertPerFace;
+	}
+	return faceArray;
+}
+
+static std::vector<glm::vec2> getTexCoords(const aiMesh* mesh, unsigned int idx) {
+	std::vector<glm::vec2> texCoords(mesh->mNumVertices);
+	for (unsigned int k = 0; k < mesh->mNumVertices; ++k) {
+		texCoords[k].s = mesh->mTextureCoords[idx][k].x;
+		texCoords[k].t = mesh->mTextureCoords[idx][k].y;
+	}
+	return texCoords;
+}
+
+void AssimpWrapper::prepareMeshes() {
+	const bool interleaved = prepared->layout != VertexLayout::SEPARATE;
+	const unsigned int packing = prepared->layout == VertexLayout::COMPACT ? MeshBuilder::PACK_ALL : MeshBuilder::PACK_NONE;
+	if (interleaved)
+		prepared->builders.assign(scene->mNumMeshes, MeshBuilder(packing));
+	else
+		prepared->meshes.resize(scene->mNumMeshes);
+	prepared->ignoredBoneWeights.assign(scene->mNumMeshes, 0);
+
+	// Cada malla se prepara de forma independiente en algún hilo trabajador. Las tareas no
+	// escriben en el log: los avisos se guardan en prepared, y los errores de MeshBuilder se
+	// lanzan como std::runtime_error
+	ThreadPool::getInstance().parallelFor(scene->mNumMeshes, [this, interleaved](size_t n) {
+		const struct aiMesh* mesh = scene->mMeshes[n];
+		if (interleaved) {
+			MeshBuilder& builder = prepared->builders[n];
+			builder.setVertices((GLfloat*)mesh->mVertices, 3, mesh->mNumVertices);
+			if (mesh->HasNormals())
+				builder.setNormals(reinterpret_cast<const glm::vec3*>(mesh->mNormals), mesh->mNumVertices);
+			if (mesh->HasTangentsAndBitangents())
+				builder.setTangents(reinterpret_cast<const glm::vec3*>(mesh->mTangents), mesh->mNumVertices);
+			if (mesh->HasBones())
+				prepared->ignoredBoneWeights[n] = builder.setSkeleton(buildSkeleton(mesh));
+			for (unsigned int idx = 0; idx < NUM_TEX_COORD && mesh->HasTextureCoords(idx); ++idx)
+				builder.setTexCoords(idx, getTexCoords(mesh, idx));
+			if (getNumVertPerFace(mesh) > 1)
+				builder.setIndices(getFaceIndices(mesh));
+			return;
+		}
+
+		PreparedMesh& pm = prepared->meshes[n];
+		if (getNumVertPerFace(mesh) > 1)
+			pm.indices = getFaceIndices(mesh);
+		if (mesh->HasBones()) {
+			pm.skeleton = buildSkeleton(mesh);
+			prepared->ignoredBoneWeights[n] =
+				pm.skeleton->buildArraysOfVerticesAndWeights(mesh->mNumVertices, pm.boneIds, pm.boneWeights);
+		}
+		for (unsigned int idx = 0; idx < NUM_TEX_COORD && mesh->HasTextureCoords(idx); ++idx)
+			pm.texCoords[idx] = getTexCoords(mesh, idx);
+	});
+}
+
 void AssimpWrapper::loadMeshes() {
 	for (unsigned int n = 0; n < scene->mNumMeshes; ++n) {
 		auto mymesh = std::make_shared<Mesh>();
 
 		const struct aiMesh* mesh = scene->mMeshes[n];
+		PreparedMesh& pm = prepared->meshes[n];
 
 		mymesh->setName(mesh->mName.C_Str());
 
 		INFO(printMeshInfo(scene, n));
 
-		size_t numVertPerFace;
+		addDrawCommand(*mymesh, mesh, GL_UNSIGNED_INT);
 
-		switch (mesh->mPrimitiveTypes) {
-		case aiPrimitiveType_TRIANGLE:
-			numVertPerFace = 3;
-			mymesh->addDrawCommand(
-				new DrawElements(GL_TRIANGLES, static_cast<GLsizei>(mesh->mNumFaces * numVertPerFace), GL_UNSIGNED_INT, 0));
-			break;
-		case aiPrimitiveType_LINE:
-			numVertPerFace = 2;
-			mymesh->addDrawCommand(
-				new DrawElements(GL_LINES, static_cast<GLsizei>(mesh->mNumFaces * numVertPerFace), GL_UNSIGNED_INT, 0));
-			break;
-		case aiPrimitiveType_POINT:
-			numVertPerFace = 1;
-			mymesh->addDrawCommand(new DrawArrays(GL_POINTS, 0, mesh->mNumVertices));
-			break;
-		default:
-			ERRT("Tipo de primitiva no soportada (" + std::to_string(mesh->mPrimitiveTypes) + ")");
-		}
-
-		if (numVertPerFace > 1) {
-			// create array with indices
-			// have to convert from Assimp format to array
-			std::vector<unsigned int> faceArray(mesh->mNumFaces * numVertPerFace);
-			size_t faceIndex = 0;
-			for (unsigned int t = 0; t < mesh->mNumFaces; ++t) {
-				const struct aiFace* face = &mesh->mFaces[t];
-				memcpy(&faceArray[faceIndex], face->mIndices, numVertPerFace * sizeof(unsigned int));
-				faceIndex += numVertPerFace;
-			}
-			mymesh->addIndices(faceArray);
-		}
+		if (!pm.indices.empty())
+			mymesh->addIndices(pm.indices);
 		// buffer for vertex positions
 		if (mesh->HasPositions())
 			mymesh->addVertices((GLfloat*)mesh->mVertices, 3, mesh->mNumVertices);
@@ -239,31 +347,36 @@ void AssimpWrapper::loadMeshes() {
 			mymesh->addTangents((GLfloat*)mesh->mTangents, mesh->mNumVertices);
 		}
 
-		if (mesh->HasBones()) {
+		if (pm.skeleton) {
 			INFO("La malla " + std::to_string(n) + " tiene " + std::to_string(mesh->mNumBones) + " huesos");
-			auto skeleton = buildSkeleton(mesh);
-			mymesh->setSkeleton(skeleton);
+			mymesh->setSkeleton(pm.skeleton, pm.boneIds, pm.boneWeights);
 		}
 
 		// buffer for vertex texture coordinates
-		for (unsigned int idx = 0; idx < NUM_TEX_COORD; ++idx) {
-			if (mesh->HasTextureCoords(idx)) {
-				std::vector<glm::vec2> texCoords(mesh->mNumVertices);
-				for (unsigned int k = 0; k < mesh->mNumVertices; ++k) {
-					texCoords[k].s = mesh->mTextureCoords[0][k].x;
-					texCoords[k].t = mesh->mTextureCoords[0][k].y;
-				}
-				mymesh->addTexCoord(idx, texCoords);
-			}
-			else
-				break;
-		}
+		for (unsigned int idx = 0; idx < NUM_TEX_COORD && !pm.texCoords[idx].empty(); ++idx)
+			mymesh->addTexCoord(idx, pm.texCoords[idx]);
 
 		mymesh->setMaterial(result->getMaterial(mesh->mMaterialIndex));
 		tempMeshes.push_back(mymesh);
 	}
 }
 
+void AssimpWrapper::loadInterleavedMeshes() {
+	auto& builders = prepared->builders;
+	// Todas las mallas de la escena comparten el buffer de vértices
+	auto meshes = MeshBuilder::build(builders);
+	for (unsigned int n = 0; n < scene->mNumMeshes; ++n) {
+		const struct aiMesh* mesh = scene->mMeshes[n];
+		INFO(printMeshInfo(scene, n));
+		if (mesh->HasBones())
+			INFO("La malla " + std::to_string(n) + " tiene " + std::to_string(mesh->mNumBones) + " huesos");
+		meshes[n]->setName(mesh->mName.C_Str());
+		addDrawCommand(*meshes[n], mesh, builders[n].getIndicesType());
+		meshes[n]->setMaterial(result->getMaterial(mesh->mMaterialIndex));
+		tempMeshes.push_back(meshes[n]);
+	}
+}
+
 std::shared_ptr<Skeleton> AssimpWrapper::buildSkeleton(const struct aiMesh* mesh)
 {
 	auto skeleton = std::make_shared<Skeleton>();
@@ -284,17 +397,47 @@ std::shared_ptr<Skeleton> AssimpWrapper::buildSkeleton(const struct aiMesh* mesh
 }
 
 
+/**
+Busca los ficheros con el nombre indicado en el directorio dir y sus subdirectorios. El
+contenido de cada directorio se lee una sola vez, y se guarda en un índice compartido por
+todas las cargas (y todos los hilos), para no recorrerlo de nuevo por cada textura
+*/
+static std::vector<std::string> findInDirectory(const std::string& dir, const std::string& name) {
+	static std::mutex m;
+	static std::map<std::string, std::multimap<std::string, std::string>> index;
+
+	std::lock_guard<std::mutex> lock{ m };
+	auto it = index.find(dir);
+	if (it == index.end()) {
+		std::multimap<std::string, std::string> files;
+		for (auto& f : PGUPV::listFiles(dir, true))
+			files.emplace(PGUPV::to_lower(PGUPV::getFilenameFromPath(f)), f);
+		it = index.emplace(dir, std::move(files)).first;
+	}
+
+	std::vector<std::string> result;
+	auto range = it->second.equal_range(PGUPV::to_lower(name));
+	for (auto r = range.first; r != range.second; ++r) {
+		// Como listFiles, sólo ignoramos mayúsculas y minúsculas en Windows
+		if (PGUPV::getPlatform() == PGUPV::Platform::WIN || PGUPV::getFilenameFromPath(r->second) == name)
+			result.push_back(r->second);
+	}
+	return result;
+}
+
 /**
 Dada la ruta de una textura, intenta buscar el fichero, en el siguiente orden:
 -# En la ruta indicada por filename
 -# En el directorio actual (ignorando la ruta proporcionada)
 -# Añadiendo como prefijo el directorio donde se encontraba el modelo
 -# En el directorio donde estaba el modelo
+-# En los subdirectorios del directorio donde estaba el modelo
 
 \param filename La ruta por donde empezar la búsqueda
+\param modelfilename La ruta del modelo (o de un fichero en su mismo directorio, como su .pgscene)
 \return La ruta completa de un fichero que se puede abrir, o filename, si no existe
 */
-std::string findTexture(const std::string& filename, const std::string& modelfilename) {
+std::string AssimpWrapper::findTexture(const std::string& filename, const std::string& modelfilename) {
 	// First, try to load the texture filename as given by the model file
 	std::ifstream f(filename.c_str());
 	if (f) {
@@ -329,7 +472,7 @@ std::string findTexture(const std::string& filename, const std::string& modelfil
 	}
 
 	// Finally, search in all the subdirectories inside the directory that contains the model
-	auto res = PGUPV::listFiles(PGUPV::getDirectory(modelfilename), true, std::vector<std::string> {PGUPV::getFilenameFromPath(filename)});
+	auto res = findInDirectory(PGUPV::getDirectory(modelfilename), PGUPV::getFilenameFromPath(filename));
 	if (res.size() == 1) {
 		return res[0];
 	}
@@ -337,46 +480,6 @@ std::string findTexture(const std::string& filename, const std::string& modelfil
 	return filename;
 }
 
-uint acceptTexture(const std::string& modelFileName, aiTextureType type, const uint textureUnitBase, const aiMaterial* mtl, PGUPV::Material& mat) {
-	aiString path;
-	unsigned int c = MIN(mtl->GetTextureCount(type), 4U); // Soportamos hasta 4 texturas de cada tipo
-	for (uint i = 0; i < c; i++) {
-		mtl->GetTexture(type, i, &path);
-		// This function will throw if we can't find the texture
-		try {
-			auto t = std::make_shared<Texture2D>(GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
-			t->loadImage(findTexture(path.C_Str(), modelFileName));
-			t->generateMipmap();
-			mat.setTexture(textureUnitBase + i, t);
-		}
-		catch (std::runtime_error&) {
-			// Could not load the texture: show a flashy checkboard
-			mat.setTexture(textureUnitBase + i, std::shared_ptr<Texture2D>(PGUPV::TextureGenerator::makeChecker(glm::vec4(1.0f, 1.0f, 1.0f, 1.0f), glm::vec4(1.0f, 0.0f, 1.0f, 1.0f))));
-		}
-	}
-	return c;
-}
-
-uint acceptTexture(const std::string& modelFileName, aiTextureType type, const uint textureUnitBase, const aiMaterial* mtl, PGUPV::PBRMaterial& mat) {
-	aiString path;
-	unsigned int c = MIN(mtl->GetTextureCount(type), 4U); // Soportamos hasta 4 texturas de cada tipo
-	for (uint i = 0; i < c; i++) {
-		mtl->GetTexture(type, i, &path);
-		// This function will throw if we can't find the texture
-		try {
-			auto t = std::make_shared<Texture2D>(GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
-			t->loadImage(findTexture(path.C_Str(), modelFileName));
-			t->generateMipmap();
-			mat.setTexture(textureUnitBase + i, t);
-		}
-		catch (std::runtime_error&) {
-			// Could not load the texture: show a flashy checkboard
-			mat.setTexture(textureUnitBase + i, std::shared_ptr<Texture2D>(PGUPV::TextureGenerator::makeChecker(glm::vec4(1.0f, 1.0f, 1.0f, 1.0f), glm::vec4(1.0f, 0.0f, 1.0f, 1.0f))));
-		}
-	}
-	return c;
-}
-
 void rejectTexture(aiTextureType type, const aiMaterial* mtl) {
 	aiString path;
 	int texIndex = 0;
@@ -386,45 +489,110 @@ void rejectTexture(aiTextureType type, const aiMaterial* mtl) {
 	}
 }
 
-void AssimpWrapper::loadTextures(const aiMaterial* aimat, Material& pgmat) {
-	/*uint nDiff = */acceptTexture(_filename, aiTextureType_DIFFUSE, Material::DIFFUSE_TUNIT, aimat, pgmat);
-	/*uint nSpec = */acceptTexture(_filename, aiTextureType_SPECULAR, Material::SPECULAR_TUNIT, aimat, pgmat);
-	/*uint nNor = */acceptTexture(_filename, aiTextureType_NORMALS, Material::NORMALMAP_TUNIT, aimat, pgmat);
-	/*uint nHei = */acceptTexture(_filename, aiTextureType_HEIGHT, Material::HEIGHTMAP_TUNIT, aimat, pgmat);
-	/*uint nOpac = */acceptTexture(_filename, aiTextureType_OPACITY, Material::OPACITYMAP_TUNIT, aimat, pgmat);
-	/*uint nAmb = */acceptTexture(_filename, aiTextureType_AMBIENT, Material::AMBIENT_TUNIT, aimat, pgmat);
+// Tipos de textura que se cargan en cada clase de material, y la unidad de textura donde van
+static const std::pair<aiTextureType, uint> regularTextureTypes[] = {
+	{ aiTextureType_DIFFUSE, Material::DIFFUSE_TUNIT },
+	{ aiTextureType_SPECULAR, Material::SPECULAR_TUNIT },
+	{ aiTextureType_NORMALS, Material::NORMALMAP_TUNIT },
+	{ aiTextureType_HEIGHT, Material::HEIGHTMAP_TUNIT },
+	{ aiTextureType_OPACITY, Material::OPACITYMAP_TUNIT },
+	{ aiTextureType_AMBIENT, Material::AMBIENT_TUNIT }
+};
 
-	rejectTexture(aiTextureType_DISPLACEMENT, aimat);
-	rejectTexture(aiTextureType_EMISSIVE, aimat);
-	rejectTexture(aiTextureType_LIGHTMAP, aimat);
-	rejectTexture(aiTextureType_NONE, aimat);
-	rejectTexture(aiTextureType_REFLECTION, aimat);
-	rejectTexture(aiTextureType_SHININESS, aimat);
-	rejectTexture(aiTextureType_UNKNOWN, aimat);
+static const std::pair<aiTextureType, uint> pbrTextureTypes[] = {
+	{ aiTextureType_BASE_COLOR, PBRMaterial::BASECOLOR_TUNIT },
+	{ aiTextureType_NORMAL_CAMERA, PBRMaterial::NORMAL_TUNIT },
+	{ aiTextureType_EMISSION_COLOR, PBRMaterial::EMISSION_TUNIT },
+	{ aiTextureType_METALNESS, PBRMaterial::METALNESS_TUNIT },
+	{ aiTextureType_DIFFUSE_ROUGHNESS, PBRMaterial::ROUGHNESS_TUNIT },
+	{ aiTextureType_AMBIENT_OCCLUSION, PBRMaterial::AMBIENTOCLUSSION_TUNIT }
+};
+
+bool isPBR(const struct aiMaterial* mtl);
+
+// Parámetros de las texturas de los modelos (los mismos que usa Texture2D::loadImage(filename))
+static PGUPV::TextureCache::Key textureKey(const std::string& path) {
+	return PGUPV::TextureCache::Key(path, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR, GL_REPEAT, GL_REPEAT, GL_RGB);
 }
 
-void PGUPV::AssimpWrapper::loadPBRTextures(const aiMaterial* aimat, PBRMaterial& pgmat)
-{
-	/*uint nDiff = */acceptTexture(_filename, aiTextureType_BASE_COLOR, PBRMaterial::BASECOLOR_TUNIT, aimat, pgmat);
-	/*uint nSpec = */acceptTexture(_filename, aiTextureType_NORMAL_CAMERA, PBRMaterial::NORMAL_TUNIT, aimat, pgmat);
-	/*uint nNor = */acceptTexture(_filename, aiTextureType_EMISSION_COLOR, PBRMaterial::EMISSION_TUNIT, aimat, pgmat);
-	/*uint nHei = */acceptTexture(_filename, aiTextureType_METALNESS, PBRMaterial::METALNESS_TUNIT, aimat, pgmat);
-	/*uint nOpac = */acceptTexture(_filename, aiTextureType_DIFFUSE_ROUGHNESS, PBRMaterial::ROUGHNESS_TUNIT, aimat, pgmat);
-	/*uint nAmb = */acceptTexture(_filename, aiTextureType_AMBIENT_OCCLUSION, PBRMaterial::AMBIENTOCLUSSION_TUNIT, aimat, pgmat);
-
-	rejectTexture(aiTextureType_DIFFUSE, aimat);
-	rejectTexture(aiTextureType_SPECULAR, aimat);
-	rejectTexture(aiTextureType_NORMALS, aimat);
-	rejectTexture(aiTextureType_HEIGHT, aimat);
-	rejectTexture(aiTextureType_OPACITY, aimat);
-	rejectTexture(aiTextureType_AMBIENT, aimat);
-	rejectTexture(aiTextureType_DISPLACEMENT, aimat);
-	rejectTexture(aiTextureType_EMISSIVE, aimat);
-	rejectTexture(aiTextureType_LIGHTMAP, aimat);
-	rejectTexture(aiTextureType_NONE, aimat);
-	rejectTexture(aiTextureType_REFLECTION, aimat);
-	rejectTexture(aiTextureType_SHININESS, aimat);
-	rejectTexture(aiTextureType_UNKNOWN, aimat);
+void AssimpWrapper::prepareTextures() {
+	auto& textures = prepared->textures;
+	for (unsigned int m = 0; m < scene->mNumMaterials; ++m) {
+		const aiMaterial* mtl = scene->mMaterials[m];
+		const bool pbr = isPBR(mtl);
+		for (const auto& tt : pbr ? pbrTextureTypes : regularTextureTypes) {
+			unsigned int c = MIN(mtl->GetTextureCount(tt.first), 4U); // Soportamos hasta 4 texturas de cada tipo
+			for (uint i = 0; i < c; i++) {
+				aiString path;
+				mtl->GetTexture(tt.first, i, &path);
+				textures.push_back(PreparedTexture{ m, tt.second + i, path.C_Str(), path.C_Str(), 0 });
+			}
+		}
+	}
+
+	auto& pool = ThreadPool::getInstance();
+	pool.parallelFor(textures.size(), [this, &textures](size_t i) {
+		textures[i].path = findTexture(textures[i].name, _filename);
+	});
+
+	// Cada fichero se carga una sola vez, aunque lo usen varios materiales, y sólo si no lo
+	// ha cargado antes otra escena
+	auto& images = prepared->images;
+	std::map<std::string, size_t> imageIndex;
+	for (auto& t : textures) {
+		auto it = imageIndex.find(t.path);
+		if (it == imageIndex.end()) {
+			it = imageIndex.emplace(t.path, images.size()).first;
+			images.push_back(PreparedImage{ t.path, TextureCache::getInstance().find(textureKey(t.path)), nullptr, std::string() });
+		}
+		t.image = it->second;
+	}
+
+	// Decodificamos las imágenes en paralelo. Las texturas de OpenGL se crean en finish.
+	// Image::tryLoad no usa el log (ni muestra diálogos), que sólo se puede usar desde el hilo principal
+	pool.parallelFor(images.size(), [&images](size_t i) {
+		auto& img = images[i];
+		if (img.texture)
+			return;
+		if (!PGUPV::fileExists(img.path)) {
+			img.error = "no existe el fichero";
+			return;
+		}
+		img.image = PGUPV::Image::tryLoad(img.path, &img.error);
+	});
+}
+
+template <typename M>
+void AssimpWrapper::loadTextures(unsigned int materialIndex, M& pgmat) {
+	for (auto& t : prepared->textures) {
+		if (t.material != materialIndex)
+			continue;
+		auto& img = prepared->images[t.image];
+		if (!img.texture) {
+			if (img.image) {
+				img.texture = TextureCache::getInstance().create(textureKey(img.path), *img.image);
+				// Ya no hace falta la copia en memoria principal
+				img.image.reset();
+			}
+			else {
+				// Could not load the texture: show a flashy checkboard
+				WARN("No se ha podido cargar la textura " + img.path + " del modelo " + _filename + ": " + img.error);
+				img.texture = TextureCache::getInstance().getFallback();
+			}
+		}
+		pgmat.setTexture(t.textureUnit, img.texture);
+	}
+}
+
+// Avisa de los tipos de textura que no se usan en ninguna clase de material
+static void rejectOtherTextures(const aiMaterial* mtl) {
+	rejectTexture(aiTextureType_DISPLACEMENT, mtl);
+	rejectTexture(aiTextureType_EMISSIVE, mtl);
+	rejectTexture(aiTextureType_LIGHTMAP, mtl);
+	rejectTexture(aiTextureType_NONE, mtl);
+	rejectTexture(aiTextureType_REFLECTION, mtl);
+	rejectTexture(aiTextureType_SHININESS, mtl);
+	rejectTexture(aiTextureType_UNKNOWN, mtl);
 }
 
 // Consideramos que el material es PBR cuando tiene alguna de las siguientes texturas
@@ -479,13 +647,21 @@ void AssimpWrapper::loadMaterials() {
 		struct aiMaterial* mtl = scene->mMaterials[i];
 		if (isPBR(mtl)) {
 			auto mat = loadPBRMaterial(mtl);
-			loadPBRTextures(mtl, *mat);
+			loadTextures(i, *mat);
+			rejectTexture(aiTextureType_DIFFUSE, mtl);
+			rejectTexture(aiTextureType_SPECULAR, mtl);
+			rejectTexture(aiTextureType_NORMALS, mtl);
+			rejectTexture(aiTextureType_HEIGHT, mtl);
+			rejectTexture(aiTextureType_OPACITY, mtl);
+			rejectTexture(aiTextureType_AMBIENT, mtl);
+			rejectOtherTextures(mtl);
 			result->addMaterial(mat);
 			INFO(printMaterialInfo(mtl) + " TextureCount: " + std::bitset<32>(mat->getTextureCounters()).to_string());
 		}
 		else {
 			auto mat = loadRegularMaterial(mtl);
-			loadTextures(mtl, *mat);
+			loadTextures(i, *mat);
+			rejectOtherTextures(mtl);
 			result->addMaterial(mat);
 			INFO(printMaterialInfo(mtl) + " TextureCount: " + std::bitset<32>(mat->getTextureCounters()).to_string());
 		}
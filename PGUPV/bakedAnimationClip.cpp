@@ -0,0 +1,260 @@
+#include <cmath>
+#include <algorithm>
+#include <gsl/gsl>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "bakedAnimationClip.h"
+#include "animationClip.h"
+#include "animationChannel.h"
+#include "log.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PGUPV_BAKED_SSE2
+#include <emmintrin.h>
+#endif
+
+using PGUPV::BakedAnimationClip;
+using PGUPV::AnimationClip;
+using PGUPV::TRS;
+
+glm::mat4 TRS::toMatrix() const {
+	return
+		glm::translate(glm::mat4(1.0f), translation) *
+		glm::mat4_cast(rotation) *
+		glm::scale(glm::mat4(1.0f), scaling);
+}
+
+namespace {
+	// Primera y última componente de la rotación
+	const uint32_t ROT_BEGIN = 3, ROT_END = 7;
+	const float identityValues[BakedAnimationClip::NUM_COMPONENTS] = {
+		0.0f, 0.0f, 0.0f,
+		0.0f, 0.0f, 0.0f, 1.0f,
+		1.0f, 1.0f, 1.0f };
+
+	bool isRotation(uint32_t component) {
+		return component >= ROT_BEGIN && component < ROT_END;
+	}
+
+	// Operaciones sobre 4 canales a la vez
+#ifdef PGUPV_BAKED_SSE2
+	struct Float4 {
+		__m128 v;
+	};
+	inline Float4 splat(float f) { return Float4{ _mm_set1_ps(f) }; }
+	inline Float4 load(const float *p) { return Float4{ _mm_loadu_ps(p) }; }
+	inline void store(float *p, Float4 a) { _mm_storeu_ps(p, a.v); }
+	inline Float4 operator+(Float4 a, Float4 b) { return Float4{ _mm_add_ps(a.v, b.v) }; }
+	inline Float4 operator-(Float4 a, Float4 b) { return Float4{ _mm_sub_ps(a.v, b.v) }; }
+	inline Float4 operator*(Float4 a, Float4 b) { return Float4{ _mm_mul_ps(a.v, b.v) }; }
+	inline Float4 operator/(Float4 a, Float4 b) { return Float4{ _mm_div_ps(a.v, b.v) }; }
+	inline Float4 sqrt(Float4 a) { return Float4{ _mm_sqrt_ps(a.v) }; }
+	// Cambia el signo de b en los elementos en los que a es negativo
+	inline Float4 flipSignIfNegative(Float4 a, Float4 b) {
+		__m128 sign = _mm_and_ps(_mm_cmplt_ps(a.v, _mm_setzero_ps()), _mm_set1_ps(-0.0f));
+		return Float4{ _mm_xor_ps(b.v, sign) };
+	}
+	inline Float4 loadUnorm16(const uint16_t *p) {
+		__m128i x = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(p));
+		x = _mm_unpacklo_epi16(x, _mm_setzero_si128());
+		return Float4{ _mm_mul_ps(_mm_cvtepi32_ps(x), _mm_set1_ps(1.0f / 65535.0f)) };
+	}
+	inline Float4 loadSnorm16(const uint16_t *p) {
+		__m128i x = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(p));
+		// Extensión de signo de 16 a 32 bits
+		x = _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16);
+		return Float4{ _mm_mul_ps(_mm_cvtepi32_ps(x), _mm_set1_ps(1.0f / 32767.0f)) };
+	}
+#else
+	struct Float4 {
+		float v[4];
+	};
+	template <typename Op>
+	inline Float4 map(Float4 a, Float4 b, Op op) {
+		Float4 r;
+		for (int i = 0; i < 4; i++) r.v[i] = op(a.v[i], b.v[i]);
+		return r;
+	}
+	inline Float4 splat(float f) { return Float4{ { f, f, f, f } }; }
+	inline Float4 load(const float *p) { return Float4{ { p[0], p[1], p[2], p[3] } }; }
+	inline void store(float *p, Float4 a) { std::copy(a.v, a.v + 4, p); }
+	inline Float4 operator+(Float4 a, Float4 b) { return map(a, b, [](float x, float y) { return x + y; }); }
+	inline Float4 operator-(Float4 a, Float4 b) { return map(a, b, [](float x, float y) { return x - y; }); }
+	inline Float4 operator*(Float4 a, Float4 b) { return map(a, b, [](float x, float y) { return x * y; }); }
+	inline Float4 operator/(Float4 a, Float4 b) { return map(a, b, [](float x, float y) { return x / y; }); }
+	inline Float4 sqrt(Float4 a) { return map(a, a, [](float x, float) { return std::sqrt(x); }); }
+	inline Float4 flipSignIfNegative(Float4 a, Float4 b) {
+		return map(a, b, [](float x, float y) { return x < 0.0f ? -y : y; });
+	}
+	inline Float4 loadUnorm16(const uint16_t *p) {
+		return Float4{ { p[0] / 65535.0f, p[1] / 65535.0f, p[2] / 65535.0f, p[3] / 65535.0f } };
+	}
+	inline Float4 loadSnorm16(const uint16_t *p) {
+		Float4 r;
+		for (int i = 0; i < 4; i++) r.v[i] = static_cast<int16_t>(p[i]) / 32767.0f;
+		return r;
+	}
+#endif
+};
+
+std::shared_ptr<BakedAnimationClip> BakedAnimationClip::build(std::shared_ptr<AnimationClip> clip,
+	float samplesPerSecond, bool quantize)
+{
+	if (!clip || clip->getTicksPerSecond() <= 0.0f || samplesPerSecond <= 0.0f)
+		ERRT("No se puede precalcular el clip de animación");
+
+	std::shared_ptr<BakedAnimationClip> baked(new BakedAnimationClip());
+	baked->clip = clip;
+	baked->numChannels = clip->getNumChannels();
+	baked->stride = (baked->numChannels + 3) & ~3U;
+	baked->framesPerTick = samplesPerSecond / clip->getTicksPerSecond();
+	const float duration = clip->getDurationInTicks();
+	baked->numFrames = std::max(1U,
+		static_cast<uint32_t>(std::ceil(duration * baked->framesPerTick)) + 1);
+
+	const auto stride = baked->stride;
+	std::vector<float> values(static_cast<size_t>(baked->numFrames) * NUM_COMPONENTS * stride);
+	for (uint32_t f = 0; f < baked->numFrames; f++) {
+		const float ticks = std::min(f / baked->framesPerTick, duration);
+		float *frame = &values[static_cast<size_t>(f) * NUM_COMPONENTS * stride];
+		for (uint32_t c = 0; c < stride; c++) {
+			float v[NUM_COMPONENTS];
+			if (c < baked->numChannels) {
+				const auto &channel = clip->getAnimationChannel(c);
+				auto p = channel->interpolatePosition(ticks);
+				auto q = channel->interpolateRotation(ticks);
+				auto s = channel->interpolateScaling(ticks);
+				// Mantener los cuaterniones en el mismo hemisferio que el fotograma anterior,
+				// para poder interpolarlos con nlerp
+				if (f > 0) {
+					const float *prev = frame - NUM_COMPONENTS * stride;
+					glm::quat pq(prev[6 * stride + c], prev[3 * stride + c], prev[4 * stride + c], prev[5 * stride + c]);
+					if (glm::dot(pq, q) < 0.0f)
+						q = -q;
+				}
+				const float cv[NUM_COMPONENTS] = { p.x, p.y, p.z, q.x, q.y, q.z, q.w, s.x, s.y, s.z };
+				std::copy(cv, cv + NUM_COMPONENTS, v);
+			}
+			else {
+				std::copy(identityValues, identityValues + NUM_COMPONENTS, v);
+			}
+			for (uint32_t k = 0; k < NUM_COMPONENTS; k++) {
+				frame[k * stride + c] = v[k];
+			}
+		}
+	}
+
+	baked->quantized = quantize;
+	if (quantize)
+		baked->quantizeFrames(values);
+	else
+		baked->frames = std::move(values);
+	return baked;
+}
+
+void BakedAnimationClip::quantizeFrames(const std::vector<float>& values)
+{
+	rangeMin.assign(NUM_COMPONENTS * stride, 0.0f);
+	rangeExtent.assign(NUM_COMPONENTS * stride, 0.0f);
+	for (uint32_t k = 0; k < NUM_COMPONENTS; k++) {
+		if (isRotation(k))
+			continue;
+		for (uint32_t c = 0; c < stride; c++) {
+			float mn = std::numeric_limits<float>::max(), mx = std::numeric_limits<float>::lowest();
+			for (uint32_t f = 0; f < numFrames; f++) {
+				auto v = values[(static_cast<size_t>(f) * NUM_COMPONENTS + k) * stride + c];
+				mn = std::min(mn, v);
+				mx = std::max(mx, v);
+			}
+			rangeMin[k * stride + c] = mn;
+			rangeExtent[k * stride + c] = mx - mn;
+		}
+	}
+
+	quantizedFrames.resize(values.size());
+	for (uint32_t f = 0; f < numFrames; f++) {
+		for (uint32_t k = 0; k < NUM_COMPONENTS; k++) {
+			const size_t base = (static_cast<size_t>(f) * NUM_COMPONENTS + k) * stride;
+			for (uint32_t c = 0; c < stride; c++) {
+				const float v = values[base + c];
+				if (isRotation(k)) {
+					auto q = static_cast<int16_t>(std::lround(glm::clamp(v, -1.0f, 1.0f) * 32767.0f));
+					quantizedFrames[base + c] = static_cast<uint16_t>(q);
+				}
+				else {
+					const float extent = rangeExtent[k * stride + c];
+					const float n = extent > 0.0f ? (v - rangeMin[k * stride + c]) / extent : 0.0f;
+					quantizedFrames[base + c] = static_cast<uint16_t>(std::lround(glm::clamp(n, 0.0f, 1.0f) * 65535.0f));
+				}
+			}
+		}
+	}
+}
+
+size_t BakedAnimationClip::getSizeInBytes() const
+{
+	return frames.size() * sizeof(float) + quantizedFrames.size() * sizeof(uint16_t) +
+		(rangeMin.size() + rangeExtent.size()) * sizeof(float);
+}
+
+void BakedAnimationClip::sample(float ticks, std::vector<TRS>& result) const
+{
+	result.resize(numChannels);
+
+	const float last = static_cast<float>(numFrames - 1);
+	const float f = glm::clamp(ticks * framesPerTick, 0.0f, last);
+	const uint32_t f0 = static_cast<uint32_t>(f);
+	const uint32_t f1 = std::min(f0 + 1, numFrames - 1);
+	const Float4 alpha = splat(f - f0);
+
+	auto fetch = [this](uint32_t frame, uint32_t k, uint32_t c) {
+		const size_t offset = (static_cast<size_t>(frame) * NUM_COMPONENTS + k) * stride + c;
+		if (!quantized)
+			return load(&frames[offset]);
+		if (isRotation(k))
+			return loadSnorm16(&quantizedFrames[offset]);
+		return load(&rangeMin[k * stride + c]) +
+			loadUnorm16(&quantizedFrames[offset]) * load(&rangeExtent[k * stride + c]);
+	};
+
+	for (uint32_t c = 0; c < stride; c += 4) {
+		Float4 out[NUM_COMPONENTS];
+		for (uint32_t k = 0; k < NUM_COMPONENTS; k++) {
+			if (isRotation(k))
+				continue;
+			Float4 a = fetch(f0, k, c), b = fetch(f1, k, c);
+			out[k] = a + (b - a) * alpha;
+		}
+
+		// nlerp de los cuaterniones, por el camino más corto
+		Float4 q0[4], q1[4];
+		Float4 dot = splat(0.0f);
+		for (uint32_t i = 0; i < 4; i++) {
+			q0[i] = fetch(f0, ROT_BEGIN + i, c);
+			q1[i] = fetch(f1, ROT_BEGIN + i, c);
+			dot = dot + q0[i] * q1[i];
+		}
+		Float4 len2 = splat(0.0f);
+		for (uint32_t i = 0; i < 4; i++) {
+			q1[i] = flipSignIfNegative(dot, q1[i]);
+			out[ROT_BEGIN + i] = q0[i] + (q1[i] - q0[i]) * alpha;
+			len2 = len2 + out[ROT_BEGIN + i] * out[ROT_BEGIN + i];
+		}
+		const Float4 len = sqrt(len2);
+		for (uint32_t i = 0; i < 4; i++) {
+			out[ROT_BEGIN + i] = out[ROT_BEGIN + i] / len;
+		}
+
+		float v[NUM_COMPONENTS][4];
+		for (uint32_t k = 0; k < NUM_COMPONENTS; k++) {
+			store(v[k], out[k]);
+		}
+		const uint32_t n = std::min(4U, numChannels - c);
+		for (uint32_t i = 0; i < n; i++) {
+			auto &r = result[c + i];
+			r.translation = glm::vec3(v[0][i], v[1][i], v[2][i]);
+			r.rotation = glm::quat(v[6][i], v[3][i], v[4][i], v[5][i]);
+			r.scaling = glm::vec3(v[7][i], v[8][i], v[9][i]);
+		}
+	}
+}
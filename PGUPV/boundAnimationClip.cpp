@@ -0,0 +1,114 @@
+#include <gsl/gsl>
+
+#include "boundAnimationClip.h"
+#include "animationClip.h"
+#include "animationChannel.h"
+#include "animatorController.h"
+#include "bakedAnimationClip.h"
+#include "nodeVisitor.h"
+#include "transform.h"
+#include "mesh.h"
+#include "skeleton.h"
+#include "bone.h"
+#include "log.h"
+
+using PGUPV::BoundAnimationClip;
+using PGUPV::AnimationClip;
+using PGUPV::Node;
+using PGUPV::Mesh;
+using PGUPV::Skeleton;
+using PGUPV::AnimatorState;
+using PGUPV::KeyFrameCursor;
+using PGUPV::BakedAnimationClip;
+
+// Se usa por referencia (push_back), así que necesita una definición (C++14)
+constexpr uint32_t BoundAnimationClip::NOPARENT;
+
+class BoundAnimationClip::Builder : public PGUPV::NodeVisitor {
+public:
+	Builder(BoundAnimationClip &bound, const std::vector<Mesh *> &meshes) : target(bound) {
+		for (auto m : meshes) {
+			skeletons.push_back(m->getSkeleton());
+		}
+		target.meshBones.resize(meshes.size());
+		parents.push_back(NOPARENT);
+	}
+
+	void apply(PGUPV::Transform &transform) override {
+		auto index = gsl::narrow<uint32_t>(target.nodes.size());
+		auto channel = target.clip ? target.clip->getChannelIndex(transform.getName()) : AnimationClip::NOCHANNEL;
+		target.nodes.push_back(BoundNode{ &transform, parents.back(), channel });
+
+		for (size_t i = 0; i < skeletons.size(); i++) {
+			if (!skeletons[i])
+				continue;
+			auto b = skeletons[i]->getBoneIndex(transform.getName());
+			if (b != Skeleton::NOBONE) {
+				target.meshBones[i].push_back(BoundBone{ index, b, skeletons[i]->getBone(b).get() });
+			}
+		}
+
+		parents.push_back(index);
+		traverse(transform);
+		parents.pop_back();
+	}
+private:
+	BoundAnimationClip &target;
+	std::vector<std::shared_ptr<Skeleton>> skeletons;
+	std::vector<uint32_t> parents;
+};
+
+BoundAnimationClip::BoundAnimationClip(std::shared_ptr<AnimationClip> animationClip, Node & root, const std::vector<Mesh*>& meshes)
+	: clip(animationClip)
+{
+	Builder builder(*this, meshes);
+	root.accept(builder);
+	nodeMatrices.resize(nodes.size(), glm::mat4(1.0f));
+}
+
+BoundAnimationClip::~BoundAnimationClip() = default;
+
+void BoundAnimationClip::setBakedAnimationClip(std::shared_ptr<BakedAnimationClip> bakedClip)
+{
+	if (bakedClip && bakedClip->getAnimationClip() != clip)
+		ERRT("El clip precalculado no corresponde al clip enlazado");
+	baked = bakedClip;
+}
+
+void BoundAnimationClip::sample(float t)
+{
+	sample(t, nullptr);
+}
+
+void BoundAnimationClip::sample(AnimatorState & state)
+{
+	assert(state.getAnimationClip() == clip);
+	sample(state.getTime(), state.getKeyFrameCursors().data());
+}
+
+void BoundAnimationClip::sample(float t, KeyFrameCursor *cursors)
+{
+	const float ticks = clip ? clip->toTicks(t) : 0.0f;
+	if (baked)
+		baked->sample(ticks, bakedSamples);
+	for (size_t i = 0; i < nodes.size(); i++) {
+		const auto &n = nodes[i];
+		glm::mat4 local;
+		if (n.channel == AnimationClip::NOCHANNEL)
+			local = n.transform->getTransform();
+		else if (baked)
+			local = bakedSamples[n.channel].toMatrix();
+		else if (cursors)
+			local = clip->getAnimationChannel(n.channel)->interpolate(ticks, cursors[n.channel]);
+		else
+			local = clip->getAnimationChannel(n.channel)->interpolate(ticks);
+		nodeMatrices[i] = n.parent == NOPARENT ? local : nodeMatrices[n.parent] * local;
+	}
+}
+
+void BoundAnimationClip::getBoneMatrices(size_t mesh, std::vector<glm::mat4>& boneMatrices) const
+{
+	for (const auto &bb : meshBones[mesh]) {
+		boneMatrices[bb.bone] = nodeMatrices[bb.node] * bb.b->getMatrix();
+	}
+}
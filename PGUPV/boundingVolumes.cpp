@@ -10,9 +10,16 @@
 
 #define GLM_ENABLE_EXPERIMENTAL
 #include <glm/gtx/norm.hpp>
+#include <glm/gtc/matrix_access.hpp>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PGUPV_BOUNDS_SSE2
+#include <emmintrin.h>
+#endif
 
 using PGUPV::BoundingBox;
 using PGUPV::BoundingSphere;
+using PGUPV::Frustum;
 using glm::vec3;
 
 BoundingBox PGUPV::computeBoundingBox(const float *v, uint ncomponents, size_t n) {
@@ -76,33 +83,85 @@ BoundingSphere PGUPV::computeBoundingSphere(const float *v, uint ncomponents,
 	return sphere;
 }
 
-glm::bvec3 and3(const glm::bvec3& a, const glm::bvec3& b) {
-	return glm::bvec3{
-		a.x && b.x,
-		a.y && b.y,
-		a.z && b.z
-	};
-}
-
 bool PGUPV::overlapsViewVolume(const BoundingBox& bb, const glm::mat4& mvp)
 {
 	if (!bb.isValid())
 		return false;
+	return Frustum(mvp).classify(bb) != Frustum::Result::OUTSIDE;
+}
+
+Frustum::Frustum(const glm::mat4 &mvp) {
+	const glm::vec4 r0 = glm::row(mvp, 0), r1 = glm::row(mvp, 1), r2 = glm::row(mvp, 2),
+		r3 = glm::row(mvp, 3);
+	planes[0] = r3 + r0; // izquierdo
+	planes[1] = r3 - r0; // derecho
+	planes[2] = r3 + r1; // inferior
+	planes[3] = r3 - r1; // superior
+	planes[4] = r3 + r2; // cercano
+	planes[5] = r3 - r2; // lejano
+	for (auto &p : planes)
+		p /= glm::length(glm::vec3(p));
 
-	auto vtcs = bb.getVertices();
-	glm::bvec3 lt{ true }, gt{ true };
-	size_t i;
-	for (i = 0; i < vtcs.size(); i++) {
-		auto v4 = mvp * vtcs[i];
-		auto v3 = glm::vec3(v4 / v4.w);
-		lt = and3(lt, glm::lessThan(v3, glm::vec3(-v4.w)));
-		gt = and3(gt, glm::greaterThan(v3, glm::vec3(v4.w)));
-		if (!(glm::any(lt) || glm::any(gt)))
-			return true;
+	for (int i = 0; i < NUM_SOA_PLANES; i++) {
+		const glm::vec4 p = i < 6 ? planes[i] : glm::vec4(0.0f, 0.0f, 0.0f, FLT_MAX);
+		for (int c = 0; c < 4; c++)
+			soa[c * NUM_SOA_PLANES + i] = p[c];
 	}
-	return false;
 }
 
+Frustum::Result Frustum::classify(const BoundingBox &bb) const {
+	return classify(bb.getCenter(), bb.getExtent(), 0.0f);
+}
+
+Frustum::Result Frustum::classify(const BoundingSphere &bs) const {
+	return classify(bs.center, vec3(0.0f), bs.radius);
+}
+
+/*
+Para cada plano, d es la distancia con signo del centro, y r la mayor distancia de un punto del
+volumen al centro en la dirección de la normal (|n| . extent + radius). El volumen está fuera si
+d + r < 0 para algún plano, y dentro si d - r >= 0 para todos
+*/
+#ifdef PGUPV_BOUNDS_SSE2
+Frustum::Result Frustum::classify(const vec3 &center, const vec3 &extent, float radius) const {
+	const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 cx = _mm_set1_ps(center.x), cy = _mm_set1_ps(center.y), cz = _mm_set1_ps(center.z);
+	const __m128 ex = _mm_set1_ps(extent.x), ey = _mm_set1_ps(extent.y), ez = _mm_set1_ps(extent.z);
+	const __m128 rad = _mm_set1_ps(radius);
+	int intersects = 0;
+	for (int i = 0; i < NUM_SOA_PLANES; i += 4) {
+		const __m128 nx = _mm_loadu_ps(soa + i);
+		const __m128 ny = _mm_loadu_ps(soa + NUM_SOA_PLANES + i);
+		const __m128 nz = _mm_loadu_ps(soa + 2 * NUM_SOA_PLANES + i);
+		const __m128 w = _mm_loadu_ps(soa + 3 * NUM_SOA_PLANES + i);
+		const __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, cx), _mm_mul_ps(ny, cy)),
+			_mm_add_ps(_mm_mul_ps(nz, cz), w));
+		const __m128 r = _mm_add_ps(_mm_add_ps(
+			_mm_mul_ps(_mm_and_ps(nx, absMask), ex), _mm_mul_ps(_mm_and_ps(ny, absMask), ey)),
+			_mm_add_ps(_mm_mul_ps(_mm_and_ps(nz, absMask), ez), rad));
+		if (_mm_movemask_ps(_mm_cmplt_ps(_mm_add_ps(d, r), zero)))
+			return Result::OUTSIDE;
+		intersects |= _mm_movemask_ps(_mm_cmplt_ps(_mm_sub_ps(d, r), zero));
+	}
+	return intersects ? Result::INTERSECTS : Result::INSIDE;
+}
+#else
+Frustum::Result Frustum::classify(const vec3 &center, const vec3 &extent, float radius) const {
+	Result result = Result::INSIDE;
+	for (const auto &p : planes) {
+		const vec3 n(p);
+		const float d = glm::dot(n, center) + p.w;
+		const float r = glm::dot(glm::abs(n), extent) + radius;
+		if (d + r < 0.0f)
+			return Result::OUTSIDE;
+		if (d - r < 0.0f)
+			result = Result::INTERSECTS;
+	}
+	return result;
+}
+#endif
+
 BoundingBox::BoundingBox(glm::vec3 p, glm::vec3 q) {
 	min = glm::min(p, q);
 	max = glm::max(p, q);
@@ -119,7 +178,19 @@ void BoundingBox::transform(const glm::mat4 & xform) {
 	if (!isValid())
 		return;
 
-	auto corners = getVertices();
+	if (glm::row(xform, 3) == glm::vec4(0.0f, 0.0f, 0.0f, 1.0f)) {
+		// J. Arvo, Transforming axis-aligned bounding boxes. Graphics Gems, 1990
+		const glm::mat3 m(xform);
+		const glm::mat3 absm(glm::abs(m[0]), glm::abs(m[1]), glm::abs(m[2]));
+		const vec3 center = m * getCenter() + vec3(xform[3]);
+		const vec3 extent = absm * getExtent();
+		min = center - extent;
+		max = center + extent;
+		return;
+	}
+
+	glm::vec4 corners[8];
+	getCorners(corners);
 	reset();
 	for (auto &vtx : corners) {
 		auto vp = xform * vtx;
@@ -131,18 +202,22 @@ void BoundingBox::transform(const glm::mat4 & xform) {
 }
 
 std::vector<glm::vec4> BoundingBox::getVertices() const {
-	return std::vector<glm::vec4> {
-		// Upper face
-		glm::vec4(min.x, max.y, max.z, 1.0),
-			glm::vec4(max, 1.0f),
-			glm::vec4(max.x, max.y, min.z, 1.0),
-			glm::vec4(min.x, max.y, min.z, 1.0),
-			// Lower face
-			glm::vec4(min.x, min.y, max.z, 1.0),
-			glm::vec4(max.x, min.y, max.z, 1.0),
-			glm::vec4(max.x, min.y, min.z, 1.0),
-			glm::vec4(min, 1.0f)
-	};
+	glm::vec4 corners[8];
+	getCorners(corners);
+	return std::vector<glm::vec4>(corners, corners + 8);
+}
+
+void BoundingBox::getCorners(glm::vec4 (&corners)[8]) const {
+	// Upper face
+	corners[0] = glm::vec4(min.x, max.y, max.z, 1.0);
+	corners[1] = glm::vec4(max, 1.0f);
+	corners[2] = glm::vec4(max.x, max.y, min.z, 1.0);
+	corners[3] = glm::vec4(min.x, max.y, min.z, 1.0);
+	// Lower face
+	corners[4] = glm::vec4(min.x, min.y, max.z, 1.0);
+	corners[5] = glm::vec4(max.x, min.y, max.z, 1.0);
+	corners[6] = glm::vec4(max.x, min.y, min.z, 1.0);
+	corners[7] = glm::vec4(min, 1.0f);
 }
 
 void BoundingSphere::grow(const BoundingSphere & other) {
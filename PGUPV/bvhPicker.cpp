@@ -0,0 +1,560 @@
+#include <algorithm>
+#include <cfloat>
+#include <unordered_map>
+
+#include <glm/gtc/matrix_inverse.hpp>
+
+#include "bvhPicker.h"
+#include "nodeVisitor.h"
+#include "matrixStack.h"
+#include "model.h"
+#include "mesh.h"
+#include "bindingPoint.h"
+#include "boundingVolumes.h"
+#include "profiler.h"
+
+using PGUPV::BVHPicker;
+using PGUPV::BoundingBox;
+using PGUPV::Mesh;
+using PGUPV::Geode;
+using PGUPV::TriangleIndices;
+
+namespace {
+	// Nodo de una BVH. Si count > 0 es una hoja con las primitivas [first, first + count) del
+	// vector de orden. Si no, sus hijos son los nodos first y first + 1
+	struct BVHNode {
+		BoundingBox box;
+		uint32_t first, count;
+	};
+
+	struct BVH {
+		std::vector<BVHNode> nodes;
+		// Primitivas en el orden de las hojas
+		std::vector<uint32_t> order;
+		// Padre de cada nodo (sólo se usa para reajustar la BVH de la escena)
+		std::vector<uint32_t> parents;
+		void clear() { nodes.clear(); order.clear(); parents.clear(); }
+	};
+
+	const uint32_t MAX_LEAF_SIZE = 4;
+	const int NUM_BINS = 12;
+	// Profundidad máxima, para que la pila del recorrido tenga un tamaño fijo
+	const uint32_t MAX_DEPTH = 60;
+	const uint32_t NO_PARENT = 0xffffffff;
+
+	float area(const BoundingBox &b) {
+		const glm::vec3 e = b.max - b.min;
+		return 2.0f * (e.x * e.y + e.y * e.z + e.z * e.x);
+	}
+
+	/*
+	Construye la BVH de las cajas indicadas, dividiendo cada nodo por el plano de menor coste
+	según la heurística de área de las superficies (SAH), evaluada en NUM_BINS intervalos de cada
+	eje.
+	*/
+	void buildBVH(const std::vector<BoundingBox> &boxes, BVH &bvh) {
+		bvh.clear();
+		if (boxes.empty())
+			return;
+		std::vector<glm::vec3> centroids(boxes.size());
+		bvh.order.resize(boxes.size());
+		for (size_t i = 0; i < boxes.size(); i++) {
+			centroids[i] = boxes[i].getCenter();
+			bvh.order[i] = static_cast<uint32_t>(i);
+		}
+		bvh.nodes.reserve(2 * boxes.size() / MAX_LEAF_SIZE + 1);
+
+		struct Task { uint32_t node, begin, end, depth; };
+		std::vector<Task> tasks;
+		bvh.nodes.push_back(BVHNode{});
+		tasks.push_back(Task{ 0, 0, static_cast<uint32_t>(boxes.size()), 0 });
+		while (!tasks.empty()) {
+			const Task task = tasks.back();
+			tasks.pop_back();
+			BoundingBox box, centroidBox;
+			for (uint32_t i = task.begin; i < task.end; i++) {
+				box.grow(boxes[bvh.order[i]]);
+				const glm::vec3 &c = centroids[bvh.order[i]];
+				centroidBox.min = glm::min(centroidBox.min, c);
+				centroidBox.max = glm::max(centroidBox.max, c);
+			}
+			const uint32_t n = task.end - task.begin;
+			bvh.nodes[task.node].box = box;
+			bvh.nodes[task.node].first = task.begin;
+			bvh.nodes[task.node].count = n;
+			if (n <= MAX_LEAF_SIZE || task.depth == MAX_DEPTH)
+				continue;
+
+			// Busca el mejor plano de división
+			float bestCost = FLT_MAX;
+			int bestAxis = -1, bestBin = 0;
+			for (int axis = 0; axis < 3; axis++) {
+				const float extent = centroidBox.max[axis] - centroidBox.min[axis];
+				if (extent <= 0.0f)
+					continue;
+				BoundingBox binBoxes[NUM_BINS];
+				uint32_t binCounts[NUM_BINS] = {};
+				const float scale = NUM_BINS / extent;
+				for (uint32_t i = task.begin; i < task.end; i++) {
+					const uint32_t p = bvh.order[i];
+					const int b = std::min(NUM_BINS - 1, static_cast<int>((centroids[p][axis] - centroidBox.min[axis]) * scale));
+					binBoxes[b].grow(boxes[p]);
+					binCounts[b]++;
+				}
+				// Áreas a la derecha de cada plano, y luego barrido de izquierda a derecha
+				float rightArea[NUM_BINS];
+				uint32_t rightCount[NUM_BINS];
+				BoundingBox acc;
+				uint32_t count = 0;
+				for (int b = NUM_BINS - 1; b > 0; b--) {
+					acc.grow(binBoxes[b]);
+					count += binCounts[b];
+					rightArea[b] = acc.isValid() ? area(acc) : 0.0f;
+					rightCount[b] = count;
+				}
+				acc.reset();
+				count = 0;
+				for (int b = 1; b < NUM_BINS; b++) {
+					acc.grow(binBoxes[b - 1]);
+					count += binCounts[b - 1];
+					if (count == 0 || rightCount[b] == 0)
+						continue;
+					const float cost = count * area(acc) + rightCount[b] * rightArea[b];
+					if (cost < bestCost) {
+						bestCost = cost;
+						bestAxis = axis;
+						bestBin = b;
+					}
+				}
+			}
+
+			uint32_t mid;
+			if (bestAxis < 0) {
+				// Todos los centros coinciden: se reparten por la mitad
+				mid = task.begin + n / 2;
+			}
+			else {
+				// Si dividir cuesta más que intersecar todas las primitivas, se deja como hoja
+				if (n <= 4 * MAX_LEAF_SIZE && bestCost >= n * area(box))
+					continue;
+				const float minC = centroidBox.min[bestAxis];
+				const float scale = NUM_BINS / (centroidBox.max[bestAxis] - minC);
+				auto it = std::partition(bvh.order.begin() + task.begin, bvh.order.begin() + task.end,
+					[&](uint32_t p) {
+					return std::min(NUM_BINS - 1, static_cast<int>((centroids[p][bestAxis] - minC) * scale)) < bestBin;
+				});
+				mid = static_cast<uint32_t>(it - bvh.order.begin());
+			}
+
+			const uint32_t left = static_cast<uint32_t>(bvh.nodes.size());
+			bvh.nodes[task.node].first = left;
+			bvh.nodes[task.node].count = 0;
+			bvh.nodes.push_back(BVHNode{});
+			bvh.nodes.push_back(BVHNode{});
+			tasks.push_back(Task{ left + 1, mid, task.end, task.depth + 1 });
+			tasks.push_back(Task{ left, task.begin, mid, task.depth + 1 });
+		}
+
+		bvh.parents.assign(bvh.nodes.size(), NO_PARENT);
+		for (uint32_t i = 0; i < bvh.nodes.size(); i++) {
+			if (bvh.nodes[i].count == 0)
+				bvh.parents[bvh.nodes[i].first] = bvh.parents[bvh.nodes[i].first + 1] = i;
+		}
+	}
+
+	// Distancia a la que el rayo entra en la caja (FLT_MAX si no la toca antes de maxT)
+	inline float intersectBox(const BoundingBox &b, const glm::vec3 &origin, const glm::vec3 &invDir, float maxT) {
+		const glm::vec3 t0 = (b.min - origin) * invDir;
+		const glm::vec3 t1 = (b.max - origin) * invDir;
+		const glm::vec3 tmin = glm::min(t0, t1), tmax = glm::max(t0, t1);
+		const float enter = std::max(std::max(tmin.x, tmin.y), std::max(tmin.z, 0.0f));
+		const float exit = std::min(std::min(tmax.x, tmax.y), std::min(tmax.z, maxT));
+		return enter <= exit ? enter : FLT_MAX;
+	}
+
+	/*
+	Recorre la BVH de delante a atrás, llamando a intersectLeaf(primitiva) para las primitivas de
+	las hojas que toca el rayo. intersectLeaf actualiza maxT si encuentra una intersección más
+	cercana
+	*/
+	template <typename F>
+	void traverseBVH(const BVH &bvh, const glm::vec3 &origin, const glm::vec3 &dir, float &maxT, F intersectLeaf) {
+		if (bvh.nodes.empty())
+			return;
+		const glm::vec3 invDir = 1.0f / dir;
+		if (intersectBox(bvh.nodes[0].box, origin, invDir, maxT) == FLT_MAX)
+			return;
+		uint32_t stack[MAX_DEPTH + 2];
+		int top = 0;
+		stack[top++] = 0;
+		while (top > 0) {
+			const BVHNode &node = bvh.nodes[stack[--top]];
+			if (node.count > 0) {
+				for (uint32_t i = node.first; i < node.first + node.count; i++)
+					intersectLeaf(bvh.order[i]);
+				continue;
+			}
+			uint32_t nearChild = node.first, farChild = node.first + 1;
+			float tNear = intersectBox(bvh.nodes[nearChild].box, origin, invDir, maxT);
+			float tFar = intersectBox(bvh.nodes[farChild].box, origin, invDir, maxT);
+			if (tFar < tNear) {
+				std::swap(nearChild, farChild);
+				std::swap(tNear, tFar);
+			}
+			// El más cercano se apila el último, para visitarlo primero
+			if (tFar != FLT_MAX)
+				stack[top++] = farChild;
+			if (tNear != FLT_MAX)
+				stack[top++] = nearChild;
+		}
+	}
+
+	// BVH de los triángulos de una malla, en su espacio del objeto
+	struct MeshBVH {
+		// Primer vértice y aristas de cada triángulo (para Möller-Trumbore)
+		struct Triangle {
+			glm::vec3 a, e1, e2;
+			uint32_t id;
+		};
+		std::vector<Triangle> triangles;
+		std::vector<TriangleIndices> indices;
+		BVH bvh;
+		BoundingBox bounds;
+		size_t nVertices;
+	};
+
+	std::shared_ptr<MeshBVH> buildMeshBVH(Mesh &mesh) {
+		auto result = std::make_shared<MeshBVH>();
+		result->nVertices = mesh.getNVertices();
+		if (result->nVertices == 0)
+			return result;
+
+		const auto vertices = mesh.getVertices();
+		void *indices = nullptr;
+		std::shared_ptr<PGUPV::BufferObject> prev;
+		if (mesh.getNIndices() > 0) {
+			prev = PGUPV::gl_copy_read_buffer.bind(mesh.getBufferObject(Mesh::INDICES));
+			indices = PGUPV::gl_copy_read_buffer.map(GL_READ_ONLY);
+		}
+		uint32_t id = 0;
+		for (auto drawCommand : mesh.getDrawCommands()) {
+			const GLenum mode = drawCommand->getGLPrimitiveType();
+			if (mode != GL_TRIANGLES && mode != GL_TRIANGLE_STRIP && mode != GL_TRIANGLE_FAN)
+				continue;
+			for (auto &t : drawCommand->getTrianglesIndices(indices)) {
+				// Los triángulos con el índice de reinicio de primitiva no existen, pero cuentan
+				// para numerar los demás
+				if (t.idx[0] < vertices.size() && t.idx[1] < vertices.size() && t.idx[2] < vertices.size()) {
+					const glm::vec3 &a = vertices[t.idx[0]];
+					result->triangles.push_back(MeshBVH::Triangle{ a, vertices[t.idx[1]] - a, vertices[t.idx[2]] - a, id });
+				}
+				result->indices.push_back(t);
+				id++;
+			}
+		}
+		if (indices) {
+			PGUPV::gl_copy_read_buffer.unmap();
+			PGUPV::gl_copy_read_buffer.bind(prev);
+		}
+
+		std::vector<BoundingBox> boxes(result->triangles.size());
+		for (size_t i = 0; i < boxes.size(); i++) {
+			const auto &t = result->triangles[i];
+			boxes[i] = BoundingBox(glm::min(t.a, t.a + t.e1), glm::max(t.a, t.a + t.e1));
+			boxes[i].min = glm::min(boxes[i].min, t.a + t.e2);
+			boxes[i].max = glm::max(boxes[i].max, t.a + t.e2);
+		}
+		buildBVH(boxes, result->bvh);
+		if (!result->bvh.nodes.empty())
+			result->bounds = result->bvh.nodes[0].box;
+		return result;
+	}
+
+	// Una malla de un Geode, con su posición en la escena
+	struct Instance {
+		Geode *geode;
+		Mesh *mesh;
+		uint meshIndex;
+		glm::mat4 modelMatrix, inverseModelMatrix;
+		std::shared_ptr<MeshBVH> bvh;
+		BoundingBox worldBox;
+	};
+
+	// Recoge las mallas visibles de la escena con sus matrices del modelo
+	class CollectInstances : public PGUPV::NodeVisitor {
+	public:
+		explicit CollectInstances(std::vector<Instance> &instances) : instances(instances) {
+			instances.clear();
+		}
+		void apply(PGUPV::Node &node) override {
+			if (node.isVisible())
+				traverse(node);
+		}
+		void apply(PGUPV::Transform &transform) override {
+			if (!transform.isVisible())
+				return;
+			stack.pushMatrix();
+			stack.multMatrix(transform.getTransform());
+			traverse(transform);
+			stack.popMatrix();
+		}
+		void apply(PGUPV::Geode &geode) override {
+			if (!geode.isVisible())
+				return;
+			auto &model = geode.getModel();
+			for (uint i = 0; i < model.getNMeshes(); i++) {
+				Instance instance;
+				instance.geode = &geode;
+				instance.mesh = &model.getMesh(i);
+				instance.meshIndex = i;
+				instance.modelMatrix = stack.getMatrix();
+				instances.push_back(instance);
+			}
+		}
+	private:
+		PGUPV::MatrixStack stack;
+		std::vector<Instance> &instances;
+	};
+};
+
+
+class BVHPicker::BVHPickerImpl {
+public:
+	BVHPickerImpl() : dirty(true) {}
+	void setScene(std::shared_ptr<Node> r) {
+		root = r;
+		dirty = true;
+	}
+	void update();
+	void invalidateMesh(Mesh *mesh) {
+		if (meshes.erase(mesh) > 0)
+			dirty = true;
+	}
+	Hit intersect(const Ray &ray) const;
+	size_t getNumInstances() const { return instances.size(); }
+	size_t getNumTriangles() const;
+private:
+	std::shared_ptr<MeshBVH> getMeshBVH(Mesh *mesh);
+	void rebuild();
+	// Recalcula la caja de la instancia y las de sus antecesores en la BVH de la escena
+	void refit(uint32_t instance);
+
+	std::shared_ptr<Node> root;
+	bool dirty;
+	std::unordered_map<Mesh *, std::shared_ptr<MeshBVH>> meshes;
+	std::vector<Instance> instances;
+	// BVH de las cajas de las instancias, y la hoja que contiene cada instancia
+	BVH sceneBVH;
+	std::vector<uint32_t> leafOf;
+	// Instancias del recorrido actual (se reutiliza entre llamadas)
+	std::vector<Instance> current;
+	// Nodo y malla de cada instancia del último recorrido que reconstruyó la BVH, y su posición
+	// en instances (-1 si la malla no tiene triángulos)
+	std::vector<std::pair<Geode *, Mesh *>> collected;
+	std::vector<int32_t> instanceOf;
+};
+
+std::shared_ptr<MeshBVH> BVHPicker::BVHPickerImpl::getMeshBVH(Mesh *mesh) {
+	auto it = meshes.find(mesh);
+	// Una malla nueva puede ocupar la dirección de otra destruida: se comprueba el número de
+	// vértices por si acaso
+	if (it != meshes.end() && it->second->nVertices == mesh->getNVertices())
+		return it->second;
+	auto bvh = buildMeshBVH(*mesh);
+	meshes[mesh] = bvh;
+	return bvh;
+}
+
+void BVHPicker::BVHPickerImpl::update() {
+	PGUPV_PROFILE_CPU_ZONE("BVHPicker::update");
+	if (!root) {
+		instances.clear();
+		collected.clear();
+		instanceOf.clear();
+		sceneBVH.clear();
+		leafOf.clear();
+		meshes.clear();
+		return;
+	}
+	CollectInstances collect(current);
+	root->accept(collect);
+
+	bool sameStructure = !dirty && current.size() == collected.size();
+	for (size_t i = 0; sameStructure && i < current.size(); i++) {
+		sameStructure = current[i].geode == collected[i].first && current[i].mesh == collected[i].second;
+	}
+	if (!sameStructure) {
+		rebuild();
+		return;
+	}
+
+	// Sólo pueden haber cambiado las matrices
+	for (size_t i = 0; i < current.size(); i++) {
+		if (instanceOf[i] < 0)
+			continue;
+		auto &instance = instances[instanceOf[i]];
+		if (instance.modelMatrix == current[i].modelMatrix)
+			continue;
+		instance.modelMatrix = current[i].modelMatrix;
+		instance.inverseModelMatrix = glm::inverse(instance.modelMatrix);
+		instance.worldBox = instance.bvh->bounds;
+		instance.worldBox.transform(instance.modelMatrix);
+		refit(static_cast<uint32_t>(instanceOf[i]));
+	}
+}
+
+void BVHPicker::BVHPickerImpl::rebuild() {
+	dirty = false;
+	instances.clear();
+	collected.clear();
+	instanceOf.assign(current.size(), -1);
+	std::unordered_map<Mesh *, std::shared_ptr<MeshBVH>> used;
+	for (size_t i = 0; i < current.size(); i++) {
+		auto &instance = current[i];
+		collected.emplace_back(instance.geode, instance.mesh);
+		instance.bvh = getMeshBVH(instance.mesh);
+		used[instance.mesh] = instance.bvh;
+		// Las mallas sin triángulos no se pueden seleccionar
+		if (instance.bvh->triangles.empty())
+			continue;
+		instanceOf[i] = static_cast<int32_t>(instances.size());
+		instance.inverseModelMatrix = glm::inverse(instance.modelMatrix);
+		instance.worldBox = instance.bvh->bounds;
+		instance.worldBox.transform(instance.modelMatrix);
+		instances.push_back(instance);
+	}
+	// Se olvidan las mallas que ya no están en la escena
+	meshes.swap(used);
+
+	std::vector<BoundingBox> boxes(instances.size());
+	for (size_t i = 0; i < instances.size(); i++)
+		boxes[i] = instances[i].worldBox;
+	buildBVH(boxes, sceneBVH);
+	leafOf.resize(instances.size());
+	for (uint32_t n = 0; n < sceneBVH.nodes.size(); n++) {
+		const auto &node = sceneBVH.nodes[n];
+		for (uint32_t i = node.first; i < node.first + node.count; i++)
+			leafOf[sceneBVH.order[i]] = n;
+	}
+}
+
+void BVHPicker::BVHPickerImpl::refit(uint32_t instance) {
+	uint32_t n = leafOf[instance];
+	auto &leaf = sceneBVH.nodes[n];
+	leaf.box.reset();
+	for (uint32_t i = leaf.first; i < leaf.first + leaf.count; i++)
+		leaf.box.grow(instances[sceneBVH.order[i]].worldBox);
+	for (n = sceneBVH.parents[n]; n != NO_PARENT; n = sceneBVH.parents[n]) {
+		auto &node = sceneBVH.nodes[n];
+		node.box = sceneBVH.nodes[node.first].box;
+		node.box.grow(sceneBVH.nodes[node.first + 1].box);
+	}
+}
+
+BVHPicker::Hit BVHPicker::BVHPickerImpl::intersect(const Ray &ray) const {
+	Hit hit;
+	hit.node = nullptr;
+	hit.mesh = nullptr;
+	hit.meshIndex = hit.triangle = 0;
+	hit.distance = FLT_MAX;
+
+	float bestT = FLT_MAX;
+	traverseBVH(sceneBVH, ray.origin, ray.direction, bestT, [&](uint32_t i) {
+		const Instance &instance = instances[i];
+		const MeshBVH &mesh = *instance.bvh;
+		// El rayo en el espacio del objeto. La dirección no se normaliza, así que la t del
+		// punto de corte es la misma en los dos espacios
+		const glm::vec3 o = glm::vec3(instance.inverseModelMatrix * glm::vec4(ray.origin, 1.0f));
+		const glm::vec3 d = glm::vec3(instance.inverseModelMatrix * glm::vec4(ray.direction, 0.0f));
+		traverseBVH(mesh.bvh, o, d, bestT, [&](uint32_t t) {
+			// Möller-Trumbore, sin descartar las caras traseras
+			const auto &tri = mesh.triangles[t];
+			const glm::vec3 p = glm::cross(d, tri.e2);
+			const float det = glm::dot(tri.e1, p);
+			if (std::abs(det) < 1e-12f)
+				return;
+			const float invDet = 1.0f / det;
+			const glm::vec3 s = o - tri.a;
+			const float u = glm::dot(s, p) * invDet;
+			if (u < 0.0f || u > 1.0f)
+				return;
+			const glm::vec3 q = glm::cross(s, tri.e1);
+			const float v = glm::dot(d, q) * invDet;
+			if (v < 0.0f || u + v > 1.0f)
+				return;
+			const float dist = glm::dot(tri.e2, q) * invDet;
+			if (dist < 0.0f || dist >= bestT)
+				return;
+			bestT = dist;
+			hit.node = instance.geode;
+			hit.mesh = instance.mesh;
+			hit.meshIndex = instance.meshIndex;
+			hit.triangle = tri.id;
+			hit.vertices = mesh.indices[tri.id];
+			hit.barycentrics = glm::vec3(1.0f - u - v, u, v);
+		});
+	});
+
+	if (hit.isValid()) {
+		hit.distance = bestT;
+		hit.position = ray.origin + bestT * ray.direction;
+	}
+	return hit;
+}
+
+size_t BVHPicker::BVHPickerImpl::getNumTriangles() const {
+	size_t n = 0;
+	for (auto &m : meshes)
+		n += m.second->triangles.size();
+	return n;
+}
+
+
+BVHPicker::BVHPicker() : pimpl(new BVHPicker::BVHPickerImpl()) {
+}
+
+BVHPicker::~BVHPicker() {
+}
+
+void BVHPicker::setScene(std::shared_ptr<Node> root) {
+	pimpl->setScene(root);
+}
+
+void BVHPicker::update() {
+	pimpl->update();
+}
+
+void BVHPicker::invalidateMesh(Mesh *mesh) {
+	pimpl->invalidateMesh(mesh);
+}
+
+BVHPicker::Hit BVHPicker::pick(const Picker::PickData &pick, const glm::mat4 &viewMatrix, const glm::mat4 &projMatrix) const {
+	return intersect(makeRay(pick, viewMatrix, projMatrix));
+}
+
+BVHPicker::Hit BVHPicker::intersect(const Ray &ray) const {
+	return pimpl->intersect(ray);
+}
+
+BVHPicker::Ray BVHPicker::makeRay(const Picker::PickData &pick, const glm::mat4 &viewMatrix, const glm::mat4 &projMatrix) {
+	// Centro del píxel en coordenadas normalizadas (el origen de PickData está arriba)
+	const float x = 2.0f * (pick.x + 0.5f) / pick.width - 1.0f;
+	const float y = 1.0f - 2.0f * (pick.y + 0.5f) / pick.height;
+	const glm::mat4 inv = glm::inverse(projMatrix * viewMatrix);
+	glm::vec4 nearPoint = inv * glm::vec4(x, y, -1.0f, 1.0f);
+	glm::vec4 farPoint = inv * glm::vec4(x, y, 1.0f, 1.0f);
+	nearPoint /= nearPoint.w;
+	farPoint /= farPoint.w;
+	Ray ray;
+	ray.origin = glm::vec3(nearPoint);
+	ray.direction = glm::normalize(glm::vec3(farPoint - nearPoint));
+	return ray;
+}
+
+size_t BVHPicker::getNumInstances() const {
+	return pimpl->getNumInstances();
+}
+
+size_t BVHPicker::getNumTriangles() const {
+	return pimpl->getNumTriangles();
+}
@@ -154,6 +154,23 @@ static void processChangeWorkingDirectory(std::list<std::string> &args,
 	INFO("Directorio actual cambiado a " + path);
 }
 
+static void processSnapShotsVideo(std::list<std::string> &args, PGUPV::App &instance) {
+	if (args.size() < 2)
+		ERRT("Falta el nombre del fichero para la opción -snapvideo");
+	args.pop_front();
+	string path = args.front();
+	args.pop_front();
+	unsigned int fps = 30;
+	if (!args.empty() && args.front().at(0) != '-') {
+		int n = stoi(args.front());
+		args.pop_front();
+		if (n <= 0)
+			ERRT("Los fotogramas por segundo de -snapvideo tienen que ser mayores que cero");
+		fps = static_cast<unsigned int>(n);
+	}
+	instance.captureSnapshotsToVideo(path, fps);
+}
+
 static void processSaveStats(std::list<std::string> &args,
 	const PGUPV::App &instance) {
 	if (args.size() < 2)
@@ -268,6 +285,8 @@ std::string CommandLineProcessor::getHelp() {
 	o << "  -snap {10,11,13-15} hace una captura de los frames 10, 11, "
 		"13, 14 y 15 y la guarda en ficheros (las llaves son "
 		"obligatorias)\n";
+	o << "  -snapvideo <filename> [fps] guarda las capturas de -snap en un vídeo "
+		"(p.e., captura.mp4), en lugar de en ficheros de imagen\n";
 	o << "  -loglevel {FRAME, LIBINFO, INFO, WARNING, ERROR} cuánta "
 		"información se almacena en el fichero de log (más a menos)\n";
 	o << "  -cwd path cambia el directorio actual al indicado antes de "
@@ -334,6 +353,8 @@ bool CommandLineProcessor::process(App & instance) {
       // capturar el frame i, los frames entre j
       // y k
       processSnapShots(targs, instance);
+    else if (arg == "-snapvideo") // Parámetro -snapvideo <fichero> [fps]
+      processSnapShotsVideo(targs, instance);
     else if (arg == "-help" || arg == "-h") // Parámetro -help
       processHelp(targs, instance);
     else if (arg ==
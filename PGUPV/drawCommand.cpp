@@ -2,6 +2,7 @@
 #include <string>
 #include <cstring>
 #include "drawCommand.h"
+#include "glMatrices.h"
 #include "log.h"
 
 using PGUPV::DrawCommand;
@@ -14,6 +15,8 @@ using PGUPV::TriangleIndices;
 
 
 void DrawCommand::render() {
+  // Sube las matrices que estén esperando en modo diferido (ver GLMatrices::setDeferredUpdates)
+  GLMatrices::flushPending();
   if (mode == GL_PATCHES) {
     glPatchParameteri(GL_PATCH_VERTICES, verticesPerPatch);
   }
@@ -29,6 +32,27 @@ void DrawCommand::render() {
   }
 }
 
+void DrawCommand::renderInstanced(GLsizei instances) {
+  GLMatrices::flushPending();
+  if (mode == GL_PATCHES) {
+    glPatchParameteri(GL_PATCH_VERTICES, verticesPerPatch);
+  }
+  if (restartPrimitive) {
+    glEnable(GL_PRIMITIVE_RESTART);
+    glPrimitiveRestartIndex(restartIndex);
+  }
+
+  renderInstancedFunc(instances);
+
+  if (restartPrimitive) {
+    glDisable(GL_PRIMITIVE_RESTART);
+  }
+}
+
+void DrawCommand::renderInstancedFunc(GLsizei) {
+  ERRT("Esta orden de dibujo no se puede dibujar con instancias");
+}
+
 
 // Activa/desactiva el reinicio de primitivas
 void DrawCommand::setPrimitiveRestart(bool restart) {
@@ -9,6 +9,9 @@
 #include "findNodeByName.h"
 #include "properties.h"
 #include "bindableTexture.h"
+#include "threadPool.h"
+#include "textureCache.h"
+#include "sceneCache.h"
 
 #include "texture2D.h"
 #include "material.h"
@@ -281,9 +284,8 @@ bool updateMaterial(Material& mat, const PGMATProperty& pgmat, const std::string
 	// Es una textura
 	auto filename = PGUPV::getDirectory(path) + value;
 
-	auto theTexture = std::make_shared<PGUPV::Texture2D>(GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
-	if (!theTexture->loadImage(filename)) return false;
-	theTexture->generateMipmap();
+	auto theTexture = PGUPV::TextureCache::getInstance().load(PGUPV::TextureCache::Key(filename));
+	if (!theTexture) return false;
 
 	if (pgmat.propertyName == "diffusemap") {
 		mat.setDiffuseTexture(theTexture, pgmat.index);
@@ -316,9 +318,8 @@ bool updateMaterial(PBRMaterial& mat, const PGMATProperty& pgmat, const std::str
 	// Es una textura
 	auto filename = PGUPV::getDirectory(path) + value;
 
-	auto theTexture = std::make_shared<PGUPV::Texture2D>(GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
-	if (!theTexture->loadImage(filename)) return false;
-	theTexture->generateMipmap();
+	auto theTexture = PGUPV::TextureCache::getInstance().load(PGUPV::TextureCache::Key(filename));
+	if (!theTexture) return false;
 
 	if (pgmat.propertyName == "basecolormap") {
 		mat.setBaseColorTexture(theTexture, pgmat.index);
@@ -409,13 +410,8 @@ static void loadPGMAT(const std::string& path, std::shared_ptr<Scene> scene) {
 }
 
 
-std::shared_ptr<Scene> FileLoader::load(const std::string& path, AssimpWrapper::LoadOptions options) {
-	AssimpWrapper loader;
-	auto scene = loader.load(path, options);
-	if (!scene) {
-		ERRT("Error cargando el fichero " + path);
-	}
-
+// Muestra el grafo de escena y aplica (o crea) el fichero .pgmat que acompaña al modelo
+static void postProcess(const std::string& path, std::shared_ptr<Scene> scene) {
 	std::ostringstream os;
 	PGUPV::DescribeScenegraph describer(os);
 	scene->getRoot()->accept(describer);
@@ -423,7 +419,7 @@ std::shared_ptr<Scene> FileLoader::load(const std::string& path, AssimpWrapper::
 
 
 	auto extraMaterialProps = PGUPV::removeExtension(path) + ".pgmat";
-	if (!fileExists(extraMaterialProps)) {
+	if (!PGUPV::fileExists(extraMaterialProps)) {
 		// No hay un fichero extra de materiales: crear una plantilla
 		createTemplatePGMAT(extraMaterialProps, scene);
 	}
@@ -431,7 +427,91 @@ std::shared_ptr<Scene> FileLoader::load(const std::string& path, AssimpWrapper::
 		// Hay un fichero extra de materiales: cargarlo
 		loadPGMAT(extraMaterialProps, scene);
 	}
+}
+
+bool FileLoader::sceneCacheEnabled = true;
+
+std::string FileLoader::getSceneCachePath(const std::string& path) {
+	return PGUPV::removeExtension(path) + ".pgscene";
+}
+
+std::shared_ptr<Scene> FileLoader::finish(const std::string& path, AssimpWrapper& loader, AssimpWrapper::LoadOptions options) {
+	auto scene = loader.finish();
+	if (sceneCacheEnabled) {
+		auto cachePath = getSceneCachePath(path);
+		if (!PGUPV::SceneCache::save(cachePath, loader, *scene, options))
+			WARN("No se ha podido guardar " + cachePath);
+	}
+	return scene;
+}
+
+std::shared_ptr<Scene> FileLoader::loadUncached(const std::string& path, AssimpWrapper::LoadOptions options,
+	AssimpWrapper::VertexLayout layout) {
+	AssimpWrapper loader;
+	try {
+		loader.prepare(path, options, layout);
+	}
+	catch (std::runtime_error& e) {
+		ERRT(e.what());
+	}
+	auto scene = finish(path, loader, options);
+	if (!scene) {
+		ERRT("Error cargando el fichero " + path);
+	}
+	return scene;
+}
 
+std::shared_ptr<Scene> FileLoader::load(const std::string& path, AssimpWrapper::LoadOptions options,
+	AssimpWrapper::VertexLayout layout) {
+	std::shared_ptr<Scene> scene;
+	auto cachePath = getSceneCachePath(path);
+	if (sceneCacheEnabled && PGUPV::SceneCache::isUpToDate(cachePath, path, options, layout))
+		scene = PGUPV::SceneCache::load(cachePath);
+	if (!scene)
+		scene = loadUncached(path, options, layout);
+	postProcess(path, scene);
+	return scene;
+}
+
+std::shared_ptr<PGUPV::PendingScene> FileLoader::loadAsync(const std::string& path, AssimpWrapper::LoadOptions options,
+	AssimpWrapper::VertexLayout layout) {
+	std::shared_ptr<PendingScene> pending(new PendingScene(path, options, layout));
+	// Si el .pgscene está al día, no hay nada que hacer en segundo plano: get() lo proyecta en memoria
+	if (sceneCacheEnabled && PGUPV::SceneCache::isUpToDate(getSceneCachePath(path), path, options, layout))
+		return pending;
+	// La tarea tiene su propia referencia al cargador, por si se destruye pending antes de que termine
+	auto loader = std::make_shared<AssimpWrapper>();
+	pending->loader = loader;
+	pending->prepared = PGUPV::ThreadPool::getInstance().submit([loader, path, options, layout]() {
+		loader->prepare(path, options, layout);
+	});
+	return pending;
+}
+
+bool PGUPV::PendingScene::isReady() const {
+	return scene || !prepared.valid() || prepared.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
+
+std::shared_ptr<Scene> PGUPV::PendingScene::get() {
+	if (scene)
+		return scene;
+	if (loader) {
+		try {
+			prepared.get();
+		}
+		catch (std::runtime_error& e) {
+			ERRT(e.what());
+		}
+		scene = FileLoader::finish(path, *loader, options);
+		loader.reset();
+	}
+	else {
+		scene = SceneCache::load(FileLoader::getSceneCachePath(path));
+		// El .pgscene no es válido: se carga el modelo (ya en el hilo principal)
+		if (!scene)
+			scene = FileLoader::loadUncached(path, options, layout);
+	}
+	postProcess(path, scene);
 	return scene;
 }
 
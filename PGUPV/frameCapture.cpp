@@ -0,0 +1,154 @@
+#include <algorithm>
+#include <cstring>
+
+#include "frameCapture.h"
+#include "videoEncoder.h"
+#include "bufferObject.h"
+#include "bindingPoint.h"
+#include "glStateCache.h"
+#include "threadPool.h"
+#include "image.h"
+#include "log.h"
+
+using PGUPV::FrameCapture;
+using PGUPV::BufferObject;
+using PGUPV::Image;
+
+FrameCapture::FrameCapture(uint width, uint height, unsigned int numBuffers) :
+	width(width), height(height), ring(std::max(numBuffers, 1U)), first(0), count(0) {
+	for (auto &r : ring) {
+		r.pbo = BufferObject::build(3UL * width * height, GL_STREAM_READ);
+		r.pbo->setGlDebugLabel("FrameCapture");
+		r.fence = nullptr;
+	}
+}
+
+FrameCapture::~FrameCapture() {
+	flush();
+	stopVideo();
+}
+
+bool FrameCapture::capture(const std::string &filename, GLenum readBuffer) {
+	if (!Image::isWritableFormat(filename)) {
+		ERR("No se puede guardar una imagen con ese formato: " + filename);
+		return false;
+	}
+	readback(readBuffer, filename);
+	return true;
+}
+
+bool FrameCapture::startVideo(const std::string &path, unsigned int fps) {
+	stopVideo();
+	try {
+		video = std::make_unique<media::VideoEncoder>(path, width, height, fps);
+	}
+	catch (std::runtime_error &e) {
+		ERR(e.what());
+		return false;
+	}
+	return true;
+}
+
+void FrameCapture::captureVideoFrame(GLenum readBuffer) {
+	if (video)
+		readback(readBuffer, "");
+}
+
+void FrameCapture::stopVideo() {
+	if (!video)
+		return;
+	// Los fotogramas del vídeo que todavía están en los PBOs
+	while (count > 0)
+		finishOldest(true);
+	video->finish();
+	video.reset();
+}
+
+void FrameCapture::readback(GLenum readBuffer, const std::string &filename) {
+	// Si el anillo está lleno, hay que esperar a la lectura más antigua
+	if (count == ring.size())
+		finishOldest(true);
+	auto &r = ring[(first + count) % ring.size()];
+	count++;
+	r.filename = filename;
+
+	GLint oldRead;
+	glGetIntegerv(GL_READ_BUFFER, &oldRead);
+	glReadBuffer(readBuffer);
+	GLStateCapturer<PixelPackState> packState;
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	auto prev = gl_pixel_pack_buffer.bind(r.pbo);
+	// Con un PBO vinculado, glReadPixels no espera a la GPU: el último parámetro es la posición en el PBO
+	glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, nullptr);
+	gl_pixel_pack_buffer.bind(prev);
+	glReadBuffer(oldRead);
+	r.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+void FrameCapture::poll() {
+	while (count > 0 && finishOldest(false))
+		;
+	// Informa de las imágenes que ya se han guardado
+	while (!saving.empty() && saving.front().second.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+		waitOldestSave();
+}
+
+void FrameCapture::flush() {
+	while (count > 0)
+		finishOldest(true);
+	while (!saving.empty())
+		waitOldestSave();
+}
+
+bool FrameCapture::finishOldest(bool wait) {
+	auto &r = ring[first];
+	GLenum status = glClientWaitSync(r.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+	if (status == GL_TIMEOUT_EXPIRED) {
+		if (!wait)
+			return false;
+		while (status == GL_TIMEOUT_EXPIRED)
+			status = glClientWaitSync(r.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+	}
+	glDeleteSync(r.fence);
+	r.fence = nullptr;
+	first = (first + 1) % ring.size();
+	count--;
+
+	const ulong size = 3UL * width * height;
+	auto prev = gl_pixel_pack_buffer.bind(r.pbo);
+	auto pixels = static_cast<uint8_t *>(gl_pixel_pack_buffer.map(0, size, GL_MAP_READ_BIT));
+	if (r.filename.empty()) {
+		if (video)
+			video->addFrame(pixels);
+	}
+	else {
+		auto image = std::make_shared<Image>(width, height, 24, pixels);
+		// No se acumulan más imágenes pendientes que las que pueden codificar los hilos
+		const size_t maxPending = 2 * std::max(1U, ThreadPool::getInstance().getNumThreads());
+		while (saving.size() >= maxPending)
+			waitOldestSave();
+		auto filename = r.filename;
+		saving.emplace_back(filename, ThreadPool::getInstance().submit([image, filename]() -> std::string {
+			try {
+				image->save(filename);
+			}
+			catch (std::exception &e) {
+				return e.what();
+			}
+			return "";
+		}));
+	}
+	gl_pixel_pack_buffer.unmap();
+	gl_pixel_pack_buffer.bind(prev);
+	return true;
+}
+
+void FrameCapture::waitOldestSave() {
+	auto filename = saving.front().first;
+	auto error = saving.front().second.get();
+	saving.pop_front();
+	if (error.empty())
+		INFO("Imagen guardada a " + filename);
+	else
+		ERR("Error guardando " + filename + ": " + error);
+}
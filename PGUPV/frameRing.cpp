@@ -0,0 +1,158 @@
+#include <thread>
+
+#include "frameRing.h"
+#include "log.h"
+
+using PGUPV::FrameRing;
+
+FrameRing::FrameRing(unsigned int width, unsigned int height, unsigned int bpp, Policy policy,
+	unsigned int numBuffers) : policy(policy) {
+	const unsigned int n = numBuffers < 2 ? 2 : numBuffers;
+	const size_t size = static_cast<size_t>(width) * height * bpp / 8;
+	const size_t stride = (size + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE * CACHE_LINE_SIZE;
+	storage.resize(n * stride + CACHE_LINE_SIZE);
+	// Primera frontera de línea de caché dentro de storage
+	auto base = reinterpret_cast<uintptr_t>(storage.data());
+	const size_t offset = (CACHE_LINE_SIZE - base % CACHE_LINE_SIZE) % CACHE_LINE_SIZE;
+	for (unsigned int i = 0; i < n; i++)
+		buffers.push_back(storage.data() + offset + i * stride);
+	init();
+}
+
+FrameRing::FrameRing(const std::vector<unsigned char *> &memory, Policy policy) :
+	policy(policy), buffers(memory) {
+	if (buffers.size() < 2)
+		ERRT("Se necesitan al menos dos buffers");
+	init();
+}
+
+void FrameRing::init() {
+	const size_t n = buffers.size();
+	ready.reset(new Entry[n]);
+	freeList.reset(new std::atomic<uint32_t>[n]);
+	// Al principio, todos los buffers están libres
+	for (size_t i = 0; i < n; i++)
+		freeList[i].store(static_cast<uint32_t>(i), std::memory_order_relaxed);
+	freeHead.store(n, std::memory_order_relaxed);
+	freeTail.store(0, std::memory_order_relaxed);
+	readyHead.store(0, std::memory_order_relaxed);
+	readyTail.store(0, std::memory_order_release);
+	writing = reading = -1;
+}
+
+int FrameRing::popReady(int64_t *timestamp) {
+	const size_t n = buffers.size();
+	uint64_t t = readyTail.load(std::memory_order_acquire);
+	for (;;) {
+		if (t == readyHead.load(std::memory_order_acquire))
+			return -1;
+		// Si otro hilo ha avanzado readyTail, la posición puede haberse reutilizado, pero
+		// entonces falla el compare_exchange y se vuelve a leer
+		const uint32_t idx = ready[t % n].buffer.load(std::memory_order_relaxed);
+		const int64_t ts = ready[t % n].timestamp.load(std::memory_order_relaxed);
+		if (readyTail.compare_exchange_weak(t, t + 1, std::memory_order_acq_rel, std::memory_order_acquire)) {
+			if (timestamp)
+				*timestamp = ts;
+			return static_cast<int>(idx);
+		}
+	}
+}
+
+void FrameRing::pushFree(uint32_t buffer) {
+	const uint64_t h = freeHead.load(std::memory_order_relaxed);
+	freeList[h % buffers.size()].store(buffer, std::memory_order_relaxed);
+	freeHead.store(h + 1, std::memory_order_release);
+}
+
+unsigned char *FrameRing::lockForRead(int64_t *timestamp) {
+	if (reading >= 0)
+		ERRT("Ya estaba bloqueado para lectura");
+	int64_t ts = 0;
+	int idx = popReady(&ts);
+	if (policy == Policy::OnlyNewest && idx >= 0) {
+		// Se descartan todos menos el más reciente (como mucho los que ya estaban en la cola,
+		// para no perseguir a un productor más rápido)
+		int64_t newerTs;
+		int newer;
+		for (size_t i = 1; i < buffers.size() && (newer = popReady(&newerTs)) >= 0; i++) {
+			pushFree(static_cast<uint32_t>(idx));
+			idx = newer;
+			ts = newerTs;
+		}
+	}
+	if (idx < 0)
+		return nullptr;
+	reading = idx;
+	if (timestamp)
+		*timestamp = ts;
+	return buffers[idx];
+}
+
+void FrameRing::unlockForRead() {
+	if (reading < 0)
+		ERRT("No se ha bloqueado antes para lectura");
+	pushFree(static_cast<uint32_t>(reading));
+	reading = -1;
+}
+
+bool FrameRing::peek(int64_t &timestamp) const {
+	const size_t n = buffers.size();
+	for (;;) {
+		const uint64_t t = readyTail.load(std::memory_order_acquire);
+		const uint64_t h = readyHead.load(std::memory_order_acquire);
+		if (t == h)
+			return false;
+		const uint64_t s = policy == Policy::OnlyNewest ? h - 1 : t;
+		timestamp = ready[s % n].timestamp.load(std::memory_order_relaxed);
+		// La posición s sólo se reutiliza después de sacar el fotograma s de la cola: si sigue
+		// en ella, la marca de tiempo leída es la buena
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (readyTail.load(std::memory_order_relaxed) <= s)
+			return true;
+	}
+}
+
+void FrameRing::clear() {
+	int idx;
+	while ((idx = popReady(nullptr)) >= 0)
+		pushFree(static_cast<uint32_t>(idx));
+}
+
+unsigned char *FrameRing::lockForWrite() {
+	if (writing >= 0)
+		ERRT("Ya estaba bloqueado para escritura");
+	const size_t n = buffers.size();
+	for (;;) {
+		const uint64_t t = freeTail.load(std::memory_order_relaxed);
+		if (t != freeHead.load(std::memory_order_acquire)) {
+			writing = static_cast<int>(freeList[t % n].load(std::memory_order_relaxed));
+			freeTail.store(t + 1, std::memory_order_release);
+			break;
+		}
+		if (policy == Policy::NoDiscard)
+			return nullptr;
+		// No hay buffers libres: se reutiliza el fotograma más antiguo sin leer
+		writing = popReady(nullptr);
+		if (writing >= 0)
+			break;
+		// El consumidor tiene todos los buffers que no están en las colas, y está a punto de
+		// devolver alguno
+		std::this_thread::yield();
+	}
+	return buffers[writing];
+}
+
+void FrameRing::unlockForWrite(int64_t timestamp) {
+	if (writing < 0)
+		ERRT("No se ha bloqueado antes para escritura");
+	const uint64_t h = readyHead.load(std::memory_order_relaxed);
+	auto &entry = ready[h % buffers.size()];
+	entry.buffer.store(static_cast<uint32_t>(writing), std::memory_order_relaxed);
+	entry.timestamp.store(timestamp, std::memory_order_relaxed);
+	readyHead.store(h + 1, std::memory_order_release);
+	writing = -1;
+}
+
+bool FrameRing::isEmpty() const {
+	return readyTail.load(std::memory_order_acquire) == readyHead.load(std::memory_order_acquire);
+}
@@ -0,0 +1,86 @@
+#include "frustumCuller.h"
+#include "indexedBindingPoint.h"
+#include "glMatrices.h"
+
+using PGUPV::FrustumCuller;
+using PGUPV::Frustum;
+using PGUPV::GLMatrices;
+
+FrustumCuller::FrustumCuller() : NodeVisitor(NodeVisitor::TraversalMode::TRAVERSE_ACTIVE_CHILDREN),
+	mvp(1.0f), frustum(mvp), inside(false), visited(0), culled(0) {
+}
+
+void FrustumCuller::render(Node &root) {
+	auto bo = PGUPV::gl_uniform_buffer.getBound(UBO_GL_MATRICES_BINDING_INDEX);
+	mats = std::static_pointer_cast<GLMatrices>(bo);
+	mvp = mats->getMatrix(GLMatrices::MODELVIEWPROJ_MATRIX);
+	frustum = Frustum(mvp);
+	inside = false;
+	visited = culled = 0;
+	root.accept(*this);
+	mats.reset();
+}
+
+bool FrustumCuller::cull(Node &node) {
+	visited++;
+	if (inside)
+		return false;
+
+	// La esfera es más barata de comprobar. Sólo si corta algún plano, se prueba la caja
+	auto result = frustum.classify(node.getBS());
+	if (result == Frustum::Result::INTERSECTS)
+		result = frustum.classify(node.getBB());
+	if (result == Frustum::Result::OUTSIDE) {
+		culled++;
+		return true;
+	}
+	inside = (result == Frustum::Result::INSIDE);
+	return false;
+}
+
+void FrustumCuller::apply(Group &group) {
+	if (!group.isVisible() || !group.getBB().isValid())
+		return;
+	const bool prevInside = inside;
+	if (!cull(group))
+		traverse(group);
+	inside = prevInside;
+}
+
+void FrustumCuller::apply(Transform &transform) {
+	if (!transform.isVisible() || !transform.getBB().isValid())
+		return;
+	const bool prevInside = inside;
+	if (!cull(transform)) {
+		const glm::mat4 prevMvp = mvp;
+		const Frustum prevFrustum = frustum;
+		mvp = mvp * transform.getTransform();
+		// Si el subgrafo está dentro, no se vuelve a comprobar nada
+		if (!inside)
+			frustum = Frustum(mvp);
+
+		mats->pushMatrix(GLMatrices::MODEL_MATRIX);
+		mats->multMatrix(GLMatrices::MODEL_MATRIX, transform.getTransform());
+		traverse(transform);
+		mats->popMatrix(GLMatrices::MODEL_MATRIX);
+
+		mvp = prevMvp;
+		frustum = prevFrustum;
+	}
+	inside = prevInside;
+}
+
+void FrustumCuller::apply(Geode &geode) {
+	if (!geode.isVisible())
+		return;
+	const bool prevInside = inside;
+	// Una geoda sin volumen de inclusión (p.e., vacía) se deja para Geode::render
+	if (!geode.getBB().isValid() || !cull(geode))
+		geode.render();
+	inside = prevInside;
+}
+
+void FrustumCuller::apply(AnimationNode &node) {
+	visited++;
+	node.render();
+}
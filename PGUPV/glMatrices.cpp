@@ -1,3 +1,6 @@
+#include <algorithm>
+#include <cstring>
+#include <vector>
 #include <glm/glm.hpp>
 
 #include "glMatrices.h"
@@ -8,12 +11,22 @@
 using PGUPV::GLMatrices;
 using PGUPV::BufferObject;
 
-GLMatrices::GLMatrices() : UniformBufferObject(size()) {
+namespace {
+	// Objetos en modo diferido con cambios sin subir, en orden de modificación
+	std::vector<GLMatrices *> pendingUpdates;
+};
+
+GLMatrices::GLMatrices() : UniformBufferObject(size()), deferred(false), dirty(0) {
 	derivedMatrices.modelview = glm::mat4(1.0f);
 	derivedMatrices.modelviewprojection = glm::mat4(1.0f);
 	derivedMatrices.normal = glm::mat3x4(1.0f);
 }
 
+GLMatrices::~GLMatrices() {
+	pendingUpdates.erase(std::remove(pendingUpdates.begin(), pendingUpdates.end(), this),
+		pendingUpdates.end());
+}
+
 const std::string GLMatrices::blockName{ "GLMatrices" };
 
 const std::string &GLMatrices::getBlockName() const { 
@@ -38,6 +51,25 @@ const Strings &GLMatrices::getDefinition() const {
 }
 
 void GLMatrices::writeMatrix(Matrix mat) {
+  if (deferred) {
+    if (mat == MODEL_MATRIX || mat == VIEW_MATRIX)
+      dirty |= DIRTY_MODELVIEW | DIRTY_MODELVIEWPROJ;
+    else if (mat == PROJ_MATRIX)
+      dirty |= DIRTY_MODELVIEWPROJ;
+    // El último modificado se sube el último, para que sea el que quede vinculado
+    if (dirty & DIRTY_UBO) {
+      if (pendingUpdates.back() != this) {
+        pendingUpdates.erase(std::find(pendingUpdates.begin(), pendingUpdates.end(), this));
+        pendingUpdates.push_back(this);
+      }
+    }
+    else {
+      dirty |= DIRTY_UBO;
+      pendingUpdates.push_back(this);
+    }
+    return;
+  }
+
   gl_uniform_buffer.bindBufferBase(this->shared_from_this(),
     UBO_GL_MATRICES_BINDING_INDEX);
   gl_uniform_buffer.write((void *)&mats[mat].getMatrix(), sizeof(glm::mat4),
@@ -69,6 +101,49 @@ void GLMatrices::writeMatrix(Matrix mat) {
   }
 }
 
+void GLMatrices::updateDerivedMatrices() const {
+  if (dirty & DIRTY_MODELVIEW) {
+    derivedMatrices.modelview =
+      mats[VIEW_MATRIX].getMatrix() * mats[MODEL_MATRIX].getMatrix();
+    glm::mat3 nm(derivedMatrices.modelview);
+    derivedMatrices.normal = glm::mat3x4(glm::transpose(glm::inverse(nm)));
+  }
+  if (dirty & DIRTY_MODELVIEWPROJ) {
+    derivedMatrices.modelviewprojection =
+      mats[PROJ_MATRIX].getMatrix() * derivedMatrices.modelview;
+  }
+  dirty &= ~(DIRTY_MODELVIEW | DIRTY_MODELVIEWPROJ);
+}
+
+void GLMatrices::flush() {
+  if (!(dirty & DIRTY_UBO))
+    return;
+  updateDerivedMatrices();
+
+  // Se sube el bloque completo con una sola escritura, con la disposición std140
+  unsigned char block[5 * sizeof(glm::mat4) + sizeof(glm::mat3x4)];
+  for (uint i = 0; i <= PROJ_MATRIX; i++)
+    memcpy(block + i * sizeof(glm::mat4), &mats[i].getMatrix(), sizeof(glm::mat4));
+  memcpy(block + 3 * sizeof(glm::mat4), &derivedMatrices, sizeof(derivedMatrices));
+  gl_uniform_buffer.bindBufferBase(this->shared_from_this(),
+    UBO_GL_MATRICES_BINDING_INDEX);
+  gl_uniform_buffer.write(block, sizeof(block), 0);
+
+  dirty &= ~DIRTY_UBO;
+  pendingUpdates.erase(std::find(pendingUpdates.begin(), pendingUpdates.end(), this));
+}
+
+void GLMatrices::flushPending() {
+  while (!pendingUpdates.empty())
+    pendingUpdates.front()->flush();
+}
+
+void GLMatrices::setDeferredUpdates(bool d) {
+  if (deferred && !d)
+    flush();
+  deferred = d;
+}
+
 void GLMatrices::loadIdentity(Matrix mat) {
   mats[mat].loadIdentity();
   writeMatrix(mat);
@@ -132,6 +207,9 @@ const glm::mat4 &GLMatrices::getMatrix(Matrix mat) const {
     ERRT("No puedes usar getMatrix para conseguir la matriz normal. Usa "
     "getNormalMatrix");
 
+  if (mat == MODELVIEW_MATRIX || mat == MODELVIEWPROJ_MATRIX)
+    updateDerivedMatrices();
+
   if (mat == MODELVIEW_MATRIX)
     return derivedMatrices.modelview;
   else if (mat == MODELVIEWPROJ_MATRIX)
@@ -141,6 +219,7 @@ const glm::mat4 &GLMatrices::getMatrix(Matrix mat) const {
 }
 
 const glm::mat3 GLMatrices::getNormalMatrix() const {
+  updateDerivedMatrices();
   return glm::mat3(derivedMatrices.normal);
 }
 
@@ -162,6 +241,7 @@ std::shared_ptr<GLMatrices> GLMatrices::build() {
 }
 
 std::ostream &PGUPV::operator<<(std::ostream &os, const GLMatrices &m) {
+  m.updateDerivedMatrices();
   os << "Model matrix:\n";
   os << m.mats[GLMatrices::MODEL_MATRIX];
   os << "View matrix:\n";
@@ -1,32 +1,93 @@
+
+#include <algorithm>
 #include "glStats.h"
 
 using PGUPV::GLStats;
 
-GLStats::GLStats() : queries{ GL_SAMPLES_PASSED, GL_PRIMITIVES_GENERATED, GL_VERTICES_SUBMITTED_ARB, GL_PRIMITIVES_SUBMITTED_ARB,
+// GPUTimeElapsed is measured with two GL_TIMESTAMP counters instead of a GL_TIME_ELAPSED query, so
+// the application can still use its own GL_TIME_ELAPSED queries while rendering
+static const unsigned int GPUTimeIndex = PGUPV::to_underlying(GLStats::Query::GPUTimeElapsed);
+static const GLenum queryTypes[] = { GL_SAMPLES_PASSED, GL_PRIMITIVES_GENERATED, GL_TIMESTAMP, GL_VERTICES_SUBMITTED_ARB, GL_PRIMITIVES_SUBMITTED_ARB,
 GL_VERTEX_SHADER_INVOCATIONS_ARB, GL_TESS_CONTROL_SHADER_PATCHES_ARB, GL_TESS_EVALUATION_SHADER_INVOCATIONS_ARB,
 GL_GEOMETRY_SHADER_INVOCATIONS, GL_GEOMETRY_SHADER_PRIMITIVES_EMITTED_ARB, GL_FRAGMENT_SHADER_INVOCATIONS_ARB,
-GL_COMPUTE_SHADER_INVOCATIONS_ARB, GL_CLIPPING_INPUT_PRIMITIVES_ARB, GL_CLIPPING_OUTPUT_PRIMITIVES_ARB }, collectExtendedStatsFlag(false) {
+GL_COMPUTE_SHADER_INVOCATIONS_ARB, GL_CLIPPING_INPUT_PRIMITIVES_ARB, GL_CLIPPING_OUTPUT_PRIMITIVES_ARB };
+
+GLStats::Slot::Slot() : endTimestamp(GL_TIMESTAMP), submitted(0), frame(0), nQueries(0), pending(false) {
+	for (auto type : queryTypes)
+		queries.emplace_back(type);
+}
+
+GLStats::GLStats(unsigned int framesInFlight) : slots(std::max(framesInFlight, 1U)), current(-1), frame(0),
+droppedFrames(0), gpuLatencyMs(0.0f), collectExtendedStatsFlag(false), elapsedMs(0.0f) {
+	static_assert(sizeof(queryTypes) / sizeof(queryTypes[0]) == NQueries, "One query type per GLStats::Query");
 	std::fill(values, values + NQueries, 0);
+	std::fill(valueFrame, valueFrame + NQueries, 0);
 }
 
 void GLStats::beginFrame() {
-	unsigned int end = 2;
-	if (collectExtendedStatsFlag)
-		end = NQueries;
-	for (unsigned int i = 0; i < end; i++) {
-		queries[i].begin();
+	frame++;
+	auto &slot = slots[frame % slots.size()];
+	if (slot.pending)
+		poll();
+	if (slot.pending) {
+		// The GPU is more than slots.size() frames behind: skip this frame instead of waiting
+		current = -1;
+		droppedFrames++;
+	}
+	else {
+		current = static_cast<int>(frame % slots.size());
+		slot.nQueries = numActiveQueries();
+		for (unsigned int i = 0; i < slot.nQueries; i++) {
+			if (i == GPUTimeIndex)
+				slot.queries[i].timestamp();
+			else
+				slot.queries[i].begin();
+		}
 	}
 	stopwatch.restart();
 }
 
 void GLStats::endFrame() {
-	unsigned int end = 2;
-
 	elapsedMs = stopwatch.getElapsed() * 0.001f; // us -> ms
-	if (collectExtendedStatsFlag)
-		end = NQueries;
-	for (unsigned int i = 0; i < end; i++) {
-		queries[i].end();
+	if (current >= 0) {
+		auto &slot = slots[current];
+		for (unsigned int i = 0; i < slot.nQueries; i++) {
+			if (i != GPUTimeIndex)
+				slot.queries[i].end();
+		}
+		slot.endTimestamp.timestamp();
+		glGetInteger64v(GL_TIMESTAMP, &slot.submitted);
+		slot.frame = frame;
+		slot.pending = true;
+		current = -1;
+	}
+	poll();
+}
+
+void GLStats::poll() {
+	for (auto &slot : slots) {
+		if (!slot.pending || !slot.endTimestamp.isResultAvailable())
+			continue;
+		bool available = true;
+		for (unsigned int i = 0; i < slot.nQueries && available; i++) {
+			available = slot.queries[i].isResultAvailable();
+		}
+		if (!available)
+			continue;
+		slot.pending = false;
+		auto finished = slot.endTimestamp.getValueU64();
+		// The slots are not polled in frame order: keep the most recent values
+		for (unsigned int i = 0; i < slot.nQueries; i++) {
+			if (slot.frame > valueFrame[i]) {
+				values[i] = slot.queries[i].getValueU64();
+				if (i == GPUTimeIndex)
+					values[i] = finished - values[i];
+				valueFrame[i] = slot.frame;
+			}
+		}
+		if (slot.frame == valueFrame[0]) {
+			gpuLatencyMs = std::max<GLint64>(static_cast<GLint64>(finished) - slot.submitted, 0) * 1e-6f; // ns -> ms
+		}
 	}
 }
 
@@ -41,9 +102,15 @@ bool GLStats::collectExtendedStats(bool extendedStats)
 		else
 			return false;
 	}
+	else
+		collectExtendedStatsFlag = false;
 	return true;
 }
 
 uint64_t GLStats::getValue(Query query) {
-	return queries[PGUPV::to_underlying(query)].getValueU64();
+	return values[PGUPV::to_underlying(query)];
+}
+
+unsigned int GLStats::getLatency(Query query) {
+	return static_cast<unsigned int>(frame - valueFrame[PGUPV::to_underlying(query)]);
 }
@@ -0,0 +1,342 @@
+#include <algorithm>
+#include <cmath>
+#include <SDL_ttf.h>
+
+#include "glyphAtlas.h"
+#include "font.h"
+#include "texture2D.h"
+#include "glStateCache.h"
+#include "app.h"
+#include "utils.h"
+#include "log.h"
+
+using PGUPV::GlyphAtlas;
+using PGUPV::Font;
+using PGUPV::Texture2D;
+
+GlyphAtlas::AtlasCache GlyphAtlas::cache;
+
+// Tamaño inicial del atlas, separación entre glifos y distancia máxima del modo SDF
+static const uint ATLAS_WIDTH = 512, ATLAS_INITIAL_HEIGHT = 256;
+static const int GLYPH_PADDING = 1, SDF_SPREAD = 4;
+static const float EDT_INF = 1e20f;
+
+// Decodifica el code point que empieza en s[i], y avanza i hasta el siguiente
+static uint32_t decodeUTF8(const std::string &s, size_t &i) {
+	const unsigned char c = static_cast<unsigned char>(s[i++]);
+	if (c < 0x80)
+		return c;
+	int extra;
+	uint32_t cp;
+	if ((c & 0xE0) == 0xC0) {
+		extra = 1;
+		cp = c & 0x1F;
+	}
+	else if ((c & 0xF0) == 0xE0) {
+		extra = 2;
+		cp = c & 0x0F;
+	}
+	else if ((c & 0xF8) == 0xF0) {
+		extra = 3;
+		cp = c & 0x07;
+	}
+	else
+		return 0xFFFD;
+	for (; extra > 0; extra--) {
+		if (i >= s.size() || (static_cast<unsigned char>(s[i]) & 0xC0) != 0x80)
+			return 0xFFFD;
+		cp = (cp << 6) | (static_cast<unsigned char>(s[i++]) & 0x3F);
+	}
+	return cp;
+}
+
+static std::string encodeUTF8(Uint16 ch) {
+	std::string result;
+	if (ch < 0x80)
+		result += static_cast<char>(ch);
+	else if (ch < 0x800) {
+		result += static_cast<char>(0xC0 | (ch >> 6));
+		result += static_cast<char>(0x80 | (ch & 0x3F));
+	}
+	else {
+		result += static_cast<char>(0xE0 | (ch >> 12));
+		result += static_cast<char>(0x80 | ((ch >> 6) & 0x3F));
+		result += static_cast<char>(0x80 | (ch & 0x3F));
+	}
+	return result;
+}
+
+// Transformada de distancia euclídea al cuadrado en una dimensión (Felzenszwalb y Huttenlocher)
+static void edt1d(const std::vector<float> &f, std::vector<float> &d, std::vector<int> &v,
+	std::vector<float> &z, int n) {
+	int k = 0;
+	v[0] = 0;
+	z[0] = -EDT_INF;
+	z[1] = EDT_INF;
+	for (int q = 1; q < n; q++) {
+		float s = ((f[q] + q * q) - (f[v[k]] + v[k] * v[k])) / (2 * q - 2 * v[k]);
+		while (s <= z[k]) {
+			k--;
+			s = ((f[q] + q * q) - (f[v[k]] + v[k] * v[k])) / (2 * q - 2 * v[k]);
+		}
+		k++;
+		v[k] = q;
+		z[k] = s;
+		z[k + 1] = EDT_INF;
+	}
+	k = 0;
+	for (int q = 0; q < n; q++) {
+		while (z[k + 1] < q)
+			k++;
+		d[q] = static_cast<float>((q - v[k]) * (q - v[k])) + f[v[k]];
+	}
+}
+
+// Distancia de cada píxel al píxel marcado más cercano
+static std::vector<float> distanceTransform(const std::vector<bool> &marked, int w, int h) {
+	std::vector<float> grid(marked.size());
+	for (size_t i = 0; i < marked.size(); i++)
+		grid[i] = marked[i] ? 0.0f : EDT_INF;
+	const int n = std::max(w, h);
+	std::vector<float> f(n), d(n), z(n + 1);
+	std::vector<int> v(n);
+	for (int x = 0; x < w; x++) {
+		for (int y = 0; y < h; y++)
+			f[y] = grid[y * w + x];
+		edt1d(f, d, v, z, h);
+		for (int y = 0; y < h; y++)
+			grid[y * w + x] = d[y];
+	}
+	for (int y = 0; y < h; y++) {
+		std::copy(grid.begin() + y * w, grid.begin() + (y + 1) * w, f.begin());
+		edt1d(f, d, v, z, w);
+		for (int x = 0; x < w; x++)
+			grid[y * w + x] = std::sqrt(d[x]);
+	}
+	return grid;
+}
+
+// Sustituye la cobertura de cada píxel por la distancia con signo al borde del glifo,
+// codificada en [0, 255] (128 es el borde)
+static void coverageToSDF(std::vector<uint8_t> &bitmap, int w, int h, int spread) {
+	std::vector<bool> inside(bitmap.size()), outside(bitmap.size());
+	for (size_t i = 0; i < bitmap.size(); i++) {
+		inside[i] = bitmap[i] >= 128;
+		outside[i] = !inside[i];
+	}
+	const std::vector<float> toInside = distanceTransform(inside, w, h);
+	const std::vector<float> toOutside = distanceTransform(outside, w, h);
+	for (size_t i = 0; i < bitmap.size(); i++) {
+		const float d = inside[i] ? toOutside[i] - 0.5f : 0.5f - toInside[i];
+		const float value = glm::clamp(0.5f + d / (2.0f * spread), 0.0f, 1.0f);
+		bitmap[i] = static_cast<uint8_t>(value * 255.0f + 0.5f);
+	}
+}
+
+std::shared_ptr<GlyphAtlas> GlyphAtlas::get(std::shared_ptr<Font> font, Mode mode) {
+	if (!font)
+		ERRT("GlyphAtlas necesita una fuente");
+	auto key = std::make_pair(font.get(), mode);
+	auto it = cache.find(key);
+	if (it != cache.end())
+		return it->second;
+	std::shared_ptr<GlyphAtlas> atlas(new GlyphAtlas(font, mode));
+	cache.insert(std::make_pair(key, atlas));
+	return atlas;
+}
+
+GlyphAtlas::GlyphAtlas(std::shared_ptr<Font> font, Mode mode) : font(font), mode(mode),
+	sdfSpread(mode == Mode::SDF ? SDF_SPREAD : 0), lineSkip(TTF_FontLineSkip(font->getTTFFont())),
+	pixels(ATLAS_WIDTH * ATLAS_INITIAL_HEIGHT, 0), width(ATLAS_WIDTH), height(ATLAS_INITIAL_HEIGHT),
+	shelfX(0), shelfY(0), shelfHeight(0), dirtyBegin(ATLAS_INITIAL_HEIGHT), dirtyEnd(0) {
+}
+
+const GlyphAtlas::Glyph &GlyphAtlas::getGlyph(uint32_t codepoint) {
+	auto it = glyphs.find(codepoint);
+	if (it != glyphs.end())
+		return it->second;
+	// Las referencias a los elementos de un unordered_map siguen siendo válidas al insertar
+	return glyphs.insert(std::make_pair(codepoint, rasterize(codepoint))).first->second;
+}
+
+GlyphAtlas::Glyph GlyphAtlas::rasterize(uint32_t codepoint) {
+	TTF_Font *ttf = font->getTTFFont();
+	Glyph glyph{ 0, 0, 0, 0, 0, 0, 0 };
+
+	// La API de 16 bits de SDL_ttf sólo llega al plano básico
+	Uint16 ch = '?';
+	if (codepoint <= 0xFFFF && TTF_GlyphIsProvided(ttf, static_cast<Uint16>(codepoint)))
+		ch = static_cast<Uint16>(codepoint);
+	int minx, maxx, miny, maxy, advance;
+	if (TTF_GlyphMetrics(ttf, ch, &minx, &maxx, &miny, &maxy, &advance) == 0)
+		glyph.advance = advance;
+	if (ch == ' ' || ch == '\t')
+		return glyph;
+
+	// Como en TextureText, pero con un solo glifo. La superficie tiene la altura de la línea
+	SDL_Color white{ 255, 255, 255, 255 }, black{ 0, 0, 0, 255 };
+	SDL_Surface *surface = TTF_RenderUTF8_Shaded(ttf, encodeUTF8(ch).c_str(), white, black);
+	if (surface == nullptr) {
+		WARN(std::string("No se ha podido rasterizar un glifo. Error SDL_ttf: ") + TTF_GetError());
+		return glyph;
+	}
+	auto coverage = [surface](int x, int y) -> uint8_t {
+		const uint8_t p = static_cast<const uint8_t *>(surface->pixels)[y * surface->pitch + x];
+		return surface->format->palette ? surface->format->palette->colors[p].r : p;
+	};
+
+	// Se descartan las filas y columnas vacías
+	int x0 = surface->w, x1 = 0, y0 = surface->h, y1 = 0;
+	for (int y = 0; y < surface->h; y++) {
+		for (int x = 0; x < surface->w; x++) {
+			if (coverage(x, y)) {
+				x0 = std::min(x0, x);
+				x1 = std::max(x1, x + 1);
+				y0 = std::min(y0, y);
+				y1 = std::max(y1, y + 1);
+			}
+		}
+	}
+	if (x0 >= x1) {
+		SDL_FreeSurface(surface);
+		return glyph;
+	}
+
+	// En modo SDF, el campo de distancias se extiende sdfSpread píxeles alrededor del glifo
+	const int w = x1 - x0 + 2 * sdfSpread, h = y1 - y0 + 2 * sdfSpread;
+	std::vector<uint8_t> bitmap(w * h, 0);
+	for (int y = y0; y < y1; y++)
+		for (int x = x0; x < x1; x++)
+			bitmap[(y - y0 + sdfSpread) * w + x - x0 + sdfSpread] = coverage(x, y);
+	SDL_FreeSurface(surface);
+	if (mode == Mode::SDF)
+		coverageToSDF(bitmap, w, h, sdfSpread);
+
+	allocateRect(w, h, glyph.x, glyph.y);
+	for (int y = 0; y < h; y++)
+		std::copy(bitmap.begin() + y * w, bitmap.begin() + (y + 1) * w,
+			pixels.begin() + (glyph.y + y) * width + glyph.x);
+	dirtyBegin = std::min(dirtyBegin, static_cast<uint>(glyph.y));
+	dirtyEnd = std::max(dirtyEnd, static_cast<uint>(glyph.y + h));
+
+	glyph.width = w;
+	glyph.height = h;
+	glyph.left = x0 - sdfSpread;
+	glyph.top = y0 - sdfSpread;
+	return glyph;
+}
+
+void GlyphAtlas::allocateRect(int w, int h, int &x, int &y) {
+	if (w + GLYPH_PADDING > static_cast<int>(width))
+		ERRT("El glifo es demasiado grande para el atlas");
+	if (shelfX + w + GLYPH_PADDING > static_cast<int>(width)) {
+		shelfY += shelfHeight + GLYPH_PADDING;
+		shelfX = 0;
+		shelfHeight = 0;
+	}
+	while (shelfY + h + GLYPH_PADDING > static_cast<int>(height)) {
+		GLint maxSize;
+		glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+		if (2 * height > static_cast<uint>(maxSize))
+			ERRT("El atlas de glifos está lleno");
+		// Las filas nuevas se añaden al final, así que los glifos no se mueven
+		pixels.resize(width * height * 2, 0);
+		height *= 2;
+	}
+	x = shelfX;
+	y = shelfY;
+	shelfX += w + GLYPH_PADDING;
+	shelfHeight = std::max(shelfHeight, h);
+}
+
+glm::vec2 GlyphAtlas::layout(const std::string &text, std::vector<Quad> &quads, uint wrapWidth,
+	float scale) {
+	const size_t first = quads.size();
+	int pen = 0, top = 0, textWidth = 0;
+	// Último espacio de la línea: primer rectángulo detrás de él, y la pluma antes y después
+	bool canBreak = false;
+	size_t breakQuad = 0;
+	int breakBegin = 0, breakEnd = 0;
+
+	size_t i = 0;
+	while (i < text.size()) {
+		const uint32_t cp = decodeUTF8(text, i);
+		if (cp == '\n') {
+			textWidth = std::max(textWidth, pen);
+			pen = 0;
+			top += lineSkip;
+			canBreak = false;
+			continue;
+		}
+		if (cp == '\r')
+			continue;
+		const Glyph &glyph = getGlyph(cp);
+		if (cp == ' ') {
+			canBreak = true;
+			breakQuad = quads.size();
+			breakBegin = pen;
+			breakEnd = pen + glyph.advance;
+			pen = breakEnd;
+			continue;
+		}
+		if (wrapWidth > 0 && canBreak && pen + glyph.advance > static_cast<int>(wrapWidth)) {
+			// La última palabra pasa a la línea siguiente
+			textWidth = std::max(textWidth, breakBegin);
+			const glm::vec2 shift(-breakEnd, lineSkip);
+			for (size_t q = breakQuad; q < quads.size(); q++) {
+				quads[q].min += shift;
+				quads[q].max += shift;
+			}
+			pen -= breakEnd;
+			top += lineSkip;
+			canBreak = false;
+		}
+		if (glyph.width > 0) {
+			Quad quad;
+			quad.min = glm::vec2(pen + glyph.left, top + glyph.top);
+			quad.max = quad.min + glm::vec2(glyph.width, glyph.height);
+			quad.uvMin = glm::vec2(glyph.x, glyph.y);
+			quad.uvMax = quad.uvMin + glm::vec2(glyph.width, glyph.height);
+			quads.push_back(quad);
+		}
+		pen += glyph.advance;
+	}
+	textWidth = std::max(textWidth, pen);
+
+	if (scale != 1.0f) {
+		for (size_t q = first; q < quads.size(); q++) {
+			quads[q].min *= scale;
+			quads[q].max *= scale;
+		}
+	}
+	return glm::vec2(textWidth, top + lineSkip) * scale;
+}
+
+void GlyphAtlas::upload() {
+	if (!texture)
+		texture = std::make_shared<Texture2D>(GL_LINEAR, GL_LINEAR, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE);
+	const bool resized = texture->getWidth() != width || texture->getHeight() != height;
+	if (!resized && dirtyBegin >= dirtyEnd)
+		return;
+
+	PGUPV::GLStateCapturer<PGUPV::ActiveTextureUnitState> restoreActiveTextureUnit;
+	PGUPV::GLStateCapturer<PGUPV::PixelUnpackState> restoreUnpack;
+	glActiveTexture(GL_TEXTURE0 + PGUPV::App::getScratchUnitTextureNumber());
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	if (resized)
+		texture->loadImageFromMemory(pixels.data(), width, height, GL_RED, GL_UNSIGNED_BYTE, GL_R8);
+	else {
+		// Sólo las filas con glifos nuevos
+		glBindTexture(GL_TEXTURE_2D, texture->getId());
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, dirtyBegin, width, dirtyEnd - dirtyBegin, GL_RED,
+			GL_UNSIGNED_BYTE, pixels.data() + dirtyBegin * width);
+	}
+	dirtyBegin = height;
+	dirtyEnd = 0;
+	CHECK_GL();
+}
+
+std::shared_ptr<Texture2D> GlyphAtlas::getTexture() {
+	upload();
+	return texture;
+}
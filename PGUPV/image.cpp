@@ -2,11 +2,15 @@
 #include <sstream>
 #include <iomanip>
 #include <memory.h>
+#include <mutex>
+#include <atomic>
+#include <memory>
 
 
 #include "image.h"
 #include "log.h"
 #include "utils.h"
+#include "pixelKernels.h"
 
 #define GLM_ENABLE_EXPERIMENTAL
 
@@ -27,6 +31,7 @@
 #endif
 
 using PGUPV::Image;
+namespace PixelKernels = PGUPV::PixelKernels;
 
 bool Image::_freeImageInitialized = false;
 
@@ -38,6 +43,12 @@ freeimageImage(nullptr), freeimageMultiImage(nullptr) {
 		ERRT(std::string("No se ha podido cargar la imagen ") + filename);
 }
 
+// Imagen vacía, para cargarla con loadFile
+Image::Image() : _width(0), _height(0), _data(nullptr), _bpp(0), _nfaces(0), _nAnimationFrames(0), _stride(0),
+freeimageImage(nullptr), freeimageMultiImage(nullptr) {
+	initLib();
+}
+
 Image::Image(Image &&other) : _width(other._width), _height(other._height),
 _data(other._data), _bpp(other._bpp), _nfaces(other._nfaces),
 _nAnimationFrames(other._nAnimationFrames), _stride(other._stride),
@@ -68,6 +79,28 @@ Image::~Image() {
 	releaseMemory();
 }
 
+void Image::resize(uint width, uint height, uint bpp) {
+	if (bpp != 8 && bpp != 16 && bpp != 24 && bpp != 32) {
+		ERRT("Sólo se aceptan imágenes en escala de grises de 8 o 16 BPP o RGB de 24 BPP o RGBA de 32 BPP");
+	}
+	const uint stride = width * bpp / 8;
+	const bool reuse = _data != nullptr && freeimageImage == nullptr && freeimageMultiImage == nullptr &&
+		MAX(_nfaces, _nAnimationFrames) == 1 && static_cast<size_t>(_stride) * _height == static_cast<size_t>(stride) * height;
+	if (!reuse) {
+		releaseMemory();
+		freeimageImage = nullptr;
+		freeimageMultiImage = nullptr;
+		_data = new uchar*[1];
+		_data[0] = new uchar[stride * height];
+	}
+	_width = width;
+	_height = height;
+	_bpp = bpp;
+	_stride = stride;
+	_nfaces = 1;
+	_nAnimationFrames = 1;
+}
+
 GLenum Image::getGLPixelBaseType() const {
 	if (freeimageImage != nullptr || freeimageMultiImage != nullptr) {
 		FREE_IMAGE_TYPE type;
@@ -274,7 +307,8 @@ void Image::releaseMemory() {
 	}
 }
 
-static std::string FreeImageErrorMsg;
+// Cada hilo que carga imágenes (p.e., los trabajadores de AssimpWrapper) tiene su mensaje
+static thread_local std::string FreeImageErrorMsg;
 
 void FreeImageErrorHandler(FREE_IMAGE_FORMAT fif, const char *message) {
 	if (fif != FIF_UNKNOWN) {
@@ -286,13 +320,14 @@ void FreeImageErrorHandler(FREE_IMAGE_FORMAT fif, const char *message) {
 }
 
 void Image::initLib() {
-	if (!_freeImageInitialized) {
+	static std::once_flag initialized;
+	std::call_once(initialized, []() {
 #ifndef _WIN32
 		FreeImage_Initialise();
 #endif
 		FreeImage_SetOutputMessage(FreeImageErrorHandler);
 		_freeImageInitialized = true;
-}
+	});
 }
 
 bool Image::loadDDS(const std::string &/*filename*/) {
@@ -324,13 +359,13 @@ bool Image::loadFreeImage(::FIBITMAP *image, const uint frame) {
 	return true;
 }
 
-bool Image::loadSimple(const std::string &filename, const FREE_IMAGE_FORMAT fileType) {
+bool Image::loadSimple(const std::string &filename, const FREE_IMAGE_FORMAT fileType, std::string &error) {
 	if (fileType == FIF_GIF)
 		freeimageImage = FreeImage_Load(fileType, filename.c_str(), GIF_PLAYBACK);
 	else
 		freeimageImage = FreeImage_Load(fileType, filename.c_str());
 	if (freeimageImage == nullptr) {
-		ERR("No se ha podido cargar la imagen " + filename + "Error: " + FreeImageErrorMsg);
+		error = "No se ha podido cargar la imagen " + filename + "Error: " + FreeImageErrorMsg;
 		return false;
 	}
 	_data = new uchar *[1];
@@ -339,20 +374,22 @@ bool Image::loadSimple(const std::string &filename, const FREE_IMAGE_FORMAT file
 	return loadFreeImage(freeimageImage);
 }
 
-bool Image::loadMulti(const std::string &filename, const FREE_IMAGE_FORMAT fileType) {
+bool Image::loadMulti(const std::string &filename, const FREE_IMAGE_FORMAT fileType, std::string &error) {
 	if (fileType == FIF_GIF)
 		freeimageMultiImage = FreeImage_OpenMultiBitmap(fileType, filename.c_str(), false, true, true, GIF_PLAYBACK);
 	else
 		freeimageMultiImage = FreeImage_OpenMultiBitmap(fileType, filename.c_str(), false, true, true);
 
 	if (freeimageMultiImage == nullptr) {
-		ERRT("No se ha podido cargar la imagen " + filename + "Error: " + FreeImageErrorMsg);
+		error = "No se ha podido cargar la imagen " + filename + "Error: " + FreeImageErrorMsg;
+		return false;
 	}
 
 	auto pageCount = FreeImage_GetPageCount(freeimageMultiImage);
 	if (pageCount == 1) {
 		FreeImage_CloseMultiBitmap(freeimageMultiImage);
-		return loadSimple(filename, fileType);
+		freeimageMultiImage = nullptr;
+		return loadSimple(filename, fileType, error);
 	}
 
 	_nAnimationFrames = pageCount;
@@ -372,8 +409,10 @@ bool Image::loadMulti(const std::string &filename, const FREE_IMAGE_FORMAT fileT
 		_stride = FreeImage_GetPitch(dib);
 		FreeImage_UnlockPage(freeimageMultiImage, dib, false);
 	}
-	else
-		ERRT("No se ha podido leer el primer frame de " + filename);
+	else {
+		error = "No se ha podido leer el primer frame de " + filename;
+		return false;
+	}
 
 	// Siempre cargamos el primer frame
 	loadFrameFromMulti(0);
@@ -383,6 +422,15 @@ bool Image::loadMulti(const std::string &filename, const FREE_IMAGE_FORMAT fileT
 // Carga la imagen en el fichero indicado. La imagen que contenía este objeto se destruye (incluyendo el
 // puntero que devolvería getData
 bool Image::load(std::string filename) {
+	std::string error;
+	if (loadFile(filename, error))
+		return true;
+	if (!error.empty())
+		ERR(error);
+	return false;
+}
+
+bool Image::loadFile(const std::string &filename, std::string &error) {
 	releaseMemory();
 
 	if (!fileExists(filename))
@@ -404,20 +452,58 @@ bool Image::load(std::string filename) {
 		return false;
 
 	if (fileType == FIF_GIF || fileType == FIF_ICO || fileType == FIF_TIFF)
-		return loadMulti(filename, fileType);
+		return loadMulti(filename, fileType, error);
 	else
-		return loadSimple(filename, fileType);
+		return loadSimple(filename, fileType, error);
 }
 
-void flipVImage(uchar *data, uint stride, uint height) {
-	uchar *tmp = new uchar[stride];
-	for (uint i = 0; i < height / 2; i++) {
-		// Swap scanlines i and _height-1-i
-		memcpy(tmp, data + stride * i, stride);
-		memcpy(data + stride * i, data + (height - i - 1) * stride, stride);
-		memcpy(data + (height - i - 1) * stride, tmp, stride);
+std::unique_ptr<Image> Image::tryLoad(const std::string &filename, std::string *error) {
+	std::unique_ptr<Image> image(new Image());
+	std::string msg;
+	if (!image->loadFile(filename, msg)) {
+		if (msg.empty())
+			msg = "No se ha podido cargar la imagen " + filename;
 	}
-	delete[] tmp;
+	else if (!image->isSupportedFormat())
+		msg = "Formato de imagen no soportado (" + std::to_string(image->_bpp) + " bpp): " + filename;
+	else
+		return image;
+	if (error)
+		*error = msg;
+	return nullptr;
+}
+
+bool Image::isSupportedFormat() const {
+	if (freeimageImage == nullptr && freeimageMultiImage == nullptr)
+		return _data != nullptr && (_bpp == 8 || _bpp == 16 || _bpp == 24 || _bpp == 32);
+	if (freeimageImage == nullptr && (lockedPages.empty() || lockedPages[0] == nullptr))
+		return false;
+	const FREE_IMAGE_TYPE type = FreeImage_GetImageType(freeimageImage != nullptr ? freeimageImage : lockedPages[0]);
+	switch (type) {
+	case FIT_BITMAP:
+		return _bpp == 8 || _bpp == 16 || _bpp == 24 || _bpp == 32;
+	case FIT_UINT16:
+	case FIT_INT16:
+	case FIT_UINT32:
+	case FIT_INT32:
+	case FIT_FLOAT:
+	case FIT_RGB16:
+	case FIT_RGBF:
+	case FIT_RGBA16:
+	case FIT_RGBAF:
+		return true;
+	default:
+		return false;
+	}
+}
+
+void flipVImage(uchar *data, uint stride, uint height) {
+	PixelKernels::parallelRows(height / 2, 2 * stride, [data, stride, height](uint begin, uint end) {
+		for (uint i = begin; i < end; i++) {
+			// Swap scanlines i and _height-1-i
+			PixelKernels::swapBytes(data + stride * i, data + (height - i - 1) * stride, stride);
+		}
+	});
 }
 
 void Image::flipV() {
@@ -432,18 +518,10 @@ void Image::flipV() {
 }
 
 
-uint maxDiffPixelRow8bpp(uchar *first, uchar *second, uint width) {
-	int maxDifference = 0;
-	for (unsigned int i = 0; i < width; i++) {
-		maxDifference = std::max(maxDifference, std::abs(*first - *second));
-		first++;
-		second++;
-	}
-	return maxDifference;
-}
-
 uint maxDiffPixelRow(uchar *first, uchar *second, uint width, uint bppFirst, uint bppSecond) {
-	if (bppFirst == 8 && bppSecond == 8) return maxDiffPixelRow8bpp(first, second, width);
+	// Sin alfa, la diferencia premultiplicada es la diferencia de los bytes
+	if (bppFirst == bppSecond && bppFirst != 32) return PixelKernels::maxAbsDiff(first, second, width * bppFirst / 8);
+	if (bppFirst == 32 && bppSecond == 32) return PixelKernels::maxPremultipliedDiffRGBA(first, second, width);
 
 	assert((bppFirst == 24 || bppFirst == 32) && (bppSecond == 24 || bppSecond == 32));
 	int maxDiff = 0;
@@ -484,15 +562,20 @@ bool Image::equals(Image &other, uint maxDifference) {
 
 
 	for (uint i = 0; i < _nfaces; i++) {
-		for (uint y = 0; y < _height; y++) {
-			uint d = maxDiffPixelRow(
-				static_cast<uchar *>(getPixels(0, y, i)),
-				static_cast<uchar *>(other.getPixels(0, y, i)),
-				_width, _bpp, other.getBPP());
-			if (d > maxDifference) {
-				INFO("Diferencia máxima encontrada hasta ahora: " + std::to_string(d));
-				return false;
+		// getPixels puede cargar la capa, así que se llama antes de repartir las filas
+		uchar *first = static_cast<uchar *>(getPixels(0, 0, i));
+		uchar *second = static_cast<uchar *>(other.getPixels(0, 0, i));
+		std::atomic<uint> found{ 0 };
+		PixelKernels::parallelRows(_height, _width * MAX(_bpp, other._bpp) / 8, [&](uint begin, uint end) {
+			for (uint y = begin; y < end && found == 0; y++) {
+				uint d = maxDiffPixelRow(first + y * _stride, second + y * other._stride, _width, _bpp, other._bpp);
+				if (d > maxDifference)
+					found = d;
 			}
+		});
+		if (found > 0) {
+			INFO("Diferencia máxima encontrada hasta ahora: " + std::to_string(found.load()));
+			return false;
 		}
 	}
 	return true;
@@ -502,13 +585,12 @@ void Image::swapRB(uint frame)  const {
 	if (_bpp != 24 && _bpp != 32)
 		ERRT("No se puede intercambiar los canales de color de esta imagen");
 	// swap R and B channels
-	for (uint j = 0; j < _height; j++) {
-		unsigned char *first = _data[frame] + _stride * j;
-		for (uint i = 0; i < _width; i++) {
-			std::swap(*first, *(first + 2));
-			first += _bpp / 8;
-		}
-	}
+	uchar *data = _data[frame];
+	const uint stride = _stride, width = _width, bytesPerPixel = _bpp / 8;
+	PixelKernels::parallelRows(_height, stride, [data, stride, width, bytesPerPixel](uint begin, uint end) {
+		for (uint j = begin; j < end; j++)
+			PixelKernels::swapRB(data + stride * j, width, bytesPerPixel);
+	});
 }
 
 bool Image::save(const std::string &filename, uint frame) {
@@ -549,6 +631,13 @@ Image *Image::extractFrame(uint frame) const {
 }
 
 Image *Image::difference(Image &other, bool ignoreAlpha) {
+	const uint outputBPP = !ignoreAlpha && MAX(getBPP(), other.getBPP()) == 32 ? 32 : 24;
+	std::unique_ptr<Image> diff(new Image(getWidth(), getHeight(), outputBPP));
+	difference(other, *diff, ignoreAlpha);
+	return diff.release();
+}
+
+void Image::difference(Image &other, Image &result, bool ignoreAlpha) {
 	if (getWidth() != other.getWidth() || getHeight() != other.getHeight())
 		ERRT("Las imágenes deben tener el mismo tamaño para calcular su diferencia");
 	if (getNumFaces() != 1 || other.getNumFaces() != 1)
@@ -558,34 +647,43 @@ Image *Image::difference(Image &other, bool ignoreAlpha) {
 
 	uint outputBPP = MAX(getBPP(), other.getBPP());
 	if (ignoreAlpha && outputBPP == 32) outputBPP = 24;
-	Image *diff = new Image(getWidth(), getHeight(), outputBPP);
-	uchar *output, *in1, *in2;
+	result.resize(getWidth(), getHeight(), outputBPP);
 	const uint minBPP = MIN(getBPP(), other.getBPP());
 	const uint numChannels = minBPP == 32 ? 4 : 3;
-	for (uint y = 0; y < getHeight(); y++) {
-		output = static_cast<uchar *>(diff->getPixels(0, y));
-		in1 = static_cast<uchar *>(this->getPixels(0, y));
-		in2 = static_cast<uchar *>(other.getPixels(0, y));
-
-		for (uint x = 0; x < getWidth(); x++) {
-			for (uint o = 0; o < numChannels; o++) {
-				*output = static_cast<uint8_t>(abs(*in1 - *in2));
-				output++;
-				in1++;
-				in2++;
+	// getPixels puede cargar la capa, así que se llama antes de repartir las filas
+	uchar *out = static_cast<uchar *>(result.getPixels());
+	uchar *first = static_cast<uchar *>(this->getPixels());
+	uchar *second = static_cast<uchar *>(other.getPixels());
+	PixelKernels::parallelRows(getHeight(), result.getStride(), [&](uint begin, uint end) {
+		uchar *output, *in1, *in2;
+		for (uint y = begin; y < end; y++) {
+			output = out + y * result.getStride();
+			in1 = first + y * getStride();
+			in2 = second + y * other.getStride();
+
+			// Si las tres imágenes tienen el mismo formato, la fila es un solo bloque de bytes
+			if (getBPP() == outputBPP && other.getBPP() == outputBPP) {
+				PixelKernels::absDiff(in1, in2, output, getWidth() * outputBPP / 8);
+				continue;
 			}
-			if (numChannels == 3) {
-				if (this->getBPP() == 32) in1++;
-				if (other.getBPP() == 32) in2++;
-				if (outputBPP == 32) {
-					*output = 255;
+			for (uint x = 0; x < getWidth(); x++) {
+				for (uint o = 0; o < numChannels; o++) {
+					*output = static_cast<uint8_t>(abs(*in1 - *in2));
 					output++;
+					in1++;
+					in2++;
+				}
+				if (numChannels == 3) {
+					if (this->getBPP() == 32) in1++;
+					if (other.getBPP() == 32) in2++;
+					if (outputBPP == 32) {
+						*output = 255;
+						output++;
+					}
 				}
 			}
 		}
-	}
-
-	return diff;
+	});
 }
 
 void Image::loadFrameFromMulti(const unsigned int frame) const {
@@ -595,7 +693,7 @@ void Image::loadFrameFromMulti(const unsigned int frame) const {
 	if (dib) {
 		_data[frame] = FreeImage_GetBits(dib);
 #if FREEIMAGE_COLORORDER==FREEIMAGE_COLORORDER_BGR
-		swapRB(frame);
+		if (_bpp == 24 || _bpp == 32) swapRB(frame);
 #endif
 		if (lockedPages[frame] != nullptr) {
 			FreeImage_UnlockPage(freeimageMultiImage, lockedPages[frame], false);
@@ -644,6 +742,21 @@ Image Image::convert8BPPGrayTo24BPPGray(const Image &src) {
 	return dst;
 }
 
+Image Image::convert24BPPTo32BPP(const Image &src, uint8_t alpha) {
+	if (src._bpp != 24)
+		ERRT("Sólo se pueden convertir imágenes de 24 bpp");
+	Image dst(src._width, src._height, 32);
+
+	uint8_t *dst_pixels = static_cast<uint8_t *>(dst.getPixels());
+	uint8_t *src_pixels = static_cast<uint8_t *>(src.getPixels());
+	PixelKernels::parallelRows(src._height, dst.getStride(), [&](uint begin, uint end) {
+		for (uint y = begin; y < end; y++)
+			PixelKernels::rgbToRGBA(src_pixels + src.getStride() * y, dst_pixels + dst.getStride() * y, src._width, alpha);
+	});
+
+	return dst;
+}
+
 bool Image::save(const std::string & filename, uint32_t width, uint32_t height, uint32_t bpp, uint8_t * bytes)
 {
 	Image tmp(width, height, bpp, bytes);
@@ -651,6 +764,13 @@ bool Image::save(const std::string & filename, uint32_t width, uint32_t height,
 }
 
 
+bool Image::isWritableFormat(const std::string &filename)
+{
+	initLib();
+	auto type = FreeImage_GetFIFFromFilename(filename.c_str());
+	return type != FIF_UNKNOWN && FreeImage_FIFSupportsWriting(type);
+}
+
 bool Image::saveHDR(const std::string& filename, uint32_t width, uint32_t height, uint32_t bpp, const float* bytes)
 {
 	initLib();
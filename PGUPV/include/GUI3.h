@@ -21,6 +21,7 @@
 #include "sceneGraphEditor.h"
 #include "treeWidget.h"
 #include "lineChartWidget.h"
+#include "profilerWidget.h"
 #include "progressBar.h"
 #include "hbox.h"
 #include "fileChooserWidget.h"
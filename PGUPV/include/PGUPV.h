@@ -21,6 +21,9 @@
 #include "texture2DArray.h"
 #include "textureText.h"
 #include "textureVideo.h"
+#include "frameCapture.h"
+#include "textureCache.h"
+#include "sceneCache.h"
 #include "bufferTexture.h"
 #include "log.h"
 #include "interpolators.h"
@@ -31,18 +34,22 @@
 #include "image.h"
 #include "keyboard.h"
 #include "query.h"
+#include "profiler.h"
 #include "glStateCache.h"
 #include "commandLineProcessor.h"
 #include "drawCommand.h"
+#include "meshBuilder.h"
 #include "texture2DBlitter.h"
 #include "material.h"
 #include "pbrMaterial.h"
 #include "uboPBRMaterial.h"
 #include "picker.h"
+#include "bvhPicker.h"
 
 // Animacin
 #include "animationClip.h"
 #include "animationChannel.h"
+#include "bakedAnimationClip.h"
 #include "skeleton.h"
 #include "bone.h"
 #include "uboBones.h"
@@ -54,5 +61,12 @@
 #include "geode.h"
 #include "scene.h"
 #include "nodeVisitor.h"
+#include "frustumCuller.h"
+#include "renderQueue.h"
+#include "instancedModel.h"
+#include "staticSceneBatch.h"
+#include "glyphAtlas.h"
+#include "textBatch.h"
+#include "pixelKernels.h"
 
 #endif
@@ -14,6 +14,15 @@ namespace PGUPV {
 		T value;
 	};
 
+	/**
+	Remembers, for each kind of keyframe of a channel, the keyframe found in the last 
+	interpolation. Consecutive samples usually fall in the same or the next interval, so 
+	keeping a cursor per channel makes forward playback O(1). Any other time point falls back 
+	to a binary search.
+	*/
+	struct KeyFrameCursor {
+		uint32_t position = 0, rotation = 0, scaling = 0;
+	};
 
 	class AnimationChannel {
 	public:
@@ -24,6 +33,9 @@ namespace PGUPV {
 		void addScalingKeyFrame(const KeyFrameValue<glm::vec3> &sca);
 
 		uint32_t getNumFrames() const;
+		const std::vector<KeyFrameValue<glm::vec3>> &getPositionKeyFrames() const { return positions; }
+		const std::vector<KeyFrameValue<glm::quat>> &getRotationKeyFrames() const { return rotations; }
+		const std::vector<KeyFrameValue<glm::vec3>> &getScalingKeyFrames() const { return scalings; }
 
 		/**
 		Return the interpolated position at t 
@@ -49,6 +61,15 @@ namespace PGUPV {
 		\return the interpolated traformation
 		*/
 		glm::mat4 interpolate(float t) const;
+		/**
+		Return the interpolated transformation at t, starting the search of the keyframes
+		at the given cursor
+		\param t time point to interpolate (in ticks)
+		\param cursor [in, out] keyframes used in the last interpolation. It is updated with
+		the keyframes used in this one
+		\return the interpolated traformation
+		*/
+		glm::mat4 interpolate(float t, KeyFrameCursor &cursor) const;
 	private:
 		std::string nodeName;
 		std::vector<KeyFrameValue<glm::vec3>> positions;
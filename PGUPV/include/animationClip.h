@@ -4,6 +4,7 @@
 #include <map>
 #include <memory>
 #include <vector>
+#include <limits>
 #include <glm/fwd.hpp>
 
 namespace PGUPV {
@@ -42,12 +43,30 @@ namespace PGUPV {
 		*/
 		bool interpolate(const float t, const std::string &boneId, glm::mat4 &mat) const;
 
+		/**
+		Convierte un instante de la animacin a ticks del clip
+		\param t instante de la animacin, en segundos. Se tiene en cuenta wrapMode
+		\return el instante correspondiente, en ticks, dentro del intervalo [0, getDurationInTicks()]
+		*/
+		float toTicks(const float t) const;
+
+		static constexpr uint32_t NOCHANNEL = std::numeric_limits<uint32_t>::max();
+		/**
+		Devuelve la posicin del canal que anima el nodo indicado (o NOCHANNEL si no hay ninguno).
+		La posicin es estable mientras no se aadan ms canales al clip, por lo que se puede 
+		usar para acceder al canal sin volver a buscarlo por su nombre.
+		*/
+		uint32_t getChannelIndex(const std::string &name) const;
+		const std::shared_ptr<AnimationChannel> &getAnimationChannel(uint32_t index) const {
+			return channels[index];
+		}
 		const std::shared_ptr<AnimationChannel> getAnimationChannel(const std::string &name) const;
 		const std::vector<std::shared_ptr<AnimationChannel>> getAnimationChannels() const;
 	private:
 		std::string id;
 		float totalTicks, ticksPerSec;
-		std::map<std::string, std::shared_ptr<AnimationChannel>> channels;
+		std::vector<std::shared_ptr<AnimationChannel>> channels;
+		std::map<std::string, uint32_t> channelIndex;
 		WrapMode wrapMode;
 	};
 };
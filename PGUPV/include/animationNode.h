@@ -7,14 +7,37 @@ namespace PGUPV {
 	class AnimatorController;
 	class NodeVisitor;
 	class Mesh;
+	class BoundAnimationClip;
+	class BakedAnimationClip;
 
 	class AnimationNode : public Node {
 	public:
 		AnimationNode(std::shared_ptr<Node> root);
+		~AnimationNode();
 		void setAnimatorController(std::shared_ptr<AnimatorController> animatorController);
 		std::shared_ptr<AnimatorController> getAnimatorController() {
 			return animController;
 		}
+		/**
+		Establece la versión precalculada del clip de animación que se usará para animar el subgrafo
+		(ver BakedAnimationClip). Sólo se usará mientras el clip del estado actual del animador sea
+		el clip a partir del que se construyó. Se puede compartir entre varios AnimationNode.
+		*/
+		void setBakedAnimationClip(std::shared_ptr<BakedAnimationClip> bakedClip);
+		/**
+		Calcula las matrices de los huesos de todas las mallas del subgrafo en el instante actual
+		de la animación. No hace llamadas a OpenGL, así que se puede llamar desde cualquier hilo.
+		Si no se ha llamado en el fotograma actual, la llama render (Scene::update la llama en 
+		paralelo para todos los AnimationNode de la escena).
+		*/
+		void updateBoneMatrices();
+		/**
+		Calcula las matrices de los huesos de los nodos indicados, repartiendo el trabajo entre 
+		los hilos de ThreadPool::getInstance(). Los nodos que comparten AnimatorController se 
+		calculan en el mismo hilo.
+		*/
+		static void updateBoneMatrices(const std::vector<AnimationNode *> &nodes);
+		//! Dibuja las mallas con las matrices de los huesos calculadas por updateBoneMatrices
 		void render() override;
 		void accept(NodeVisitor &dispatcher) override;
 		void ascend(NodeVisitor &visitor) override;
@@ -24,9 +47,17 @@ namespace PGUPV {
 		void recomputeBoundingSphere() override;
 	private:
 		void build();
+		void bindAnimationClip();
 		std::shared_ptr<Node> subScene;
 		std::shared_ptr<AnimatorController> animController;
 		std::map<Mesh *, glm::mat4> worldMatrix, inverseWorldMatrix;
 		std::vector<Mesh *> meshes;
+		std::unique_ptr<BoundAnimationClip> boundClip;
+		std::shared_ptr<BakedAnimationClip> bakedClip;
+		// Matrices de los huesos de cada malla (en el orden de meshes)
+		std::vector<std::vector<glm::mat4>> bonePalettes;
+		// Fotograma en el que se calcularon las matrices de los huesos
+		unsigned long bonesFrame;
+		bool bonesValid;
 	};
 };
@@ -2,8 +2,11 @@
 
 #include <string>
 #include <memory>
+#include <vector>
 #include <glm/fwd.hpp>
 
+#include "animationChannel.h"
+
 namespace PGUPV {
 	class AnimationClip;
 	class AnimatorState {
@@ -22,12 +25,20 @@ namespace PGUPV {
 		\return true si el clip de animacin tiene datos para el hueso indicado, o false en otro caso
 		*/
 		bool interpolate(const std::string &boneId, glm::mat4 &mat) const;
+		//! Devuelve el instante actual de la animacin, en segundos
+		float getTime() const { return animationTime / 1000.f; }
+		/**
+		Devuelve los cursores de los canales del clip (uno por canal, en el orden del clip), 
+		que recuerdan los ltimos keyframes usados para acelerar la siguiente interpolacin
+		*/
+		std::vector<KeyFrameCursor> &getKeyFrameCursors();
 		void reset();
 	private:
 		std::string stateName;
 		std::shared_ptr<AnimationClip> animationClip;
 		float animationSpeed;
 		uint64_t animationTime;
+		std::vector<KeyFrameCursor> cursors;
 	};
 
 	class Group;
@@ -149,6 +149,13 @@ namespace PGUPV {
 
     void setFramesToLive(long frames);
     void captureSnapshots(PGUPV::Intervals ints);
+    /**
+    Hace que los fotogramas indicados con captureSnapshots (o con la opción -snap) se guarden
+    en un vídeo, en lugar de en ficheros de imagen
+    \param path fichero de vídeo (el formato depende de la extensión, p.e., .mp4)
+    \param fps fotogramas por segundo del vídeo
+    */
+    void captureSnapshotsToVideo(const std::string &path, unsigned int fps = 30);
     // Devuelve el frame actual
     ulong getCurrentFrame() { return _current_frame; };
 
@@ -377,6 +384,12 @@ namespace PGUPV {
     uint initX, initY, initWidth, initHeight;
     int64_t ftl;
     Intervals snapshots;
+    // Fichero de vídeo en el que se guardan las capturas de snapshots (vacío para guardar imágenes)
+    std::string snapshotsVideo;
+    unsigned int snapshotsVideoFps;
+    // true cuando ya se ha empezado a grabar snapshotsVideo. Si el vídeo termina antes (p.e.,
+    // porque ha cambiado el tamaño de la ventana), no se vuelve a empezar: se perdería lo grabado
+    bool snapshotsVideoStarted;
     int preferredMajorGLVer, preferredMinorGLVer, minimumGLVer;
     void destroy(void);
     std::vector<std::function<void()>> onShutdownFunctions;
@@ -11,6 +11,7 @@
 #include <assimp/Exporter.hpp>
 
 #include "fileFormats.h"
+#include "meshBuilder.h"
 
 struct aiScene;
 struct aiMaterial;
@@ -24,10 +25,13 @@ namespace PGUPV {
   class Node;
   class Mesh;
   class Skeleton;
+  class Texture2D;
+  class Image;
 
   class AssimpWrapper {
   public:
     AssimpWrapper();
+    ~AssimpWrapper();
     /**
       Opciones de postprocesado de una escena:
       NONE: no se aplica ningún postprocesado a la escena
@@ -40,13 +44,41 @@ namespace PGUPV {
       NONE, FAST, MEDIUM, HIGHEST_QUALITY
     };
 
+    /**
+      Cómo se guardan los vértices de las mallas en la GPU:
+      SEPARATE: un buffer object por atributo
+      INTERLEAVED: los vértices de todas las mallas de la escena, intercalados en un único
+          buffer object (ver MeshBuilder)
+      COMPACT: igual que el anterior, pero con formatos compactos (MeshBuilder::PACK_ALL)
+    */
+    enum class VertexLayout {
+      SEPARATE, INTERLEAVED, COMPACT
+    };
+
     /**
     Carga una escena desde el fichero indicado
     \param filename ruta del fichero a cargar
     \param options Postprocesado a realizar sobre la escena (por defecto,
       LoadOptions::MEDIUM)
+    \param layout forma de guardar los vértices en la GPU
+    */
+    std::shared_ptr<Scene> load(const std::string &filename, LoadOptions options = LoadOptions::MEDIUM,
+      VertexLayout layout = VertexLayout::SEPARATE);
+
+    /**
+    Primera fase de la carga (load = prepare + finish): lee el fichero, prepara los índices, las
+    coordenadas de textura y los huesos de las mallas y decodifica las imágenes de las texturas,
+    repartiendo el trabajo entre los hilos de ThreadPool::getInstance(). No hace llamadas a
+    OpenGL, así que se puede ejecutar en cualquier hilo (ver FileLoader::loadAsync).
+    Si no puede leer el fichero lanza std::runtime_error, sin mostrar el error al usuario.
     */
-    std::shared_ptr<Scene> load(const std::string &filename, LoadOptions options = LoadOptions::MEDIUM);
+    void prepare(const std::string &filename, LoadOptions options = LoadOptions::MEDIUM,
+      VertexLayout layout = VertexLayout::SEPARATE);
+    /**
+    Segunda fase de la carga: crea los materiales, las texturas y las mallas de la escena
+    preparada por AssimpWrapper::prepare. Sólo se puede llamar desde el hilo principal.
+    */
+    std::shared_ptr<Scene> finish();
 
 	std::vector<ExportFileFormat> listSupportedExportFormat();
 
@@ -59,12 +91,65 @@ namespace PGUPV {
 	bool save(const std::string &path, const std::string &id, std::shared_ptr<Scene> scene);
 
   private:
+    // SceneCache guarda los datos preparados en el formato .pgscene
+    friend class SceneCache;
+
+    static std::string findTexture(const std::string &filename, const std::string &modelfilename);
+
+    // Índices, coordenadas de textura y huesos de una malla, en el formato de PGUPV
+    struct PreparedMesh {
+      std::vector<unsigned int> indices;
+      std::vector<glm::vec2> texCoords[NUM_TEX_COORD];
+      std::shared_ptr<Skeleton> skeleton;
+      std::vector<glm::uvec4> boneIds;
+      std::vector<glm::vec4> boneWeights;
+    };
+
+    // Una textura de un material. image es su posición en Prepared::images
+    struct PreparedTexture {
+      unsigned int material;
+      unsigned int textureUnit;
+      // La ruta tal como aparece en el modelo, y la del fichero encontrado por findTexture
+      std::string name, path;
+      size_t image;
+    };
+
+    // Un fichero de imagen distinto, que puede estar usado por varias texturas de la escena
+    struct PreparedImage {
+      std::string path;
+      // La textura, si ya estaba en la caché (o cuando se ha creado en finish)
+      std::shared_ptr<Texture2D> texture;
+      // La imagen decodificada, si no estaba en la caché (nula si no se ha podido cargar)
+      std::unique_ptr<Image> image;
+      // Si no se ha podido cargar, el motivo (se avisa en finish, desde el hilo principal)
+      std::string error;
+    };
+
+    // Datos calculados en prepare que usa finish
+    struct Prepared {
+      VertexLayout layout;
+      // Con VertexLayout::SEPARATE
+      std::vector<PreparedMesh> meshes;
+      // Con VertexLayout::INTERLEAVED y COMPACT
+      std::vector<MeshBuilder> builders;
+      std::vector<PreparedTexture> textures;
+      std::vector<PreparedImage> images;
+      // Pesos de huesos ignorados en cada malla (de vértices con más de 4 huesos). Se avisa en
+      // finish, desde el hilo principal
+      std::vector<uint32_t> ignoredBoneWeights;
+    };
+
+    void prepareMeshes();
+    void prepareTextures();
     void loadMaterials();
 	void loadMeshes();
+	// Crea las mallas con los vértices intercalados (ver MeshBuilder)
+	void loadInterleavedMeshes();
 	void saveMeshes(aiScene *assScene, Scene &scene);
 	void loadAnimations();
-    void loadTextures(const aiMaterial *aimat, Material &pgmat);
-    void loadPBRTextures(const aiMaterial *aimat, PBRMaterial &pgmat);
+    // Asigna al material las texturas decodificadas en prepare
+    template <typename M>
+    void loadTextures(unsigned int materialIndex, M &pgmat);
 
 	Assimp::Exporter &getExporter();
 	std::shared_ptr<Skeleton> buildSkeleton(const struct aiMesh *mesh);
@@ -73,8 +158,10 @@ namespace PGUPV {
     const aiScene* scene;
     std::shared_ptr<Scene> result;
     std::string _filename;
-    static Assimp::Importer importer;
+    // Cada cargador tiene el suyo, para poder cargar varias escenas a la vez
+    Assimp::Importer importer;
 	std::unique_ptr<Assimp::Exporter> exporter;
+    std::unique_ptr<Prepared> prepared;
     std::vector<std::shared_ptr<Mesh>> tempMeshes;
   };
 };
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <glm/vec3.hpp>
+#include <glm/mat4x4.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+namespace PGUPV {
+	class AnimationClip;
+
+	/**
+	Transformación de un canal de animación, descompuesta en traslación, rotación y escalado
+	*/
+	struct TRS {
+		glm::vec3 translation;
+		glm::quat rotation;
+		glm::vec3 scaling;
+		//! Devuelve la matriz translate * rotate * scale
+		glm::mat4 toMatrix() const;
+	};
+
+	/**
+	Versión precalculada de un AnimationClip, pensada para animar muchos personajes en la CPU.
+
+	Todos los canales del clip se remuestrean a una frecuencia fija, y los valores se guardan
+	en estructura de arrays: para cada fotograma, cada componente (tx, ty, tz, qx, qy, qz, qw,
+	sx, sy, sz) ocupa un array contiguo con un valor por canal. Así, el muestreo de todos
+	los canales en un instante se hace de cuatro en cuatro canales con SSE2 (o con código
+	escalar si no está disponible), interpolando linealmente entre los dos fotogramas más
+	cercanos (nlerp para las rotaciones).
+
+	Opcionalmente, los valores se cuantizan a 16 bits: los cuaterniones como enteros
+	normalizados con signo, y las traslaciones y escalados relativos al rango [min, max] de
+	cada componente de cada canal. Eso reduce la memoria a menos de la mitad.
+
+	Los canales están en el mismo orden que en el clip original (ver AnimationClip::getChannelIndex)
+	*/
+	class BakedAnimationClip {
+	public:
+		/**
+		Construye la versión precalculada del clip
+		\param clip clip original
+		\param samplesPerSecond frecuencia de remuestreo
+		\param quantize si es true, los valores se guardan con 16 bits
+		*/
+		static std::shared_ptr<BakedAnimationClip> build(std::shared_ptr<AnimationClip> clip,
+			float samplesPerSecond = 30.0f, bool quantize = true);
+		std::shared_ptr<AnimationClip> getAnimationClip() const { return clip; }
+		uint32_t getNumChannels() const { return numChannels; }
+		uint32_t getNumFrames() const { return numFrames; }
+		bool isQuantized() const { return quantized; }
+		//! Memoria ocupada por los fotogramas, en bytes
+		size_t getSizeInBytes() const;
+		/**
+		Calcula la transformación de todos los canales en el instante indicado
+		\param ticks instante, en ticks del clip original (ver AnimationClip::toTicks)
+		\param result [out] transformación de cada canal. Se redimensiona al número de canales
+		*/
+		void sample(float ticks, std::vector<TRS> &result) const;
+
+		// Número de componentes por canal y fotograma
+		static const uint32_t NUM_COMPONENTS = 10;
+	private:
+		BakedAnimationClip() = default;
+		void quantizeFrames(const std::vector<float> &values);
+		std::shared_ptr<AnimationClip> clip;
+		uint32_t numChannels = 0, numFrames = 0;
+		// Número de canales redondeado al siguiente múltiplo de 4
+		uint32_t stride = 0;
+		float framesPerTick = 0.0f;
+		bool quantized = false;
+		// (frame * NUM_COMPONENTS + componente) * stride + canal
+		std::vector<float> frames;
+		std::vector<uint16_t> quantizedFrames;
+		// Rango de cada componente de traslación y escalado: componente * stride + canal
+		std::vector<float> rangeMin, rangeExtent;
+	};
+};
@@ -22,6 +22,9 @@ namespace PGUPV {
 		//! Desvincula las texturas que se asociaron con este material
 		virtual void unuse() = 0;
 
+		//! true si las mallas con este material se deben dibujar con mezcla de colores (ver RenderQueue)
+		virtual bool isTransparent() const { return false; }
+
 	protected:
 		std::string name;
 	};
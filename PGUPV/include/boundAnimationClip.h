@@ -0,0 +1,87 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <limits>
+#include <glm/mat4x4.hpp>
+
+namespace PGUPV {
+	struct KeyFrameCursor;
+	class AnimationClip;
+	class Node;
+	class Transform;
+	class Mesh;
+	class Bone;
+	class AnimatorState;
+	class BakedAnimationClip;
+	struct TRS;
+
+	/**
+	Clip de animación enlazado a un subgrafo de escena concreto. Al construirlo se resuelve,
+	una única vez, qué canal del clip anima cada nodo Transform del subgrafo, y qué hueso de
+	cada malla se corresponde con cada nodo. El muestreo de la animación recorre después
+	arrays densos indexados por enteros, sin buscar canales ni huesos por su nombre.
+
+	Si se modifica la estructura del subgrafo (se añaden o quitan nodos Transform), hay que
+	volver a construir el objeto.
+	*/
+	class BoundAnimationClip {
+	public:
+		/**
+		\param clip clip de animación a enlazar (puede ser nulo: los nodos conservan su transformación)
+		\param root raíz del subgrafo animado
+		\param meshes mallas del subgrafo. El orden define el índice que se usará en getBoneMatrices
+		*/
+		BoundAnimationClip(std::shared_ptr<AnimationClip> clip, Node &root, const std::vector<Mesh *> &meshes);
+		~BoundAnimationClip();
+		std::shared_ptr<AnimationClip> getAnimationClip() const { return clip; }
+		/**
+		Establece la versión precalculada del clip que se usará para muestrear la animación 
+		(o ninguna, si es nulo). Tiene que haberse construido a partir del clip enlazado
+		*/
+		void setBakedAnimationClip(std::shared_ptr<BakedAnimationClip> bakedClip);
+		/**
+		Calcula la matriz del sistema de coordenadas de cada nodo Transform del subgrafo,
+		relativa a la raíz, en el instante indicado
+		\param t instante de la animación, en segundos. Se tiene en cuenta el wrapMode del clip
+		*/
+		void sample(float t);
+		/**
+		Igual que sample(float), pero en el instante actual del estado indicado, y usando sus cursores
+		para no buscar desde el principio los keyframes de cada canal
+		\param state estado del animador. Su clip tiene que ser el enlazado con este objeto
+		*/
+		void sample(AnimatorState &state);
+		/**
+		Escribe en boneMatrices las matrices de los huesos de la malla indicada, a partir de la
+		última llamada a sample. Las posiciones de huesos que no tengan un nodo asociado no se modifican
+		\param mesh índice de la malla, en el vector proporcionado en el constructor
+		\param boneMatrices [out] vector con, al menos, tantos elementos como huesos tiene la malla
+		*/
+		void getBoneMatrices(size_t mesh, std::vector<glm::mat4> &boneMatrices) const;
+		size_t getNumNodes() const { return nodes.size(); }
+
+		static constexpr uint32_t NOPARENT = std::numeric_limits<uint32_t>::max();
+	private:
+		class Builder;
+		struct BoundNode {
+			Transform *transform;
+			// Posición del padre en nodes (los padres siempre aparecen antes que sus hijos)
+			uint32_t parent;
+			// Posición del canal en el clip, o AnimationClip::NOCHANNEL
+			uint32_t channel;
+		};
+		struct BoundBone {
+			uint32_t node;
+			uint32_t bone;
+			const Bone *b;
+		};
+		std::shared_ptr<AnimationClip> clip;
+		std::shared_ptr<BakedAnimationClip> baked;
+		std::vector<TRS> bakedSamples;
+		std::vector<BoundNode> nodes;
+		std::vector<glm::mat4> nodeMatrices;
+		std::vector<std::vector<BoundBone>> meshBones;
+		void sample(float t, KeyFrameCursor *cursors);
+	};
+};
@@ -45,6 +45,10 @@ namespace PGUPV {
     */
     glm::vec3 getCenter() const { return (max + min) / 2.0f; }
     /**
+    \return la mitad del tamaño de la caja en cada eje
+    */
+    glm::vec3 getExtent() const { return (max - min) / 2.0f; }
+    /**
     Coordenadas de la esquina inferior izquierda posterior y de la superior derecha anterior
     */
     glm::vec3 min, max;
@@ -65,7 +69,9 @@ namespace PGUPV {
       max = glm::vec3(-FLT_MAX);
     }
     /**
-    Aplica la transformación a la caja de inclusión
+    Aplica la transformación a la caja de inclusión. Si la transformación es afín, la nueva
+    caja se calcula a partir del centro y la semiextensión (método de Arvo), sin transformar
+    las esquinas
     */
     void transform(const glm::mat4 &xform);
     /**
@@ -74,6 +80,10 @@ namespace PGUPV {
     cara inferior. Empieza por el vértice superior izquierdo anterior.
     */
     std::vector<glm::vec4> getVertices() const;
+    /**
+    Igual que getVertices, pero escribe las esquinas en el array indicado, sin reservar memoria
+    */
+    void getCorners(glm::vec4 (&corners)[8]) const;
   };
 
   /*
@@ -101,8 +111,36 @@ namespace PGUPV {
   BoundingSphere computeBoundingSphere(const float *v, uint ncomponents, size_t n);
 
   //! \return true, si la caja de inclusión interseca con el volumen de la vista definido por mvp (producto
-  //! de las matrices model, view y projection.
+  //! de las matrices model, view y projection. Si hay que comprobar varias cajas con la misma matriz, es
+  //! más eficiente construir un Frustum y usar Frustum::classify
   bool overlapsViewVolume(const BoundingBox &bb, const glm::mat4& mvp);
+
+  /*
+  Volumen de la vista representado por sus seis planos (izquierdo, derecho, inferior, superior,
+  cercano y lejano), extraídos de la matriz de proyección según el método de Gribb y Hartmann.
+  Si la matriz es el producto de las matrices model, view y projection, los planos están en el
+  sistema de coordenadas del modelo, y se pueden comparar directamente con sus volúmenes de
+  inclusión. Las normales de los planos están normalizadas y apuntan hacia el interior.
+
+  Las pruebas con cajas y esferas comparan cuatro planos a la vez con SSE2, si está disponible.
+  */
+  struct Frustum {
+    enum class Result { OUTSIDE, INTERSECTS, INSIDE };
+    explicit Frustum(const glm::mat4 &mvp);
+    //! \return si la caja está fuera del volumen, lo corta o está completamente dentro
+    Result classify(const BoundingBox &bb) const;
+    //! \return si la esfera está fuera del volumen, lo corta o está completamente dentro
+    Result classify(const BoundingSphere &bs) const;
+    // (a, b, c, d), tal que ax + by + cz + d >= 0 para los puntos del interior
+    glm::vec4 planes[6];
+  private:
+    // Comprueba la caja centrada en center, con semiextensión extent, agrandada radius unidades
+    Result classify(const glm::vec3 &center, const glm::vec3 &extent, float radius) const;
+    // Planos en estructura de arrays: componente * NUM_SOA_PLANES + plano. Se añaden dos
+    // planos que no descartan nada para poder procesarlos de cuatro en cuatro
+    static const int NUM_SOA_PLANES = 8;
+    float soa[4 * NUM_SOA_PLANES];
+  };
 };
 
 
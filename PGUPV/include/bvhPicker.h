@@ -0,0 +1,109 @@
+#pragma once
+
+#include <memory>
+
+#include <glm/vec3.hpp>
+#include <glm/mat4x4.hpp>
+
+#include "picker.h"
+#include "drawCommand.h"
+
+namespace PGUPV {
+	class Node;
+	class Geode;
+	class Mesh;
+
+	/**
+	\class BVHPicker
+
+	Picking en la CPU, sin dibujar nada ni leer de la GPU: lanza un rayo desde la posición del
+	clic y lo interseca con los triángulos de las mallas de la escena. Los triángulos de cada
+	Mesh (los que devuelven los DrawCommand::getTrianglesIndices de la malla) se organizan en
+	una jerarquía de volúmenes de inclusión (BVH) en el espacio del objeto, que se construye
+	una vez por malla y se comparte entre todos los Geode que la usan. Encima de ellas hay otra
+	BVH con las cajas de inclusión de cada malla en el espacio del mundo.
+
+	update recorre la escena: si sólo han cambiado las matrices de los Transform, reajusta las
+	cajas de las mallas afectadas y las de sus antecesores en la BVH de la escena, sin
+	reconstruir nada. Así se puede hacer picking en todos los fotogramas (p.e., para resaltar
+	el objeto bajo el ratón).
+
+	Ejemplo de uso:
+
+	BVHPicker picker;
+	picker.setScene(scene->getRoot());
+	...
+	picker.update(); // una vez por fotograma, o antes de cada pick
+	auto hit = picker.pick(Picker::PickData{x, y, windowWidth, windowHeight}, view, proj);
+	if (hit.isValid()) {
+		// se ha hecho clic sobre el triángulo hit.triangle de la malla hit.mesh del nodo hit.node
+	}
+
+	\warning Los triángulos se leen de los buffers de la malla la primera vez que aparece en la
+	escena: si se cambian sus vértices o índices hay que llamar a invalidateMesh. Las mallas con
+	huesos se intersecan en su pose de reposo. Sólo se tienen en cuenta las primitivas de tipo
+	triángulo (GL_TRIANGLES, GL_TRIANGLE_STRIP y GL_TRIANGLE_FAN).
+	*/
+	class BVHPicker {
+	public:
+		struct Ray {
+			glm::vec3 origin;
+			glm::vec3 direction; // normalizada
+		};
+
+		/**
+		Resultado de la intersección del rayo con la escena
+		*/
+		struct Hit {
+			Geode *node;      // nodo que contiene la malla (nullptr si el rayo no toca nada)
+			Mesh *mesh;       // malla intersecada
+			uint meshIndex;   // posición de la malla en el Model del nodo
+			// Triángulo intersecado: posición en la lista formada por los triángulos de los
+			// DrawCommand de la malla, en orden, y los índices de sus vértices
+			uint triangle;
+			TriangleIndices vertices;
+			glm::vec3 barycentrics; // pesos de cada vértice del triángulo en el punto de corte
+			float distance;         // distancia desde el origen del rayo, en el espacio del mundo
+			glm::vec3 position;     // punto de corte en el espacio del mundo
+			bool isValid() const { return node != nullptr; }
+		};
+
+		BVHPicker();
+		~BVHPicker();
+		/**
+		Establece la escena sobre la que se hará picking. La BVH se construye en la siguiente
+		llamada a update
+		*/
+		void setScene(std::shared_ptr<Node> root);
+		/**
+		Actualiza la BVH con el estado actual de la escena. Tiene que llamarse desde el hilo con el
+		contexto de OpenGL (la primera vez que aparece una malla se leen sus buffers)
+		*/
+		void update();
+		/**
+		Descarta la BVH de la malla, para que se vuelva a construir en el siguiente update
+		*/
+		void invalidateMesh(Mesh *mesh);
+		/**
+		Calcula el triángulo más cercano que se ve en el píxel indicado
+		\param pick información sobre la posición del clic
+		\param viewMatrix la matriz view de la cámara
+		\param projMatrix la matriz projection de la cámara
+		*/
+		Hit pick(const Picker::PickData &pick, const glm::mat4 &viewMatrix, const glm::mat4 &projMatrix) const;
+		//! Calcula la primera intersección del rayo con la escena
+		Hit intersect(const Ray &ray) const;
+		//! Construye el rayo que pasa por el centro del píxel indicado
+		static Ray makeRay(const Picker::PickData &pick, const glm::mat4 &viewMatrix, const glm::mat4 &projMatrix);
+
+		//! Número de mallas en la escena (en la última llamada a update)
+		size_t getNumInstances() const;
+		//! Número de triángulos de las mallas distintas de la escena
+		size_t getNumTriangles() const;
+	private:
+		BVHPicker(const BVHPicker &) = delete;
+		BVHPicker &operator=(const BVHPicker &) = delete;
+		class BVHPickerImpl;
+		std::unique_ptr<BVHPickerImpl> pimpl;
+	};
+};
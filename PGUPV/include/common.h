@@ -26,6 +26,10 @@
 #define UBO_PBR_MATERIALS_BINDING_INDEX 4
 #define UBO_PBR_LIGHTS_BINDING_INDEX 5
 
+// Puntos de vinculación globales para bloques de almacenamiento (shader storage blocks)
+#define SSBO_INSTANCES_BINDING_INDEX 0
+#define SSBO_DRAW_DATA_BINDING_INDEX 1
+
 #ifndef uchar
 typedef unsigned char uchar;
 #endif
@@ -29,6 +29,14 @@ namespace PGUPV {
     virtual ~DrawCommand() {};
     void render();
     virtual void renderFunc() = 0;
+    /**
+    Dibuja la orden varias veces con una sola llamada (glDraw*Instanced). Los shaders
+    distinguen cada instancia con gl_InstanceID (ver InstancedModel)
+    \param instances número de instancias
+    */
+    void renderInstanced(GLsizei instances);
+    //! Por defecto lanza una excepción: las subclases que admiten instancias la redefinen
+    virtual void renderInstancedFunc(GLsizei instances);
     void setVerticesPerPatch(GLint nvertices) { verticesPerPatch = nvertices; };
     GLint getVerticesPerPatch() const { return verticesPerPatch; };
     /**
@@ -86,6 +94,9 @@ namespace PGUPV {
     virtual void renderFunc() override {
       glDrawArrays(mode, first, count);
     }
+    void renderInstancedFunc(GLsizei instances) override {
+      glDrawArraysInstanced(mode, first, count, instances);
+    }
     std::vector<TriangleIndices> getTrianglesIndices(void *indicesBuffer) override;
   private:
     GLint first; GLsizei count;
@@ -112,6 +123,9 @@ namespace PGUPV {
     void renderFunc() override {
       glDrawElements(mode, count, type, offset);
     }
+    void renderInstancedFunc(GLsizei instances) override {
+      glDrawElementsInstanced(mode, count, type, offset, instances);
+    }
     std::vector<TriangleIndices> getTrianglesIndices(void *indicesBuffer) override;
   private:
     GLsizei count; GLenum type; const void *offset;
@@ -141,6 +155,9 @@ namespace PGUPV {
     virtual void renderFunc() override {
       glDrawElementsBaseVertex(mode, count, type, offset, basevertex);
     }
+    void renderInstancedFunc(GLsizei instances) override {
+      glDrawElementsInstancedBaseVertex(mode, count, type, offset, instances, basevertex);
+    }
   private:
     GLsizei count; GLenum type; GLvoid *offset; GLint basevertex;
   };
@@ -171,6 +188,10 @@ namespace PGUPV {
     virtual void renderFunc() override {
       glDrawRangeElements(mode, start, end, count, type, offset);
     }
+    // No hay versión con instancias de glDrawRangeElements
+    void renderInstancedFunc(GLsizei instances) override {
+      glDrawElementsInstanced(mode, count, type, offset, instances);
+    }
   private:
     GLuint start; GLuint end; GLsizei count; GLenum type; const void *offset;
   };
@@ -201,6 +222,9 @@ namespace PGUPV {
     virtual void renderFunc() override {
       glDrawRangeElementsBaseVertex(mode, start, end, count, type, offset, basevertex);
     }
+    void renderInstancedFunc(GLsizei instances) override {
+      glDrawElementsInstancedBaseVertex(mode, count, type, offset, instances, basevertex);
+    }
   private:
     GLuint start; GLuint end; GLsizei count; GLenum type; GLvoid  *offset;
     GLint basevertex;
@@ -228,6 +252,10 @@ namespace PGUPV {
     virtual void renderFunc() override {
       glMultiDrawArrays(mode, &first[0], &count[0], primcount);
     }
+    void renderInstancedFunc(GLsizei instances) override {
+      for (GLsizei i = 0; i < primcount; i++)
+        glDrawArraysInstanced(mode, first[i], count[i], instances);
+    }
   private:
     GLsizei primcount;
     std::vector<GLint> first;
@@ -259,6 +287,10 @@ namespace PGUPV {
     virtual void renderFunc() override {
       glMultiDrawElements(mode, &count[0], type, &indices[0], primcount);
     }
+    void renderInstancedFunc(GLsizei instances) override {
+      for (GLsizei i = 0; i < primcount; i++)
+        glDrawElementsInstanced(mode, count[i], type, indices[i], instances);
+    }
   private:
 
     std::vector<GLint> count;
@@ -296,6 +328,10 @@ namespace PGUPV {
     virtual void renderFunc() override {
       glMultiDrawElementsBaseVertex(mode, &count[0], type, &indices[0], primcount, &baseVertex[0]);
     }
+    void renderInstancedFunc(GLsizei instances) override {
+      for (GLsizei i = 0; i < primcount; i++)
+        glDrawElementsInstancedBaseVertex(mode, count[i], type, indices[i], instances, baseVertex[i]);
+    }
   private:
 
     std::vector<GLint> count;
@@ -1,20 +1,87 @@
 #pragma once
 #include <string>
 #include <memory>
+#include <future>
 
 #include "assimpWrapper.h"
 
 namespace PGUPV {
 	class Scene;
 
+	/**
+	\class PendingScene
+	Escena que se está cargando en segundo plano (ver FileLoader::loadAsync). La aplicación
+	puede seguir dibujando mientras tanto, y consultar en cada fotograma si ya está lista:
+
+	auto pending = FileLoader::loadAsync("modelo.obj");
+	...
+	if (pending && pending->isReady()) {
+	  model = pending->get();
+	  pending.reset();
+	}
+	*/
+	class PendingScene {
+	public:
+		//! true si ya ha terminado la parte de la carga que se hace en segundo plano
+		bool isReady() const;
+		/**
+		Termina la carga, creando los objetos de OpenGL de la escena, y la devuelve. Si la
+		parte en segundo plano no ha terminado, espera. Sólo se puede llamar desde el hilo
+		principal. Las siguientes llamadas devuelven la misma escena.
+		*/
+		std::shared_ptr<Scene> get();
+	private:
+		friend class FileLoader;
+		PendingScene(const std::string &path, AssimpWrapper::LoadOptions options, AssimpWrapper::VertexLayout layout) :
+			path(path), options(options), layout(layout) {}
+		std::string path;
+		AssimpWrapper::LoadOptions options;
+		AssimpWrapper::VertexLayout layout;
+		// Si es nullptr, la escena se lee de su .pgscene en get()
+		std::shared_ptr<AssimpWrapper> loader;
+		std::future<void> prepared;
+		std::shared_ptr<Scene> scene;
+	};
+
 	class FileLoader {
 	public:
-		static std::shared_ptr<Scene> load(const std::string &path, AssimpWrapper::LoadOptions options = AssimpWrapper::LoadOptions::MEDIUM);
+		/**
+		Carga la escena del fichero indicado. Si junto al modelo hay un .pgscene (ver SceneCache)
+		más reciente y guardado con las mismas opciones, se carga desde él. Si no, se importa
+		con Assimp y se genera el .pgscene para la próxima vez.
+		*/
+		static std::shared_ptr<Scene> load(const std::string &path, AssimpWrapper::LoadOptions options = AssimpWrapper::LoadOptions::MEDIUM,
+			AssimpWrapper::VertexLayout layout = AssimpWrapper::VertexLayout::SEPARATE);
+		/**
+		Empieza a cargar la escena en los hilos de ThreadPool::getInstance() y vuelve
+		inmediatamente. Cuando PendingScene::isReady devuelva true, PendingScene::get termina la
+		carga en el hilo principal (sólo crea los objetos de OpenGL, así que es rápido).
+		*/
+		static std::shared_ptr<PendingScene> loadAsync(const std::string &path,
+			AssimpWrapper::LoadOptions options = AssimpWrapper::LoadOptions::MEDIUM,
+			AssimpWrapper::VertexLayout layout = AssimpWrapper::VertexLayout::SEPARATE);
 		/**
 			\return la lista de formatos de fichero soportados para escritura
 		*/
 		static std::vector<ExportFileFormat> getSupportedExportFileFormats();
 
 		static bool save(const std::string &path, const std::string &id, std::shared_ptr<Scene> scene);
+
+		/**
+		Activa o desactiva el uso de los ficheros .pgscene en load y loadAsync (por defecto,
+		activado). Desactívalo si estás modificando el importador o los modelos no se pueden
+		escribir en su directorio.
+		*/
+		static void setSceneCacheEnabled(bool enabled) { sceneCacheEnabled = enabled; }
+		static bool isSceneCacheEnabled() { return sceneCacheEnabled; }
+	private:
+		friend class PendingScene;
+		// Termina la carga de loader y guarda el .pgscene
+		static std::shared_ptr<Scene> finish(const std::string &path, AssimpWrapper &loader, AssimpWrapper::LoadOptions options);
+		// Importa el fichero con Assimp, sin usar el .pgscene
+		static std::shared_ptr<Scene> loadUncached(const std::string &path, AssimpWrapper::LoadOptions options,
+			AssimpWrapper::VertexLayout layout);
+		static std::string getSceneCachePath(const std::string &path);
+		static bool sceneCacheEnabled;
 	};
 };
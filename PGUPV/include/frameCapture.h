@@ -0,0 +1,95 @@
+#pragma once
+
+#include <deque>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "common.h"
+
+namespace media {
+	class VideoEncoder;
+};
+
+namespace PGUPV {
+	class BufferObject;
+
+	/**
+	\class FrameCapture
+	Guarda fotogramas de la ventana en ficheros de imagen, o en un vídeo, sin detener el
+	dibujado. glReadPixels copia el framebuffer a uno de los PBOs de un anillo (sin esperar a
+	la GPU), y los píxeles se leen unos fotogramas después, cuando su fence indica que la copia
+	ha terminado. Las imágenes se codifican en los hilos de ThreadPool::getInstance(), y los
+	vídeos en el hilo de media::VideoEncoder.
+
+	Hay que llamar a poll una vez por fotograma (App::run lo hace con la captura de la
+	ventana). Todos los métodos se deben llamar desde el hilo principal.
+	*/
+	class FrameCapture {
+	public:
+		static const unsigned int DEFAULT_NUM_BUFFERS = 3;
+		/**
+		\param width ancho de las capturas
+		\param height alto de las capturas
+		\param numBuffers número de PBOs del anillo (fotogramas cuya lectura puede estar pendiente)
+		*/
+		FrameCapture(uint width, uint height, unsigned int numBuffers = DEFAULT_NUM_BUFFERS);
+		//! Espera a que se guarden todas las capturas pendientes
+		~FrameCapture();
+
+		/**
+		Guarda el contenido del buffer indicado en un fichero de imagen. El fichero se escribe
+		más tarde, en otro hilo
+		\param filename fichero a escribir (el formato depende de la extensión)
+		\param readBuffer buffer a leer del framebuffer actual (GL_FRONT, GL_BACK...)
+		\return false si no se puede guardar una imagen con ese nombre
+		*/
+		bool capture(const std::string &filename, GLenum readBuffer = GL_FRONT);
+		/**
+		Empieza a grabar un vídeo. Mientras, captureVideoFrame añade fotogramas
+		\param path fichero de salida (el formato depende de la extensión, p.e., .mp4)
+		\param fps fotogramas por segundo del vídeo
+		\return true si se ha podido crear el fichero
+		*/
+		bool startVideo(const std::string &path, unsigned int fps = 30);
+		//! Añade el contenido del buffer indicado al vídeo que se está grabando
+		void captureVideoFrame(GLenum readBuffer = GL_FRONT);
+		//! Termina el vídeo (espera a que se codifiquen los fotogramas pendientes)
+		void stopVideo();
+		bool isRecordingVideo() const { return video != nullptr; }
+
+		//! Procesa las lecturas que ya han terminado, sin esperar a la GPU
+		void poll();
+		//! Espera a que se lean y se guarden todas las capturas pendientes
+		void flush();
+
+		uint getWidth() const { return width; }
+		uint getHeight() const { return height; }
+	private:
+		FrameCapture(const FrameCapture &) = delete;
+		FrameCapture &operator=(const FrameCapture &) = delete;
+
+		struct Readback {
+			std::shared_ptr<BufferObject> pbo;
+			GLsync fence;
+			// Fichero de destino (vacío si el fotograma es para el vídeo)
+			std::string filename;
+		};
+		void readback(GLenum readBuffer, const std::string &filename);
+		// Lee los píxeles del PBO más antiguo (esperando a la GPU si wait es true) y los envía a guardar
+		bool finishOldest(bool wait);
+		// Espera a que termine la escritura de la imagen más antigua, e informa de los errores
+		void waitOldestSave();
+
+		uint width, height;
+		// Anillo de lecturas: las pendientes son las count que empiezan en first
+		std::vector<Readback> ring;
+		size_t first, count;
+		// Imágenes que se están codificando: el fichero, y el mensaje de error (vacío si no lo hay)
+		std::deque<std::pair<std::string, std::future<std::string>>> saving;
+		std::unique_ptr<media::VideoEncoder> video;
+	};
+};
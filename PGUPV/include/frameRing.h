@@ -0,0 +1,123 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "pingPongBuffers.h"
+
+namespace PGUPV {
+
+	/**
+	\class FrameRing
+	Anillo de buffers para pasar fotogramas de un hilo productor a un hilo consumidor, sin
+	mutex. Tiene la misma interfaz y las mismas políticas que PingPongBuffers:
+
+	unsigned char *b = ring.lockForWrite();
+	// rellenar b
+	ring.unlockForWrite(timestamp);
+
+	// en otro thread
+	unsigned char *c = ring.lockForRead(&timestamp);
+	// leer c
+	ring.unlockForRead();
+
+	Sólo puede haber un productor (lockForWrite, unlockForWrite) y un consumidor (lockForRead,
+	unlockForRead, peek, clear). Los buffers no se copian: se pasan de un hilo a otro por dos
+	colas de índices (fotogramas listos y buffers libres). Con las políticas que descartan, el
+	productor saca el fotograma más antiguo de la cola de listos con una operación atómica
+	(compare-and-swap), y el consumidor hace lo mismo al leer, así que nunca se bloquean.
+
+	Los buffers propios empiezan en una frontera de línea de caché, y su tamaño se redondea a un
+	múltiplo de ella, para que el productor y el consumidor no compartan líneas al escribir en
+	buffers consecutivos. También se pueden usar buffers externos (p.e., buffers de OpenGL
+	mapeados), que el productor rellena directamente.
+	*/
+	class FrameRing {
+	public:
+		using Policy = PingPongBuffers::Policy;
+		static const size_t CACHE_LINE_SIZE = 64;
+
+		/**
+		\param width, height, bpp tamaño de cada fotograma
+		\param policy política de descarte (ver PingPongBuffers::Policy)
+		\param numBuffers número de buffers (al menos dos). Uno puede estar leyéndose, y otro
+		escribiéndose; el resto son los fotogramas que el productor puede adelantarse
+		*/
+		FrameRing(unsigned int width, unsigned int height, unsigned int bpp,
+			Policy policy = Policy::OnlyNewest, unsigned int numBuffers = 2);
+		/**
+		Usa como buffers la memoria indicada, que debe seguir siendo válida mientras exista
+		este objeto
+		\param memory puntero al principio de cada buffer (al menos dos)
+		*/
+		FrameRing(const std::vector<unsigned char *> &memory, Policy policy = Policy::OnlyNewest);
+
+		/**
+		Devuelve el siguiente fotograma según la política, o nullptr si no hay ninguno. Sólo lo
+		puede llamar el consumidor
+		\param timestamp [out] si no es nullptr, se escribe la marca de tiempo del buffer devuelto
+		*/
+		unsigned char *lockForRead(int64_t *timestamp = nullptr);
+		//! Devuelve al productor el buffer leído
+		void unlockForRead();
+		/**
+		Consulta la marca de tiempo del buffer que devolvería lockForRead, sin bloquearlo. Sólo lo
+		puede llamar el consumidor
+		\return false si no hay ningún buffer para leer
+		*/
+		bool peek(int64_t &timestamp) const;
+		//! Descarta todos los fotogramas pendientes de leer. Sólo lo puede llamar el consumidor
+		void clear();
+
+		/**
+		Devuelve un buffer para escribir el siguiente fotograma, o nullptr si no hay ninguno
+		libre (sólo con Policy::NoDiscard). Sólo lo puede llamar el productor
+		*/
+		unsigned char *lockForWrite();
+		//! \param timestamp marca de tiempo asociada al buffer escrito
+		void unlockForWrite(int64_t timestamp = 0);
+
+		//! true si no hay fotogramas pendientes de leer
+		bool isEmpty() const;
+		unsigned int getNumBuffers() const { return static_cast<unsigned int>(buffers.size()); }
+	private:
+		FrameRing(const FrameRing &) = delete;
+		FrameRing &operator=(const FrameRing &) = delete;
+
+		struct Entry {
+			std::atomic<uint32_t> buffer;
+			std::atomic<int64_t> timestamp;
+		};
+		// Saca el fotograma más antiguo de la cola de listos (la pueden llamar los dos hilos).
+		// Devuelve -1 si está vacía
+		int popReady(int64_t *timestamp);
+		// Devuelve un buffer al productor (sólo el consumidor)
+		void pushFree(uint32_t buffer);
+		void init();
+
+		Policy policy;
+		std::vector<unsigned char *> buffers;
+		// Memoria de los buffers, si no es externa
+		std::vector<unsigned char> storage;
+		// Colas circulares de getNumBuffers() posiciones (nunca puede haber más elementos)
+		std::unique_ptr<Entry[]> ready;
+		std::unique_ptr<std::atomic<uint32_t>[]> freeList;
+
+		// Cada grupo de variables está en su propia línea de caché
+		char padding0[CACHE_LINE_SIZE];
+		// Estado del productor: final de la cola de listos, principio de la de libres y buffer
+		// que se está escribiendo
+		std::atomic<uint64_t> readyHead, freeTail;
+		int writing;
+		char padding1[CACHE_LINE_SIZE];
+		// Estado del consumidor: final de la cola de libres y buffer que se está leyendo
+		std::atomic<uint64_t> freeHead;
+		int reading;
+		char padding2[CACHE_LINE_SIZE];
+		// Principio de la cola de listos (lo avanzan los dos hilos)
+		std::atomic<uint64_t> readyTail;
+		char padding3[CACHE_LINE_SIZE];
+	};
+};
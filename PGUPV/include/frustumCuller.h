@@ -0,0 +1,49 @@
+#pragma once
+// 2026
+#include <memory>
+#include "nodeVisitor.h"
+
+/**
+\class FrustumCuller
+Visitante que dibuja un grafo de escena saltándose los subgrafos cuyos volúmenes de inclusión
+quedan fuera del volumen de la vista. Produce el mismo resultado que Node::render, pero cada
+nodo se compara con los planos del volumen de la vista (ver Frustum) antes de dibujarlo.
+Los volúmenes de inclusión de cada nodo están en el sistema de coordenadas de su padre, así que
+los planos se expresan en el sistema de coordenadas de cada Transform (multiplicando la matriz
+model-view-projection por la transformación), y no hace falta transformar los volúmenes.
+Si un nodo está completamente dentro del volumen de la vista, sus descendientes no se comprueban.
+
+Los nodos de animación (AnimationNode) se dibujan siempre, ya que la malla deformada por el
+esqueleto se puede salir del volumen de inclusión de la pose de reposo.
+*/
+
+namespace PGUPV {
+	class GLMatrices;
+
+	class FrustumCuller : public NodeVisitor {
+	public:
+		FrustumCuller();
+		/**
+		Dibuja el grafo que cuelga del nodo indicado usando las matrices GLMatrices vinculadas
+		en UBO_GL_MATRICES_BINDING_INDEX para calcular el volumen de la vista
+		*/
+		void render(Node &root);
+		void apply(Group &group) override;
+		void apply(Transform &transform) override;
+		void apply(Geode &geode) override;
+		void apply(AnimationNode &node) override;
+		//! Número de nodos alcanzados en el último dibujado
+		size_t getNumVisitedNodes() const { return visited; }
+		//! Número de nodos descartados (junto con su subgrafo) en el último dibujado
+		size_t getNumCulledNodes() const { return culled; }
+	private:
+		// Devuelve true si el nodo queda fuera del volumen de la vista
+		bool cull(Node &node);
+		std::shared_ptr<GLMatrices> mats;
+		glm::mat4 mvp;
+		Frustum frustum;
+		// true si el subgrafo actual está completamente dentro del volumen de la vista
+		bool inside;
+		size_t visited, culled;
+	};
+};
@@ -28,6 +28,14 @@ mat4 modelviewprojMatrix;
 mat3 normalMatrix;
 };
 
+Por defecto, cada operación sobre una matriz recalcula las matrices derivadas y las sube al
+UBO. Con setDeferredUpdates(true) las operaciones sólo modifican las pilas de matrices, y
+tanto el cálculo de las matrices derivadas como la subida del bloque completo (con una única
+escritura) se aplazan hasta que se dibuja algo (ver flushPending) o se consultan con
+getMatrix/getNormalMatrix. Es útil cuando se encadenan muchas operaciones antes de cada
+dibujo, como al recorrer un grafo de escena. Si se dibuja sin usar Mesh o DrawCommand, hay
+que llamar a flushPending antes.
+
 */
 
 namespace PGUPV {
@@ -62,17 +70,38 @@ namespace PGUPV {
     const glm::mat4 &getMatrix(Matrix mat) const;
     const glm::mat3 getNormalMatrix() const;
     void reset();
+    ~GLMatrices();
+    /**
+    Activa o desactiva el modo diferido. Al desactivarlo, se suben los cambios pendientes
+    */
+    void setDeferredUpdates(bool deferred);
+    bool isDeferred() const { return deferred; }
+    //! Sube al UBO los cambios pendientes de este objeto (sólo en modo diferido)
+    void flush();
+    /**
+    Sube los cambios pendientes de todos los objetos en modo diferido. El último objeto
+    modificado es el que queda vinculado al punto UBO_GL_MATRICES_BINDING_INDEX. Mesh y
+    DrawCommand lo llaman antes de dibujar
+    */
+    static void flushPending();
   private:
     GLMatrices();
     GLMatrices(const GLMatrices&);
 
     void writeMatrix(Matrix mat);
+    void updateDerivedMatrices() const;
     MatrixStack mats[PROJ_MATRIX + 1];
-    struct {
+    // Las matrices derivadas se calculan bajo demanda en el modo diferido
+    mutable struct {
       glm::mat4 modelview;
       glm::mat4 modelviewprojection;
       glm::mat3x4 normal; // Debido a como se almacenan las matrices con la directiva std140
     } derivedMatrices;
+    enum DirtyFlags : unsigned int {
+      DIRTY_MODELVIEW = 1, DIRTY_MODELVIEWPROJ = 2, DIRTY_UBO = 4
+    };
+    bool deferred;
+    mutable unsigned int dirty;
 
     friend std::ostream& operator<<(std::ostream &os, const GLMatrices& m);
   };
@@ -9,7 +9,15 @@ namespace PGUPV {
 	class GLQuery {
 	public:
 		GLQuery(GLenum type) : queryType(type), queryId(0) {
-			
+
+		}
+		GLQuery(GLQuery &&other) noexcept : queryType(other.queryType), queryId(other.queryId) {
+			other.queryId = 0;
+		}
+		GLQuery(const GLQuery &) = delete;
+		GLQuery &operator=(const GLQuery &) = delete;
+		~GLQuery() {
+			if (queryId) glDeleteQueries(1, &queryId);
 		}
 		void begin() {
 			if (!queryId) glGenQueries(1, &queryId);
@@ -18,6 +26,18 @@ namespace PGUPV {
 		void end() {
 			glEndQuery(queryType);
 		}
+		// Para las consultas de tipo GL_TIMESTAMP, que no tienen begin/end
+		void timestamp() {
+			if (!queryId) glGenQueries(1, &queryId);
+			glQueryCounter(queryId, GL_TIMESTAMP);
+		}
+		// No bloquea. Si devuelve true, getValueU32 y getValueU64 tampoco bloquearán
+		bool isResultAvailable() {
+			GLuint available = GL_FALSE;
+			if (!queryId) return false;
+			glGetQueryObjectuiv(queryId, GL_QUERY_RESULT_AVAILABLE, &available);
+			return available == GL_TRUE;
+		}
 		uint32_t getValueU32() {
 			uint32_t result;
 			if (!queryId) return 0;
@@ -34,4 +54,4 @@ namespace PGUPV {
 		GLenum queryType;
 		GLuint queryId;
 	};
-};
\ No newline at end of file
+};
@@ -274,4 +274,19 @@ namespace PGUPV {
   private:
     GLint alignment;
   };
+
+  /**
+\class PixelUnpackState
+*/
+  class PixelUnpackState {
+  public:
+    void capture() {
+      glGetIntegerv(GL_UNPACK_ALIGNMENT, &alignment);
+    }
+    void restore() {
+      glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
+    }
+  private:
+    GLint alignment;
+  };
 };
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <GL/glew.h>
+#include <vector>
 #include "stopWatch.h"
 #include "glQuery.h"
 #include "utils.h"
@@ -8,18 +9,31 @@
 // 2018
 
 namespace PGUPV {
+	/**
+	Collects OpenGL statistics of every frame without stalling the pipeline. The queries of
+	each frame go into one of the slots of a pool (by default, DEFAULT_FRAMES_IN_FLIGHT deep),
+	and their results are only read when GL_QUERY_RESULT_AVAILABLE says they are ready. So the
+	values returned by getValue belong to some previous frame: getLatency tells how many frames
+	old they are. If every slot of the pool is still waiting for the GPU, the current frame is
+	not measured (see getDroppedFrames).
+	*/
 	class GLStats {
 	public:
 		/**
 		The queries ending with Ext are only collected when requested with collectExtendedStats(true);
+		GPUTimeElapsed is the GPU time spent rendering the frame, in nanoseconds
 		*/
 		enum class Query {
-			SamplesPassed, PrimitivesGenerated, VerticesSubmittedExt, PrimitivesSubmittedExt,
+			SamplesPassed, PrimitivesGenerated, GPUTimeElapsed, VerticesSubmittedExt, PrimitivesSubmittedExt,
 			VertexShaderInvocationsExt, TessControlShaderPatchesExt, TessEvalShaderInvocationsExt,
 			GeometryShaderInvocationsExt, GeometryShaderPrimitivesEmittedExt, FragmentShaderInvocationsExt,
 			ComputeShaderInvocationsExt, ClippingInputPrimitivesExt, ClippingOutputPrimitivesExt
 		};
-		GLStats();
+		static const unsigned int DEFAULT_FRAMES_IN_FLIGHT = 4;
+		/**
+		\param framesInFlight number of frames whose results can be pending at the same time
+		*/
+		GLStats(unsigned int framesInFlight = DEFAULT_FRAMES_IN_FLIGHT);
 		void beginFrame();
 		void endFrame();
 		/**
@@ -28,15 +42,49 @@ namespace PGUPV {
 		\return true if the current environment supports extended stats (extension GL_ARB_pipeline_statistics_query)
 		*/
 		bool collectExtendedStats(bool extendedStats);
+		//! Last available value of the given query. It never blocks
 		uint64_t getValue(Query query);
+		//! Number of frames between the current one and the one getValue(query) was measured in
+		unsigned int getLatency(Query query);
+		//! CPU time (ms) spent between beginFrame and endFrame in the last frame
 		float getFrameDuration() { return elapsedMs; }
+		//! GPU time (ms) spent rendering the last available frame
+		float getGPUFrameDuration() { return getValue(Query::GPUTimeElapsed) * 1e-6f; }
+		/**
+		Time (ms) since the CPU finished submitting the last available frame until the GPU
+		finished executing it (measured with GL_TIMESTAMP)
+		*/
+		float getGPULatency() { return gpuLatencyMs; }
+		//! Number of frames that could not be measured because all the slots of the pool were busy
+		uint64_t getDroppedFrames() { return droppedFrames; }
 	private:
 		constexpr static unsigned int NQueries{ static_cast<unsigned int>(PGUPV::to_underlying(Query::ClippingOutputPrimitivesExt)) + 1 };
+		constexpr static unsigned int NBasicQueries{ static_cast<unsigned int>(PGUPV::to_underlying(Query::GPUTimeElapsed)) + 1 };
+		// The queries of one frame
+		struct Slot {
+			Slot();
+			std::vector<GLQuery> queries;
+			GLQuery endTimestamp;
+			// CPU side GL_TIMESTAMP when the frame was submitted
+			GLint64 submitted;
+			uint64_t frame;
+			unsigned int nQueries;
+			bool pending;
+		};
+		// Reads the results of the slots that are ready, without blocking
+		void poll();
+		unsigned int numActiveQueries() const { return collectExtendedStatsFlag ? NQueries : NBasicQueries; }
+
+		std::vector<Slot> slots;
+		// Slot used by the current frame, or -1 if the frame is not measured
+		int current;
+		uint64_t frame;
 		uint64_t values[NQueries];
-		GLQuery queries[NQueries];
+		uint64_t valueFrame[NQueries];
+		uint64_t droppedFrames;
+		float gpuLatencyMs;
 		bool collectExtendedStatsFlag;
 		MicroSecStopWatch stopwatch;
 		float elapsedMs;
 	};
 };
-
@@ -0,0 +1,113 @@
+#pragma once
+// 2026
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <glm/vec2.hpp>
+
+#include "common.h"
+
+namespace PGUPV {
+	class Font;
+	class Texture2D;
+
+	/**
+	\class GlyphAtlas
+	Caché de glifos de una fuente (ver Font::loadFont). Cada glifo se rasteriza una sola vez
+	con SDL_ttf, la primera vez que se usa, y se copia a una textura de un canal (GL_R8)
+	compartida por todos los textos que usan esa fuente. Los glifos se colocan por estantes;
+	cuando no caben, la textura dobla su altura (las coordenadas de los glifos se expresan en
+	píxeles del atlas, así que siguen siendo válidas).
+
+	En modo SDF, en lugar de la cobertura de cada píxel se guarda la distancia (con signo) al
+	borde del glifo, de forma que el texto se puede escalar sin que se vea borroso. En este
+	caso conviene cargar la fuente con un tamaño grande (p.e., 48 puntos).
+
+	Normalmente no se usa directamente, sino a través de TextBatch:
+
+	auto atlas = GlyphAtlas::get(Font::loadFont("../recursos/fuentes/FreeSans.ttf", 14));
+	*/
+	class GlyphAtlas {
+	public:
+		enum class Mode { COVERAGE, SDF };
+
+		//! Un glifo en el atlas
+		struct Glyph {
+			int x, y, width, height; // rectángulo en el atlas (píxeles, la fila 0 es la de arriba)
+			int left, top;           // posición respecto a la pluma y a la parte de arriba de la línea
+			int advance;             // avance horizontal de la pluma
+		};
+		//! Rectángulo de un glifo colocado en un texto
+		struct Quad {
+			glm::vec2 min, max;      // esquinas superior izquierda e inferior derecha (píxeles, y hacia abajo)
+			glm::vec2 uvMin, uvMax;  // en píxeles del atlas
+		};
+
+		/**
+		Devuelve el atlas de la fuente indicada en el modo indicado (sólo se crea uno por fuente
+		y modo)
+		*/
+		static std::shared_ptr<GlyphAtlas> get(std::shared_ptr<Font> font, Mode mode = Mode::COVERAGE);
+
+		//! Devuelve el glifo del code point indicado, rasterizándolo si es necesario
+		const Glyph &getGlyph(uint32_t codepoint);
+
+		/**
+		Coloca los glifos de la cadena indicada (en UTF-8) a partir de la esquina superior
+		izquierda, saltando de línea en cada '\\n'.
+		\param text cadena a colocar
+		\param quads vector al que se añaden los rectángulos de los glifos visibles
+		\param wrapWidth si es mayor que 0, las líneas más anchas se parten por los espacios
+		(en píxeles de la fuente, antes de escalar)
+		\param scale factor de escala de las posiciones
+		\return el ancho y alto del texto (escalado)
+		*/
+		glm::vec2 layout(const std::string &text, std::vector<Quad> &quads, uint wrapWidth = 0,
+			float scale = 1.0f);
+
+		/**
+		Sube a la textura los glifos añadidos desde la última llamada
+		\warning Cambia la unidad de textura activa a App::getScratchUnitTextureNumber mientras
+		sube los glifos, y deja la textura vinculada en ella
+		*/
+		void upload();
+		//! La textura del atlas, con los glifos pendientes ya subidos
+		std::shared_ptr<Texture2D> getTexture();
+
+		Mode getMode() const { return mode; }
+		//! Distancia máxima (en píxeles) representada en el modo SDF
+		int getSDFSpread() const { return sdfSpread; }
+		//! Distancia entre las líneas de texto, en píxeles
+		int getLineSkip() const { return lineSkip; }
+		uint getWidth() const { return width; }
+		uint getHeight() const { return height; }
+		size_t getNumGlyphs() const { return glyphs.size(); }
+	private:
+		GlyphAtlas(std::shared_ptr<Font> font, Mode mode);
+		GlyphAtlas(const GlyphAtlas &) = delete;
+		GlyphAtlas &operator=(const GlyphAtlas &) = delete;
+		// Rasteriza el glifo y lo copia al atlas
+		Glyph rasterize(uint32_t codepoint);
+		// Busca un hueco del tamaño indicado, haciendo crecer el atlas si es necesario
+		void allocateRect(int w, int h, int &x, int &y);
+
+		typedef std::map<std::pair<Font *, Mode>, std::shared_ptr<GlyphAtlas>> AtlasCache;
+		// Como las fuentes, los atlas no se liberan nunca
+		static AtlasCache cache;
+
+		std::shared_ptr<Font> font;
+		Mode mode;
+		int sdfSpread, lineSkip;
+		std::unordered_map<uint32_t, Glyph> glyphs;
+		// Copia en memoria del atlas, para poder crecer sin leer la textura
+		std::vector<uint8_t> pixels;
+		uint width, height;
+		// Estante actual
+		int shelfX, shelfY, shelfHeight;
+		// Filas modificadas desde el último upload
+		uint dirtyBegin, dirtyEnd;
+		std::shared_ptr<Texture2D> texture;
+	};
+};
@@ -1,6 +1,7 @@
 #ifndef _IMAGE_H
 #define _IMAGE_H
 
+#include <memory>
 #include <string>
 #include <GL/glew.h>
 #include <FreeImage.h>
@@ -32,6 +33,16 @@ namespace PGUPV {
 		~Image();
 		bool load(std::string filename);
 		/**
+		Carga la imagen del fichero indicado sin escribir en el log ni lanzar excepciones, así que
+		se puede llamar desde cualquier hilo (p.e., desde las tareas de ThreadPool). Además de las
+		imágenes que no se pueden leer, rechaza las que no tienen un formato que se pueda usar
+		como textura (ver getGLFormatType)
+		\param filename nombre del fichero
+		\param error si no es nulo, recibe la descripción del error
+		\return la imagen cargada, o nullptr si no se ha podido cargar
+		*/
+		static std::unique_ptr<Image> tryLoad(const std::string &filename, std::string *error = nullptr);
+		/**
 	  Guarda la imagen en el fichero indicado. Se puede guardar un frame de una animación
 	  o una cara de un cubo
 	  \param filename Nombre del fichero resultante
@@ -44,6 +55,10 @@ namespace PGUPV {
 		*/
 		static bool save(const std::string &filename, uint width, uint height, uint bpp, uint8_t *bytes);
 		static bool saveHDR(const std::string& filename, uint32_t width, uint32_t height, uint32_t bpp, const float* bytes);
+		/**
+		\return true si se puede guardar una imagen en el fichero indicado (según su extensión)
+		*/
+		static bool isWritableFormat(const std::string &filename);
 
 		// Ancho
 		uint getWidth() const { return _width; };
@@ -90,6 +105,17 @@ namespace PGUPV {
 		\return Una nueva imagen con la diferencia entre ambas.
 		*/
 		Image *difference(Image &other, bool ignoreAlpha = true);
+		/**
+		Igual que la anterior, pero escribe la diferencia en result, reutilizando su memoria
+		si ya tiene el tamaño necesario (ver Image::resize)
+		*/
+		void difference(Image &other, Image &result, bool ignoreAlpha = true);
+
+		/**
+		Cambia el tamaño de la imagen (que pasa a tener una sola capa). Si la imagen ya tenía
+		memoria propia del mismo tamaño en bytes, se reutiliza. El contenido queda indefinido
+		*/
+		void resize(uint width, uint height, uint bpp);
 
 		/**
 		Devuelve un puntero al píxel indicado. El origen de la imagen está en la
@@ -125,18 +151,27 @@ namespace PGUPV {
     Para cada pixel replica el valor original para RGB.
     */
     static Image convert8BPPGrayTo24BPPGray(const Image &src);
+    /**
+    Convierte una imagen RGB de 24 bits por pixel en una RGBA de 32, con el alfa indicado.
+    */
+    static Image convert24BPPTo32BPP(const Image &src, uint8_t alpha = 255);
 
 		/**
 		\return Información sobre la versión de la biblioteca de carga de imágenes utilizada
 		*/
 		static const std::string getLibraryInfo();
 	private:
+		Image();
 		Image(const Image &);
 		Image &operator=(const Image &);
 		bool loadDDS(const std::string &filename);
 
-		bool loadSimple(const std::string &filename, const ::FREE_IMAGE_FORMAT fileType);
-		bool loadMulti(const std::string &filename, const ::FREE_IMAGE_FORMAT fileType);
+		// Carga la imagen sin escribir en el log. Si falla, devuelve false y deja en error el motivo
+		bool loadFile(const std::string &filename, std::string &error);
+		bool loadSimple(const std::string &filename, const ::FREE_IMAGE_FORMAT fileType, std::string &error);
+		bool loadMulti(const std::string &filename, const ::FREE_IMAGE_FORMAT fileType, std::string &error);
+		// true si getGLFormatType acepta el tipo de la imagen cargada
+		bool isSupportedFormat() const;
 		void loadFrameFromMulti(const unsigned int frame) const;
 
 		void swapRB(uint frame) const;
@@ -0,0 +1,102 @@
+#pragma once
+// 2026
+#include <memory>
+#include <string>
+#include <vector>
+#include <glm/mat4x4.hpp>
+#include <glm/vec4.hpp>
+
+#include "common.h"
+#include "renderable.h"
+
+namespace PGUPV {
+	class Model;
+	class BufferObject;
+
+	/**
+	\class InstancedModel
+	Dibuja muchas copias de un mismo modelo con una sola llamada de dibujo por cada orden de
+	dibujo de sus mallas, en lugar de una llamada (y varias escrituras en el UBO de GLMatrices)
+	por copia. Cada instancia tiene su matriz del modelo y un vec4 de uso libre (p.e., un color),
+	que se suben a un shader storage buffer vinculado en SSBO_INSTANCES_BINDING_INDEX. Los
+	shaders los leen con gl_InstanceID:
+
+	$GLMatrices
+	$Instances
+	...
+	gl_Position = modelviewprojMatrix * instances[gl_InstanceID].modelMatrix * position;
+
+	(ver InstancedModel::definition, y ConstantIllumInstancedProgram). La matriz del modelo de
+	GLMatrices se sigue aplicando a todas las instancias.
+
+	auto trees = std::make_shared<InstancedModel>(treeModel);
+	for (...)
+		trees->addInstance(glm::translate(glm::mat4(1.0f), pos));
+	...
+	ConstantIllumInstancedProgram::use();
+	trees->render();
+
+	Las instancias sólo se vuelven a subir a la GPU si han cambiado desde el último dibujado.
+
+	\warning Necesita OpenGL 4.3. Las mallas con huesos se dibujan en su pose de reposo
+	*/
+	class InstancedModel : public Renderable {
+	public:
+		//! Datos de cada instancia (con el formato std430 de InstancedModel::definition)
+		struct Instance {
+			glm::mat4 modelMatrix;
+			glm::vec4 data;
+		};
+		//! Nombre a sustituir en los shaders por definition ($Instances)
+		static const std::string blockName;
+		//! Declaración GLSL del bloque con las instancias
+		static const Strings definition;
+
+		explicit InstancedModel(std::shared_ptr<Model> model);
+		~InstancedModel();
+
+		/**
+		Añade una instancia
+		\return su posición
+		*/
+		size_t addInstance(const glm::mat4 &modelMatrix, const glm::vec4 &data = glm::vec4(1.0f));
+		//! Cambia la matriz del modelo de la instancia indicada
+		void setInstanceMatrix(size_t i, const glm::mat4 &modelMatrix);
+		//! Cambia los datos de usuario de la instancia indicada
+		void setInstanceData(size_t i, const glm::vec4 &data);
+		const Instance &getInstance(size_t i) const { return instances[i]; }
+		/**
+		Elimina la instancia indicada. La última instancia pasa a ocupar su posición
+		*/
+		void removeInstance(size_t i);
+		//! Sustituye todas las instancias
+		void setInstances(const std::vector<Instance> &newInstances);
+		void clearInstances();
+		size_t getNumInstances() const { return instances.size(); }
+
+		std::shared_ptr<Model> getModel() const { return model; }
+		//! Número de llamadas de dibujo del último render
+		size_t getNumDrawCalls() const { return drawCalls; }
+
+		//! Dibuja todas las instancias
+		void render() override;
+		//! Caja de inclusión de todas las instancias
+		BoundingBox getBB() override;
+		//! Esfera de inclusión de todas las instancias
+		BoundingSphere getBS() override;
+	private:
+		InstancedModel(const InstancedModel &) = delete;
+		InstancedModel &operator=(const InstancedModel &) = delete;
+		// Sube las instancias al buffer, si han cambiado
+		void upload();
+		void updateBoundingVolumes();
+
+		std::shared_ptr<Model> model;
+		std::vector<Instance> instances;
+		std::shared_ptr<BufferObject> buffer;
+		bool dirty, boundsDirty;
+		BoundingBox bb;
+		BoundingSphere bs;
+		size_t drawCalls;
+	};
+};
@@ -2,6 +2,7 @@
 #define _LOG_H 2014
 
 #include <fstream>
+#include <mutex>
 #include <stdexcept>
 #include <observable.h>
 #include <string>
@@ -48,6 +49,7 @@ namespace PGUPV {
     void showLogFileInEditor();
     //Log de la aplicación
     std::ofstream errLog;
+    std::mutex errLogMutex;
     // Nivel de notificación (desde NO_LOG_MSGS: no msgs hasta FRAME_LEVEL: máximo detalle)
     NOTIFICATION_LEVEL notification_level;
     bool logFullFilepath;
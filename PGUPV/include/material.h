@@ -32,6 +32,8 @@ namespace PGUPV {
 		void use() override;
 		//! Desvincula las texturas que se asociaron con este material
 		void unuse() override;
+		//! true si el color difuso no es opaco, o si tiene mapas de opacidad
+		bool isTransparent() const override;
 
 		/**
 		Establece una textura de tipo difuso
@@ -1,11 +1,22 @@
 #pragma once
 
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <vector>
 
 struct AVFormatContext;
 struct AVCodecContext;
 struct AVFrame;
 
+namespace PGUPV {
+  class FrameRing;
+};
+
 namespace media {
   class Media {
   public:
@@ -21,14 +32,75 @@ namespace media {
     std::string getCodecDescription() const;
     //! Descripcin de la codificacin de los pxeles
     std::string getPixelFormat() const;
-    //! Devuelve un puntero al siguiente frame (RGB24), o NULL si no hay ms
+    /**
+    Devuelve un puntero al siguiente frame (RGB24) si, segn el reloj de reproduccin de este
+    objeto, ya toca mostrarlo. Si no, o si no hay ms, devuelve NULL. Si la aplicacin va ms
+    lenta que el vdeo, se descartan (sin convertirlos) los fotogramas que llegan tarde
+    */
     uint8_t *getNextFrame(bool originAtBottom = true);
     //! Devuelve true si se ha llegado al final del fichero
     bool endOfVideoReached() const { return endOfVideo; }
     void setAutoLoop(bool loop) { autoloop = loop; }
+    /**
+    Salta al primer fotograma cuya marca de tiempo sea mayor o igual que la indicada (no al
+    fotograma clave anterior). Si el vdeo est en pausa, ese fotograma ser el siguiente que
+    se obtenga
+    \param seconds posicin, en segundos desde el principio del vdeo
+    */
+    void seek(double seconds);
+    /**
+    Con el vdeo en pausa, hace que la siguiente llamada a getNextFrame o lockFrame devuelva
+    el siguiente fotograma
+    */
+    void step();
+    //! Posicin del ltimo fotograma devuelto, en segundos
+    double getPosition() const;
+    //! Duracin del vdeo en segundos (0 si no se conoce)
+    double getDuration() const;
+
+    /**
+    Arranca un hilo que decodifica el vdeo por adelantado y deja los fotogramas (RGB24) en un
+    anillo de numFrames buffers. A partir de ese momento, los fotogramas se obtienen con
+    lockFrame/unlockFrame, y no se puede llamar a getNextFrame.
+    \param originAtBottom si es true, la primera fila de cada fotograma es la inferior
+    \param numFrames nmero de fotogramas que el hilo puede decodificar por adelantado
+    */
+    void startDecodingThread(bool originAtBottom = true, unsigned int numFrames = 4);
+    /**
+    Igual que la anterior, pero el hilo escribe los fotogramas directamente en la memoria
+    indicada (p.e., en buffers de OpenGL mapeados), que debe seguir siendo vlida hasta que
+    se detenga el hilo. lockFrame devolver uno de esos punteros.
+    \param originAtBottom si es true, la primera fila de cada fotograma es la inferior
+    \param frameMemory puntero a cada buffer del anillo (al menos dos), de
+      getWidth() * getHeight() * 3 bytes cada uno
+    */
+    void startDecodingThread(bool originAtBottom, const std::vector<uint8_t *> &frameMemory);
+    //! Detiene el hilo decodificador (no debe haber ningn fotograma bloqueado)
+    void stopDecodingThread();
+    bool isDecodingThreadRunning() const { return decoder.joinable(); }
+    /**
+    Devuelve el fotograma ms reciente que ya debera mostrarse segn su marca de tiempo (PTS),
+    descartando los anteriores que no se hayan llegado a mostrar. Si el vdeo viene de una cmara,
+    devuelve el ltimo capturado. Hay que llamar a unlockFrame cuando se termine de usar.
+    \return el fotograma, o nullptr si no hay ninguno nuevo
+    */
+    const uint8_t *lockFrame();
+    //! Libera el fotograma devuelto por lockFrame
+    void unlockFrame();
+    //! Detiene o reanuda el reloj de reproduccin usado por getNextFrame y lockFrame
+    void setPaused(bool paused);
+    bool isPaused() const { return paused; }
   protected:
     bool searchAudioVideoStreams();
     void prepareForReading();
+    //! true si el vdeo viene de una fuente en directo (no se respetan las marcas de tiempo)
+    virtual bool isLive() const { return false; }
+    //! Salta al principio del vdeo. Debe llamarse sin el hilo decodificador funcionando
+    bool seekToStart();
+    // Parmetros de la ltima llamada a startDecodingThread
+    bool decoderOriginAtBottom = true;
+    unsigned int decoderNumFrames = 4;
+    std::vector<uint8_t *> decoderMemory;
 
     int firstVideoStream = -1, firstAudioStream = -1;
     // ffmpeg stuff
@@ -38,11 +110,54 @@ namespace media {
     AVFrame         *pFrameRGB = nullptr;
     uint8_t         *buffer = NULL;
     struct SwsContext      *sws_ctx = nullptr;
-    unsigned long msPerFrame; // Duracin de un frame en ms (1000/FPS)
+    int64_t frameDuration; // Duracin de un frame en microsegundos (1000000/FPS)
   private:
+    // Decodifica el siguiente fotograma en pFrame. Devuelve 1 si lo consigue, 0 al final
+    // del fichero y un cdigo de error de ffmpeg (<0) en otro caso
+    int decodeNextFrame();
+    // Convierte pFrame a RGB24 en dst
+    void convertFrame(uint8_t *dst, bool originAtBottom);
+    // Marca de tiempo de pFrame, en microsegundos desde el principio del vdeo
+    int64_t getFrameTimestamp() const;
+    // Deja en pFrame el siguiente fotograma (volviendo al principio si est activado autoloop).
+    // Devuelve false si no hay ms
+    bool fetchFrame();
+    void decodeLoop(bool originAtBottom);
+    // Arranca el hilo con los parmetros de la ltima llamada a startDecodingThread
+    void launchDecoder();
+    // Tiempo actual del reloj de reproduccin
+    int64_t getClockTime() const;
+    // Devuelve true si ya toca mostrar el fotograma con la marca de tiempo indicada
+    bool isDue(int64_t timestamp);
+    // Ajusta el reloj para que el fotograma indicado sea el actual
+    void frameShown(int64_t timestamp);
+    // Escribe el error en el log o, desde el hilo decodificador, lo guarda en decoderErrors
+    void reportError(const std::string &msg);
+    // Escribe en el log los errores del hilo decodificador (desde el hilo que lo controla)
+    void logDecoderErrors();
+
     static bool libInitialized;
-    bool autoloop, endOfVideo;
+    bool autoloop;
+    std::atomic<bool> endOfVideo;
 
+    // Hilo decodificador y anillo de fotogramas decodificados. El anillo no necesita exclusin
+    // mutua; el mutex protege los cambios en el anillo que pueden despertar al hilo
+    std::unique_ptr<PGUPV::FrameRing> frames;
+    std::thread decoder;
+    std::mutex decoderMutex;
+    std::condition_variable decoderCV;
+    std::atomic<bool> stopDecoder;
+    // Errores del hilo decodificador, que no puede escribir en el log (protegido por decoderMutex)
+    std::vector<std::string> decoderErrors;
+    // Estado del decodificador (lo usa el hilo decodificador, si est en marcha): pFrame contiene
+    // un fotograma que todava no se ha devuelto
+    bool framePending;
+    int64_t pendingTimestamp, lastDecodedTimestamp;
+    // Reloj de reproduccin (slo se usa desde el hilo que obtiene los fotogramas), en
+    // microsegundos: instante en el que empez la marca de tiempo 0, instante en el que se paus
+    // y la marca de tiempo a partir de la cual se detecta que el vdeo ha vuelto a empezar
+    int64_t clockStart, pauseStart, clockReference, lastShownTimestamp;
+    bool paused, stepRequested;
   };
 
   std::string ffmpegError(int errnum);
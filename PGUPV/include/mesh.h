@@ -27,7 +27,8 @@ namespace PGUPV {
 	número de elementos distinto.
 	Cada array se almacenará en un VBO y las conexiones con los puntos de
 	vinculación de atributos se almacena en un VAO por
-	cada Mesh.
+	cada Mesh. Para guardar todos los atributos intercalados en un único VBO, usa
+	la clase MeshBuilder.
 	Para dibujar primitivas con los vértices y sus atributos anteriores, se pueden
 	incorporar llamadas de dibujado con
 	el método addDrawCommand. De esta forma, con un mismo array de vértices se
@@ -74,6 +75,18 @@ namespace PGUPV {
 		};
 
 #define NUM_TEX_COORD 4
+
+		/**
+		Formato de un atributo guardado en un buffer de vértices intercalados (ver MeshBuilder)
+		*/
+		struct VertexAttribFormat {
+			uint index;        // índice del atributo
+			GLint size;        // número de componentes
+			GLenum type;       // tipo de cada componente (GL_FLOAT, GL_HALF_FLOAT...)
+			bool normalized;   // si los enteros se normalizan al convertirlos a float
+			bool integer;      // si el shader lo recibe como entero (glVertexAttribIFormat)
+			GLuint offset;     // desplazamiento dentro del vértice, en bytes
+		};
 		// Constructor de una malla
 		Mesh();
 		~Mesh();
@@ -221,6 +234,12 @@ namespace PGUPV {
 		void setTangent(const glm::vec3 &t);
 
 		void setSkeleton(std::shared_ptr<Skeleton> skel);
+		/**
+		Igual que el anterior, pero con los índices y los pesos de los huesos de cada vértice ya
+		calculados (ver Skeleton::buildArraysOfVerticesAndWeights), p.e., en otro hilo
+		*/
+		void setSkeleton(std::shared_ptr<Skeleton> skel, const std::vector<glm::uvec4> &boneIds,
+			const std::vector<glm::vec4> &boneWeights);
 		std::shared_ptr<Skeleton> getSkeleton() const;
 		/**
 		Inserta un atributo a los vértices.
@@ -298,6 +317,12 @@ namespace PGUPV {
 		*/
 		void render();
 		/**
+		Dibuja la malla varias veces, con una llamada con instancias por cada orden de dibujo
+		(ver InstancedModel)
+		\param instances número de instancias
+		*/
+		void renderInstanced(GLsizei instances);
+		/**
 		\return el número de vértices de la malla (cuidado! NO el número de
 		 índices)
 		*/
@@ -382,6 +407,20 @@ namespace PGUPV {
 		*/
 		std::vector<glm::vec2> getTexCoords(unsigned int texUnit = 0) const;
 
+		/**
+		Devuelve los colores de los vértices de la malla
+		\warning No abusar de estas funciones, puesto que tienen que traer la información
+		desde la GPU
+		*/
+		std::vector<glm::vec4> getColors() const;
+
+		/**
+		Devuelve las tangentes de los vértices de la malla
+		\warning No abusar de estas funciones, puesto que tienen que traer la información
+		desde la GPU
+		*/
+		std::vector<glm::vec3> getTangents() const;
+
 		/**
 		Devuelve los índices de la malla
 		\warning No abusar de estas funciones, puesto que tienen que traer la información
@@ -393,7 +432,14 @@ namespace PGUPV {
 
 		std::shared_ptr<UBOBones> getBones() const;
 
+		//! true si alguno de los atributos está en un buffer de vértices intercalados
+		bool isInterleaved() const { return !interleaved.empty(); }
+
 	protected:
+		friend class MeshBuilder;
+		friend class SceneCache;
+		friend class RenderQueue;
+		friend class StaticSceneBatch;
 		std::string name;
 		std::vector<DrawCommand *> drawCommands;
 		BoundingBox bb;
@@ -403,6 +449,8 @@ namespace PGUPV {
 		GLenum indices_type;
 		size_t n_indices, n_vertices;
 		unsigned int n_components_per_vertex;
+		// Componentes de cada color, si no están en un buffer intercalado
+		unsigned int n_components_per_color;
 		struct StaticAttribute {
 			StaticAttribute(GLint index, const glm::vec4 &val) {
 				attrIndex = index;
@@ -435,6 +483,11 @@ namespace PGUPV {
 		  \returns true si el atributo estaba en la lista y se ha eliminado
 		  */
 		bool removeStaticAttributeValue(GLint index);
+		/**
+		  Dibuja la malla con el VAO y el material que estén vinculados (ver Mesh::render)
+		  \param instances número de instancias a dibujar, o 0 para dibujar sin instancias
+		  */
+		void renderDrawCommands(GLsizei instances = 0);
 
 		/**
 		  Prepara la entrada de un nuevo VBO:
@@ -451,6 +504,24 @@ namespace PGUPV {
 			const void *a, uint ncomponents, size_t n, GLenum usage);
 		void setAttributeSetup(uint attribute_index, std::shared_ptr<BufferObject> bo);
 
+		/**
+		Conecta los atributos indicados a un buffer con los vértices intercalados, usando
+		glVertexAttribFormat y glBindVertexBuffer
+		\param bo buffer con los vértices
+		\param offset posición del primer vértice dentro del buffer, en bytes
+		\param stride tamaño de cada vértice, en bytes
+		\param formats formato de cada atributo dentro del vértice
+		*/
+		void setInterleavedAttributes(std::shared_ptr<BufferObject> bo, GLintptr offset, GLsizei stride,
+			const std::vector<VertexAttribFormat> &formats);
+		// Formato de los atributos intercalados (vacío si cada atributo está en su VBO)
+		std::vector<VertexAttribFormat> interleaved;
+		GLintptr interleavedOffset;
+		GLsizei interleavedStride;
+		// Devuelve el contenido del atributo indicado (de tipo float, half float o 2_10_10_10)
+		template <typename V>
+		std::vector<V> readAttribute(uint attribIndex, GLint ncomponents) const;
+
 		/**
 		Define los huesos que afectan a cada vértice de la malla (máximo 4 huesos por vértice)
 		\param boneIds para cada vértice, se almacena el índice de cada hueso en una componente
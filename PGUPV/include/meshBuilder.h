@@ -0,0 +1,126 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "common.h"
+#include "mesh.h"
+
+namespace PGUPV {
+
+	class Skeleton;
+
+	/**
+	\class MeshBuilder
+
+	Construye mallas cuyos atributos se guardan intercalados en un único buffer object (en vez
+	de un VBO por atributo, como hacen los métodos Mesh::add*). Así cada vértice ocupa posiciones
+	contiguas de memoria, y una escena grande usa muchos menos buffers. Los atributos se
+	conectan al VAO con glVertexAttribFormat/glBindVertexBuffer (OpenGL 4.3).
+
+	Opcionalmente, algunos atributos se guardan en formatos compactos, transparentes para los
+	shaders (que siguen declarándolos como vec2, vec3, uvec4...):
+	- PACK_TEX_COORDS: coordenadas de textura en half float
+	- PACK_NORMALS: normales y tangentes en GL_INT_2_10_10_10_REV normalizado
+	- PACK_BONE_IDS: índices de los huesos en un byte (o en dos, si hay más de 256 huesos)
+
+	Ejemplo:
+
+	MeshBuilder b;
+	b.setVertices(vertices);
+	b.setNormals(normals);
+	b.setTexCoords(0, texCoords);
+	b.setIndices(indices);
+	auto mesh = b.build();
+	mesh->addDrawCommand(new DrawElements(GL_TRIANGLES, n, b.getIndicesType(), nullptr));
+
+	Con MeshBuilder::build(builders) se pueden construir varias mallas (p.e., las de un modelo)
+	que comparten un único buffer de vértices.
+
+	Los métodos set* no usan OpenGL ni el log, así que se pueden llamar desde cualquier hilo (p.e.,
+	AssimpWrapper::prepare): si los datos no son válidos, lanzan std::runtime_error. build sólo se
+	puede llamar desde el hilo principal.
+	*/
+	class MeshBuilder {
+	public:
+		enum Packing {
+			PACK_NONE = 0,
+			PACK_TEX_COORDS = 1,
+			PACK_NORMALS = 2,
+			PACK_BONE_IDS = 4,
+			PACK_ALL = PACK_TEX_COORDS | PACK_NORMALS | PACK_BONE_IDS
+		};
+		/**
+		\param packing combinación de valores de MeshBuilder::Packing que indica qué atributos
+		se guardan en formato compacto
+		*/
+		explicit MeshBuilder(unsigned int packing = PACK_ALL);
+
+		//! Posiciones de los vértices, con ncomponents floats cada una (2, 3 o 4)
+		void setVertices(const float *v, uint ncomponents, size_t n);
+		void setVertices(const std::vector<glm::vec3> &v) { setVertices(&v[0].x, 3, v.size()); }
+		void setNormals(const glm::vec3 *n, size_t count);
+		void setNormals(const std::vector<glm::vec3> &n) { setNormals(n.data(), n.size()); }
+		void setTangents(const glm::vec3 *t, size_t count);
+		void setTangents(const std::vector<glm::vec3> &t) { setTangents(t.data(), t.size()); }
+		void setColors(const glm::vec4 *c, size_t count);
+		void setColors(const std::vector<glm::vec4> &c) { setColors(c.data(), c.size()); }
+		void setTexCoords(uint texUnit, const glm::vec2 *t, size_t count);
+		void setTexCoords(uint texUnit, const std::vector<glm::vec2> &t) { setTexCoords(texUnit, t.data(), t.size()); }
+		/**
+		Añade los índices y los pesos de los huesos que afectan a cada vértice
+		\return el número de pesos ignorados, de vértices con más de 4 huesos
+		*/
+		uint32_t setSkeleton(std::shared_ptr<Skeleton> skel);
+		/**
+		Índices de la malla. Se guardan con el tipo más pequeño que los pueda representar
+		(ver getIndicesType)
+		*/
+		void setIndices(const GLuint *i, size_t n);
+		void setIndices(const std::vector<GLuint> &i) { setIndices(i.data(), i.size()); }
+
+		size_t getNVertices() const { return nVertices; }
+		//! Tipo con el que se guardarán los índices (GL_UNSIGNED_SHORT o GL_UNSIGNED_INT)
+		GLenum getIndicesType() const;
+		//! Tamaño de cada vértice en el buffer, en bytes
+		GLsizei getVertexSize() const;
+
+		/**
+		Crea la malla, con todos sus atributos en un único buffer object. No añade ninguna
+		orden de dibujo ni material.
+		\param usage el tipo de uso que se le dará al buffer object
+		*/
+		std::shared_ptr<Mesh> build(GLenum usage = GL_STATIC_DRAW) const;
+		/**
+		Crea varias mallas que comparten un único buffer object con los vértices de todas
+		ellas (cada malla sigue teniendo su propio buffer de índices)
+		*/
+		static std::vector<std::shared_ptr<Mesh>> build(const std::vector<MeshBuilder> &builders,
+			GLenum usage = GL_STATIC_DRAW);
+	private:
+		friend class SceneCache;
+		// Formato de cada atributo dentro del vértice
+		std::vector<Mesh::VertexAttribFormat> getLayout(GLsizei &stride) const;
+		// Escribe los vértices intercalados en dst (getVertexSize() * getNVertices() bytes)
+		void fill(uint8_t *dst, const std::vector<Mesh::VertexAttribFormat> &layout, GLsizei stride) const;
+		static std::vector<std::shared_ptr<Mesh>> buildShared(const std::vector<const MeshBuilder *> &builders,
+			GLenum usage);
+		void buildMesh(Mesh &mesh, std::shared_ptr<BufferObject> bo, GLintptr offset, GLenum usage) const;
+		void checkSize(size_t n, const char *what);
+
+		unsigned int packing;
+		size_t nVertices;
+		uint nComponentsPerVertex;
+		std::vector<float> vertices;
+		std::vector<glm::vec3> normals, tangents;
+		std::vector<glm::vec4> colors;
+		std::vector<glm::vec2> texCoords[NUM_TEX_COORD];
+		std::vector<glm::uvec4> boneIds;
+		std::vector<glm::vec4> boneWeights;
+		std::shared_ptr<Skeleton> skeleton;
+		std::vector<GLuint> indices;
+		GLuint maxIndex, maxBoneId;
+	};
+};
@@ -34,6 +34,7 @@ namespace PGUPV {
 		// se ha hecho clic sobre el modelo id
 	}
 
+	\sa BVHPicker para hacer picking en la CPU, sin dibujar la escena otra vez
 	*/
 
 	class Picker {
@@ -1,6 +1,7 @@
 
 #pragma once
 
+#include <cstdint>
 #include <vector>
 #include <mutex>
 
@@ -26,6 +27,13 @@ namespace PGUPV {
      de secuencia (es decir, devolver el buffer n, y luego el n-1).
      Hay varias políticas que deciden cómo se inserta un nuevo buffer y cómo se lee un buffer, descritas más adelante.
 
+     Por defecto se usan dos buffers, pero se puede usar un anillo con más (p.e., para que el productor
+     pueda adelantarse varios elementos al consumidor). Cada buffer puede llevar asociada una marca de
+     tiempo, que se indica al terminar de escribirlo y que se puede consultar antes de leerlo (peek).
+
+     Los buffers pueden estar en memoria externa (p.e., buffers de OpenGL mapeados), para que el
+     productor escriba directamente en ella.
+
      */
     
     class PingPongBuffers {
@@ -42,29 +50,50 @@ namespace PGUPV {
          */
         enum class Policy { OnlyNewest, DiscardOldest, NoDiscard };
         PingPongBuffers(unsigned int width, unsigned int height, unsigned int bpp,
-                        Policy policy = Policy::OnlyNewest);
-        unsigned char *lockForRead();
+                        Policy policy = Policy::OnlyNewest, unsigned int numBuffers = 2);
+        /**
+         Usa como buffers la memoria indicada, que debe seguir siendo válida mientras exista
+         este objeto
+         \param memory puntero al principio de cada buffer (al menos dos)
+         */
+        PingPongBuffers(const std::vector<unsigned char *> &memory, Policy policy = Policy::OnlyNewest);
+        /**
+         \param timestamp [out] si no es nullptr, se escribe la marca de tiempo del buffer devuelto
+         */
+        unsigned char *lockForRead(int64_t *timestamp = nullptr);
         void unlockForRead();
         unsigned char *lockForWrite();
-        void unlockForWrite();
+        //! \param timestamp marca de tiempo asociada al buffer escrito
+        void unlockForWrite(int64_t timestamp = 0);
+        /**
+         Consulta la marca de tiempo del buffer que devolvería lockForRead, sin bloquearlo
+         \return false si no hay ningún buffer para leer
+         */
+        bool peek(int64_t &timestamp);
+        //! Descarta todos los buffers pendientes de leer
+        void clear();
         bool isEmpty() const;
+        unsigned int getNumBuffers() const { return static_cast<unsigned int>(buffers.size()); }
     private:
-        static const int NUM_BUFFERS = 2;
+        int findNextToRead();
         Policy policy;
-        std::vector<unsigned char> buffers[NUM_BUFFERS];
-        long ids[NUM_BUFFERS];
+        std::vector<unsigned char *> buffers;
+        // Memoria de los buffers, si no es externa
+        std::vector<std::vector<unsigned char>> storage;
+        std::vector<long> ids;
+        std::vector<int64_t> timestamps;
         std::mutex m;
         int nextId = 1;
         inline int findMaxId() {
             auto maxIdx = 0;
-            for (int i = 1; i< NUM_BUFFERS; i++)
+            for (int i = 1; i < static_cast<int>(ids.size()); i++)
                 if (ids[i] > ids[maxIdx])
                     maxIdx = i;
             return maxIdx;
         };
         inline int findMinId() {
             auto minIdx = 0;
-            for (int i = 1; i < NUM_BUFFERS; i++)
+            for (int i = 1; i < static_cast<int>(ids.size()); i++)
                 if (ids[i] < ids[minIdx])
                     minIdx = i;
             return minIdx;
@@ -0,0 +1,48 @@
+#pragma once
+// 2026
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+#include "common.h"
+
+namespace PGUPV {
+	/**
+	Operaciones sobre filas de píxeles de 8 bits por canal, usadas por Image. Cada función
+	tiene una versión escalar, una con SSE2 y otra con AVX2; se usa la mejor que permiten las
+	opciones de compilación (p.e., -mavx2 o /arch:AVX2). Las que reordenan bytes dentro de un
+	píxel de 24 bits (swapRB de 24 bpp y rgbToRGBA) necesitan SSSE3, que se supone
+	disponible cuando lo está AVX2.
+
+	Ninguna función reserva memoria. parallelRows reparte las filas de una imagen entre los
+	hilos de ThreadPool::getInstance().
+	*/
+	namespace PixelKernels {
+		//! Intercambia los canales rojo y azul de width píxeles de 3 o 4 bytes
+		void swapRB(uint8_t *row, size_t width, uint bytesPerPixel);
+		//! Intercambia el contenido de dos zonas de memoria de n bytes que no se solapan
+		void swapBytes(uint8_t *a, uint8_t *b, size_t n);
+		//! out[i] = |a[i] - b[i]| para n bytes (out puede ser a o b)
+		void absDiff(const uint8_t *a, const uint8_t *b, uint8_t *out, size_t n);
+		//! Máximo de |a[i] - b[i]| para n bytes
+		uint maxAbsDiff(const uint8_t *a, const uint8_t *b, size_t n);
+		/**
+		Máxima diferencia entre los canales de color de width píxeles RGBA, multiplicando
+		cada canal por el alfa de su píxel (como Image::equals):
+		max(|a.c * a.alfa - b.c * b.alfa| / 255)
+		*/
+		uint maxPremultipliedDiffRGBA(const uint8_t *a, const uint8_t *b, size_t width);
+		//! Copia width píxeles RGB a RGBA, con el alfa indicado
+		void rgbToRGBA(const uint8_t *src, uint8_t *dst, size_t width, uint8_t alpha = 255);
+
+		/**
+		Ejecuta op(begin, end) sobre bloques de filas consecutivas que cubren [0, rows),
+		repartidos entre los hilos de ThreadPool::getInstance(). Las imágenes pequeñas se
+		procesan en un solo bloque, en el hilo que llama
+		\param rows número de filas
+		\param bytesPerRow bytes que procesa op en cada fila (para decidir el tamaño de los bloques)
+		\param op función a ejecutar sobre cada bloque
+		*/
+		void parallelRows(uint rows, size_t bytesPerRow, const std::function<void(uint, uint)> &op);
+	};
+};
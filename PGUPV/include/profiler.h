@@ -0,0 +1,160 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "glQuery.h"
+
+namespace PGUPV {
+
+	/**
+	\class Profiler
+	Mide cuánto tarda cada parte de un fotograma, tanto en la CPU (microsegundos) como en
+	la GPU (con consultas GL_TIMESTAMP). El código a medir se divide en zonas, que se pueden
+	anidar:
+
+	void MyRender::render() {
+	  PGUPV_PROFILE_ZONE("MyRender::render");
+	  ...
+	  {
+	    PGUPV_PROFILE_ZONE("Sombras");
+	    ...
+	  }
+	}
+
+	App::run marca el principio y el final de cada fotograma, y la biblioteca ya define
+	zonas para cada renderer, Scene::render, AnimationNode::render, TextureVideo::update y
+	Picker::pick. Los resultados se muestran en el panel de estadísticas de la ventana
+	(ver ProfilerWidget), y se pueden guardar en formato Chrome trace (para abrirlos con
+	chrome://tracing o https://ui.perfetto.dev).
+
+	Los tiempos de la GPU no se esperan: se leen varios fotogramas después, cuando están
+	disponibles, así que getLastFrame devuelve un fotograma anterior al actual.
+
+	Mientras está desactivado (por defecto), cada zona sólo cuesta una comprobación. Las
+	zonas sólo se registran en el hilo principal (el que llama a beginFrame); en otros hilos
+	se ignoran.
+	*/
+	class Profiler {
+	public:
+		//! Una zona medida. Los tiempos están en microsegundos desde el principio del fotograma
+		struct Zone {
+			std::string name;
+			unsigned int depth;
+			int64_t cpuBegin, cpuEnd;
+			// -1 si no se ha medido en la GPU
+			int64_t gpuBegin, gpuEnd;
+		};
+		struct Frame {
+			uint64_t number;
+			// Principio del fotograma, en microsegundos desde que se creó el Profiler
+			int64_t start;
+			int64_t cpuDuration;
+			// -1 si no se ha medido en la GPU
+			int64_t gpuDuration;
+			std::vector<Zone> zones;
+		};
+		static const unsigned int DEFAULT_FRAMES_IN_FLIGHT = 4;
+		// Número máximo de fotogramas que se guardan en una captura
+		static const size_t MAX_CAPTURED_FRAMES = 10000;
+
+		//! Devuelve el profiler compartido por toda la aplicación
+		static Profiler &getInstance();
+
+		void setEnabled(bool enabled);
+		bool isEnabled() const { return enabled; }
+
+		void beginFrame();
+		void endFrame();
+		/**
+		Empieza una zona, dentro de la última zona que se haya abierto
+		\param name nombre de la zona
+		\param gpu si es true, también se mide el tiempo en la GPU
+		\return true si se ha abierto la zona (el profiler está activado, se está en medio de un
+		fotograma y se ha llamado desde el hilo principal). Sólo entonces hay que llamar a endZone
+		*/
+		bool beginZone(const std::string &name, bool gpu = true);
+		//! Termina la última zona abierta
+		void endZone();
+
+		//! Último fotograma cuyos tiempos están completos (number es 0 si todavía no hay ninguno)
+		const Frame &getLastFrame() const { return lastFrame; }
+
+		/**
+		Empieza a guardar todos los fotogramas (hasta MAX_CAPTURED_FRAMES), para escribirlos con
+		saveChromeTrace. Activa el profiler, si no lo estaba
+		*/
+		void startCapture();
+		//! Deja de guardar fotogramas
+		void stopCapture();
+		bool isCapturing() const { return capturing; }
+		size_t getNumCapturedFrames() const { return captured.size(); }
+		/**
+		Escribe los fotogramas capturados en formato Chrome trace (JSON). La CPU y la GPU
+		aparecen como dos hilos distintos
+		\return true si se ha podido escribir el fichero
+		*/
+		bool saveChromeTrace(const std::string &path) const;
+	private:
+		Profiler();
+		Profiler(const Profiler &) = delete;
+		Profiler &operator=(const Profiler &) = delete;
+
+		// Un fotograma cuyos tiempos de GPU pueden no estar disponibles todavía
+		struct PendingFrame {
+			Frame frame;
+			std::vector<GLQuery> timestamps;
+			// Número de consultas de timestamps usadas en el fotograma
+			unsigned int usedTimestamps;
+			// Índices de las consultas de cada zona en timestamps (-1 si no se mide en la GPU)
+			std::vector<std::pair<int, int>> zoneQueries;
+			// Principio del fotograma en la GPU (GL_TIMESTAMP, en nanosegundos)
+			GLint64 gpuReference;
+			bool pending;
+		};
+		int64_t now() const;
+		int newTimestamp();
+		// Recoge los resultados de la GPU que estén disponibles, sin esperar
+		void poll();
+		void complete(PendingFrame &pf, bool gpuAvailable);
+
+		bool enabled, capturing, inFrame;
+		std::thread::id mainThread;
+		int64_t epoch;
+		uint64_t frameNumber;
+		std::vector<PendingFrame> frames;
+		// Fotograma en curso (índice en frames)
+		unsigned int current;
+		// Zonas abiertas (índices en frames[current].frame.zones)
+		std::vector<size_t> openZones;
+		Frame lastFrame;
+		std::vector<Frame> captured;
+	};
+
+	//! Zona que dura hasta el final del ámbito en que se declara (ver PGUPV_PROFILE_ZONE)
+	class ProfileScope {
+	public:
+		// Con el profiler desactivado, no se llega a construir el std::string con el nombre
+		explicit ProfileScope(const char *name, bool gpu = true) :
+			active(Profiler::getInstance().isEnabled() && Profiler::getInstance().beginZone(name, gpu)) {}
+		explicit ProfileScope(const std::string &name, bool gpu = true) :
+			active(Profiler::getInstance().isEnabled() && Profiler::getInstance().beginZone(name, gpu)) {}
+		~ProfileScope() {
+			if (active)
+				Profiler::getInstance().endZone();
+		}
+		ProfileScope(const ProfileScope &) = delete;
+		ProfileScope &operator=(const ProfileScope &) = delete;
+	private:
+		bool active;
+	};
+};
+
+#define PGUPV_PROFILE_CONCAT2(a, b) a##b
+#define PGUPV_PROFILE_CONCAT(a, b) PGUPV_PROFILE_CONCAT2(a, b)
+// Mide el resto del ámbito actual como una zona con el nombre indicado
+#define PGUPV_PROFILE_ZONE(name) PGUPV::ProfileScope PGUPV_PROFILE_CONCAT(profileScope_, __LINE__)(name)
+// Como PGUPV_PROFILE_ZONE, pero sólo mide en la CPU (para código que no llama a OpenGL)
+#define PGUPV_PROFILE_CPU_ZONE(name) PGUPV::ProfileScope PGUPV_PROFILE_CONCAT(profileScope_, __LINE__)(name, false)
@@ -0,0 +1,17 @@
+#pragma once
+
+#include "widget.h"
+
+namespace PGUPV {
+	/**
+	\class ProfilerWidget
+	Muestra las zonas del último fotograma medido por el Profiler como un diagrama de llamas
+	(uno para la CPU y otro para la GPU), y permite capturar fotogramas y guardarlos en
+	formato Chrome trace. Window lo añade al panel de estadísticas.
+	*/
+	class ProfilerWidget : public Widget {
+	public:
+		ProfilerWidget();
+		void renderWidget() override;
+	};
+};
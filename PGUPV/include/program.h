@@ -5,13 +5,17 @@
 #include <string>
 #include <memory>
 #include <map>
+#include <unordered_map>
 #include <iostream>
+#include <cstring>
 
 #include <GL/glew.h>
 
 #include "utils.h"
+#include "log.h"
 #include "uniformBufferObject.h"
 #include "shader.h"
+#include "uniformWriter.h"
 
 namespace PGUPV {
 
@@ -64,6 +68,37 @@ namespace PGUPV {
 		std::vector<UniformInfoBlock> blocks;
 	};
 
+	/**
+	Tipo GLSL (GL_FLOAT_VEC3, GL_FLOAT_MAT4...) que corresponde a cada tipo de C++ que se puede
+	usar con Program::getUniform. Si no hay una especialización para un tipo, no compila.
+	*/
+	template <typename T> struct GLSLUniformType;
+#define PGUPV_GLSL_UNIFORM_TYPE(T, E) \
+	template <> struct GLSLUniformType<T> { static const GLenum type = E; }
+	PGUPV_GLSL_UNIFORM_TYPE(GLfloat, GL_FLOAT);
+	PGUPV_GLSL_UNIFORM_TYPE(glm::vec2, GL_FLOAT_VEC2);
+	PGUPV_GLSL_UNIFORM_TYPE(glm::vec3, GL_FLOAT_VEC3);
+	PGUPV_GLSL_UNIFORM_TYPE(glm::vec4, GL_FLOAT_VEC4);
+	PGUPV_GLSL_UNIFORM_TYPE(GLdouble, GL_DOUBLE);
+	PGUPV_GLSL_UNIFORM_TYPE(glm::dvec2, GL_DOUBLE_VEC2);
+	PGUPV_GLSL_UNIFORM_TYPE(glm::dvec3, GL_DOUBLE_VEC3);
+	PGUPV_GLSL_UNIFORM_TYPE(glm::dvec4, GL_DOUBLE_VEC4);
+	PGUPV_GLSL_UNIFORM_TYPE(GLint, GL_INT);
+	PGUPV_GLSL_UNIFORM_TYPE(glm::ivec2, GL_INT_VEC2);
+	PGUPV_GLSL_UNIFORM_TYPE(glm::ivec3, GL_INT_VEC3);
+	PGUPV_GLSL_UNIFORM_TYPE(glm::ivec4, GL_INT_VEC4);
+	PGUPV_GLSL_UNIFORM_TYPE(GLuint, GL_UNSIGNED_INT);
+	PGUPV_GLSL_UNIFORM_TYPE(glm::uvec2, GL_UNSIGNED_INT_VEC2);
+	PGUPV_GLSL_UNIFORM_TYPE(glm::uvec3, GL_UNSIGNED_INT_VEC3);
+	PGUPV_GLSL_UNIFORM_TYPE(glm::uvec4, GL_UNSIGNED_INT_VEC4);
+	PGUPV_GLSL_UNIFORM_TYPE(bool, GL_BOOL);
+	PGUPV_GLSL_UNIFORM_TYPE(glm::mat2, GL_FLOAT_MAT2);
+	PGUPV_GLSL_UNIFORM_TYPE(glm::mat3, GL_FLOAT_MAT3);
+	PGUPV_GLSL_UNIFORM_TYPE(glm::mat4, GL_FLOAT_MAT4);
+#undef PGUPV_GLSL_UNIFORM_TYPE
+
+	template <typename T> class Uniform;
+
 	/**
 	\class Program
 
@@ -138,6 +173,26 @@ namespace PGUPV {
 	  */
 		int getUniformLocation(const std::string &uniform);
 
+		/**
+		Devuelve un manejador para escribir el uniform indicado, del tipo T de C++ que le
+		corresponde (p.e., glm::mat4 para un mat4, o GLint para un sampler). Las escrituras usan
+		glProgramUniform*, así que no hace falta instalar el programa, y se omiten si el valor no
+		ha cambiado desde la última escritura con un manejador. En contextos sin OpenGL 4.1 ni
+		GL_ARB_separate_shader_objects, cada escritura instala el programa temporalmente. El manejador sigue funcionando si
+		se vuelve a enlazar el programa (p.e., al recargar los shaders).
+		\warning Si el mismo uniform se escribe también con glUniform*, llama a
+		invalidateUniformValues después
+		\param uniform nombre del uniform
+		*/
+		template <typename T>
+		Uniform<T> getUniform(const std::string &uniform);
+
+		/**
+		Olvida los últimos valores escritos con los manejadores de Program::getUniform, para que
+		la siguiente escritura de cada uniform llegue a OpenGL
+		*/
+		void invalidateUniformValues();
+
 		/**
 		Conecta el buffer object con el programa. Esta función pide al objeto bo el
 		nombre del bloque y su definición durante la compilación del shader y realiza
@@ -198,6 +253,8 @@ namespace PGUPV {
 		(con Program::use), se deinstala el anterior
 		*/
 		void unUse();
+		//! Devuelve el último programa instalado con Program::use (o nullptr)
+		static Program *getCurrentProgram() { return prevProgram; }
 
 		/**
 		Devuelve el tamaño del bloque de uniforms, según el driver de OpenGL.
@@ -374,6 +431,53 @@ namespace PGUPV {
 		Program(const Program &);
 		Program &operator=(Program);
 
+		template <typename T> friend class Uniform;
+
+		/*
+		Uniform activo del programa. Los elementos de los arrays (nombre[i]) tienen su propia
+		entrada, pero el último valor escrito de todo el array se guarda en la del elemento 0
+		*/
+		struct ActiveUniform {
+			std::string name;
+			GLenum type;
+			GLint location;  // -1 si es miembro de un bloque
+			GLint arraySize;
+			GLint blockIndex, offset;
+			// Entrada del elemento 0 del array (la propia si no es un array) y posición en él
+			size_t base;
+			GLint element;
+			// Últimos valores escritos (sólo en la entrada base): tamaño de cada elemento, bytes
+			// y si se conoce el valor de cada elemento
+			size_t valueSize;
+			std::vector<unsigned char> value;
+			std::vector<bool> known;
+		};
+		// Manejador pedido con getUniform: el nombre y su entrada en uniforms (-1 si no existe)
+		struct UniformHandle {
+			std::string name;
+			GLenum type;
+			int entry;
+		};
+		// Lee una vez, después de enlazar, todos los uniforms y bloques activos
+		void introspect();
+		// Busca la entrada del uniform en la tabla, o -1
+		int findUniform(const std::string &name) const;
+		// Resuelve la entrada del manejador en el programa actual. Devuelve false si el tipo
+		// del uniform no es el del manejador
+		bool resolveHandle(UniformHandle &handle);
+		size_t addUniformHandle(const std::string &name, GLenum type);
+		template <typename T>
+		void writeUniform(size_t handle, const T *values, GLsizei count);
+
+		std::vector<ActiveUniform> uniforms;
+		std::unordered_map<std::string, size_t> uniformsByName;
+		std::vector<UniformHandle> uniformHandles;
+		// Bloques de uniforms activos (sin sus miembros), y su índice por nombre
+		std::vector<UniformInfoBlock> uniformBlocks;
+		std::unordered_map<std::string, GLuint> uniformBlocksByName;
+		// Número de uniforms de subrutina de cada etapa
+		GLint activeSubroutineUniforms[Shader::NUM_SHADER_TYPES];
+
 		// Devuelve la localización del uniform de tipo subrutina indicado en el
 		// shader de tipo indicado
 		uint getSubroutineUniformLocation(Shader::ShaderType type, std::string name);
@@ -403,6 +507,79 @@ namespace PGUPV {
 		static Program *prevProgram;
 	};
 
+	/**
+	\class Uniform
+	Manejador de un uniform de tipo T de un programa (ver Program::getUniform):
+
+	auto mvp = program.getUniform<glm::mat4>("mvp");
+	...
+	mvp = projection * view * model;
+
+	Si el uniform no está activo en el programa (p.e., porque el compilador lo ha eliminado),
+	las escrituras no hacen nada.
+	*/
+	template <typename T>
+	class Uniform {
+	public:
+		Uniform() : program(nullptr), handle(0) {};
+		//! Escribe el valor, si es distinto del último escrito
+		void set(const T &value) { set(&value, 1); }
+		/**
+		Escribe count elementos consecutivos de un array uniform, empezando por el elemento de
+		este manejador
+		*/
+		void set(const T *values, size_t count) {
+			if (program)
+				program->writeUniform(handle, values, static_cast<GLsizei>(count));
+		}
+		Uniform &operator=(const T &value) { set(value); return *this; }
+		//! true si el uniform está activo en el programa
+		bool isActive() const { return getLocation() >= 0; }
+		//! Localización del uniform en el programa, o -1
+		GLint getLocation() const {
+			if (!program) return -1;
+			int entry = program->uniformHandles[handle].entry;
+			return entry < 0 ? -1 : program->uniforms[entry].location;
+		}
+	private:
+		friend class Program;
+		Uniform(Program *program, size_t handle) : program(program), handle(handle) {};
+		Program *program;
+		size_t handle;
+	};
+
+	template <typename T>
+	Uniform<T> Program::getUniform(const std::string &uniform) {
+		return Uniform<T>(this, addUniformHandle(uniform, GLSLUniformType<T>::type));
+	}
+
+	template <typename T>
+	void Program::writeUniform(size_t handle, const T *values, GLsizei count) {
+		if (!programId)
+			compile();
+		const int entry = uniformHandles[handle].entry;
+		if (entry < 0 || count <= 0)
+			return;
+		const ActiveUniform &u = uniforms[entry];
+		ActiveUniform &base = uniforms[u.base];
+		if (u.element + count > base.arraySize)
+			ERRT("Escribiendo fuera del array uniform " + base.name);
+		if (base.valueSize != sizeof(T)) {
+			base.valueSize = sizeof(T);
+			base.value.assign(sizeof(T) * base.arraySize, 0);
+			base.known.assign(base.arraySize, false);
+		}
+		unsigned char *last = &base.value[u.element * sizeof(T)];
+		bool same = std::memcmp(last, values, count * sizeof(T)) == 0;
+		for (GLsizei i = 0; same && i < count; i++)
+			same = base.known[u.element + i];
+		if (same)
+			return;
+		std::memcpy(last, values, count * sizeof(T));
+		std::fill(base.known.begin() + u.element, base.known.begin() + u.element + count, true);
+		UniformWriter::write(programId, u.location, count, values);
+	}
+
 } // namespace
 
 #endif
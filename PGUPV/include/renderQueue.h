@@ -0,0 +1,99 @@
+#pragma once
+// 2026
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include <glm/mat4x4.hpp>
+
+#include "nodeVisitor.h"
+
+/**
+\class RenderQueue
+Visitante que dibuja un grafo de escena ordenando las mallas por el estado de OpenGL que
+necesitan, en lugar de en el orden del grafo. Primero recorre el grafo y guarda, por cada malla
+visible, el programa instalado, su material, su VAO y su matriz del modelo en el sistema de
+coordenadas del mundo. Después ordena los elementos por una clave de 64 bits que empaqueta el
+estado, y los dibuja cambiando sólo el estado que es distinto del del elemento anterior (sin
+volver a llamar a BaseMaterial::use si el material es el mismo, ni a vincular el VAO si es la
+misma malla).
+
+Los elementos opacos se dibujan primero, agrupados por programa, material y malla, y dentro de
+cada grupo de delante hacia atrás. Los transparentes (ver BaseMaterial::isTransparent) se dibujan
+después, de atrás hacia delante, que es lo que necesita la mezcla de colores.
+
+El programa de cada elemento es el que estaba instalado (con Program::use) al llamar a render, ya
+que los nodos del grafo no tienen programa propio.
+
+Los nodos de animación (AnimationNode) se dibujan durante el recorrido, ya que escriben los huesos
+de cada malla justo antes de dibujarla.
+*/
+
+namespace PGUPV {
+	class GLMatrices;
+	class Program;
+	class BaseMaterial;
+	class Mesh;
+
+	class RenderQueue : public NodeVisitor {
+	public:
+		/**
+		Contadores del último dibujado. Los cambios evitados son los elementos que se han dibujado
+		sin cambiar ese estado, porque era el mismo que el del elemento anterior
+		*/
+		struct Stats {
+			size_t opaqueItems, transparentItems;
+			size_t programChanges, materialChanges, vaoChanges;
+			size_t programChangesAvoided, materialChangesAvoided, vaoChangesAvoided;
+		};
+		RenderQueue();
+		/**
+		Dibuja el grafo que cuelga del nodo indicado, usando las matrices GLMatrices vinculadas
+		en UBO_GL_MATRICES_BINDING_INDEX (igual que Node::render)
+		*/
+		void render(Node &root);
+		//! Activa o desactiva el recorte de los nodos que quedan fuera del volumen de la vista
+		void setFrustumCulling(bool enable) { frustumCulling = enable; }
+		bool isFrustumCullingEnabled() const { return frustumCulling; }
+
+		void apply(Group &group) override;
+		void apply(Transform &transform) override;
+		void apply(Geode &geode) override;
+		void apply(AnimationNode &node) override;
+
+		const Stats &getStats() const { return stats; }
+		//! Número de nodos alcanzados en el último dibujado con el recorte activado
+		size_t getNumVisitedNodes() const { return visited; }
+		//! Número de nodos descartados (junto con su subgrafo) en el último dibujado con el recorte activado
+		size_t getNumCulledNodes() const { return culled; }
+	private:
+		struct Item {
+			Program *program;
+			BaseMaterial *material;
+			Mesh *mesh;
+			glm::mat4 world;
+		};
+		// Devuelve true si el nodo queda fuera del volumen de la vista
+		bool cull(Node &node);
+		// Construye la clave de ordenación del elemento
+		uint64_t makeKey(const Item &item, bool transparent);
+		// Índice denso (por orden de aparición) del objeto en el dibujado actual
+		static uint32_t denseIndex(std::unordered_map<const void *, uint32_t> &seen, const void *p);
+		void submit();
+
+		std::shared_ptr<GLMatrices> mats;
+		Program *program;
+		glm::mat4 view, viewProj;
+		// Matriz del modelo del nodo actual, en el sistema de coordenadas del mundo
+		glm::mat4 world;
+		Frustum frustum;
+		bool frustumCulling, inside;
+		size_t visited, culled;
+
+		std::vector<Item> items;
+		// Clave de cada elemento y su posición en items
+		std::vector<std::pair<uint64_t, uint32_t>> order;
+		std::unordered_map<const void *, uint32_t> seenPrograms, seenMaterials, seenMeshes;
+		Stats stats;
+	};
+};
@@ -14,6 +14,7 @@ namespace PGUPV {
 	class AnimationClip;
 	class BaseMaterial;
 	class Mesh;
+	class RenderQueue;
 
 	/* Una escena es un objeto compuesto por diferentes nodos. Cada nodo contien un modelo, que puede
 	estar compuesto por varios Meshes, y diferentes modelos pueden compartir un mismo
@@ -27,7 +28,24 @@ namespace PGUPV {
 		~Scene() {};
 		void setRoot(std::shared_ptr<Node> root);
 		std::shared_ptr<Node> getRoot() { return sceneRoot; }
+		/**
+		Dibuja la escena. Si está activado el recorte por volumen de la vista, se saltan los
+		subgrafos que quedan fuera (ver FrustumCuller). Si está activada la cola de dibujado,
+		las mallas se dibujan ordenadas por estado (ver RenderQueue)
+		*/
 		void render() override;
+		//! Activa o desactiva el recorte de los nodos que quedan fuera del volumen de la vista
+		void setFrustumCulling(bool enable) { frustumCulling = enable; }
+		bool isFrustumCullingEnabled() const { return frustumCulling; }
+		//! Activa o desactiva el dibujado ordenado por estado (ver RenderQueue)
+		void setRenderQueue(bool enable);
+		bool isRenderQueueEnabled() const { return renderQueue != nullptr; }
+		//! Cola de dibujado (con las estadísticas del último render), o nullptr si no está activada
+		std::shared_ptr<RenderQueue> getRenderQueue() const { return renderQueue; }
+		//! Número de nodos alcanzados en el último render con el recorte activado
+		size_t getNumVisitedNodes() const { return visitedNodes; }
+		//! Número de nodos descartados en el último render con el recorte activado
+		size_t getNumCulledNodes() const { return culledNodes; }
 		BoundingBox getBB() override;
 		BoundingSphere getBS() override;
 		/**
@@ -96,6 +114,9 @@ namespace PGUPV {
 		std::shared_ptr<Node> sceneRoot;
 		std::vector<std::shared_ptr<BaseMaterial>> materials;
 		std::vector<std::shared_ptr<AnimationClip>> animations;
+		bool frustumCulling;
+		size_t visitedNodes, culledNodes;
+		std::shared_ptr<RenderQueue> renderQueue;
 	};
 };
 #endif
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <string>
+#include <memory>
+
+#include "assimpWrapper.h"
+
+namespace PGUPV {
+	class Scene;
+	class Node;
+
+	/**
+	\class SceneCache
+	Guarda y carga escenas ya procesadas en un formato binario propio (.pgscene), para no
+	tener que volver a importarlas con Assimp (y repetir su postprocesado) cada vez que se
+	arranca la aplicación. FileLoader::load lo usa automáticamente: el fichero se guarda
+	junto al modelo (modelo.pgscene, como el .pgmat) la primera vez que se carga, y se usa
+	mientras sea más reciente que el modelo.
+
+	El fichero contiene los vértices y los índices de las mallas en el mismo formato que se
+	envía a la GPU (según el AssimpWrapper::VertexLayout con el que se cargó), el grafo de
+	escena, los materiales (con las rutas de sus texturas tal como aparecen en el modelo, que se
+	buscan al cargar igual que lo hace AssimpWrapper), los esqueletos y las animaciones.
+	Para cargarlo se proyecta en memoria, y los buffers se crean directamente desde la
+	proyección, sin copias intermedias.
+	*/
+	class SceneCache {
+	public:
+		/**
+		\return true si el fichero cachePath existe, es más reciente que el modelo sourcePath
+		y se guardó con las mismas opciones de carga
+		*/
+		static bool isUpToDate(const std::string &cachePath, const std::string &sourcePath,
+			AssimpWrapper::LoadOptions options, AssimpWrapper::VertexLayout layout);
+		/**
+		Carga la escena guardada en el fichero indicado. Sólo desde el hilo principal.
+		\return la escena, o nullptr si el fichero no existe o no es válido
+		*/
+		static std::shared_ptr<Scene> load(const std::string &cachePath);
+		/**
+		Guarda la escena que acaba de cargar loader (después de AssimpWrapper::finish y antes
+		de hacerle cualquier cambio)
+		\param cachePath fichero a escribir
+		\param loader el cargador que ha leído la escena
+		\param scene la escena devuelta por loader
+		\param options las opciones con las que se ha cargado
+		\return true si se ha podido guardar
+		*/
+		static bool save(const std::string &cachePath, const AssimpWrapper &loader, Scene &scene,
+			AssimpWrapper::LoadOptions options);
+	};
+};
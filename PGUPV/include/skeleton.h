@@ -38,7 +38,12 @@ namespace PGUPV {
 
 		uint32_t getNBones() const;
 
-		void buildArraysOfVerticesAndWeights(uint32_t size, std::vector<glm::uvec4> &boneIds, std::vector<glm::vec4> &boneWeights);
+		/**
+		Calcula los índices y los pesos de los (hasta 4) huesos que afectan a cada vértice. No
+		escribe en el log, así que se puede llamar desde cualquier hilo
+		\return el número de pesos ignorados, de vértices con más de 4 huesos
+		*/
+		uint32_t buildArraysOfVerticesAndWeights(uint32_t size, std::vector<glm::uvec4> &boneIds, std::vector<glm::vec4> &boneWeights);
 		//void buildArrayOfMatrices(std::vector<glm::mat4> &matrices);
 	private:
 		std::map<std::string, uint32_t> boneNameCache;
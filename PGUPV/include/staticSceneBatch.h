@@ -0,0 +1,145 @@
+#pragma once
+// 2026
+#include <memory>
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+#include <glm/mat4x4.hpp>
+#include <glm/vec4.hpp>
+
+#include "common.h"
+#include "mesh.h"
+#include "program.h"
+
+namespace PGUPV {
+	class Node;
+	class Scene;
+	class BaseMaterial;
+	class BufferObject;
+
+	/**
+	\class StaticSceneBatch
+	Dibuja la geometría estática de una escena con muy pocas llamadas de OpenGL. Al construirlo,
+	recorre el grafo y copia las mallas que tienen los mismos atributos (posiciones, normales,
+	colores, coordenadas de textura...) en una única malla (un VAO, un buffer de vértices
+	intercalados y un buffer de índices, ver MeshBuilder). Por cada aparición de una malla en la
+	escena se genera un DrawElementsIndirectCommand, y unos datos por dibujo (la matriz del
+	modelo, la esfera de inclusión y el índice del material) que se guardan en un shader
+	storage buffer vinculado en SSBO_DRAW_DATA_BINDING_INDEX. Después, render dibuja cada grupo
+	de mallas con el mismo material con un glMultiDrawElementsIndirect.
+
+	Los shaders reciben el índice del dibujo en el atributo DRAW_INDEX_ATTRIB (instanciado, con
+	baseInstance), y leen sus datos del bloque $DrawData (ver StaticSceneBatch::definition):
+
+	program.addAttributeLocation(StaticSceneBatch::DRAW_INDEX_ATTRIB, "drawIndex");
+	program.replaceString("$" + StaticSceneBatch::blockName, StaticSceneBatch::definition);
+	...
+	$GLMatrices
+	$DrawData
+	in uint drawIndex;
+	...
+	gl_Position = modelviewprojMatrix * drawData[drawIndex].modelMatrix * position;
+
+	(ver ConstantIllumBatchProgram). La matriz del modelo de GLMatrices se aplica a toda la
+	escena. Los materiales se establecen con BaseMaterial::use antes de cada grupo, así que los
+	shaders pueden seguir usando $Material y sus texturas.
+
+	Con setGPUCulling(true), antes de dibujar un shader de computación descarta los dibujos cuya
+	esfera de inclusión queda fuera del volumen de la vista, y compacta los que quedan al
+	principio del grupo de su material. Si está disponible GL_ARB_indirect_parameters, el
+	número de dibujos de cada grupo se lee de la GPU; si no, los huecos tienen 0 instancias.
+
+	Las mallas que no se pueden juntar (con huesos, con atributos estáticos o no estándar, con
+	primitivas que no son triángulos o con comandos de dibujo distintos de DrawArrays y
+	DrawElements) se dibujan una a una con renderSeparateMeshes, con un
+	programa que no use $DrawData.
+
+	\warning Necesita OpenGL 4.3. Los cambios posteriores en el grafo (transformaciones, mallas,
+	visibilidad) no se reflejan hasta que se vuelve a llamar a build
+	*/
+	class StaticSceneBatch {
+	public:
+		//! Atributo con el índice del dibujo (el primero que no usa Mesh)
+		static const uint DRAW_INDEX_ATTRIB = Mesh::_LAST_;
+		//! Datos de cada dibujo (con el formato std430 de StaticSceneBatch::definition)
+		struct DrawData {
+			glm::mat4 modelMatrix;
+			glm::vec4 boundingSphere; // centro y radio, en el sistema de coordenadas de la escena
+			GLuint materialIndex;     // posición en getMaterials()
+			GLuint group;             // grupo (malla y material) al que pertenece el dibujo
+			GLuint groupFirst;        // primer comando del grupo en el buffer indirecto
+			GLuint padding;
+		};
+		//! Nombre a sustituir en los shaders por definition ($DrawData)
+		static const std::string blockName;
+		//! Declaración GLSL del bloque con los datos de cada dibujo
+		static const Strings definition;
+
+		StaticSceneBatch();
+		~StaticSceneBatch();
+		//! Construye los buffers a partir del estado actual de la escena
+		void build(Scene &scene);
+		void build(std::shared_ptr<Node> root);
+		//! Dibuja las mallas combinadas
+		void render();
+		//! Dibuja las mallas que no se han podido combinar (con Mesh::render)
+		void renderSeparateMeshes();
+
+		//! Activa o desactiva el recorte en la GPU de los dibujos fuera del volumen de la vista
+		void setGPUCulling(bool enable) { gpuCulling = enable; }
+		bool isGPUCullingEnabled() const { return gpuCulling; }
+
+		//! Número de dibujos (apariciones de mallas) en los buffers indirectos
+		size_t getNumDraws() const { return draws.size(); }
+		//! Número de llamadas a glMultiDrawElementsIndirect en cada render
+		size_t getNumMultiDrawCalls() const { return groups.size(); }
+		//! Número de mallas que no se han podido juntar (se dibujan una a una)
+		size_t getNumSeparateMeshes() const { return separate.size(); }
+		//! Materiales indexados por DrawData::materialIndex
+		const std::vector<std::shared_ptr<BaseMaterial>> &getMaterials() const { return materials; }
+	private:
+		StaticSceneBatch(const StaticSceneBatch &) = delete;
+		StaticSceneBatch &operator=(const StaticSceneBatch &) = delete;
+
+		// Mismo formato que espera glMultiDrawElementsIndirect
+		struct DrawElementsIndirectCommand {
+			GLuint count;
+			GLuint instanceCount;
+			GLuint firstIndex;
+			GLint baseVertex;
+			GLuint baseInstance;
+		};
+		// Dibujos consecutivos que comparten la malla combinada y el material
+		struct Group {
+			size_t arena;
+			std::shared_ptr<BaseMaterial> material;
+			GLuint first;
+			GLsizei count;
+		};
+		// Malla combinada con las mallas que tienen los mismos atributos
+		struct Arena {
+			std::shared_ptr<Mesh> mesh;
+			GLenum indicesType;
+		};
+		struct SeparateMesh {
+			Mesh *mesh;
+			glm::mat4 modelMatrix;
+		};
+		void cull();
+		void release();
+		// true si la malla se puede copiar en una malla combinada
+		static bool canMerge(const Mesh &mesh);
+
+		std::shared_ptr<Node> root;
+		std::vector<Arena> arenas;
+		std::vector<Group> groups;
+		std::vector<DrawData> draws;
+		std::vector<SeparateMesh> separate;
+		std::vector<std::shared_ptr<BaseMaterial>> materials;
+		std::shared_ptr<BufferObject> commands, culledCommands, drawData, drawIndices, groupCounts;
+		bool gpuCulling;
+		std::unique_ptr<Program> cullProgram;
+		Uniform<glm::vec4> cullPlanes;
+		Uniform<GLuint> cullNumDraws;
+	};
+};
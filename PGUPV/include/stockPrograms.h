@@ -9,6 +9,9 @@
 namespace PGUPV {
 	//void builder(StockPrograms stockProgramId, Program &p);
 	void buildConstantShading(PGUPV::Program &program);
+	void buildConstantShadingInstanced(PGUPV::Program &program);
+	void buildConstantShadingBatch(PGUPV::Program &program);
+	void buildTextBatch(PGUPV::Program &program);
 	void buildReplaceTexture(PGUPV::Program &program);
 	void buildConstantColorUniform(PGUPV::Program &program);
 
@@ -65,6 +68,39 @@ namespace PGUPV {
 
   typedef StockProgram<buildConstantShading> ConstantIllumProgram;
 
+  /**
+  \class ConstantIllumInstancedProgram
+  Igual que ConstantIllumProgram, pero para dibujar un InstancedModel: cada instancia aplica
+  su matriz del modelo, y multiplica el color de los vrtices por el vec4 de la instancia.
+
+  ConstantIllumInstancedProgram::use();
+
+  instancedModel.render();
+
+  \warning Necesita OpenGL 4.3
+  */
+  typedef StockProgram<buildConstantShadingInstanced> ConstantIllumInstancedProgram;
+
+  /**
+  \class ConstantIllumBatchProgram
+  Igual que ConstantIllumProgram, pero para dibujar un StaticSceneBatch: cada dibujo aplica
+  su matriz del modelo, que lee del bloque $DrawData con el atributo drawIndex.
+
+  ConstantIllumBatchProgram::use();
+
+  batch.render();
+
+  \warning Necesita OpenGL 4.3
+  */
+  typedef StockProgram<buildConstantShadingBatch> ConstantIllumBatchProgram;
+
+  /**
+  \class TextBatchProgram
+  Programa que usa TextBatch para dibujar los glifos de un GlyphAtlas. Los uniforms
+  viewportSize, atlas y sdf los establece TextBatch::render.
+  */
+  typedef StockProgram<buildTextBatch> TextBatchProgram;
+
   /**
   \class TextureReplaceProgram
   Programa que aplica al polgono dibujado una textura tal cual, segn las
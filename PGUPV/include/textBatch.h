@@ -0,0 +1,98 @@
+#pragma once
+// 2026
+#include <memory>
+#include <string>
+#include <vector>
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+
+#include "common.h"
+#include "glyphAtlas.h"
+#include "vertexArrayObject.h"
+
+namespace PGUPV {
+	class BufferObject;
+
+	/**
+	\class TextBatch
+	Dibuja muchos textos con una sola llamada de dibujo. Cada texto se descompone en un
+	rectángulo por glifo, que apunta a la zona correspondiente de un GlyphAtlas compartido,
+	así que cambiar un texto no crea ni sube texturas: sólo rellena el buffer de vértices, que
+	se sube a la GPU (una vez) en el siguiente render.
+
+	Hay dos tipos de textos:
+	- addText: en coordenadas de la ventana (píxeles, con el origen en la esquina inferior
+	izquierda del viewport). Útil para HUDs, contadores de FPS, etc.
+	- addLabel: etiquetas ancladas en un punto de la escena, que se proyecta con la matriz
+	modelviewprojMatrix de GLMatrices en cada render (no hace falta volver a construir el
+	texto cuando se mueve la cámara). El tamaño de las letras no depende de la distancia.
+
+	TextBatch fps;
+	...
+	fps.clear();
+	fps.addText("FPS: " + std::to_string(rate), glm::vec2(10, height - 10));
+	for (auto &o : objects)
+	fps.addLabel(o.name, o.position);
+	fps.render();
+
+	Los textos se dibujan encima de la escena (sin test de profundidad) y mezclados con lo que
+	haya en el framebuffer.
+	*/
+	class TextBatch {
+	public:
+		explicit TextBatch(std::shared_ptr<GlyphAtlas> atlas = nullptr);
+		~TextBatch();
+
+		/**
+		Añade un texto en coordenadas de la ventana
+		\param text cadena en UTF-8 (puede tener varias líneas)
+		\param pos posición de la esquina superior izquierda del texto, en píxeles
+		\param color color del texto
+		\param scale factor de escala del texto
+		\param wrapWidth si es mayor que 0, ancho máximo de las líneas (en píxeles de la fuente)
+		\return el tamaño del texto en píxeles
+		*/
+		glm::vec2 addText(const std::string &text, const glm::vec2 &pos,
+			const glm::vec4 &color = glm::vec4(1.0f), float scale = 1.0f, uint wrapWidth = 0);
+		/**
+		Añade una etiqueta centrada horizontalmente sobre un punto de la escena
+		\param text cadena en UTF-8
+		\param anchor punto de la escena (en el sistema de coordenadas del modelo)
+		\param color color del texto
+		\param offset desplazamiento de la base del texto respecto al punto proyectado, en píxeles
+		\param scale factor de escala del texto
+		\return el tamaño del texto en píxeles
+		*/
+		glm::vec2 addLabel(const std::string &text, const glm::vec3 &anchor,
+			const glm::vec4 &color = glm::vec4(1.0f), const glm::vec2 &offset = glm::vec2(0.0f),
+			float scale = 1.0f);
+		//! Elimina todos los textos
+		void clear();
+		//! Dibuja todos los textos
+		void render();
+
+		std::shared_ptr<GlyphAtlas> getAtlas() const { return atlas; }
+		//! Número de glifos (rectángulos) a dibujar
+		size_t getNumGlyphs() const { return vertices.size() / 4; }
+	private:
+		TextBatch(const TextBatch &) = delete;
+		TextBatch &operator=(const TextBatch &) = delete;
+		struct Vertex {
+			glm::vec4 anchor;   // w = 0: píxeles de la ventana, w = 1: punto de la escena
+			glm::vec2 offset;   // en píxeles, respecto al anchor
+			glm::vec2 texCoord; // en píxeles del atlas
+			glm::vec4 color;
+		};
+		void addQuads(const glm::vec4 &anchor, const glm::vec2 &origin, const glm::vec4 &color);
+		// Sube los vértices (y los índices que falten), si han cambiado
+		void upload();
+
+		std::shared_ptr<GlyphAtlas> atlas;
+		std::vector<GlyphAtlas::Quad> quads;
+		std::vector<Vertex> vertices;
+		std::shared_ptr<BufferObject> vbo, ibo;
+		VertexArrayObject vao;
+		bool dirty;
+	};
+};
@@ -4,7 +4,7 @@
 
 namespace PGUPV {
   class Rect;
-  class TextureText;
+  class TextBatch;
   class GLMatrices;
   class Program;
 
@@ -22,11 +22,14 @@ namespace PGUPV {
     void reshape(uint w, uint h) override;
     void setMaxWidth(uint w);
   private:
-    std::shared_ptr<Rect> overlay, background;
-    std::shared_ptr<TextureText> textHelp;
+    std::shared_ptr<Rect> background;
+    std::shared_ptr<TextBatch> textHelp;
     std::shared_ptr<GLMatrices> mats;
+    std::string text;
     unsigned int windowWidth, windowHeight;
     unsigned int maxWidth;
     unsigned int textWidth, textHeight;
+    // Escala con la que se ha colocado el texto en textHelp (0 si hay que volver a colocarlo)
+    float layoutScale;
   };
 };
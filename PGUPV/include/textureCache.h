@@ -0,0 +1,91 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <GL/glew.h>
+
+namespace PGUPV {
+
+	class Texture2D;
+	class Image;
+
+	/**
+	Caché de texturas 2D cargadas desde fichero, compartida por toda la aplicación. Las
+	texturas se identifican por la ruta del fichero y por sus parámetros (filtros, modo de
+	repetición y formato interno), así que si varios materiales usan la misma imagen se
+	carga una sola vez, y todos comparten el mismo objeto textura.
+
+	La caché no mantiene vivas las texturas: sólo guarda referencias débiles, y una textura
+	se libera cuando deja de usarla el último material. Como las texturas son compartidas,
+	no hay que cambiar sus parámetros ni su contenido (si hace falta, crea una nueva).
+
+	find se puede llamar desde cualquier hilo. El resto de métodos crean objetos de
+	OpenGL, así que sólo se pueden llamar desde el hilo principal.
+	*/
+	class TextureCache {
+	public:
+		//! Parámetros de una textura de la caché
+		struct Key {
+			Key(const std::string &path, GLenum minFilter = GL_LINEAR_MIPMAP_LINEAR, GLenum magFilter = GL_LINEAR,
+				GLenum wrapS = GL_REPEAT, GLenum wrapT = GL_REPEAT, GLenum internalFormat = GL_RGB) :
+				path(path), minFilter(minFilter), magFilter(magFilter), wrapS(wrapS), wrapT(wrapT),
+				internalFormat(internalFormat) {}
+			std::string path;
+			GLenum minFilter, magFilter, wrapS, wrapT, internalFormat;
+			bool operator<(const Key &other) const {
+				return std::tie(path, minFilter, magFilter, wrapS, wrapT, internalFormat) <
+					std::tie(other.path, other.minFilter, other.magFilter, other.wrapS, other.wrapT, other.internalFormat);
+			}
+		};
+
+		//! Devuelve la caché compartida por toda la aplicación
+		static TextureCache &getInstance();
+
+		/**
+		\return la textura con los parámetros indicados, si está en la caché y alguien la
+		sigue usando, o nullptr
+		*/
+		std::shared_ptr<Texture2D> find(const Key &key);
+		/**
+		Añade a la caché una textura ya cargada (p.e., desde una imagen decodificada en otro hilo)
+		*/
+		void insert(const Key &key, std::shared_ptr<Texture2D> texture);
+		/**
+		Crea una textura con la imagen indicada (ya decodificada, p.e., en otro hilo) y la
+		añade a la caché
+		*/
+		std::shared_ptr<Texture2D> create(const Key &key, const Image &image);
+		/**
+		Devuelve la textura de la caché o, si no está, la carga desde el fichero key.path (con
+		mipmaps, si el filtro de minimización los usa) y la añade.
+		\return la textura, o nullptr si no se ha podido cargar el fichero
+		*/
+		std::shared_ptr<Texture2D> load(const Key &key);
+		/**
+		Textura que se usa en lugar de las que no se han podido cargar: un tablero de ajedrez
+		de colores llamativos. Se crea una sola, que comparten todos los materiales
+		*/
+		std::shared_ptr<Texture2D> getFallback();
+
+		//! Número de texturas vivas en la caché
+		size_t size();
+		//! Olvida todas las texturas (las que se estén usando siguen siendo válidas)
+		void clear();
+	private:
+		TextureCache() : purgeThreshold(MIN_PURGE_THRESHOLD) {}
+		TextureCache(const TextureCache &) = delete;
+		TextureCache &operator=(const TextureCache &) = delete;
+		// Elimina las entradas de texturas que ya se han liberado
+		void purge();
+
+		static const size_t MIN_PURGE_THRESHOLD = 64;
+		std::mutex m;
+		std::map<Key, std::weak_ptr<Texture2D>> textures;
+		// Se purga cuando el mapa alcanza este tamaño, que se duplica tras cada purga
+		size_t purgeThreshold;
+		std::weak_ptr<Texture2D> fallback;
+	};
+};
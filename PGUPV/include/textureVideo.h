@@ -1,6 +1,8 @@
 #pragma once
 
 #include <memory>
+#include <vector>
+#include "bufferObject.h"
 #include "media.h"
 #include "texture2D.h"
 #include "videoDevice.h"
@@ -13,6 +15,11 @@ namespace PGUPV {
   Construye una textura 2D asociada a un flujo de vídeo, que puede venir desde una cámara o desde
   un fichero de vídeo.
 
+  Si el sistema soporta GL_ARB_buffer_storage (OpenGL 4.4), el hilo decodificador escribe cada
+  fotograma directamente en un anillo de pixel buffer objects mapeados de forma persistente, y
+  la subida a la textura la hace la GPU desde ese buffer sin que la CPU copie los píxeles. Cada
+  buffer no se devuelve al decodificador hasta que la GPU ha terminado de leerlo (con un fence).
+  Si no, los fotogramas se suben desde memoria de la CPU.
   */
 
   class TextureVideo : public Texture2D {
@@ -61,7 +68,28 @@ namespace PGUPV {
       hace nada en caso de estar asociada a una cámara)
     */
     void rewind();
+    /**
+      Salta a la posición indicada del vídeo (sólo si la textura está reproduciendo un archivo)
+      \param seconds segundos desde el principio del vídeo
+    */
+    void seek(double seconds);
+    /**
+      Con el vídeo en pausa, avanza un fotograma
+    */
+    void step();
+    //! Posición del fotograma mostrado, en segundos
+    double getPosition() const { return media->getPosition(); }
+    //! Duración del vídeo, en segundos (0 si no se conoce)
+    double getDuration() const { return media->getDuration(); }
   private:
+    // Número de buffers en el anillo de fotogramas decodificados
+    static const unsigned int NUM_FRAMES = 4;
+    void uploadFrame();
+    // Arranca el hilo decodificador, creando los PBOs si se pueden usar
+    void startDecoding();
+    // Espera a que la GPU termine de leer el fotograma subido y lo devuelve al decodificador
+    void releaseFrame();
+    void destroyPBOs();
     void registerCallback();
     void unregisterCallback();
     std::unique_ptr<media::Media> media;
@@ -69,5 +97,11 @@ namespace PGUPV {
     enum class Status { PLAYING, PAUSE };
     Status status;
     size_t updateCallbackId;
+    // Anillo de PBOs en el que escribe el hilo decodificador (vacío si no se usan)
+    std::vector<std::shared_ptr<BufferObject>> pbos;
+    std::vector<uint8_t *> pboMemory;
+    // Fotograma bloqueado que la GPU puede estar leyendo todavía, y su fence
+    const uint8_t *frameInUse;
+    GLsync uploadFence;
   };
 };
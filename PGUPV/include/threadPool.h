@@ -0,0 +1,77 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace PGUPV {
+
+	/**
+	Conjunto de hilos trabajadores que ejecutan las tareas que se les encargan. La biblioteca
+	usa el conjunto compartido (getInstance) para repartir trabajo de la CPU entre todos los
+	núcleos, como el cálculo de las matrices de los huesos de las animaciones.
+
+	Las tareas no deben hacer llamadas a OpenGL: sólo el hilo principal tiene el contexto.
+	*/
+	class ThreadPool {
+	public:
+		/**
+		Crea el conjunto de hilos
+		\param numThreads número de hilos trabajadores. Si es 0, se crea uno por núcleo
+		*/
+		explicit ThreadPool(unsigned int numThreads = 0);
+		~ThreadPool();
+
+		//! Devuelve el conjunto de hilos compartido por toda la aplicación
+		static ThreadPool &getInstance();
+
+		unsigned int getNumThreads() const { return static_cast<unsigned int>(workers.size()); }
+		/**
+		Cambia el número de hilos trabajadores. Espera a que terminen las tareas pendientes
+		\param numThreads número de hilos. Si es 0, se crea uno por núcleo
+		*/
+		void resize(unsigned int numThreads);
+
+		/**
+		Encola una tarea para que la ejecute alguno de los hilos
+		\param task función a ejecutar
+		\return un future con el resultado de la tarea (o la excepción que haya lanzado)
+		*/
+		template <typename F>
+		std::future<typename std::result_of<F()>::type> submit(F task) {
+			using R = typename std::result_of<F()>::type;
+			auto pt = std::make_shared<std::packaged_task<R()>>(std::move(task));
+			auto result = pt->get_future();
+			enqueue([pt]() { (*pt)(); });
+			return result;
+		}
+
+		/**
+		Ejecuta op(i) para todo i en [0, n), repartiendo las llamadas entre los hilos
+		trabajadores y el hilo que llama, y espera a que terminen todas. Si alguna llamada
+		lanza una excepción, se relanza aquí. Se puede llamar desde dentro de una tarea.
+		\param n número de iteraciones
+		\param op función a ejecutar en cada iteración
+		*/
+		void parallelFor(size_t n, const std::function<void(size_t)> &op);
+	private:
+		ThreadPool(const ThreadPool &) = delete;
+		ThreadPool &operator=(const ThreadPool &) = delete;
+		void enqueue(std::function<void()> task);
+		void start(unsigned int numThreads);
+		void stop();
+		void workerLoop();
+
+		std::vector<std::thread> workers;
+		std::deque<std::function<void()>> tasks;
+		std::mutex m;
+		std::condition_variable cv;
+		bool done;
+	};
+};
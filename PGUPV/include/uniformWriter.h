@@ -3,6 +3,7 @@
 
 #include <GL/glew.h>
 #include <glm/glm.hpp>
+#include <vector>
 
 namespace PGUPV {
 class UniformWriter {
@@ -71,6 +72,217 @@ public:
 		glUniform4ui(loc, v.x, v.y, v.z, v.w);
 	}
 
+	// Versiones con acceso directo (glProgramUniform*): escriben count elementos consecutivos
+	// de un array en el programa indicado, sin tener que instalarlo con Program::use.
+	// glProgramUniform* necesita OpenGL 4.1 o GL_ARB_separate_shader_objects. Si no están
+	// disponibles, se instala el programa temporalmente y se usa glUniform*
+
+	inline static void write(GLuint program, GLint loc, GLsizei count, const GLfloat *v) {
+		if (hasDirectAccess())
+			glProgramUniform1fv(program, loc, count, v);
+		else {
+			InstalledProgram installed(program);
+			glUniform1fv(loc, count, v);
+		}
+	}
+
+	inline static void write(GLuint program, GLint loc, GLsizei count, const glm::vec2 *v) {
+		if (hasDirectAccess())
+			glProgramUniform2fv(program, loc, count, &v->x);
+		else {
+			InstalledProgram installed(program);
+			glUniform2fv(loc, count, &v->x);
+		}
+	}
+
+	inline static void write(GLuint program, GLint loc, GLsizei count, const glm::vec3 *v) {
+		if (hasDirectAccess())
+			glProgramUniform3fv(program, loc, count, &v->x);
+		else {
+			InstalledProgram installed(program);
+			glUniform3fv(loc, count, &v->x);
+		}
+	}
+
+	inline static void write(GLuint program, GLint loc, GLsizei count, const glm::vec4 *v) {
+		if (hasDirectAccess())
+			glProgramUniform4fv(program, loc, count, &v->x);
+		else {
+			InstalledProgram installed(program);
+			glUniform4fv(loc, count, &v->x);
+		}
+	}
+
+	inline static void write(GLuint program, GLint loc, GLsizei count, const GLdouble *v) {
+		if (hasDirectAccess())
+			glProgramUniform1dv(program, loc, count, v);
+		else {
+			InstalledProgram installed(program);
+			glUniform1dv(loc, count, v);
+		}
+	}
+
+	inline static void write(GLuint program, GLint loc, GLsizei count, const glm::dvec2 *v) {
+		if (hasDirectAccess())
+			glProgramUniform2dv(program, loc, count, &v->x);
+		else {
+			InstalledProgram installed(program);
+			glUniform2dv(loc, count, &v->x);
+		}
+	}
+
+	inline static void write(GLuint program, GLint loc, GLsizei count, const glm::dvec3 *v) {
+		if (hasDirectAccess())
+			glProgramUniform3dv(program, loc, count, &v->x);
+		else {
+			InstalledProgram installed(program);
+			glUniform3dv(loc, count, &v->x);
+		}
+	}
+
+	inline static void write(GLuint program, GLint loc, GLsizei count, const glm::dvec4 *v) {
+		if (hasDirectAccess())
+			glProgramUniform4dv(program, loc, count, &v->x);
+		else {
+			InstalledProgram installed(program);
+			glUniform4dv(loc, count, &v->x);
+		}
+	}
+
+	inline static void write(GLuint program, GLint loc, GLsizei count, const GLint *v) {
+		if (hasDirectAccess())
+			glProgramUniform1iv(program, loc, count, v);
+		else {
+			InstalledProgram installed(program);
+			glUniform1iv(loc, count, v);
+		}
+	}
+
+	inline static void write(GLuint program, GLint loc, GLsizei count, const glm::ivec2 *v) {
+		if (hasDirectAccess())
+			glProgramUniform2iv(program, loc, count, &v->x);
+		else {
+			InstalledProgram installed(program);
+			glUniform2iv(loc, count, &v->x);
+		}
+	}
+
+	inline static void write(GLuint program, GLint loc, GLsizei count, const glm::ivec3 *v) {
+		if (hasDirectAccess())
+			glProgramUniform3iv(program, loc, count, &v->x);
+		else {
+			InstalledProgram installed(program);
+			glUniform3iv(loc, count, &v->x);
+		}
+	}
+
+	inline static void write(GLuint program, GLint loc, GLsizei count, const glm::ivec4 *v) {
+		if (hasDirectAccess())
+			glProgramUniform4iv(program, loc, count, &v->x);
+		else {
+			InstalledProgram installed(program);
+			glUniform4iv(loc, count, &v->x);
+		}
+	}
+
+	inline static void write(GLuint program, GLint loc, GLsizei count, const GLuint *v) {
+		if (hasDirectAccess())
+			glProgramUniform1uiv(program, loc, count, v);
+		else {
+			InstalledProgram installed(program);
+			glUniform1uiv(loc, count, v);
+		}
+	}
+
+	inline static void write(GLuint program, GLint loc, GLsizei count, const glm::uvec2 *v) {
+		if (hasDirectAccess())
+			glProgramUniform2uiv(program, loc, count, &v->x);
+		else {
+			InstalledProgram installed(program);
+			glUniform2uiv(loc, count, &v->x);
+		}
+	}
+
+	inline static void write(GLuint program, GLint loc, GLsizei count, const glm::uvec3 *v) {
+		if (hasDirectAccess())
+			glProgramUniform3uiv(program, loc, count, &v->x);
+		else {
+			InstalledProgram installed(program);
+			glUniform3uiv(loc, count, &v->x);
+		}
+	}
+
+	inline static void write(GLuint program, GLint loc, GLsizei count, const glm::uvec4 *v) {
+		if (hasDirectAccess())
+			glProgramUniform4uiv(program, loc, count, &v->x);
+		else {
+			InstalledProgram installed(program);
+			glUniform4uiv(loc, count, &v->x);
+		}
+	}
+
+	inline static void write(GLuint program, GLint loc, GLsizei count, const bool *v) {
+		const std::vector<GLint> ints(v, v + count);
+		if (hasDirectAccess())
+			glProgramUniform1iv(program, loc, count, ints.data());
+		else {
+			InstalledProgram installed(program);
+			glUniform1iv(loc, count, ints.data());
+		}
+	}
+
+	inline static void write(GLuint program, GLint loc, GLsizei count, const glm::mat2 *v) {
+		if (hasDirectAccess())
+			glProgramUniformMatrix2fv(program, loc, count, GL_FALSE, &(*v)[0][0]);
+		else {
+			InstalledProgram installed(program);
+			glUniformMatrix2fv(loc, count, GL_FALSE, &(*v)[0][0]);
+		}
+	}
+
+	inline static void write(GLuint program, GLint loc, GLsizei count, const glm::mat3 *v) {
+		if (hasDirectAccess())
+			glProgramUniformMatrix3fv(program, loc, count, GL_FALSE, &(*v)[0][0]);
+		else {
+			InstalledProgram installed(program);
+			glUniformMatrix3fv(loc, count, GL_FALSE, &(*v)[0][0]);
+		}
+	}
+
+	inline static void write(GLuint program, GLint loc, GLsizei count, const glm::mat4 *v) {
+		if (hasDirectAccess())
+			glProgramUniformMatrix4fv(program, loc, count, GL_FALSE, &(*v)[0][0]);
+		else {
+			InstalledProgram installed(program);
+			glUniformMatrix4fv(loc, count, GL_FALSE, &(*v)[0][0]);
+		}
+	}
+
+private:
+	static bool hasDirectAccess() {
+		static const bool direct = GLEW_VERSION_4_1 || GLEW_ARB_separate_shader_objects;
+		return direct;
+	}
+
+	// Instala el programa indicado mientras existe, y luego vuelve a instalar el anterior
+	class InstalledProgram {
+	public:
+		explicit InstalledProgram(GLuint program) {
+			glGetIntegerv(GL_CURRENT_PROGRAM, &previous);
+			if (static_cast<GLuint>(previous) != program)
+				glUseProgram(program);
+			else
+				previous = -1;
+		}
+		~InstalledProgram() {
+			if (previous >= 0)
+				glUseProgram(static_cast<GLuint>(previous));
+		}
+		InstalledProgram(const InstalledProgram &) = delete;
+		InstalledProgram &operator=(const InstalledProgram &) = delete;
+	private:
+		GLint previous;
+	};
 };
 
 }; // namespace
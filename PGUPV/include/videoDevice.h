@@ -32,6 +32,8 @@ namespace media {
 		static Options listOptions(unsigned int camera);
 		// Constante que indica usar la velocidad mayor
 		static const float MAX_FPS;
+	protected:
+		bool isLive() const override { return true; }
 	private:
 		static bool libavInitialized;
 		static std::vector<std::string> availableCameras;
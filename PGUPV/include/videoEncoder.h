@@ -0,0 +1,83 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct AVFormatContext;
+struct AVCodecContext;
+struct AVStream;
+struct AVFrame;
+struct SwsContext;
+
+namespace media {
+	/**
+	\class VideoEncoder
+	Escribe un fichero de vídeo con los fotogramas que se le pasan (RGB24), usando las
+	bibliotecas de ffmpeg. El formato y el codec dependen de la extensión del fichero (p.e.,
+	.mp4 o .avi). La conversión de color y la codificación se hacen en un hilo propio, así
+	que addFrame sólo copia el fotograma a una cola (y espera si la cola está llena).
+	*/
+	class VideoEncoder {
+	public:
+		// Número máximo de fotogramas en la cola
+		static const size_t MAX_QUEUED_FRAMES = 8;
+		/**
+		Crea el fichero y arranca el hilo codificador. Si no se puede, lanza std::runtime_error
+		(sin escribir en el log ni mostrar el error al usuario).
+		\param path fichero de salida
+		\param width ancho de los fotogramas
+		\param height alto de los fotogramas
+		\param fps fotogramas por segundo del vídeo
+		*/
+		VideoEncoder(const std::string &path, unsigned int width, unsigned int height, unsigned int fps);
+		//! Termina el vídeo (ver finish)
+		~VideoEncoder();
+		/**
+		Añade un fotograma al vídeo
+		\param rgb width * height píxeles RGB24, sin relleno entre filas, empezando por la fila
+		de abajo (como los devuelve glReadPixels)
+		*/
+		void addFrame(const uint8_t *rgb);
+		/**
+		Espera a que se codifiquen los fotogramas pendientes y cierra el fichero. Después no se
+		pueden añadir más fotogramas
+		\return true si se ha podido escribir el vídeo completo
+		*/
+		bool finish();
+		unsigned int getNumFrames() const { return numFrames; }
+	private:
+		VideoEncoder(const VideoEncoder &) = delete;
+		VideoEncoder &operator=(const VideoEncoder &) = delete;
+		void encoderThread();
+		// Convierte el fotograma y lo envía al codificador
+		void encode(const std::vector<uint8_t> &rgb);
+		// Envía el fotograma (o nullptr, para vaciar el codificador) y escribe los paquetes generados
+		void writePackets(AVFrame *frame);
+		void release();
+
+		std::string path;
+		unsigned int width, height, numFrames;
+		AVFormatContext *formatCtx;
+		AVCodecContext *codecCtx;
+		AVStream *stream;
+		AVFrame *frame;
+		SwsContext *swsCtx;
+		int64_t nextPts;
+
+		std::thread thread;
+		std::mutex m;
+		std::condition_variable cv;
+		std::deque<std::vector<uint8_t>> queue;
+		// Buffers ya codificados, para reutilizarlos
+		std::vector<std::vector<uint8_t>> spare;
+		bool done;
+		// Descripción del primer error del hilo codificador (vacía si no ha habido ninguno)
+		std::string error;
+		bool finished;
+	};
+};
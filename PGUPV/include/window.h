@@ -41,6 +41,7 @@ namespace PGUPV {
 	class LineChartWidget;
 	class Label;
 	class LogConsole;
+	class FrameCapture;
 
 	class Window {
 	public:
@@ -144,6 +145,20 @@ namespace PGUPV {
 		 ventana */
 		bool saveColorBuffer(const std::string &filename,
 			GLint framebuffer = GL_FRONT);
+		/**
+		 Como saveColorBuffer, pero sin detener el dibujado: los píxeles se leen unos
+		 fotogramas después, y la imagen se guarda en otro hilo (ver FrameCapture)
+		 */
+		bool captureColorBuffer(const std::string &filename,
+			GLint framebuffer = GL_FRONT);
+		/**
+		 Devuelve el objeto que hace las capturas asíncronas de la ventana (p.e., para grabar
+		 un vídeo). Si la ventana ha cambiado de tamaño, termina las capturas pendientes y crea
+		 uno nuevo
+		 */
+		FrameCapture &getFrameCapture();
+		//! Procesa las capturas asíncronas que ya han terminado. App::run la llama en cada fotograma
+		void pollFrameCapture();
 		// Devuelve el número de bits por cada elemento del stencil del framebuffer
 		// asociado a GL_READ_BUFFER
 		uint getStencilSize();
@@ -208,6 +223,7 @@ namespace PGUPV {
 		bool _showfps, _showHelp, _showConsole;
 		ShowBuffer _showBuffer;
 		std::unique_ptr<BufferRenderer> _bufferRenderer;
+		std::unique_ptr<FrameCapture> _frameCapture;
 		std::shared_ptr<TextOverlay> _helpOverlay;
 		bool _showGUI;
 		GLVersion _openGLVersion;
@@ -218,9 +234,9 @@ namespace PGUPV {
 
 		// Panel de estadísticas
 		std::shared_ptr<Panel> statspanel;
-		std::shared_ptr<LineChartWidget> fpsWidget, msPerFrameWidget, samplesPassedWidget, primitivesGeneratedWidget, verticesSubmittedWidget;
+		std::shared_ptr<LineChartWidget> fpsWidget, msPerFrameWidget, gpuMsPerFrameWidget, samplesPassedWidget, primitivesGeneratedWidget, verticesSubmittedWidget;
 		std::shared_ptr<LineChartWidget> primitivesSubmittedWidget, fragmentShaderInvWidget, clippingInWidget, clippingOutWidget;
-		std::shared_ptr<Label> vertexShaderInvWidget, tessControlShaderInvWidget, tessEvalShaderInvWidget, computeShaderInvWidget;
+		std::shared_ptr<Label> gpuLatencyWidget, vertexShaderInvWidget, tessControlShaderInvWidget, tessEvalShaderInvWidget, computeShaderInvWidget;
 
 		GLStats glstats;
 
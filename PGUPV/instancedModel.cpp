@@ -0,0 +1,127 @@
+#include "instancedModel.h"
+#include "model.h"
+#include "bufferObject.h"
+#include "indexedBindingPoint.h"
+#include "profiler.h"
+#include "log.h"
+
+using PGUPV::InstancedModel;
+using PGUPV::BoundingBox;
+using PGUPV::BoundingSphere;
+
+const std::string InstancedModel::blockName{ "Instances" };
+
+const Strings InstancedModel::definition{
+"struct Instance {",
+"  mat4 modelMatrix;",
+"  vec4 data;",
+"};",
+"layout (std430, binding=" + std::to_string(SSBO_INSTANCES_BINDING_INDEX) + ") readonly buffer Instances {",
+"  Instance instances[];",
+"};",
+};
+
+InstancedModel::InstancedModel(std::shared_ptr<Model> model) : model(model), dirty(true),
+	boundsDirty(true), drawCalls(0) {
+	if (!model)
+		ERRT("InstancedModel necesita un modelo");
+}
+
+InstancedModel::~InstancedModel() {
+}
+
+size_t InstancedModel::addInstance(const glm::mat4 &modelMatrix, const glm::vec4 &data) {
+	Instance instance;
+	instance.modelMatrix = modelMatrix;
+	instance.data = data;
+	instances.push_back(instance);
+	dirty = boundsDirty = true;
+	return instances.size() - 1;
+}
+
+void InstancedModel::setInstanceMatrix(size_t i, const glm::mat4 &modelMatrix) {
+	instances.at(i).modelMatrix = modelMatrix;
+	dirty = boundsDirty = true;
+}
+
+void InstancedModel::setInstanceData(size_t i, const glm::vec4 &data) {
+	instances.at(i).data = data;
+	dirty = true;
+}
+
+void InstancedModel::removeInstance(size_t i) {
+	if (i >= instances.size())
+		ERRT("Esa instancia no existe");
+	instances[i] = instances.back();
+	instances.pop_back();
+	dirty = boundsDirty = true;
+}
+
+void InstancedModel::setInstances(const std::vector<Instance> &newInstances) {
+	instances = newInstances;
+	dirty = boundsDirty = true;
+}
+
+void InstancedModel::clearInstances() {
+	instances.clear();
+	dirty = boundsDirty = true;
+}
+
+void InstancedModel::upload() {
+	if (!dirty)
+		return;
+	const size_t size = instances.size() * sizeof(Instance);
+	if (!buffer || buffer->getSize() < size) {
+		// Se reserva el doble, para no tener que crear otro buffer cada vez que se añade una instancia
+		buffer = BufferObject::build(2 * size, GL_DYNAMIC_DRAW);
+	}
+	else {
+		// El buffer puede estar en uso por el fotograma anterior: se descarta su contenido para que
+		// el driver no tenga que esperar a la GPU
+		glInvalidateBufferData(buffer->getId());
+	}
+	gl_shader_storage_buffer.bindBufferBase(buffer, SSBO_INSTANCES_BINDING_INDEX);
+	gl_shader_storage_buffer.write(instances.data(), static_cast<ulong>(size), 0);
+	dirty = false;
+}
+
+void InstancedModel::render() {
+	drawCalls = 0;
+	if (instances.empty())
+		return;
+	PGUPV_PROFILE_ZONE("InstancedModel::render");
+	upload();
+	gl_shader_storage_buffer.bindBufferBase(buffer, SSBO_INSTANCES_BINDING_INDEX);
+	const GLsizei n = static_cast<GLsizei>(instances.size());
+	for (uint i = 0; i < model->getNMeshes(); i++) {
+		Mesh &mesh = model->getMesh(i);
+		mesh.renderInstanced(n);
+		drawCalls += mesh.getDrawCommands().size();
+	}
+}
+
+void InstancedModel::updateBoundingVolumes() {
+	if (!boundsDirty)
+		return;
+	bb.reset();
+	bs.reset();
+	const BoundingBox modelBB = model->getBB();
+	for (const auto &instance : instances) {
+		BoundingBox instanceBB = modelBB;
+		instanceBB.transform(instance.modelMatrix);
+		bb.grow(instanceBB);
+	}
+	if (bb.isValid())
+		bs = BoundingSphere(bb.getCenter(), glm::length(bb.max - bb.getCenter()));
+	boundsDirty = false;
+}
+
+BoundingBox InstancedModel::getBB() {
+	updateBoundingVolumes();
+	return bb;
+}
+
+BoundingSphere InstancedModel::getBS() {
+	updateBoundingVolumes();
+	return bs;
+}
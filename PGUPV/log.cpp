@@ -80,6 +80,7 @@ void Log::writeErrorLog(const std::string &str, const char *file, int line,
 
 		INSERTA EN LA LINEA SIGUIENTE EL PUNTO DE RUPTURA ->
 		*/
+		std::lock_guard<std::mutex> lock{ errLogMutex };
 		errLog.flush();
 	}
 }
@@ -150,7 +151,11 @@ void Log::writeErrorLog(const std::string &str, int level) {
 	std::cerr << msg.str();
 #endif
 #endif
-	errLog << "[" << PGUPV::getCurrentDateTimeString() << "] " << msg.str();
+	{
+		// Se puede escribir en el log desde los hilos trabajadores
+		std::lock_guard<std::mutex> lock{ errLogMutex };
+		errLog << "[" << PGUPV::getCurrentDateTimeString() << "] " << msg.str();
+	}
 
 	notify(msg.str());
 }
@@ -194,6 +194,13 @@ void Material::use() {
 }
 
 
+bool Material::isTransparent() const {
+	if (getDiffuse().a < 1.0f)
+		return true;
+	auto opacity = texs.lower_bound(OPACITYMAP_TUNIT);
+	return opacity != texs.end() && opacity->first < AMBIENT_TUNIT;
+}
+
 void Material::unuse() {
 	for (auto t : texs) {
 		t.second->unbind();
@@ -1,6 +1,8 @@
 
+#include <chrono>
 #include <vector>
 #include <assert.h>
+#include <cstring>
 
 extern "C" {
 #ifdef _WIN32
@@ -18,13 +20,20 @@ extern "C" {
 
 #include "app.h"
 #include "media.h"
+#include "frameRing.h"
 #include "log.h"
 
 using media::Media;
+using PGUPV::FrameRing;
 
 bool Media::libInitialized = false;
 
-Media::Media() : autoloop(false), endOfVideo(false) {
+// Valor de clockStart cuando el reloj de reproducción todavía no ha empezado
+static const int64_t CLOCK_NOT_STARTED = INT64_MIN;
+
+Media::Media() : frameDuration(40000), autoloop(false), endOfVideo(false), stopDecoder(false),
+	framePending(false), pendingTimestamp(0), lastDecodedTimestamp(-1), clockStart(CLOCK_NOT_STARTED),
+	pauseStart(0), clockReference(0), lastShownTimestamp(0), paused(false), stepRequested(false) {
 	if (!libInitialized) {
 		// Register all formats and codecs
 		av_register_all();
@@ -32,6 +41,8 @@ Media::Media() : autoloop(false), endOfVideo(false) {
 }
 
 Media::~Media() {
+	stopDecodingThread();
+
 	// Free the RGB image
 	if (buffer) av_free(buffer);
 
@@ -132,7 +143,9 @@ void Media::prepareForReading() {
 	av_image_fill_arrays(pFrameRGB->data, pFrameRGB->linesize, buffer,
 		AV_PIX_FMT_RGB24, w, h, 1);
 
-	msPerFrame = static_cast<unsigned int>(1000.0f / getFPS());
+	auto fps = getFPS();
+	if (fps > 0.0f)
+		frameDuration = static_cast<int64_t>(1e6f / fps);
 }
 
 float Media::getFPS() const {
@@ -185,97 +198,330 @@ std::string Media::getPixelFormat() const {
 
 
 
-// From https://blogs.gentoo.org/lu_zero/2016/03/29/new-avcodec-api/
-static int decode(AVCodecContext *avctx, AVFrame *frame, int *got_frame, AVPacket *pkt)
-{
-	int ret;
+// Basado en https://blogs.gentoo.org/lu_zero/2016/03/29/new-avcodec-api/
+int Media::decodeNextFrame() {
+	AVPacket packet;
+	for (;;) {
+		int ret = avcodec_receive_frame(pCodecCtx, pFrame);
+		if (ret >= 0)
+			return 1;
+		if (ret == AVERROR_EOF)
+			return 0;
+		if (ret != AVERROR(EAGAIN))
+			return ret;
+
+		// El decodificador necesita más paquetes
+		ret = av_read_frame(pFormatCtx, &packet);
+		if (ret == AVERROR_EOF) {
+			// Sacamos los fotogramas que queden dentro del decodificador
+			avcodec_send_packet(pCodecCtx, nullptr);
+			continue;
+		}
+		if (ret < 0)
+			return ret;
+		if (packet.stream_index == firstVideoStream)
+			ret = avcodec_send_packet(pCodecCtx, &packet);
+		// Free the packet that was allocated by av_read_frame
+		av_packet_unref(&packet);
+		if (ret < 0 && ret != AVERROR_EOF)
+			return ret;
+	}
+}
 
-	*got_frame = 0;
+void Media::convertFrame(uint8_t *dst, bool originAtBottom) {
+	const int stride = 3 * pCodecCtx->width;
+	uint8_t *dstData[4] = { dst, nullptr, nullptr, nullptr };
+	int dstLinesize[4] = { stride, 0, 0, 0 };
+	if (originAtBottom) {
+		// sws_scale escribe las filas de abajo a arriba si empezamos por la última con el paso negativo
+		dstData[0] = dst + static_cast<ptrdiff_t>(stride) * (pCodecCtx->height - 1);
+		dstLinesize[0] = -stride;
+	}
+
+	// Convert the image from its native format to RGB
+	sws_scale(
+		sws_ctx,
+		(uint8_t const * const *)pFrame->data,
+		pFrame->linesize,
+		0,
+		pCodecCtx->height,
+		dstData,
+		dstLinesize
+	);
+}
+
+int64_t Media::getFrameTimestamp() const {
+	auto pts = av_frame_get_best_effort_timestamp(pFrame);
+	if (pts == AV_NOPTS_VALUE)
+		return lastDecodedTimestamp + frameDuration;
+	auto start = pFormatCtx->start_time == AV_NOPTS_VALUE ? 0 : pFormatCtx->start_time;
+	return av_rescale_q(pts, pFormatCtx->streams[firstVideoStream]->time_base, AVRational{ 1, 1000000 }) - start;
+}
 
-	if (pkt) {
-		ret = avcodec_send_packet(avctx, pkt);
-		// In particular, we don't expect AVERROR(EAGAIN), because we read all
-		// decoded frames with avcodec_receive_frame() until done.
+bool Media::seekToStart() {
+	auto start = pFormatCtx->start_time == AV_NOPTS_VALUE ? 0 : pFormatCtx->start_time;
+	int err = av_seek_frame(pFormatCtx, -1, start, AVSEEK_FLAG_BACKWARD);
+	if (err < 0) {
+		reportError("No se ha podido saltar al principio del vídeo (" + ffmpegError(err) + ")");
+		return false;
+	}
+	avcodec_flush_buffers(pCodecCtx);
+	framePending = false;
+	lastDecodedTimestamp = -1;
+	endOfVideo = false;
+	return true;
+}
+
+bool Media::fetchFrame() {
+	if (framePending)
+		return true;
+	for (;;) {
+		int ret = decodeNextFrame();
+		if (ret > 0)
+			break;
 		if (ret < 0)
-			return ret == AVERROR_EOF ? 0 : ret;
+			reportError("Error decodificando el vídeo: " + ffmpegError(ret));
+		else if (autoloop && seekToStart())
+			continue;
+		endOfVideo = true;
+		return false;
 	}
+	pendingTimestamp = lastDecodedTimestamp = getFrameTimestamp();
+	framePending = true;
+	return true;
+}
+
+void Media::seek(double seconds) {
+	// El hilo decodificador usa el contexto de ffmpeg, así que lo paramos mientras saltamos
+	const bool threaded = isDecodingThreadRunning();
+	if (threaded)
+		stopDecodingThread();
+
+	const int64_t target = static_cast<int64_t>(seconds * 1e6);
+	auto start = pFormatCtx->start_time == AV_NOPTS_VALUE ? 0 : pFormatCtx->start_time;
+	// Saltamos al fotograma clave anterior, y decodificamos hasta llegar al pedido
+	int err = av_seek_frame(pFormatCtx, -1, start + target, AVSEEK_FLAG_BACKWARD);
+	if (err < 0) {
+		ERR("No se ha podido saltar en el vídeo (" + ffmpegError(err) + ")");
+	}
+	else {
+		avcodec_flush_buffers(pCodecCtx);
+		framePending = false;
+		lastDecodedTimestamp = -1;
+		endOfVideo = false;
+		const bool loop = autoloop;
+		autoloop = false;
+		while (fetchFrame() && pendingTimestamp + frameDuration / 2 < target)
+			framePending = false;
+		autoloop = loop;
+	}
+
+	clockStart = CLOCK_NOT_STARTED;
+	lastShownTimestamp = clockReference = pendingTimestamp;
+	if (paused)
+		stepRequested = true;
+	if (threaded)
+		launchDecoder();
+}
 
-	ret = avcodec_receive_frame(avctx, frame);
-	if (ret < 0 && ret != AVERROR(EAGAIN) && ret != AVERROR_EOF)
-		return ret;
-	if (ret >= 0)
-		*got_frame = 1;
+void Media::step() {
+	if (paused)
+		stepRequested = true;
+}
+
+double Media::getPosition() const {
+	return lastShownTimestamp / 1e6;
+}
+
+double Media::getDuration() const {
+	if (pFormatCtx->duration == AV_NOPTS_VALUE)
+		return 0.0;
+	return pFormatCtx->duration / 1e6;
+}
+
+int64_t Media::getClockTime() const {
+	return paused ? pauseStart : PGUPV::App::getCurrentMicroSecs();
+}
+
+bool Media::isDue(int64_t timestamp) {
+	if (stepRequested)
+		return true;
+	const int64_t now = getClockTime();
+	if (clockStart == CLOCK_NOT_STARTED) {
+		// El primer fotograma se muestra inmediatamente
+		clockStart = now - timestamp;
+		clockReference = timestamp;
+	}
+	else if (timestamp < clockReference) {
+		// El vídeo ha vuelto a empezar: el primer fotograma va justo después del último
+		clockStart += clockReference + frameDuration - timestamp;
+		clockReference = timestamp;
+	}
+	return !paused && timestamp <= now - clockStart;
+}
 
-	return 0;
+void Media::frameShown(int64_t timestamp) {
+	if (stepRequested) {
+		clockStart = getClockTime() - timestamp;
+		stepRequested = false;
+	}
+	clockReference = lastShownTimestamp = timestamp;
 }
 
 uint8_t *Media::getNextFrame(bool originAtBottom) {
-	AVPacket packet;
-	int frameFinished;
-	uint8_t *result = nullptr;
-	bool done = false;
-	static unsigned long lastFrameTimeStamp = 0;
-
-	auto now = PGUPV::App::getInstance().getCurrentMillis();
-	auto delta = now - lastFrameTimeStamp;
-	if (delta < msPerFrame)
-		return nullptr;
-
-	lastFrameTimeStamp = now;
-
-  int avreadReturnCode = -1;
-	while (!done && (avreadReturnCode = av_read_frame(pFormatCtx, &packet)) >= 0) {
-		// Is this a packet from the video stream?
-		if (packet.stream_index == firstVideoStream) {
-			decode(pCodecCtx, pFrame, &frameFinished, &packet);
-
-			// Did we get a video frame?
-			if (frameFinished) {
-				// Convert the image from its native format to RGB
-				sws_scale(
-					sws_ctx,
-					(uint8_t const * const *)pFrame->data,
-					pFrame->linesize,
-					0,
-					pCodecCtx->height,
-					pFrameRGB->data,
-					pFrameRGB->linesize
-				);
-
-				result = pFrameRGB->data[0];
-
-				if (originAtBottom) {
-					auto stride = pFrameRGB->linesize[0];
-					std::vector<uint8_t> tmpBuffer(stride);
-					uint8_t *org, *dst;
-					for (int i = 0; i < pCodecCtx->height / 2; i++) {
-						org = result + stride * i;
-						dst = result + stride * (pCodecCtx->height - i - 1);
-						memcpy(&tmpBuffer[0], org, stride);
-						memcpy(org, dst, stride);
-						memcpy(dst, &tmpBuffer[0], stride);
-					}
-				}
-				done = true;
+	if (isDecodingThreadRunning())
+		ERRT("Con el hilo decodificador en marcha hay que usar lockFrame/unlockFrame");
+
+	while (fetchFrame() && isDue(pendingTimestamp)) {
+		framePending = false;
+		// Si el siguiente fotograma también toca ya, éste ha llegado tarde: lo descartamos sin convertirlo
+		if (!stepRequested && isDue(pendingTimestamp + frameDuration))
+			continue;
+		convertFrame(buffer, originAtBottom);
+		frameShown(pendingTimestamp);
+		return buffer;
+	}
+	return nullptr;
+}
+
+void Media::startDecodingThread(bool originAtBottom, unsigned int numFrames) {
+	stopDecodingThread();
+	decoderOriginAtBottom = originAtBottom;
+	decoderNumFrames = numFrames;
+	decoderMemory.clear();
+	launchDecoder();
+}
+
+void Media::startDecodingThread(bool originAtBottom, const std::vector<uint8_t *> &frameMemory) {
+	stopDecodingThread();
+	decoderOriginAtBottom = originAtBottom;
+	decoderNumFrames = static_cast<unsigned int>(frameMemory.size());
+	decoderMemory = frameMemory;
+	launchDecoder();
+}
+
+void Media::launchDecoder() {
+	// Con una cámara sólo interesa el último fotograma capturado
+	auto policy = isLive() ? FrameRing::Policy::OnlyNewest : FrameRing::Policy::NoDiscard;
+	if (decoderMemory.empty())
+		frames = std::unique_ptr<FrameRing>(new FrameRing(getWidth(), getHeight(), 24,
+			policy, decoderNumFrames));
+	else
+		frames = std::unique_ptr<FrameRing>(new FrameRing(decoderMemory, policy));
+	stopDecoder = false;
+	decoder = std::thread(&Media::decodeLoop, this, decoderOriginAtBottom);
+}
+
+void Media::stopDecodingThread() {
+	if (!decoder.joinable())
+		return;
+	{
+		std::lock_guard<std::mutex> lock{ decoderMutex };
+		stopDecoder = true;
+	}
+	decoderCV.notify_all();
+	decoder.join();
+	frames.reset();
+	logDecoderErrors();
+}
+
+// true en los hilos decodificadores (decodeLoop)
+static thread_local bool isDecoderThread = false;
+
+void Media::reportError(const std::string &msg) {
+	if (isDecoderThread) {
+		std::lock_guard<std::mutex> lock{ decoderMutex };
+		decoderErrors.push_back(msg);
+	}
+	else
+		ERR(msg);
+}
+
+void Media::logDecoderErrors() {
+	std::vector<std::string> errors;
+	{
+		std::lock_guard<std::mutex> lock{ decoderMutex };
+		errors.swap(decoderErrors);
+	}
+	for (auto &e : errors)
+		ERR(e);
+}
+
+void Media::decodeLoop(bool originAtBottom) {
+	isDecoderThread = true;
+	while (!stopDecoder && fetchFrame()) {
+		// Esperamos a que haya un buffer libre en el anillo
+		uint8_t *dst = nullptr;
+		{
+			std::unique_lock<std::mutex> lock{ decoderMutex };
+			decoderCV.wait(lock, [this, &dst]() {
+				return stopDecoder || (dst = frames->lockForWrite()) != nullptr;
+			});
+		}
+		if (!dst)
+			break;
+		convertFrame(dst, originAtBottom);
+		framePending = false;
+		{
+			std::lock_guard<std::mutex> lock{ decoderMutex };
+			frames->unlockForWrite(pendingTimestamp);
+		}
+		decoderCV.notify_all();
+	}
+	// Por si lockFrame está esperando un fotograma que ya no llegará
+	decoderCV.notify_all();
+}
+
+const uint8_t *Media::lockFrame() {
+	if (!frames)
+		ERRT("No se ha arrancado el hilo decodificador");
+
+	const uint8_t *result = nullptr;
+	{
+		std::unique_lock<std::mutex> lock{ decoderMutex };
+		if (isLive()) {
+			result = frames->lockForRead();
+		}
+		else {
+			int64_t timestamp;
+			// Al avanzar fotograma a fotograma, damos tiempo al hilo para decodificar el siguiente
+			if (stepRequested)
+				decoderCV.wait_for(lock, std::chrono::milliseconds(100), [this, &timestamp]() {
+					return endOfVideo || frames->peek(timestamp);
+				});
+			while (frames->peek(timestamp) && isDue(timestamp)) {
+				// Si ya teníamos uno, ha llegado tarde: lo descartamos
+				if (result)
+					frames->unlockForRead();
+				result = frames->lockForRead(&timestamp);
+				frameShown(timestamp);
 			}
 		}
+	}
+	// Los fotogramas descartados dejan sitio al hilo decodificador
+	decoderCV.notify_all();
+	logDecoderErrors();
+	return result;
+}
 
-		// Free the packet that was allocated by av_read_frame
-		av_packet_unref(&packet);
+void Media::unlockFrame() {
+	{
+		std::lock_guard<std::mutex> lock{ decoderMutex };
+		frames->unlockForRead();
 	}
+	decoderCV.notify_all();
+}
 
-  if (!done) {
-    // We arrive here because av_read_frame failed. Let's investigate
-    if (avreadReturnCode == AVERROR_EOF) {
-      if (autoloop) {
-        av_seek_frame(pFormatCtx, -1, 0, AVSEEK_FLAG_BACKWARD);
-      }
-      else {
-        endOfVideo = true;
-      }
-    }
-  }
-	return result;
+void Media::setPaused(bool pause) {
+	if (pause == paused)
+		return;
+	const int64_t now = PGUPV::App::getCurrentMicroSecs();
+	if (pause)
+		pauseStart = now;
+	else if (clockStart != CLOCK_NOT_STARTED)
+		clockStart += now - pauseStart;
+	paused = pause;
+	stepRequested = false;
 }
 
 std::string media::ffmpegError(int errnum)
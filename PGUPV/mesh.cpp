@@ -1,5 +1,6 @@
 
 #include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
 #include <algorithm>
 #include <sstream>
 #include <gsl/gsl>
@@ -26,10 +27,11 @@ using glm::vec2;
 using glm::vec3;
 using glm::vec4;
 
-Mesh::Mesh() : vbos(_LAST_), epsilonSquared(1e-6f) {
+Mesh::Mesh() : vbos(_LAST_), epsilonSquared(1e-6f), interleavedOffset(0), interleavedStride(0) {
 	indices_type = 0;
 	n_indices = 0;
 	n_vertices = 0;
+	n_components_per_color = 4;
 }
 
 Mesh::~Mesh() { clearDrawCommands(); }
@@ -165,18 +167,10 @@ void Mesh::computeSmoothNormals() {
 		indices = gl_copy_write_buffer.map(GL_READ_ONLY);
 	}
 
-	// Conseguir los vértices
-	auto vtx = getBufferObject(VERTICES);
-	gl_copy_read_buffer.bind(vtx);
-	GLfloat *vs = static_cast<GLfloat *>(gl_copy_read_buffer.map(GL_READ_ONLY));
-
-	// Preguntar por su formato
-	GLint ncomponents;
-	GLint vtxFormat;
-	glGetVertexAttribiv(VERTICES, GL_VERTEX_ATTRIB_ARRAY_SIZE, &ncomponents);
-	glGetVertexAttribiv(VERTICES, GL_VERTEX_ATTRIB_ARRAY_TYPE, &vtxFormat);
-
-	assert(vtxFormat == GL_FLOAT);
+	// Conseguir los vértices (pueden estar intercalados con otros atributos)
+	auto vertices = getVertices();
+	GLfloat *vs = &vertices[0].x;
+	const GLint ncomponents = 3;
 
 	std::vector<glm::vec3> smoothNormals(n_vertices, glm::vec3(0.0f, 0.0f, 0.0f));
 	std::vector<uint> count(n_vertices, 0);
@@ -262,8 +256,6 @@ void Mesh::computeSmoothNormals() {
 		gl_copy_write_buffer.unmap();
 		gl_copy_write_buffer.unbind();
 	}
-	gl_copy_read_buffer.unmap();
-	gl_copy_read_buffer.unbind();
 
 	addNormals(smoothNormals);
 }
@@ -359,8 +351,14 @@ void Mesh::setSkeleton(std::shared_ptr<Skeleton> skel)
 	std::vector<glm::uvec4> boneIds;
 	std::vector<glm::vec4> boneWeights;
 
-	skel->buildArraysOfVerticesAndWeights(gsl::narrow<uint32_t>(n_vertices), boneIds, boneWeights);
+	if (skel->buildArraysOfVerticesAndWeights(gsl::narrow<uint32_t>(n_vertices), boneIds, boneWeights) > 0)
+		WARN("The maximum number of bones per vertex is 4. Ignoring bones");
+	setSkeleton(skel, boneIds, boneWeights);
+}
 
+void Mesh::setSkeleton(std::shared_ptr<Skeleton> skel, const std::vector<glm::uvec4> &boneIds,
+	const std::vector<glm::vec4> &boneWeights)
+{
 	addBoneIds(boneIds);
 	addBoneWeights(boneWeights);
 
@@ -405,6 +403,7 @@ void Mesh::addColors(const glm::vec4 *c, size_t n, GLenum usage) {
 	if (n == 0)
 		return;
 
+	n_components_per_color = 4;
 	createBufferAndCopy(COLORS, sizeof(glm::vec4) * n, usage, c);
 	glEnableVertexAttribArray(COLORS);
 	glVertexAttribPointer(COLORS, 4, GL_FLOAT, GL_FALSE, 0, 0);
@@ -417,6 +416,7 @@ void Mesh::addColors(const float *c, uint ncomponents, size_t nColors,
 	if (nColors == 0)
 		return;
 
+	n_components_per_color = ncomponents;
 	createBufferAndCopy(COLORS, sizeof(float) * ncomponents * nColors, usage, c);
 	glEnableVertexAttribArray(COLORS);
 	glVertexAttribPointer(COLORS, ncomponents, GL_FLOAT, GL_FALSE, 0, 0);
@@ -495,6 +495,30 @@ void Mesh::setAttributeSetup(uint attribute_index, std::shared_ptr<BufferObject>
 	glEnableVertexAttribArray(attribute_index);
 }
 
+void Mesh::setInterleavedAttributes(std::shared_ptr<BufferObject> bo, GLintptr offset, GLsizei stride,
+	const std::vector<VertexAttribFormat> &formats) {
+	// Usamos el último punto de vinculación de buffers de vértices, para no interferir con
+	// glVertexAttribPointer (que usa el del mismo índice que el atributo)
+	GLint bindings;
+	glGetIntegerv(GL_MAX_VERTEX_ATTRIB_BINDINGS, &bindings);
+	const GLuint binding = bindings - 1;
+
+	for (auto &f : formats) {
+		prepareNewVBO(f.index);
+		vbos[f.index] = bo;
+		glEnableVertexAttribArray(f.index);
+		if (f.integer)
+			glVertexAttribIFormat(f.index, f.size, f.type, f.offset);
+		else
+			glVertexAttribFormat(f.index, f.size, f.type, f.normalized, f.offset);
+		glVertexAttribBinding(f.index, binding);
+	}
+	glBindVertexBuffer(binding, bo->getId(), offset, stride);
+	interleaved = formats;
+	interleavedOffset = offset;
+	interleavedStride = stride;
+}
+
 void Mesh::setAttribute(uint attribute_index, std::shared_ptr<BufferObject> bo,
 	GLenum type, uint ncomponents) {
 	setAttributeSetup(attribute_index, bo);
@@ -561,6 +585,16 @@ bool Mesh::removeStaticAttributeValue(GLint index) {
 void Mesh::render() {
 	vao.bind();
 	if (material) material->use();
+	renderDrawCommands();
+}
+
+void Mesh::renderInstanced(GLsizei instances) {
+	vao.bind();
+	if (material) material->use();
+	renderDrawCommands(instances);
+}
+
+void Mesh::renderDrawCommands(GLsizei instances) {
 	if (bones) bones->use();
 
 	for (std::vector<StaticAttribute>::iterator i = staticAttrValues.begin();
@@ -572,8 +606,12 @@ void Mesh::render() {
 		WARN("Intentando dibujar un Mesh sin comandos de dibujo (no se dibujará nada)");
 	}
 #endif
-	for (auto d : drawCommands)
-		d->render();
+	for (auto d : drawCommands) {
+		if (instances > 0)
+			d->renderInstanced(instances);
+		else
+			d->render();
+	}
 	CHECK_GL();
 }
 
@@ -637,6 +675,9 @@ void Mesh::prepareNewVBO(uint attribIndex) {
 		WARN("Sustituyendo un valor estático asociado al atributo " +
 			std::to_string(attribIndex) +
 			" establecido previamente por un buffer");
+	// Si estaba en el buffer intercalado, deja de estarlo
+	interleaved.erase(std::remove_if(interleaved.begin(), interleaved.end(),
+		[attribIndex](const VertexAttribFormat &f) { return f.index == attribIndex; }), interleaved.end());
 }
 
 
@@ -665,25 +706,53 @@ const std::string Mesh::to_string() const {
 	return os.str();
 }
 
+// Convierte a float la componente c del atributo con el formato indicado
+static float decodeComponent(const uint8_t *p, GLenum type, int c) {
+	switch (type) {
+	case GL_HALF_FLOAT:
+		return glm::unpackHalf1x16(reinterpret_cast<const uint16_t *>(p)[c]);
+	case GL_INT_2_10_10_10_REV:
+		return glm::unpackSnorm3x10_1x2(*reinterpret_cast<const uint32_t *>(p))[c];
+	default:
+		assert(type == GL_FLOAT);
+		return reinterpret_cast<const float *>(p)[c];
+	}
+}
+
 template <typename V>
-std::vector<V> copyFromPFloatToVectorVec(std::shared_ptr<BufferObject> vbo, size_t count, int n_components = 3) {
-	auto prev = PGUPV::gl_copy_read_buffer.bind(vbo);
-	float *vb = static_cast<float *>(PGUPV::gl_copy_read_buffer.map(GL_READ_ONLY));
+std::vector<V> Mesh::readAttribute(uint attribIndex, GLint ncomponents) const {
+	// Si no está en el buffer intercalado, son floats consecutivos
+	VertexAttribFormat format{ attribIndex, ncomponents, GL_FLOAT, false, false, 0 };
+	GLintptr offset = 0;
+	GLsizei stride = static_cast<GLsizei>(sizeof(float) * ncomponents);
+	for (auto &f : interleaved) {
+		if (f.index == attribIndex) {
+			format = f;
+			offset = interleavedOffset;
+			stride = interleavedStride;
+		}
+	}
+
+	auto prev = PGUPV::gl_copy_read_buffer.bind(vbos[attribIndex]);
+	const uint8_t *vb = static_cast<const uint8_t *>(PGUPV::gl_copy_read_buffer.map(GL_READ_ONLY));
 	assert(vb != nullptr);
+	vb += offset + format.offset;
 
 	std::vector<V> dst;
-	for (size_t i = 0; i < count; i++) {
+	dst.reserve(n_vertices);
+	for (size_t i = 0; i < n_vertices; i++) {
 		V v;
 		for (typename V::length_type c = 0; c < V::length(); c++) {
-			if (c < n_components) {
-				v[c] = vb[c];
+			if (c < format.size) {
+				v[c] = decodeComponent(vb, format.type, c);
 			}
 			else {
-				v[c] = 0.0f;
+				// Como en OpenGL, las componentes que no están en el buffer valen (0, 0, 0, 1)
+				v[c] = c == 3 ? 1.0f : 0.0f;
 			}
 		}
 		dst.push_back(v);
-		vb += n_components;
+		vb += stride;
 	}
 	PGUPV::gl_copy_read_buffer.unmap();
 	PGUPV::gl_copy_read_buffer.bind(prev);
@@ -692,18 +761,28 @@ std::vector<V> copyFromPFloatToVectorVec(std::shared_ptr<BufferObject> vbo, size
 
 
 std::vector<glm::vec3> Mesh::getVertices() const {
-	auto dst = copyFromPFloatToVectorVec<glm::vec3>(vbos[VERTICES], n_vertices, n_components_per_vertex);
-	return dst;
+	return readAttribute<glm::vec3>(VERTICES, n_components_per_vertex);
 }
 
 std::vector<glm::vec3> Mesh::getNormals() const {
 	if (!vbos[NORMALS]) return std::vector<glm::vec3>();
-	return copyFromPFloatToVectorVec<glm::vec3>(vbos[NORMALS], n_vertices);
+	return readAttribute<glm::vec3>(NORMALS, 3);
 }
 
 std::vector<glm::vec2> Mesh::getTexCoords(unsigned int texCoordSet) const {
 	if (!vbos[TEX_COORD0 + texCoordSet]) return std::vector<glm::vec2>();
-	return copyFromPFloatToVectorVec<glm::vec2>(vbos[TEX_COORD0 + texCoordSet], n_vertices, 2);
+	return readAttribute<glm::vec2>(TEX_COORD0 + texCoordSet, 2);
+}
+
+std::vector<glm::vec4> Mesh::getColors() const {
+	if (!vbos[COLORS]) return std::vector<glm::vec4>();
+	// readAttribute completa el alfa que no está en el buffer (intercalado o no) con 1
+	return readAttribute<glm::vec4>(COLORS, n_components_per_color);
+}
+
+std::vector<glm::vec3> Mesh::getTangents() const {
+	if (!vbos[TANGENTS]) return std::vector<glm::vec3>();
+	return readAttribute<glm::vec3>(TANGENTS, 3);
 }
 
 template <typename T>
@@ -0,0 +1,258 @@
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <glm/gtc/packing.hpp>
+#include <gsl/gsl>
+
+#include "meshBuilder.h"
+#include "bufferObject.h"
+#include "bindingPoint.h"
+#include "skeleton.h"
+#include "uboBones.h"
+#include "log.h"
+
+using PGUPV::MeshBuilder;
+using PGUPV::Mesh;
+using PGUPV::BufferObject;
+using PGUPV::Skeleton;
+using PGUPV::UBOBones;
+
+MeshBuilder::MeshBuilder(unsigned int packing) : packing(packing), nVertices(0), nComponentsPerVertex(0),
+	maxIndex(0), maxBoneId(0) {
+}
+
+void MeshBuilder::checkSize(size_t n, const char *what) {
+	if (n != nVertices)
+		throw std::runtime_error(std::string("El número de ") + what + " (" + std::to_string(n) +
+			") no coincide con el de vértices (" + std::to_string(nVertices) + "). Llama antes a setVertices");
+}
+
+void MeshBuilder::setVertices(const float *v, uint ncomponents, size_t n) {
+	if (ncomponents < 2 || ncomponents > 4)
+		throw std::runtime_error("Los vértices deben tener 2, 3 o 4 componentes");
+	nVertices = n;
+	nComponentsPerVertex = ncomponents;
+	vertices.assign(v, v + ncomponents * n);
+}
+
+void MeshBuilder::setNormals(const glm::vec3 *n, size_t count) {
+	checkSize(count, "normales");
+	normals.assign(n, n + count);
+}
+
+void MeshBuilder::setTangents(const glm::vec3 *t, size_t count) {
+	checkSize(count, "tangentes");
+	tangents.assign(t, t + count);
+}
+
+void MeshBuilder::setColors(const glm::vec4 *c, size_t count) {
+	checkSize(count, "colores");
+	colors.assign(c, c + count);
+}
+
+void MeshBuilder::setTexCoords(uint texUnit, const glm::vec2 *t, size_t count) {
+	if (texUnit >= NUM_TEX_COORD)
+		throw std::runtime_error("Sólo se admiten " + std::to_string(NUM_TEX_COORD) + " juegos de coordenadas de textura");
+	checkSize(count, "coordenadas de textura");
+	texCoords[texUnit].assign(t, t + count);
+}
+
+uint32_t MeshBuilder::setSkeleton(std::shared_ptr<Skeleton> skel) {
+	const uint32_t ignored = skel->buildArraysOfVerticesAndWeights(gsl::narrow<uint32_t>(nVertices), boneIds, boneWeights);
+	maxBoneId = skel->getNBones() > 0 ? skel->getNBones() - 1 : 0;
+	skeleton = skel;
+	return ignored;
+}
+
+void MeshBuilder::setIndices(const GLuint *i, size_t n) {
+	indices.assign(i, i + n);
+	maxIndex = indices.empty() ? 0 : *std::max_element(indices.begin(), indices.end());
+}
+
+GLenum MeshBuilder::getIndicesType() const {
+	// Los índices de un byte no se recomiendan: muchas tarjetas los convierten en el driver
+	return maxIndex <= 0xFFFF ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+}
+
+std::vector<Mesh::VertexAttribFormat> MeshBuilder::getLayout(GLsizei &stride) const {
+	std::vector<Mesh::VertexAttribFormat> layout;
+	GLuint offset = 0;
+	auto add = [&layout, &offset](uint index, GLint size, GLenum type, bool normalized, bool integer, GLuint bytes) {
+		layout.push_back(Mesh::VertexAttribFormat{ index, size, type, normalized, integer, offset });
+		// Todos los atributos empiezan en un múltiplo de 4 bytes
+		offset += (bytes + 3) & ~3U;
+	};
+	const bool packNormals = (packing & PACK_NORMALS) != 0;
+
+	add(Mesh::VERTICES, nComponentsPerVertex, GL_FLOAT, false, false, sizeof(float) * nComponentsPerVertex);
+	if (!normals.empty()) {
+		if (packNormals)
+			add(Mesh::NORMALS, 4, GL_INT_2_10_10_10_REV, true, false, 4);
+		else
+			add(Mesh::NORMALS, 3, GL_FLOAT, false, false, sizeof(glm::vec3));
+	}
+	if (!colors.empty())
+		add(Mesh::COLORS, 4, GL_FLOAT, false, false, sizeof(glm::vec4));
+	for (uint i = 0; i < NUM_TEX_COORD; i++) {
+		if (texCoords[i].empty())
+			continue;
+		if (packing & PACK_TEX_COORDS)
+			add(Mesh::TEX_COORD0 + i, 2, GL_HALF_FLOAT, false, false, 2 * sizeof(uint16_t));
+		else
+			add(Mesh::TEX_COORD0 + i, 2, GL_FLOAT, false, false, sizeof(glm::vec2));
+	}
+	if (!tangents.empty()) {
+		if (packNormals)
+			add(Mesh::TANGENTS, 4, GL_INT_2_10_10_10_REV, true, false, 4);
+		else
+			add(Mesh::TANGENTS, 3, GL_FLOAT, false, false, sizeof(glm::vec3));
+	}
+	if (!boneIds.empty()) {
+		if (!(packing & PACK_BONE_IDS))
+			add(Mesh::BONE_IDS, 4, GL_UNSIGNED_INT, false, true, sizeof(glm::uvec4));
+		else if (maxBoneId <= 0xFF)
+			add(Mesh::BONE_IDS, 4, GL_UNSIGNED_BYTE, false, true, 4 * sizeof(uint8_t));
+		else
+			add(Mesh::BONE_IDS, 4, GL_UNSIGNED_SHORT, false, true, 4 * sizeof(uint16_t));
+		add(Mesh::BONE_WEIGHTS, 4, GL_FLOAT, false, false, sizeof(glm::vec4));
+	}
+	stride = static_cast<GLsizei>(offset);
+	return layout;
+}
+
+GLsizei MeshBuilder::getVertexSize() const {
+	GLsizei stride;
+	getLayout(stride);
+	return stride;
+}
+
+void MeshBuilder::fill(uint8_t *dst, const std::vector<Mesh::VertexAttribFormat> &layout, GLsizei stride) const {
+	// Se escribe atributo a atributo, para recorrer los arrays de origen secuencialmente
+	for (auto &f : layout) {
+		uint8_t *p = dst + f.offset;
+		for (size_t i = 0; i < nVertices; i++, p += stride) {
+			switch (f.index) {
+			case Mesh::VERTICES:
+				memcpy(p, &vertices[i * nComponentsPerVertex], sizeof(float) * nComponentsPerVertex);
+				break;
+			case Mesh::NORMALS:
+			case Mesh::TANGENTS:
+			{
+				const glm::vec3 &n = f.index == Mesh::NORMALS ? normals[i] : tangents[i];
+				if (f.type == GL_INT_2_10_10_10_REV) {
+					uint32_t packed = glm::packSnorm3x10_1x2(glm::vec4(n, 0.0f));
+					memcpy(p, &packed, sizeof(packed));
+				}
+				else
+					memcpy(p, &n, sizeof(n));
+			}
+			break;
+			case Mesh::COLORS:
+				memcpy(p, &colors[i], sizeof(glm::vec4));
+				break;
+			case Mesh::BONE_IDS:
+				if (f.type == GL_UNSIGNED_BYTE) {
+					uint8_t ids[4];
+					for (int c = 0; c < 4; c++)
+						ids[c] = static_cast<uint8_t>(boneIds[i][c]);
+					memcpy(p, ids, sizeof(ids));
+				}
+				else if (f.type == GL_UNSIGNED_SHORT) {
+					uint16_t ids[4];
+					for (int c = 0; c < 4; c++)
+						ids[c] = static_cast<uint16_t>(boneIds[i][c]);
+					memcpy(p, ids, sizeof(ids));
+				}
+				else
+					memcpy(p, &boneIds[i], sizeof(glm::uvec4));
+				break;
+			case Mesh::BONE_WEIGHTS:
+				memcpy(p, &boneWeights[i], sizeof(glm::vec4));
+				break;
+			default:
+			{
+				// Coordenadas de textura
+				const glm::vec2 &t = texCoords[f.index - Mesh::TEX_COORD0][i];
+				if (f.type == GL_HALF_FLOAT) {
+					uint32_t packed = glm::packHalf2x16(t);
+					memcpy(p, &packed, sizeof(packed));
+				}
+				else
+					memcpy(p, &t, sizeof(t));
+			}
+			}
+		}
+	}
+}
+
+void MeshBuilder::buildMesh(Mesh &mesh, std::shared_ptr<BufferObject> bo, GLintptr offset, GLenum usage) const {
+	GLsizei stride;
+	auto layout = getLayout(stride);
+
+	mesh.n_vertices = nVertices;
+	mesh.n_components_per_vertex = nComponentsPerVertex;
+	mesh.setInterleavedAttributes(bo, offset, stride, layout);
+	mesh.bb = computeBoundingBox(vertices.data(), nComponentsPerVertex, nVertices);
+	mesh.bs = computeBoundingSphere(vertices.data(), nComponentsPerVertex, nVertices);
+
+	if (!indices.empty()) {
+		if (getIndicesType() == GL_UNSIGNED_SHORT) {
+			std::vector<GLushort> shortIndices(indices.begin(), indices.end());
+			mesh.addIndices(shortIndices, usage);
+		}
+		else
+			mesh.addIndices(indices, usage);
+	}
+
+	if (skeleton) {
+		mesh.setBones(UBOBones::build(std::vector<glm::mat4>(skeleton->getNBones(), glm::mat4(1.0f))));
+		mesh.skeleton = skeleton;
+	}
+}
+
+std::shared_ptr<Mesh> MeshBuilder::build(GLenum usage) const {
+	return buildShared({ this }, usage)[0];
+}
+
+std::vector<std::shared_ptr<Mesh>> MeshBuilder::build(const std::vector<MeshBuilder> &builders, GLenum usage) {
+	std::vector<const MeshBuilder *> ptrs;
+	for (auto &b : builders)
+		ptrs.push_back(&b);
+	return buildShared(ptrs, usage);
+}
+
+std::vector<std::shared_ptr<Mesh>> MeshBuilder::buildShared(const std::vector<const MeshBuilder *> &builders, GLenum usage) {
+	std::vector<std::shared_ptr<Mesh>> result;
+	if (builders.empty())
+		return result;
+
+	// Posición de cada malla en el buffer compartido
+	std::vector<GLintptr> offsets;
+	size_t total = 0;
+	for (auto b : builders) {
+		if (b->nVertices == 0)
+			ERRT("No se han definido los vértices de la malla");
+		offsets.push_back(total);
+		total += b->getVertexSize() * b->nVertices;
+	}
+
+	auto bo = BufferObject::build(total, usage);
+	bo->setGlDebugLabel("Vértices intercalados");
+	// Escribimos directamente en el buffer, sin pasar por una copia intermedia
+	auto prev = gl_array_buffer.bind(bo);
+	auto dst = static_cast<uint8_t *>(gl_array_buffer.map(GL_WRITE_ONLY));
+	for (size_t i = 0; i < builders.size(); i++) {
+		GLsizei stride;
+		auto layout = builders[i]->getLayout(stride);
+		builders[i]->fill(dst + offsets[i], layout, stride);
+	}
+	gl_array_buffer.unmap();
+	gl_array_buffer.bind(prev);
+
+	for (size_t i = 0; i < builders.size(); i++) {
+		auto mesh = std::make_shared<Mesh>();
+		builders[i]->buildMesh(*mesh, bo, offsets[i], usage);
+		result.push_back(mesh);
+	}
+	return result;
+}
@@ -6,6 +6,7 @@
 #include <program.h>
 #include <model.h>
 #include <camera.h>
+#include <profiler.h>
 
 #include <glm/gtc/matrix_transform.hpp>
 
@@ -40,6 +41,7 @@ Picker::~Picker()
 
 uint32_t Picker::pick(const PickData& pick, const glm::mat4& viewMatrix, const glm::mat4& projMatrix, const std::vector<ModelId>& objects)
 {
+	PGUPV_PROFILE_ZONE("Picker::pick");
 	return pimpl->pick(pick, viewMatrix, projMatrix, objects);
 }
 
@@ -112,10 +114,6 @@ uint32_t Picker::PickerImpl::pick(const Picker::PickData &pick, const glm::mat4&
 		selectionWindowSide * selectionWindowSide * sizeof(GLuint),
 		&ids[0]);
 
-	for (int i = 0; i < selectionWindowSide * selectionWindowSide; i++) {
-		INFO(std::to_string(ids[i]));
-	}
-
 	return ids[selectionWindowSemiWidth * selectionWindowSide + selectionWindowSemiWidth];
 }
 
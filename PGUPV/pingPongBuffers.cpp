@@ -4,31 +4,45 @@
 
 using PGUPV::PingPongBuffers;
 
-PingPongBuffers::PingPongBuffers(unsigned int width, unsigned int height, unsigned int bpp, Policy policy)
-: policy(policy) {
-    for (unsigned int i = 0; i < NUM_BUFFERS; i++) {
-        buffers[i].resize(width * height * bpp / 8);
-        ids[i] = 0;
+PingPongBuffers::PingPongBuffers(unsigned int width, unsigned int height, unsigned int bpp, Policy policy,
+    unsigned int numBuffers)
+: policy(policy), storage(numBuffers < 2 ? 2 : numBuffers), ids(storage.size(), 0),
+    timestamps(storage.size(), 0) {
+    for (auto &b : storage) {
+        b.resize(width * height * bpp / 8);
+        buffers.push_back(&b[0]);
     }
 }
 
-unsigned char *PingPongBuffers::lockForRead() {
-    std::lock_guard<std::mutex> lock{m};
-    int maxIdx = findMaxId();
-    if (ids[maxIdx] == 0)
-        return nullptr;
-    if (ids[maxIdx] == LONG_MAX)
-        ERRT("Ya estaba bloqueado para lectura");
+PingPongBuffers::PingPongBuffers(const std::vector<unsigned char *> &memory, Policy policy)
+: policy(policy), buffers(memory), ids(buffers.size(), 0), timestamps(buffers.size(), 0) {
+    if (buffers.size() < 2)
+        ERRT("Se necesitan al menos dos buffers");
+}
 
-    if (policy != Policy::OnlyNewest) {
-        int minNonZero = maxIdx;
-        for (int i = (maxIdx + 1) % NUM_BUFFERS; i != maxIdx; i = ( i + 1) % NUM_BUFFERS)
-            if (ids[i] > 0 && ids[i] < LONG_MAX && ids[i] < ids[minNonZero])
-                minNonZero = i;
-        maxIdx = minNonZero;
+// Devuelve el índice del buffer que se leería, o -1 si no hay ninguno listo
+int PingPongBuffers::findNextToRead() {
+    int idx = -1;
+    for (int i = 0; i < static_cast<int>(ids.size()); i++) {
+        if (ids[i] <= 0 || ids[i] == LONG_MAX)
+            continue;
+        if (idx < 0 || (policy == Policy::OnlyNewest ? ids[i] > ids[idx] : ids[i] < ids[idx]))
+            idx = i;
     }
-    ids[maxIdx] = LONG_MAX;
-    return &buffers[maxIdx][0];
+    return idx;
+}
+
+unsigned char *PingPongBuffers::lockForRead(int64_t *timestamp) {
+    std::lock_guard<std::mutex> lock{m};
+    if (ids[findMaxId()] == LONG_MAX)
+        ERRT("Ya estaba bloqueado para lectura");
+    int idx = findNextToRead();
+    if (idx < 0)
+        return nullptr;
+    ids[idx] = LONG_MAX;
+    if (timestamp)
+        *timestamp = timestamps[idx];
+    return buffers[idx];
 }
 
 void PingPongBuffers::unlockForRead() {
@@ -39,6 +53,22 @@ void PingPongBuffers::unlockForRead() {
     ids[maxIdx] = 0;
 }
 
+bool PingPongBuffers::peek(int64_t &timestamp) {
+    std::lock_guard<std::mutex> lock{m};
+    int idx = findNextToRead();
+    if (idx < 0)
+        return false;
+    timestamp = timestamps[idx];
+    return true;
+}
+
+void PingPongBuffers::clear() {
+    std::lock_guard<std::mutex> lock{m};
+    for (auto &id : ids)
+        if (id > 0 && id < LONG_MAX)
+            id = 0;
+}
+
 unsigned char * PingPongBuffers::lockForWrite() {
     std::lock_guard<std::mutex> lock{m};
     int minIdx = findMinId();
@@ -46,21 +76,23 @@ unsigned char * PingPongBuffers::lockForWrite() {
         ERRT("Ya estaba bloqueado para escritura");
     if (ids[minIdx] == 0 || policy != Policy::NoDiscard ) {
         ids[minIdx] = LONG_MIN;
-        return &buffers[minIdx][0];
+        return buffers[minIdx];
         
     }
     return nullptr;
 }
 
-void PingPongBuffers::unlockForWrite() {
+void PingPongBuffers::unlockForWrite(int64_t timestamp) {
     std::lock_guard<std::mutex> lock{m};
+    const int n = static_cast<int>(ids.size());
     int minIdx = findMinId();
     if (ids[minIdx] != LONG_MIN)
         ERRT("No se ha bloqueado antes para escritura");
     ids[minIdx] = nextId++;
+    timestamps[minIdx] = timestamp;
     if (policy == Policy::OnlyNewest) {
         // Discard others
-        for (int i = (minIdx + 1) % NUM_BUFFERS; i != minIdx; i = (i + 1) % NUM_BUFFERS)
+        for (int i = (minIdx + 1) % n; i != minIdx; i = (i + 1) % n)
             if (ids[i] > 0 && ids[i] < LONG_MAX)
                 ids[i] = 0;
     }
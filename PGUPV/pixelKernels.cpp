@@ -0,0 +1,228 @@
+#include <algorithm>
+#include <cstdlib>
+
+#include "pixelKernels.h"
+#include "threadPool.h"
+
+#if defined(__AVX2__)
+#define PGUPV_PIXELS_AVX2
+#define PGUPV_PIXELS_SSSE3
+#include <immintrin.h>
+#elif defined(__SSSE3__)
+#define PGUPV_PIXELS_SSSE3
+#include <tmmintrin.h>
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PGUPV_PIXELS_SSE2
+#include <emmintrin.h>
+#endif
+
+// Bytes mínimos de cada bloque de parallelRows, para que compense repartir el trabajo
+static const size_t MIN_BYTES_PER_BLOCK = 256 * 1024;
+
+#ifdef PGUPV_PIXELS_SSE2
+// Máximo de los enteros sin signo de 16 bits (SSE2 sólo tiene _mm_max_epi16, con signo)
+static inline __m128i maxU16(__m128i a, __m128i b) {
+	return _mm_add_epi16(_mm_subs_epu16(a, b), b);
+}
+
+// Diferencia (premultiplicada) de los canales de color de 2 píxeles RGBA en 16 bits
+static inline __m128i premultipliedDiff(__m128i a, __m128i b, __m128i colorMask) {
+	const __m128i alphaA = _mm_shufflehi_epi16(_mm_shufflelo_epi16(a, 0xFF), 0xFF);
+	const __m128i alphaB = _mm_shufflehi_epi16(_mm_shufflelo_epi16(b, 0xFF), 0xFF);
+	// Los productos caben en 16 bits (255 * 255)
+	const __m128i pa = _mm_mullo_epi16(a, alphaA), pb = _mm_mullo_epi16(b, alphaB);
+	return _mm_and_si128(_mm_or_si128(_mm_subs_epu16(pa, pb), _mm_subs_epu16(pb, pa)), colorMask);
+}
+#endif
+
+#ifdef PGUPV_PIXELS_AVX2
+static inline __m256i premultipliedDiff(__m256i a, __m256i b, __m256i colorMask) {
+	const __m256i alphaA = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(a, 0xFF), 0xFF);
+	const __m256i alphaB = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(b, 0xFF), 0xFF);
+	const __m256i pa = _mm256_mullo_epi16(a, alphaA), pb = _mm256_mullo_epi16(b, alphaB);
+	return _mm256_and_si256(_mm256_or_si256(_mm256_subs_epu16(pa, pb), _mm256_subs_epu16(pb, pa)), colorMask);
+}
+#endif
+
+void PGUPV::PixelKernels::swapRB(uint8_t *row, size_t width, uint bytesPerPixel) {
+	size_t x = 0;
+	if (bytesPerPixel == 4) {
+#if defined(PGUPV_PIXELS_AVX2)
+		const __m256i ga = _mm256_set1_epi32(static_cast<int>(0xFF00FF00)), low = _mm256_set1_epi32(0xFF);
+		for (; x + 8 <= width; x += 8) {
+			__m256i *p = reinterpret_cast<__m256i *>(row + 4 * x);
+			const __m256i v = _mm256_loadu_si256(p);
+			const __m256i r = _mm256_slli_epi32(_mm256_and_si256(v, low), 16);
+			const __m256i b = _mm256_and_si256(_mm256_srli_epi32(v, 16), low);
+			_mm256_storeu_si256(p, _mm256_or_si256(_mm256_and_si256(v, ga), _mm256_or_si256(r, b)));
+		}
+#elif defined(PGUPV_PIXELS_SSE2)
+		const __m128i ga = _mm_set1_epi32(static_cast<int>(0xFF00FF00)), low = _mm_set1_epi32(0xFF);
+		for (; x + 4 <= width; x += 4) {
+			__m128i *p = reinterpret_cast<__m128i *>(row + 4 * x);
+			const __m128i v = _mm_loadu_si128(p);
+			const __m128i r = _mm_slli_epi32(_mm_and_si128(v, low), 16);
+			const __m128i b = _mm_and_si128(_mm_srli_epi32(v, 16), low);
+			_mm_storeu_si128(p, _mm_or_si128(_mm_and_si128(v, ga), _mm_or_si128(r, b)));
+		}
+#endif
+	}
+	else {
+#ifdef PGUPV_PIXELS_SSSE3
+		// 5 píxeles por cada 16 bytes. El último byte no se toca: es del píxel siguiente
+		const __m128i shuffle = _mm_setr_epi8(2, 1, 0, 5, 4, 3, 8, 7, 6, 11, 10, 9, 14, 13, 12, 15);
+		for (; 3 * x + 16 <= 3 * width; x += 5) {
+			__m128i *p = reinterpret_cast<__m128i *>(row + 3 * x);
+			_mm_storeu_si128(p, _mm_shuffle_epi8(_mm_loadu_si128(p), shuffle));
+		}
+#endif
+	}
+	for (uint8_t *p = row + bytesPerPixel * x; x < width; x++, p += bytesPerPixel)
+		std::swap(p[0], p[2]);
+}
+
+void PGUPV::PixelKernels::swapBytes(uint8_t *a, uint8_t *b, size_t n) {
+	size_t i = 0;
+#if defined(PGUPV_PIXELS_AVX2)
+	for (; i + 32 <= n; i += 32) {
+		const __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a + i));
+		const __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b + i));
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(a + i), vb);
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(b + i), va);
+	}
+#elif defined(PGUPV_PIXELS_SSE2)
+	for (; i + 16 <= n; i += 16) {
+		const __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i));
+		const __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i));
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(a + i), vb);
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(b + i), va);
+	}
+#endif
+	std::swap_ranges(a + i, a + n, b + i);
+}
+
+void PGUPV::PixelKernels::absDiff(const uint8_t *a, const uint8_t *b, uint8_t *out, size_t n) {
+	size_t i = 0;
+#if defined(PGUPV_PIXELS_AVX2)
+	for (; i + 32 <= n; i += 32) {
+		const __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a + i));
+		const __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b + i));
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i),
+			_mm256_or_si256(_mm256_subs_epu8(va, vb), _mm256_subs_epu8(vb, va)));
+	}
+#elif defined(PGUPV_PIXELS_SSE2)
+	for (; i + 16 <= n; i += 16) {
+		const __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i));
+		const __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i));
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(out + i),
+			_mm_or_si128(_mm_subs_epu8(va, vb), _mm_subs_epu8(vb, va)));
+	}
+#endif
+	for (; i < n; i++)
+		out[i] = static_cast<uint8_t>(std::abs(a[i] - b[i]));
+}
+
+uint PGUPV::PixelKernels::maxAbsDiff(const uint8_t *a, const uint8_t *b, size_t n) {
+	size_t i = 0;
+	int result = 0;
+#if defined(PGUPV_PIXELS_AVX2)
+	__m256i acc = _mm256_setzero_si256();
+	for (; i + 32 <= n; i += 32) {
+		const __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a + i));
+		const __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b + i));
+		acc = _mm256_max_epu8(acc, _mm256_or_si256(_mm256_subs_epu8(va, vb), _mm256_subs_epu8(vb, va)));
+	}
+	alignas(32) uint8_t lanes[32];
+	_mm256_store_si256(reinterpret_cast<__m256i *>(lanes), acc);
+	result = *std::max_element(lanes, lanes + 32);
+#elif defined(PGUPV_PIXELS_SSE2)
+	__m128i acc = _mm_setzero_si128();
+	for (; i + 16 <= n; i += 16) {
+		const __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i));
+		const __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i));
+		acc = _mm_max_epu8(acc, _mm_or_si128(_mm_subs_epu8(va, vb), _mm_subs_epu8(vb, va)));
+	}
+	alignas(16) uint8_t lanes[16];
+	_mm_store_si128(reinterpret_cast<__m128i *>(lanes), acc);
+	result = *std::max_element(lanes, lanes + 16);
+#endif
+	for (; i < n; i++)
+		result = std::max(result, std::abs(a[i] - b[i]));
+	return static_cast<uint>(result);
+}
+
+uint PGUPV::PixelKernels::maxPremultipliedDiffRGBA(const uint8_t *a, const uint8_t *b, size_t width) {
+	size_t x = 0;
+	// Máximo de |a.c * a.alfa - b.c * b.alfa|. La división por 255 se hace al final
+	uint result = 0;
+#if defined(PGUPV_PIXELS_AVX2)
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i colorMask = _mm256_set1_epi64x(0x0000FFFFFFFFFFFFLL);
+	__m256i acc = zero;
+	for (; x + 8 <= width; x += 8) {
+		const __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a + 4 * x));
+		const __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b + 4 * x));
+		acc = _mm256_max_epu16(acc, premultipliedDiff(_mm256_unpacklo_epi8(va, zero), _mm256_unpacklo_epi8(vb, zero), colorMask));
+		acc = _mm256_max_epu16(acc, premultipliedDiff(_mm256_unpackhi_epi8(va, zero), _mm256_unpackhi_epi8(vb, zero), colorMask));
+	}
+	alignas(32) uint16_t lanes[16];
+	_mm256_store_si256(reinterpret_cast<__m256i *>(lanes), acc);
+	result = *std::max_element(lanes, lanes + 16);
+#elif defined(PGUPV_PIXELS_SSE2)
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i colorMask = _mm_set_epi32(0x0000FFFF, static_cast<int>(0xFFFFFFFF), 0x0000FFFF, static_cast<int>(0xFFFFFFFF));
+	__m128i acc = zero;
+	for (; x + 4 <= width; x += 4) {
+		const __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + 4 * x));
+		const __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + 4 * x));
+		acc = maxU16(acc, premultipliedDiff(_mm_unpacklo_epi8(va, zero), _mm_unpacklo_epi8(vb, zero), colorMask));
+		acc = maxU16(acc, premultipliedDiff(_mm_unpackhi_epi8(va, zero), _mm_unpackhi_epi8(vb, zero), colorMask));
+	}
+	alignas(16) uint16_t lanes[8];
+	_mm_store_si128(reinterpret_cast<__m128i *>(lanes), acc);
+	result = *std::max_element(lanes, lanes + 8);
+#endif
+	for (; x < width; x++) {
+		const uint8_t *pa = a + 4 * x, *pb = b + 4 * x;
+		for (uint c = 0; c < 3; c++)
+			result = std::max(result, static_cast<uint>(std::abs(pa[c] * pa[3] - pb[c] * pb[3])));
+	}
+	return result / 255;
+}
+
+void PGUPV::PixelKernels::rgbToRGBA(const uint8_t *src, uint8_t *dst, size_t width, uint8_t alpha) {
+	size_t x = 0;
+#ifdef PGUPV_PIXELS_SSSE3
+	// Cada carga de 16 bytes tiene 4 píxeles completos (y 4 bytes que no se usan)
+	const __m128i shuffle = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+	const __m128i alphaMask = _mm_set1_epi32(static_cast<int>(static_cast<uint32_t>(alpha) << 24));
+	for (; x + 6 <= width; x += 4) {
+		const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 3 * x));
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + 4 * x), _mm_or_si128(_mm_shuffle_epi8(v, shuffle), alphaMask));
+	}
+#endif
+	for (; x < width; x++) {
+		dst[4 * x] = src[3 * x];
+		dst[4 * x + 1] = src[3 * x + 1];
+		dst[4 * x + 2] = src[3 * x + 2];
+		dst[4 * x + 3] = alpha;
+	}
+}
+
+void PGUPV::PixelKernels::parallelRows(uint rows, size_t bytesPerRow, const std::function<void(uint, uint)> &op) {
+	if (rows == 0)
+		return;
+	auto &pool = ThreadPool::getInstance();
+	const size_t minRows = std::max<size_t>(1, MIN_BYTES_PER_BLOCK / std::max<size_t>(1, bytesPerRow));
+	// Unos pocos bloques por hilo, para repartir mejor la carga
+	const size_t maxBlocks = 4 * (pool.getNumThreads() + 1);
+	const size_t blocks = std::min(maxBlocks, std::max<size_t>(1, rows / minRows));
+	if (blocks == 1) {
+		op(0, rows);
+		return;
+	}
+	pool.parallelFor(blocks, [rows, blocks, &op](size_t i) {
+		op(static_cast<uint>(rows * i / blocks), static_cast<uint>(rows * (i + 1) / blocks));
+	});
+}
@@ -0,0 +1,197 @@
+#include <chrono>
+#include <fstream>
+
+#include "profiler.h"
+#include "json.hpp"
+
+using PGUPV::Profiler;
+
+using json = nlohmann::json;
+
+Profiler &Profiler::getInstance() {
+	static Profiler profiler;
+	return profiler;
+}
+
+Profiler::Profiler() : enabled(false), capturing(false), inFrame(false), epoch(0), frameNumber(0),
+frames(DEFAULT_FRAMES_IN_FLIGHT), current(0) {
+	epoch = now();
+	lastFrame.number = 0;
+	lastFrame.start = lastFrame.cpuDuration = 0;
+	lastFrame.gpuDuration = -1;
+	for (auto &pf : frames) {
+		pf.usedTimestamps = 0;
+		pf.gpuReference = 0;
+		pf.pending = false;
+	}
+}
+
+int64_t Profiler::now() const {
+	return std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count() - epoch;
+}
+
+void Profiler::setEnabled(bool enable) {
+	enabled = enable;
+	if (!enabled)
+		stopCapture();
+}
+
+void Profiler::beginFrame() {
+	frameNumber++;
+	if (!enabled)
+		return;
+	mainThread = std::this_thread::get_id();
+	current = static_cast<unsigned int>(frameNumber % frames.size());
+	auto &pf = frames[current];
+	if (pf.pending)
+		poll();
+	if (pf.pending) {
+		// La GPU va más de frames.size() fotogramas por detrás: no se espera, y el fotograma
+		// que ocupaba la posición se queda sin los tiempos de la GPU
+		complete(pf, false);
+	}
+	pf.frame.number = frameNumber;
+	pf.frame.start = now();
+	pf.frame.zones.clear();
+	pf.zoneQueries.clear();
+	pf.usedTimestamps = 0;
+	glGetInteger64v(GL_TIMESTAMP, &pf.gpuReference);
+	openZones.clear();
+	inFrame = true;
+	// El fotograma completo es la zona raíz
+	beginZone("Frame");
+}
+
+void Profiler::endFrame() {
+	if (!inFrame)
+		return;
+	// Cierra las zonas que se hayan quedado abiertas, incluida la raíz
+	while (!openZones.empty())
+		endZone();
+	inFrame = false;
+	auto &pf = frames[current];
+	pf.frame.cpuDuration = pf.frame.zones.front().cpuEnd;
+	pf.pending = true;
+	poll();
+}
+
+bool Profiler::beginZone(const std::string &name, bool gpu) {
+	if (!enabled || !inFrame || std::this_thread::get_id() != mainThread)
+		return false;
+	auto &pf = frames[current];
+	Zone zone;
+	zone.name = name;
+	zone.depth = static_cast<unsigned int>(openZones.size());
+	zone.cpuBegin = now() - pf.frame.start;
+	zone.cpuEnd = zone.cpuBegin;
+	zone.gpuBegin = zone.gpuEnd = -1;
+	int query = -1;
+	if (gpu) {
+		query = newTimestamp();
+		pf.timestamps[query].timestamp();
+	}
+	openZones.push_back(pf.frame.zones.size());
+	pf.frame.zones.push_back(zone);
+	pf.zoneQueries.emplace_back(query, -1);
+	return true;
+}
+
+void Profiler::endZone() {
+	if (openZones.empty() || std::this_thread::get_id() != mainThread)
+		return;
+	auto &pf = frames[current];
+	auto idx = openZones.back();
+	openZones.pop_back();
+	pf.frame.zones[idx].cpuEnd = now() - pf.frame.start;
+	if (pf.zoneQueries[idx].first >= 0) {
+		int query = newTimestamp();
+		pf.timestamps[query].timestamp();
+		pf.zoneQueries[idx].second = query;
+	}
+}
+
+int Profiler::newTimestamp() {
+	auto &pf = frames[current];
+	if (pf.usedTimestamps == pf.timestamps.size())
+		pf.timestamps.emplace_back(GL_TIMESTAMP);
+	return static_cast<int>(pf.usedTimestamps++);
+}
+
+void Profiler::poll() {
+	for (auto &pf : frames) {
+		if (!pf.pending)
+			continue;
+		// Las consultas terminan en orden, pero se comprueban todas por si acaso
+		bool available = true;
+		for (unsigned int i = 0; i < pf.usedTimestamps && available; i++) {
+			available = pf.timestamps[i].isResultAvailable();
+		}
+		if (available)
+			complete(pf, true);
+	}
+}
+
+void Profiler::complete(PendingFrame &pf, bool gpuAvailable) {
+	pf.pending = false;
+	if (gpuAvailable) {
+		// Tiempos de la GPU en microsegundos desde el principio del fotograma en la CPU
+		auto toMicroSec = [&pf](int query) -> int64_t {
+			return (static_cast<GLint64>(pf.timestamps[query].getValueU64()) - pf.gpuReference) / 1000;
+		};
+		for (size_t i = 0; i < pf.frame.zones.size(); i++) {
+			auto queries = pf.zoneQueries[i];
+			if (queries.first >= 0 && queries.second >= 0) {
+				pf.frame.zones[i].gpuBegin = toMicroSec(queries.first);
+				pf.frame.zones[i].gpuEnd = toMicroSec(queries.second);
+			}
+		}
+	}
+	auto &root = pf.frame.zones.front();
+	pf.frame.gpuDuration = root.gpuBegin >= 0 ? root.gpuEnd - root.gpuBegin : -1;
+
+	// Los fotogramas pueden completarse desordenados: sólo se muestra el más reciente
+	if (pf.frame.number > lastFrame.number)
+		lastFrame = pf.frame;
+	if (capturing) {
+		if (captured.size() < MAX_CAPTURED_FRAMES)
+			captured.push_back(pf.frame);
+		else
+			capturing = false;
+	}
+}
+
+void Profiler::startCapture() {
+	captured.clear();
+	enabled = capturing = true;
+}
+
+void Profiler::stopCapture() {
+	capturing = false;
+}
+
+bool Profiler::saveChromeTrace(const std::string &path) const {
+	const int CPU_TID = 1, GPU_TID = 2;
+	json events = json::array();
+	events.push_back({ { "name", "thread_name" }, { "ph", "M" }, { "pid", 1 }, { "tid", CPU_TID }, { "args", { { "name", "CPU" } } } });
+	events.push_back({ { "name", "thread_name" }, { "ph", "M" }, { "pid", 1 }, { "tid", GPU_TID }, { "args", { { "name", "GPU" } } } });
+	// Los eventos son completos ("ph": "X"), con principio y duración en microsegundos
+	for (auto &frame : captured) {
+		for (auto &zone : frame.zones) {
+			events.push_back({ { "name", zone.name }, { "cat", "cpu" }, { "ph", "X" }, { "pid", 1 }, { "tid", CPU_TID },
+				{ "ts", frame.start + zone.cpuBegin }, { "dur", zone.cpuEnd - zone.cpuBegin },
+				{ "args", { { "frame", frame.number } } } });
+			if (zone.gpuBegin >= 0)
+				events.push_back({ { "name", zone.name }, { "cat", "gpu" }, { "ph", "X" }, { "pid", 1 }, { "tid", GPU_TID },
+					{ "ts", frame.start + zone.gpuBegin }, { "dur", zone.gpuEnd - zone.gpuBegin },
+					{ "args", { { "frame", frame.number } } } });
+		}
+	}
+	json trace = { { "traceEvents", events }, { "displayTimeUnit", "ms" } };
+
+	std::ofstream f(path);
+	if (!f)
+		return false;
+	f << trace.dump();
+	return static_cast<bool>(f);
+}
@@ -0,0 +1,63 @@
+#include <guipg.h>
+#include <algorithm>
+#include <sstream>
+
+#include "profilerWidget.h"
+#include "profiler.h"
+#include "log.h"
+
+using PGUPV::ProfilerWidget;
+using PGUPV::Profiler;
+using PGUPV::GUILib;
+
+ProfilerWidget::ProfilerWidget() {
+	setLabel("Profiler");
+}
+
+void ProfilerWidget::renderWidget() {
+	auto &profiler = Profiler::getInstance();
+	bool enabled = profiler.isEnabled();
+	if (GUILib::Checkbox("Enable profiler", &enabled))
+		profiler.setEnabled(enabled);
+	if (!enabled)
+		return;
+
+	if (!profiler.isCapturing()) {
+		if (GUILib::Buttom("Start capture", glm::vec2(0.0f)))
+			profiler.startCapture();
+	}
+	else if (GUILib::Buttom("Save Chrome trace (" + std::to_string(profiler.getNumCapturedFrames()) + " frames)", glm::vec2(0.0f))) {
+		profiler.stopCapture();
+		const std::string path = "profile.json";
+		if (profiler.saveChromeTrace(path))
+			INFO("Chrome trace guardado en " + path + " (ábrelo con chrome://tracing o https://ui.perfetto.dev)");
+		else
+			ERR("No se ha podido escribir " + path);
+	}
+
+	auto &frame = profiler.getLastFrame();
+	if (frame.number == 0 || frame.zones.empty())
+		return;
+	std::ostringstream os;
+	os.precision(3);
+	os << std::fixed << "Frame " << frame.number << ": CPU " << frame.cpuDuration / 1000.0f << " ms";
+	if (frame.gpuDuration >= 0)
+		os << ", GPU " << frame.gpuDuration / 1000.0f << " ms";
+	GUILib::Text(os.str());
+
+	// Las dos gráficas usan la misma escala (el fotograma en la CPU o en la GPU, el más largo)
+	std::vector<GUILib::FlameGraphItem> cpu, gpu;
+	float span = frame.cpuDuration / 1000.0f;
+	int64_t gpuStart = frame.zones.front().gpuBegin;
+	for (auto &zone : frame.zones) {
+		cpu.push_back(GUILib::FlameGraphItem{ zone.name, zone.cpuBegin / 1000.0f, (zone.cpuEnd - zone.cpuBegin) / 1000.0f, zone.depth });
+		if (zone.gpuBegin >= 0 && gpuStart >= 0) {
+			gpu.push_back(GUILib::FlameGraphItem{ zone.name, (zone.gpuBegin - gpuStart) / 1000.0f, (zone.gpuEnd - zone.gpuBegin) / 1000.0f, zone.depth });
+			span = std::max(span, (zone.gpuEnd - gpuStart) / 1000.0f);
+		}
+	}
+	const float rowHeight = 18.0f;
+	GUILib::FlameGraph("CPU##" + label, cpu, span, rowHeight);
+	if (!gpu.empty())
+		GUILib::FlameGraph("GPU##" + label, gpu, span, rowHeight);
+}
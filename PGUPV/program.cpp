@@ -5,6 +5,7 @@
 
 #include <iomanip>
 #include <algorithm>
+#include <numeric>
 #include <gsl/gsl>
 
 #include <assert.h>
@@ -40,7 +41,7 @@ void declareVarTU(const std::string &base, uint texUnitBase, Program &m) {
 		m.replaceString(base + std::to_string(i), std::to_string(texUnitBase + i - 1));
 }
 
-Program::Program() : programId(0) {
+Program::Program() : activeSubroutineUniforms(), programId(0) {
 	App::getInstance().getShaderLibrary().add(this);
 
 	declareVarTU("$TEXDIFF", PGUPV::Material::DIFFUSE_TUNIT, *this);
@@ -60,6 +61,12 @@ void Program::release() {
 		glDeleteProgram(programId);
 		programId = 0;
 	}
+	uniforms.clear();
+	uniformsByName.clear();
+	uniformBlocks.clear();
+	uniformBlocksByName.clear();
+	for (auto &h : uniformHandles)
+		h.entry = -1;
 }
 
 int Program::loadFiles(const std::string &name) {
@@ -232,9 +239,25 @@ int Program::getUniformLocation(const std::string &uniform) {
 		ERRT("No se puede pedir la posición de un uniform si el shader no está "
 			"enlazado");
 
-	CHECK_GL();
-
-	GLint loc = glGetUniformLocation(programId, uniform.c_str());
+	int entry = findUniform(uniform);
+	if (entry < 0) {
+		// Un nombre que no aparece en la lista de uniforms activos: se pregunta una vez a
+		// OpenGL y se recuerda el resultado
+		ActiveUniform u;
+		u.name = uniform;
+		u.type = 0;
+		u.location = glGetUniformLocation(programId, uniform.c_str());
+		u.arraySize = 1;
+		u.blockIndex = -1;
+		u.offset = -1;
+		u.base = uniforms.size();
+		u.element = 0;
+		u.valueSize = 0;
+		entry = static_cast<int>(uniforms.size());
+		uniforms.push_back(u);
+		uniformsByName[uniform] = entry;
+	}
+	GLint loc = uniforms[entry].location;
 	if (loc == -1)
 		ERR("¡Cuidado! No se encuentra la variable uniform " + uniform +
 			". Asegúrate de que el programa donde"
@@ -289,7 +312,9 @@ bool Program::linkProgram(const PGUPV::Uints &shids,
 
 	glGetProgramiv(programId, GL_LINK_STATUS, &linked);
 
-	if (linked == GL_FALSE) {
+	if (linked == GL_TRUE)
+		introspect();
+	else {
 		GLint length;
 		GLchar *log;
 		glGetProgramiv(programId, GL_INFO_LOG_LENGTH, &length);
@@ -340,12 +365,16 @@ bool Program::bindBlockToBindingPoint(const std::string &blockName,
 	if (programId == 0)
 		ERRT("Antes de llamar a Program::bindBlockToBindingPoint debes compilar el programa");
 
-	GLuint idx = glGetUniformBlockIndex(programId, blockName.c_str());
-	if (idx == GL_INVALID_INDEX)
+	auto it = uniformBlocksByName.find(blockName);
+	if (it == uniformBlocksByName.end())
 		return false;
 
-	glUniformBlockBinding(programId, idx, bindingPoint);
-
+	// El punto de vinculación es parte del estado del programa: sólo hay que cambiarlo una vez
+	auto &block = uniformBlocks[it->second];
+	if (block.binding != static_cast<GLint>(bindingPoint)) {
+		glUniformBlockBinding(programId, it->second, bindingPoint);
+		block.binding = bindingPoint;
+	}
 	return true;
 }
 
@@ -404,12 +433,10 @@ uint Program::getUniformBlockSize(const std::string &blockName) {
 	if (programId == 0)
 		return 0;
 
-	GLuint idx = glGetUniformBlockIndex(programId, blockName.c_str());
-	if (idx == GL_INVALID_INDEX)
+	auto it = uniformBlocksByName.find(blockName);
+	if (it == uniformBlocksByName.end())
 		return 0;
-	GLint size;
-	glGetActiveUniformBlockiv(programId, idx, GL_UNIFORM_BLOCK_DATA_SIZE, &size);
-	return size;
+	return uniformBlocks[it->second].blockSize;
 }
 
 int Program::getUniformBlockMemberOffset(const std::string &blockName,
@@ -422,17 +449,10 @@ int Program::getUniformBlockMemberOffset(const std::string &member) {
 	if (programId == 0)
 		return -1;
 
-	CHECK_GL();
-	const char *pname = member.c_str();
-	GLuint idx;
-
-	glGetUniformIndices(programId, 1, &pname, &idx);
-	if (idx == GL_INVALID_INDEX)
+	int entry = findUniform(member);
+	if (entry < 0 || uniforms[entry].blockIndex < 0)
 		return -1;
-
-	GLint offset;
-	glGetActiveUniformsiv(programId, 1, &idx, GL_UNIFORM_OFFSET, &offset);
-	return offset;
+	return uniforms[entry].offset;
 }
 
 int Program::getActiveUniformName(uint idx, std::string &name) const {
@@ -797,8 +817,8 @@ void Program::printInfo(std::ostream &os) const {
 		os << "  Default Uniform Block members:" << std::endl;
 		for (const auto i : uniforms.defaultBlockUniforms) {
 			os << "       " << i.toString();
-			GLint loc;
-			loc = glGetUniformLocation(programId, i.name.c_str());
+			int entry = findUniform(i.name);
+			GLint loc = entry < 0 ? -1 : this->uniforms[entry].location;
 			if (loc == -1)
 				os << ": localización desconocida (es una variable predefinida?)";
 			else {
@@ -928,70 +948,161 @@ void Program::printInfo(std::ostream &os) const {
 #endif
 }
 
-void findOtherArrayMembers(const GLint programId, const std::string &name,
-	uint size, GLint type,
-	std::vector<UniformInfo> &dest) {
-	size_t posB = name.find_first_of("[");
-	std::string base(name, 0, posB);
-
-	for (uint i = 1; i < size; i++) {
-		std::ostringstream uniformName;
-		uniformName << base << "[" << std::to_string(i) << "]";
-		GLint loc = glGetUniformLocation(programId, uniformName.str().c_str());
-		if (loc < 0) {
-			ERR(base + " es de tipo array con " + std::to_string(size) +
-				" elementos, pero no encuentro " + uniformName.str());
+UniformInfoBlocks Program::getActiveUniforms() const {
+	UniformInfoBlocks ublocks;
+	ublocks.totalActiveUniforms = getProgramInfo(GL_ACTIVE_UNIFORMS);
+	ublocks.blocks = uniformBlocks;
+	for (auto &u : uniforms) {
+		// Los nombres que no son uniforms activos (ver getUniformLocation)
+		if (u.type == 0)
+			continue;
+		if (u.blockIndex == -1) {
+			// Los arrays aparecen elemento a elemento
+			ublocks.defaultBlockUniforms.push_back(UniformInfo(u.name, u.offset, 1, u.type));
+		}
+		else if (u.base == static_cast<size_t>(&u - &uniforms[0])) {
+			ublocks.blocks[u.blockIndex].uniforms.push_back(UniformInfo(u.name, u.offset, u.arraySize, u.type));
 		}
-		dest.push_back(UniformInfo(uniformName.str(), 0, 1, type));
 	}
+	// El punto de vinculación puede haberse cambiado fuera de la clase
+	for (uint i = 0; i < ublocks.blocks.size(); i++)
+		glGetActiveUniformBlockiv(programId, i, GL_UNIFORM_BLOCK_BINDING, &ublocks.blocks[i].binding);
+	return ublocks;
 }
 
-
-UniformInfoBlocks Program::getActiveUniforms() const {
-
-	uint nuniblocks = getProgramInfo(GL_ACTIVE_UNIFORM_BLOCKS);
-	UniformInfoBlocks ublocks;
-
-	ublocks.blocks.resize(nuniblocks);
-
-	ublocks.totalActiveUniforms = getProgramInfo(GL_ACTIVE_UNIFORMS);
-	for (uint i = 0; i < ublocks.totalActiveUniforms; i++) {
-		std::string un;
-		getActiveUniformName(i, un);
-		GLint offset, size, type, blockIdx;
-		glGetActiveUniformsiv(programId, 1, &i, GL_UNIFORM_OFFSET, &offset);
-		glGetActiveUniformsiv(programId, 1, &i, GL_UNIFORM_SIZE, &size);
-		glGetActiveUniformsiv(programId, 1, &i, GL_UNIFORM_TYPE, &type);
-		glGetActiveUniformsiv(programId, 1, &i, GL_UNIFORM_BLOCK_INDEX, &blockIdx);
-		if (blockIdx == -1) {
-			UniformInfo uniform(un, offset, size, type);
-			if (size > 1) {
-				uniform.size = 1;
-				ublocks.defaultBlockUniforms.push_back(uniform);
-				findOtherArrayMembers(programId, un, size, type,
-					ublocks.defaultBlockUniforms);
+void Program::introspect() {
+	uniforms.clear();
+	uniformsByName.clear();
+	uniformBlocks.clear();
+	uniformBlocksByName.clear();
+
+	const GLint n = getProgramInfo(GL_ACTIVE_UNIFORMS);
+	if (n > 0) {
+		// Todas las propiedades de todos los uniforms, con una llamada por propiedad
+		std::vector<GLuint> indices(n);
+		std::iota(indices.begin(), indices.end(), 0);
+		std::vector<GLint> types(n), sizes(n), blocks(n), offsets(n);
+		glGetActiveUniformsiv(programId, n, indices.data(), GL_UNIFORM_TYPE, types.data());
+		glGetActiveUniformsiv(programId, n, indices.data(), GL_UNIFORM_SIZE, sizes.data());
+		glGetActiveUniformsiv(programId, n, indices.data(), GL_UNIFORM_BLOCK_INDEX, blocks.data());
+		glGetActiveUniformsiv(programId, n, indices.data(), GL_UNIFORM_OFFSET, offsets.data());
+		std::vector<char> buffer(getProgramInfo(GL_ACTIVE_UNIFORM_MAX_LENGTH) + 1);
+
+		for (GLint i = 0; i < n; i++) {
+			glGetActiveUniformName(programId, i, static_cast<GLsizei>(buffer.size()), nullptr, buffer.data());
+			ActiveUniform u;
+			u.name = buffer.data();
+			u.type = types[i];
+			u.location = blocks[i] == -1 ? glGetUniformLocation(programId, u.name.c_str()) : -1;
+			u.arraySize = sizes[i];
+			u.blockIndex = blocks[i];
+			u.offset = offsets[i];
+			u.base = uniforms.size();
+			u.element = 0;
+			u.valueSize = 0;
+			uniformsByName[u.name] = u.base;
+			// Los arrays se llaman nombre[0]: también se pueden buscar como nombre
+			const bool isArray = u.name.size() > 3 && u.name.compare(u.name.size() - 3, 3, "[0]") == 0;
+			std::string arrayName;
+			if (isArray) {
+				arrayName = u.name.substr(0, u.name.size() - 3);
+				uniformsByName[arrayName] = u.base;
 			}
-			else {
-				ublocks.defaultBlockUniforms.push_back(uniform);
+			uniforms.push_back(u);
+
+			// El resto de elementos de los arrays del bloque por defecto
+			if (isArray && u.blockIndex == -1) {
+				const size_t base = uniforms.size() - 1;
+				for (GLint e = 1; e < u.arraySize; e++) {
+					ActiveUniform elem = uniforms[base];
+					elem.name = arrayName + "[" + std::to_string(e) + "]";
+					elem.location = glGetUniformLocation(programId, elem.name.c_str());
+					elem.arraySize = u.arraySize - e;
+					elem.base = base;
+					elem.element = e;
+					uniformsByName[elem.name] = uniforms.size();
+					uniforms.push_back(elem);
+				}
 			}
 		}
-		else {
-			ublocks.blocks[blockIdx].uniforms.push_back(
-				UniformInfo(un, offset, size, type));
-		}
 	}
 
-	for (uint i = 0; i < nuniblocks; i++) {
+	const GLint nBlocks = getProgramInfo(GL_ACTIVE_UNIFORM_BLOCKS);
+	uniformBlocks.resize(nBlocks);
+	for (GLint i = 0; i < nBlocks; i++) {
 		char bname[200];
 		glGetActiveUniformBlockName(programId, i, sizeof(bname), NULL, bname);
-		ublocks.blocks[i].name = bname;
-		glGetActiveUniformBlockiv(programId, i, GL_UNIFORM_BLOCK_BINDING,
-			&ublocks.blocks[i].binding);
-		glGetActiveUniformBlockiv(programId, i, GL_UNIFORM_BLOCK_DATA_SIZE,
-			&ublocks.blocks[i].blockSize);
+		uniformBlocks[i].name = bname;
+		glGetActiveUniformBlockiv(programId, i, GL_UNIFORM_BLOCK_BINDING, &uniformBlocks[i].binding);
+		glGetActiveUniformBlockiv(programId, i, GL_UNIFORM_BLOCK_DATA_SIZE, &uniformBlocks[i].blockSize);
+		uniformBlocksByName[bname] = i;
 	}
 
-	return ublocks;
+	for (int i = 0; i < Shader::NUM_SHADER_TYPES; i++) {
+		Shader::ShaderType type = (Shader::ShaderType)i;
+		activeSubroutineUniforms[i] = 0;
+		if (hasShaderType(type))
+			glGetProgramStageiv(programId, Shader::toGLType(type), GL_ACTIVE_SUBROUTINE_UNIFORMS,
+				&activeSubroutineUniforms[i]);
+	}
+
+	// Los manejadores existentes apuntan a las nuevas entradas
+	for (auto &h : uniformHandles) {
+		if (!resolveHandle(h))
+			ERR("El uniform " + h.name + " ya no es de tipo " + getGLSLTypeInfo(h.type).name);
+	}
+	CHECK_GL();
+}
+
+int Program::findUniform(const std::string &name) const {
+	auto it = uniformsByName.find(name);
+	return it == uniformsByName.end() ? -1 : static_cast<int>(it->second);
+}
+
+// Se pueden escribir con un GLint los samplers e imágenes, y los bool
+static bool compatibleUniformTypes(GLenum declared, GLenum handle) {
+	if (declared == handle)
+		return true;
+	if (handle == GL_INT) {
+		const auto &info = PGUPV::getGLSLTypeInfo(declared);
+		return declared == GL_BOOL || (info.glEnum != 0 && info.numComponents == 0);
+	}
+	return false;
+}
+
+bool Program::resolveHandle(UniformHandle &handle) {
+	handle.entry = -1;
+	const int entry = findUniform(handle.name);
+	if (entry < 0 || uniforms[entry].location < 0)
+		return true;
+	if (!compatibleUniformTypes(uniforms[entry].type, handle.type))
+		return false;
+	handle.entry = entry;
+	return true;
+}
+
+size_t Program::addUniformHandle(const std::string &name, GLenum type) {
+	for (size_t i = 0; i < uniformHandles.size(); i++) {
+		if (uniformHandles[i].name == name && uniformHandles[i].type == type)
+			return i;
+	}
+	UniformHandle handle;
+	handle.name = name;
+	handle.type = type;
+	handle.entry = -1;
+	if (programId) {
+		if (!resolveHandle(handle))
+			ERRT("El uniform " + name + " no es de tipo " + getGLSLTypeInfo(type).name);
+		if (handle.entry < 0)
+			ERR("¡Cuidado! No se encuentra la variable uniform " + name + ". Las escrituras no tendrán efecto");
+	}
+	uniformHandles.push_back(handle);
+	return uniformHandles.size() - 1;
+}
+
+void Program::invalidateUniformValues() {
+	for (auto &u : uniforms)
+		std::fill(u.known.begin(), u.known.end(), false);
 }
 
 bool Program::hasShaderType(Shader::ShaderType type) const {
@@ -1088,10 +1199,7 @@ void Program::refreshRoutineUniforms() {
 #ifdef _DEBUG
 		// Durante el desarrollo, comprobaremos que los índices son válidos y
 		// que hay todos los que son. En release, no se comprobará.
-		GLint n;
-		glGetProgramStageiv(programId, Shader::toGLType(type),
-			GL_ACTIVE_SUBROUTINE_UNIFORMS, &n);
-		if (static_cast<size_t>(n) != subrutinas[i].size()) {
+		if (static_cast<size_t>(activeSubroutineUniforms[i]) != subrutinas[i].size()) {
 			ERRT("No has establecido la subrutina de todos los uniforms de tipo "
 				"subrutina de tu " +
 				Shader::toFriendlyName(type));
@@ -89,8 +89,9 @@ void RenderBoundingVolumes::renderBBox(const BoundingBox &bb, bool highlight, co
   m.setColor(color);
   auto vbo = m.getBufferObject(Mesh::VERTICES);
   gl_copy_write_buffer.bind(vbo);
-  auto vertices = bb.getVertices();
-  gl_copy_write_buffer.write(&vertices[0]);
+  glm::vec4 vertices[8];
+  bb.getCorners(vertices);
+  gl_copy_write_buffer.write(vertices);
   if (highlight) {
     glLineWidth(SELECTED_NODE_WIDTH_BBOX);
   }
@@ -0,0 +1,199 @@
+#include <algorithm>
+#include <cstring>
+
+#include "renderQueue.h"
+#include "indexedBindingPoint.h"
+#include "glMatrices.h"
+#include "program.h"
+#include "model.h"
+#include "profiler.h"
+
+using PGUPV::RenderQueue;
+using PGUPV::Frustum;
+using PGUPV::GLMatrices;
+
+// Bits de cada campo de la clave
+static const unsigned int PROGRAM_BITS = 10, MATERIAL_BITS = 14, MESH_BITS = 14, DEPTH_BITS = 25;
+static const uint64_t TRANSPARENT_BIT = uint64_t(1) << 63;
+
+static uint64_t field(uint32_t value, unsigned int bits, unsigned int shift) {
+	return (static_cast<uint64_t>(value) & ((uint64_t(1) << bits) - 1)) << shift;
+}
+
+RenderQueue::RenderQueue() : NodeVisitor(NodeVisitor::TraversalMode::TRAVERSE_ACTIVE_CHILDREN),
+	program(nullptr), view(1.0f), viewProj(1.0f), world(1.0f), frustum(viewProj),
+	frustumCulling(false), inside(false), visited(0), culled(0), stats() {
+}
+
+void RenderQueue::render(Node &root) {
+	PGUPV_PROFILE_ZONE("RenderQueue::render");
+	auto bo = PGUPV::gl_uniform_buffer.getBound(UBO_GL_MATRICES_BINDING_INDEX);
+	mats = std::static_pointer_cast<GLMatrices>(bo);
+	program = Program::getCurrentProgram();
+	view = mats->getMatrix(GLMatrices::VIEW_MATRIX);
+	viewProj = mats->getMatrix(GLMatrices::PROJ_MATRIX) * view;
+	world = mats->getMatrix(GLMatrices::MODEL_MATRIX);
+	frustum = Frustum(viewProj * world);
+	inside = !frustumCulling;
+	visited = culled = 0;
+	items.clear();
+	seenPrograms.clear();
+	seenMaterials.clear();
+	seenMeshes.clear();
+	root.accept(*this);
+	submit();
+	mats.reset();
+}
+
+bool RenderQueue::cull(Node &node) {
+	visited++;
+	if (inside)
+		return false;
+
+	auto result = frustum.classify(node.getBS());
+	if (result == Frustum::Result::INTERSECTS)
+		result = frustum.classify(node.getBB());
+	if (result == Frustum::Result::OUTSIDE) {
+		culled++;
+		return true;
+	}
+	inside = (result == Frustum::Result::INSIDE);
+	return false;
+}
+
+void RenderQueue::apply(Group &group) {
+	if (!group.isVisible() || !group.getBB().isValid())
+		return;
+	const bool prevInside = inside;
+	if (!cull(group))
+		traverse(group);
+	inside = prevInside;
+}
+
+void RenderQueue::apply(Transform &transform) {
+	if (!transform.isVisible() || !transform.getBB().isValid())
+		return;
+	const bool prevInside = inside;
+	if (!cull(transform)) {
+		const glm::mat4 prevWorld = world;
+		const Frustum prevFrustum = frustum;
+		world = world * transform.getTransform();
+		// Como en FrustumCuller, los planos se expresan en el sistema de coordenadas de la
+		// transformación
+		if (!inside)
+			frustum = Frustum(viewProj * world);
+		traverse(transform);
+		world = prevWorld;
+		frustum = prevFrustum;
+	}
+	inside = prevInside;
+}
+
+void RenderQueue::apply(Geode &geode) {
+	if (!geode.isVisible())
+		return;
+	const bool prevInside = inside;
+	if (!geode.getBB().isValid() || !cull(geode)) {
+		Model &model = geode.getModel();
+		for (uint i = 0; i < model.getNMeshes(); i++) {
+			Mesh &mesh = model.getMesh(i);
+			Item item;
+			item.program = program;
+			item.material = mesh.getMaterial().get();
+			item.mesh = &mesh;
+			item.world = world;
+			items.push_back(item);
+		}
+	}
+	inside = prevInside;
+}
+
+void RenderQueue::apply(AnimationNode &node) {
+	visited++;
+	mats->pushMatrix(GLMatrices::MODEL_MATRIX);
+	mats->setMatrix(GLMatrices::MODEL_MATRIX, world);
+	node.render();
+	mats->popMatrix(GLMatrices::MODEL_MATRIX);
+}
+
+uint32_t RenderQueue::denseIndex(std::unordered_map<const void *, uint32_t> &seen, const void *p) {
+	auto it = seen.find(p);
+	if (it != seen.end())
+		return it->second;
+	const uint32_t idx = static_cast<uint32_t>(seen.size());
+	seen[p] = idx;
+	return idx;
+}
+
+uint64_t RenderQueue::makeKey(const Item &item, bool transparent) {
+	const uint32_t p = denseIndex(seenPrograms, item.program);
+	const uint32_t m = denseIndex(seenMaterials, item.material);
+	const uint32_t v = denseIndex(seenMeshes, item.mesh);
+
+	// Distancia a la cámara del centro de la malla. Los bits de un float positivo se ordenan
+	// igual que el número
+	glm::vec4 center = view * item.world * glm::vec4(item.mesh->getBB().getCenter(), 1.0f);
+	const float depth = std::max(-center.z, 0.0f);
+	uint32_t depthBits;
+	std::memcpy(&depthBits, &depth, sizeof(depthBits));
+
+	if (transparent) {
+		// De atrás hacia delante, y después por estado
+		return TRANSPARENT_BIT | field(~depthBits, 32, 31) |
+			field(p, PROGRAM_BITS, 21) | field(m, MATERIAL_BITS, 7) | field(v, 7, 0);
+	}
+	return field(p, PROGRAM_BITS, 64 - 1 - PROGRAM_BITS) |
+		field(m, MATERIAL_BITS, DEPTH_BITS + MESH_BITS) |
+		field(v, MESH_BITS, DEPTH_BITS) |
+		field(depthBits >> (32 - DEPTH_BITS), DEPTH_BITS, 0);
+}
+
+void RenderQueue::submit() {
+	stats = Stats();
+	order.clear();
+	order.reserve(items.size());
+	for (uint32_t i = 0; i < items.size(); i++) {
+		const bool transparent = items[i].material && items[i].material->isTransparent();
+		if (transparent)
+			stats.transparentItems++;
+		else
+			stats.opaqueItems++;
+		order.emplace_back(makeKey(items[i], transparent), i);
+	}
+	std::sort(order.begin(), order.end());
+
+	mats->pushMatrix(GLMatrices::MODEL_MATRIX);
+	Program *currentProgram = Program::getCurrentProgram();
+	BaseMaterial *currentMaterial = nullptr;
+	Mesh *currentMesh = nullptr;
+	for (auto &o : order) {
+		const Item &item = items[o.second];
+		if (item.program != currentProgram) {
+			if (item.program)
+				item.program->use();
+			currentProgram = item.program;
+			stats.programChanges++;
+		}
+		else
+			stats.programChangesAvoided++;
+		if (item.mesh != currentMesh) {
+			item.mesh->vao.bind();
+			currentMesh = item.mesh;
+			stats.vaoChanges++;
+		}
+		else
+			stats.vaoChangesAvoided++;
+		// Como en Mesh::render, una malla sin material usa el último establecido
+		if (item.material && item.material != currentMaterial) {
+			item.material->use();
+			currentMaterial = item.material;
+			stats.materialChanges++;
+		}
+		else
+			stats.materialChangesAvoided++;
+
+		mats->setMatrix(GLMatrices::MODEL_MATRIX, item.world);
+		item.mesh->renderDrawCommands();
+	}
+	mats->popMatrix(GLMatrices::MODEL_MATRIX);
+}
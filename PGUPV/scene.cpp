@@ -5,7 +5,10 @@
 #include "findNodeByName.h"
 #include "animationClip.h"
 #include "updateVisitor.h"
+#include "frustumCuller.h"
+#include "renderQueue.h"
 #include "baseMaterial.h"
+#include "profiler.h"
 
 using PGUPV::Node;
 using PGUPV::Scene;
@@ -17,7 +20,7 @@ using PGUPV::AnimationClip;
 using PGUPV::BaseMaterial;
 
 
-Scene::Scene() {
+Scene::Scene() : frustumCulling(false), visitedNodes(0), culledNodes(0) {
 }
 
 void Scene::setRoot(std::shared_ptr<Node> root) {
@@ -25,10 +28,32 @@ void Scene::setRoot(std::shared_ptr<Node> root) {
 }
 
 void Scene::render() {
-	if (sceneRoot)
+	if (!sceneRoot)
+		return;
+	PGUPV_PROFILE_ZONE("Scene::render");
+	if (renderQueue) {
+		renderQueue->setFrustumCulling(frustumCulling);
+		renderQueue->render(*sceneRoot);
+		visitedNodes = renderQueue->getNumVisitedNodes();
+		culledNodes = renderQueue->getNumCulledNodes();
+	}
+	else if (frustumCulling) {
+		PGUPV::FrustumCuller culler;
+		culler.render(*sceneRoot);
+		visitedNodes = culler.getNumVisitedNodes();
+		culledNodes = culler.getNumCulledNodes();
+	}
+	else
 		sceneRoot->render();
 }
 
+void Scene::setRenderQueue(bool enable) {
+	if (!enable)
+		renderQueue.reset();
+	else if (!renderQueue)
+		renderQueue = std::make_shared<PGUPV::RenderQueue>();
+}
+
 BoundingBox Scene::getBB() {
 	if (sceneRoot)
 		return sceneRoot->getBB();
@@ -59,9 +84,21 @@ void Scene::print(std::ostream & os) {
 
 void Scene::update(unsigned int )
 {
-	PGUPV::UpdateVisitor update;
-	if (sceneRoot)
+	// Adems de llamar a los callbacks, recoge los nodos animados para calcular sus
+	// matrices de huesos en paralelo
+	class AnimationUpdateVisitor : public PGUPV::UpdateVisitor {
+	public:
+		void apply(PGUPV::AnimationNode &node) override {
+			handle_callbacks_and_traverse(node);
+			animated.push_back(&node);
+		}
+		std::vector<PGUPV::AnimationNode *> animated;
+	};
+	AnimationUpdateVisitor update;
+	if (sceneRoot) {
 		sceneRoot->accept(update);
+		PGUPV::AnimationNode::updateBoneMatrices(update.animated);
+	}
 }
 
 
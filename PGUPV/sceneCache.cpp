@@ -0,0 +1,824 @@
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <stdexcept>
+#include <type_traits>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <assimp/scene.h>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "sceneCache.h"
+#include "scene.h"
+#include "group.h"
+#include "transform.h"
+#include "geode.h"
+#include "mesh.h"
+#include "meshBuilder.h"
+#include "drawCommand.h"
+#include "material.h"
+#include "pbrMaterial.h"
+#include "skeleton.h"
+#include "bone.h"
+#include "uboBones.h"
+#include "animationClip.h"
+#include "animationChannel.h"
+#include "bufferObject.h"
+#include "bindingPoint.h"
+#include "textureCache.h"
+#include "texture2D.h"
+#include "image.h"
+#include "threadPool.h"
+#include "stopWatch.h"
+#include "utils.h"
+#include "log.h"
+
+using PGUPV::SceneCache;
+using PGUPV::AssimpWrapper;
+using PGUPV::Scene;
+using PGUPV::Node;
+using PGUPV::Group;
+using PGUPV::Transform;
+using PGUPV::Geode;
+using PGUPV::Mesh;
+using PGUPV::MeshBuilder;
+using PGUPV::Material;
+using PGUPV::PBRMaterial;
+using PGUPV::BaseMaterial;
+using PGUPV::Skeleton;
+using PGUPV::Bone;
+using PGUPV::AnimationClip;
+using PGUPV::AnimationChannel;
+using PGUPV::KeyFrameValue;
+using PGUPV::BufferObject;
+using PGUPV::TextureCache;
+using PGUPV::Texture2D;
+
+/*
+Formato de los ficheros .pgscene:
+
+- Cabecera (Header)
+- Descripción de la escena: materiales, mallas, grafo de escena y animaciones, escritos
+  secuencialmente (ver SceneCache::save)
+- Área de datos, con los vértices y los índices de las mallas tal y como se envían a la
+  GPU. Con los vértices intercalados, los de todas las mallas van al principio y seguidos,
+  y se suben en un único buffer object.
+
+Todos los valores se guardan en el orden de bytes de la máquina: el fichero es una caché
+local, no un formato de intercambio.
+*/
+
+namespace {
+	const char MAGIC[8] = { 'P', 'G', 'S', 'C', 'E', 'N', 'E', '\0' };
+	// Incrementar cada vez que cambie el formato (los ficheros anteriores se regeneran)
+	const uint32_t VERSION = 2;
+	// Alineamiento de los bloques del área de datos
+	const size_t DATA_ALIGNMENT = 16;
+
+	struct Header {
+		char magic[8];
+		uint32_t version;
+		uint32_t options;
+		uint32_t layout;
+		uint32_t reserved;
+		uint64_t dataOffset;
+		uint64_t dataSize;
+	};
+
+	enum NodeType : uint8_t {
+		GROUP_NODE, TRANSFORM_NODE, GEODE_NODE
+	};
+
+	enum MaterialType : uint8_t {
+		REGULAR_MATERIAL, PBR_MATERIAL
+	};
+
+	class Writer {
+	public:
+		template <typename T>
+		void put(const T &v) {
+			static_assert(std::is_trivially_copyable<T>::value, "Sólo tipos que se pueden copiar con memcpy");
+			meta.append(reinterpret_cast<const char *>(&v), sizeof(T));
+		}
+		void putString(const std::string &s) {
+			put(static_cast<uint32_t>(s.size()));
+			meta.append(s);
+		}
+		template <typename T>
+		void putArray(const std::vector<T> &v) {
+			static_assert(std::is_trivially_copyable<T>::value, "Sólo tipos que se pueden copiar con memcpy");
+			put(static_cast<uint32_t>(v.size()));
+			meta.append(reinterpret_cast<const char *>(v.data()), v.size() * sizeof(T));
+		}
+		// Reserva un bloque en el área de datos, y devuelve su posición
+		uint64_t reserveData(size_t bytes) {
+			size_t offset = (data.size() + DATA_ALIGNMENT - 1) & ~(DATA_ALIGNMENT - 1);
+			data.resize(offset + bytes);
+			return offset;
+		}
+		uint64_t addData(const void *src, size_t bytes) {
+			auto offset = reserveData(bytes);
+			if (bytes)
+				memcpy(&data[offset], src, bytes);
+			return offset;
+		}
+		uint8_t *getData(uint64_t offset) { return &data[offset]; }
+
+		bool write(const std::string &path, uint32_t options, uint32_t layout) {
+			Header header;
+			memcpy(header.magic, MAGIC, sizeof(MAGIC));
+			header.version = VERSION;
+			header.options = options;
+			header.layout = layout;
+			header.reserved = 0;
+			header.dataOffset = (sizeof(Header) + meta.size() + DATA_ALIGNMENT - 1) & ~(DATA_ALIGNMENT - 1);
+			header.dataSize = data.size();
+
+			// Se escribe en un fichero temporal, para no dejar un .pgscene a medias
+			auto tmpPath = path + ".tmp";
+			{
+				std::ofstream f(tmpPath, std::ios::binary | std::ios::trunc);
+				if (!f)
+					return false;
+				f.write(reinterpret_cast<const char *>(&header), sizeof(header));
+				f.write(meta.data(), meta.size());
+				const char padding[DATA_ALIGNMENT] = {};
+				f.write(padding, header.dataOffset - sizeof(Header) - meta.size());
+				f.write(reinterpret_cast<const char *>(data.data()), data.size());
+				if (!f) {
+					f.close();
+					std::remove(tmpPath.c_str());
+					return false;
+				}
+			}
+			std::remove(path.c_str());
+			return std::rename(tmpPath.c_str(), path.c_str()) == 0;
+		}
+	private:
+		std::string meta;
+		std::vector<uint8_t> data;
+	};
+
+	// Lee la descripción de la escena. Si el fichero está truncado, lanza std::runtime_error
+	class Reader {
+	public:
+		Reader(const uint8_t *begin, const uint8_t *end) : p(begin), end(end) {}
+		template <typename T>
+		T get() {
+			T v;
+			check(sizeof(T));
+			memcpy(&v, p, sizeof(T));
+			p += sizeof(T);
+			return v;
+		}
+		std::string getString() {
+			auto n = get<uint32_t>();
+			check(n);
+			std::string s(reinterpret_cast<const char *>(p), n);
+			p += n;
+			return s;
+		}
+		template <typename T>
+		std::vector<T> getArray() {
+			auto n = get<uint32_t>();
+			check(static_cast<size_t>(n) * sizeof(T));
+			std::vector<T> v(n);
+			if (n)
+				memcpy(v.data(), p, n * sizeof(T));
+			p += n * sizeof(T);
+			return v;
+		}
+	private:
+		void check(size_t bytes) {
+			if (static_cast<size_t>(end - p) < bytes)
+				throw std::runtime_error("Fichero .pgscene truncado");
+		}
+		const uint8_t *p, *end;
+	};
+
+	// Fichero proyectado en memoria, de sólo lectura
+	class MappedFile {
+	public:
+		MappedFile() : ptr(nullptr), length(0) {}
+		~MappedFile() { close(); }
+		bool open(const std::string &path) {
+#ifdef _WIN32
+			file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+				FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+			if (file == INVALID_HANDLE_VALUE)
+				return false;
+			LARGE_INTEGER size;
+			if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+				close();
+				return false;
+			}
+			length = static_cast<size_t>(size.QuadPart);
+			mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			if (mapping == nullptr) {
+				close();
+				return false;
+			}
+			ptr = static_cast<const uint8_t *>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+#else
+			int fd = ::open(path.c_str(), O_RDONLY);
+			if (fd < 0)
+				return false;
+			struct stat st;
+			if (fstat(fd, &st) != 0 || st.st_size == 0) {
+				::close(fd);
+				return false;
+			}
+			length = static_cast<size_t>(st.st_size);
+			void *p = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+			// La proyección sigue siendo válida después de cerrar el descriptor
+			::close(fd);
+			ptr = p == MAP_FAILED ? nullptr : static_cast<const uint8_t *>(p);
+#endif
+			if (!ptr) {
+				close();
+				return false;
+			}
+			return true;
+		}
+		void close() {
+#ifdef _WIN32
+			if (ptr)
+				UnmapViewOfFile(ptr);
+			if (mapping != nullptr)
+				CloseHandle(mapping);
+			if (file != INVALID_HANDLE_VALUE)
+				CloseHandle(file);
+			mapping = nullptr;
+			file = INVALID_HANDLE_VALUE;
+#else
+			if (ptr)
+				munmap(const_cast<uint8_t *>(ptr), length);
+#endif
+			ptr = nullptr;
+			length = 0;
+		}
+		const uint8_t *data() const { return ptr; }
+		size_t size() const { return length; }
+	private:
+		const uint8_t *ptr;
+		size_t length;
+#ifdef _WIN32
+		HANDLE file = INVALID_HANDLE_VALUE, mapping = nullptr;
+#endif
+	};
+
+	bool readHeader(const std::string &path, Header &header) {
+		std::ifstream f(path, std::ios::binary);
+		if (!f.read(reinterpret_cast<char *>(&header), sizeof(header)))
+			return false;
+		return memcmp(header.magic, MAGIC, sizeof(MAGIC)) == 0 && header.version == VERSION;
+	}
+
+	// Número de bytes de cada vértice de los atributos que se guardan por separado
+	size_t getAttributeSize(uint32_t attribute) {
+		switch (attribute) {
+		case Mesh::VERTICES:
+		case Mesh::NORMALS:
+		case Mesh::TANGENTS:
+			return sizeof(glm::vec3);
+		case Mesh::BONE_IDS:
+			return sizeof(glm::uvec4);
+		case Mesh::BONE_WEIGHTS:
+			return sizeof(glm::vec4);
+		default:
+			if (attribute >= Mesh::TEX_COORD0 && attribute < Mesh::TEX_COORD0 + NUM_TEX_COORD)
+				return sizeof(glm::vec2);
+			throw std::runtime_error("Atributo desconocido en el fichero .pgscene");
+		}
+	}
+
+	size_t getIndexSize(GLenum type) {
+		switch (type) {
+		case 0:
+			return 0;
+		case GL_UNSIGNED_SHORT:
+			return sizeof(GLushort);
+		case GL_UNSIGNED_INT:
+			return sizeof(GLuint);
+		default:
+			throw std::runtime_error("Tipo de índices desconocido en el fichero .pgscene");
+		}
+	}
+
+	void writeNode(Writer &w, Node &node, const std::map<const Mesh *, uint32_t> &meshIndex) {
+		auto geode = dynamic_cast<Geode *>(&node);
+		if (geode) {
+			w.put(GEODE_NODE);
+			w.putString(node.getName());
+			w.put(static_cast<uint8_t>(node.isVisible()));
+			auto &model = geode->getModel();
+			w.put(model.getNMeshes());
+			for (uint i = 0; i < model.getNMeshes(); i++)
+				w.put(meshIndex.at(&model.getMesh(i)));
+			return;
+		}
+		auto group = dynamic_cast<Group *>(&node);
+		if (!group)
+			throw std::runtime_error("Tipo de nodo no soportado en los ficheros .pgscene");
+		auto xform = dynamic_cast<Transform *>(&node);
+		w.put(xform ? TRANSFORM_NODE : GROUP_NODE);
+		w.putString(node.getName());
+		w.put(static_cast<uint8_t>(node.isVisible()));
+		if (xform)
+			w.put(xform->getTransform());
+		w.put(static_cast<uint32_t>(group->getNumChildren()));
+		for (size_t i = 0; i < group->getNumChildren(); i++)
+			writeNode(w, *group->getChild(i), meshIndex);
+	}
+
+	std::shared_ptr<Node> readNode(Reader &r, const std::vector<std::shared_ptr<Mesh>> &meshes) {
+		auto type = r.get<NodeType>();
+		auto name = r.getString();
+		bool visible = r.get<uint8_t>() != 0;
+		std::shared_ptr<Node> node;
+		if (type == GEODE_NODE) {
+			auto geode = Geode::build();
+			auto n = r.get<uint32_t>();
+			for (uint32_t i = 0; i < n; i++)
+				geode->addMesh(meshes.at(r.get<uint32_t>()));
+			node = geode;
+		}
+		else {
+			std::shared_ptr<Group> group;
+			if (type == TRANSFORM_NODE)
+				group = Transform::build(r.get<glm::mat4>());
+			else if (type == GROUP_NODE)
+				group = Group::build();
+			else
+				throw std::runtime_error("Tipo de nodo desconocido en el fichero .pgscene");
+			auto n = r.get<uint32_t>();
+			for (uint32_t i = 0; i < n; i++)
+				group->addChild(readNode(r, meshes));
+			node = group;
+		}
+		node->setName(name);
+		node->setVisible(visible);
+		return node;
+	}
+
+	void writeSkeleton(Writer &w, const std::shared_ptr<Skeleton> &skeleton) {
+		const uint32_t nBones = skeleton ? skeleton->getNBones() : 0;
+		w.put(nBones);
+		for (uint32_t i = 0; i < nBones; i++) {
+			auto bone = skeleton->getBone(i);
+			w.putString(bone->getName());
+			w.put(bone->getMatrix());
+		}
+	}
+
+	// Los huesos se guardan sin sus pesos, que ya están en los atributos de los vértices
+	std::shared_ptr<Skeleton> readSkeleton(Reader &r) {
+		auto nBones = r.get<uint32_t>();
+		if (nBones == 0)
+			return nullptr;
+		auto skeleton = std::make_shared<Skeleton>();
+		for (uint32_t i = 0; i < nBones; i++) {
+			auto bone = std::make_shared<Bone>(r.getString());
+			bone->setMatrix(r.get<glm::mat4>());
+			skeleton->addBone(bone);
+		}
+		return skeleton;
+	}
+};
+
+
+bool SceneCache::isUpToDate(const std::string &cachePath, const std::string &sourcePath,
+	AssimpWrapper::LoadOptions options, AssimpWrapper::VertexLayout layout) {
+	if (!PGUPV::fileExists(cachePath) || !PGUPV::fileExists(sourcePath))
+		return false;
+	if (PGUPV::getFileModificationTime(cachePath) < PGUPV::getFileModificationTime(sourcePath))
+		return false;
+	Header header;
+	return readHeader(cachePath, header) && header.options == static_cast<uint32_t>(options) &&
+		header.layout == static_cast<uint32_t>(layout);
+}
+
+
+bool SceneCache::save(const std::string &cachePath, const AssimpWrapper &loader, Scene &scene,
+	AssimpWrapper::LoadOptions options) {
+	if (!loader.prepared || !loader.scene)
+		return false;
+	const auto &prepared = *loader.prepared;
+	const aiScene *aiscene = loader.scene;
+	const bool interleaved = prepared.layout != AssimpWrapper::VertexLayout::SEPARATE;
+
+	try {
+		Writer w;
+
+		// Materiales
+		w.put(static_cast<uint32_t>(scene.getNumMaterials()));
+		for (unsigned int i = 0; i < scene.getNumMaterials(); i++) {
+			auto base = scene.getMaterial(i);
+			auto mat = std::dynamic_pointer_cast<Material>(base);
+			w.put(mat ? REGULAR_MATERIAL : PBR_MATERIAL);
+			w.putString(base->getName());
+			if (mat) {
+				w.put(mat->getAmbient());
+				w.put(mat->getDiffuse());
+				w.put(mat->getSpecular());
+				w.put(mat->getEmissive());
+				w.put(mat->getShininess());
+			}
+			std::vector<const AssimpWrapper::PreparedTexture *> textures;
+			for (auto &t : prepared.textures)
+				if (t.material == i)
+					textures.push_back(&t);
+			w.put(static_cast<uint32_t>(textures.size()));
+			for (auto t : textures) {
+				w.put(static_cast<uint32_t>(t->textureUnit));
+				// La ruta del modelo, no la encontrada, que puede ser relativa al directorio de
+				// trabajo actual. Se vuelve a buscar al cargar
+				w.putString(t->name);
+			}
+		}
+
+		// Con los vértices intercalados, los de todas las mallas van seguidos al principio
+		// del área de datos, como en MeshBuilder::build(builders)
+		std::vector<uint64_t> vertexOffsets;
+		uint64_t vertexRegionOffset = 0, vertexRegionSize = 0;
+		if (interleaved) {
+			size_t total = 0;
+			for (auto &b : prepared.builders) {
+				vertexOffsets.push_back(total);
+				total += static_cast<size_t>(b.getVertexSize()) * b.getNVertices();
+			}
+			vertexRegionOffset = w.reserveData(total);
+			vertexRegionSize = total;
+			for (size_t n = 0; n < prepared.builders.size(); n++) {
+				GLsizei stride;
+				auto layout = prepared.builders[n].getLayout(stride);
+				prepared.builders[n].fill(w.getData(vertexRegionOffset + vertexOffsets[n]), layout, stride);
+			}
+		}
+		w.put(vertexRegionOffset);
+		w.put(vertexRegionSize);
+
+		// Mallas
+		std::map<const Mesh *, uint32_t> meshIndex;
+		w.put(static_cast<uint32_t>(aiscene->mNumMeshes));
+		for (unsigned int n = 0; n < aiscene->mNumMeshes; n++) {
+			const aiMesh *aimesh = aiscene->mMeshes[n];
+			const Mesh &mesh = *loader.tempMeshes[n];
+			meshIndex[&mesh] = n;
+
+			w.putString(aimesh->mName.C_Str());
+			w.put(static_cast<uint32_t>(aimesh->mMaterialIndex));
+			w.put(static_cast<uint32_t>(mesh.getDrawCommands().at(0)->getGLPrimitiveType()));
+			w.put(static_cast<uint32_t>(aimesh->mNumVertices));
+			w.put(mesh.getBB().min);
+			w.put(mesh.getBB().max);
+			w.put(mesh.getBS().center);
+			w.put(mesh.getBS().radius);
+
+			// Índices (tipo 0: la malla se dibuja con glDrawArrays)
+			const std::vector<GLuint> &indices = interleaved ? prepared.builders[n].indices : prepared.meshes[n].indices;
+			GLenum indicesType = 0;
+			uint64_t indicesOffset = 0;
+			if (!indices.empty()) {
+				indicesType = interleaved ? prepared.builders[n].getIndicesType() : GL_UNSIGNED_INT;
+				if (indicesType == GL_UNSIGNED_SHORT) {
+					std::vector<GLushort> shortIndices(indices.begin(), indices.end());
+					indicesOffset = w.addData(shortIndices.data(), shortIndices.size() * sizeof(GLushort));
+				}
+				else
+					indicesOffset = w.addData(indices.data(), indices.size() * sizeof(GLuint));
+			}
+			w.put(static_cast<uint32_t>(indicesType));
+			w.put(static_cast<uint32_t>(indices.size()));
+			w.put(indicesOffset);
+
+			w.put(static_cast<uint8_t>(interleaved));
+			std::shared_ptr<Skeleton> skeleton;
+			if (interleaved) {
+				GLsizei stride;
+				auto layout = prepared.builders[n].getLayout(stride);
+				w.put(vertexOffsets[n]);
+				w.put(static_cast<uint32_t>(stride));
+				w.put(static_cast<uint32_t>(layout.size()));
+				for (auto &f : layout) {
+					w.put(static_cast<uint32_t>(f.index));
+					w.put(static_cast<int32_t>(f.size));
+					w.put(static_cast<uint32_t>(f.type));
+					w.put(static_cast<uint8_t>(f.normalized));
+					w.put(static_cast<uint8_t>(f.integer));
+					w.put(static_cast<uint32_t>(f.offset));
+				}
+				skeleton = prepared.builders[n].skeleton;
+			}
+			else {
+				// Un bloque por atributo: (índice del atributo, posición en el área de datos)
+				const auto &pm = prepared.meshes[n];
+				const size_t nv = aimesh->mNumVertices;
+				std::vector<std::pair<uint32_t, uint64_t>> streams;
+				if (aimesh->HasPositions())
+					streams.emplace_back(Mesh::VERTICES, w.addData(aimesh->mVertices, nv * sizeof(glm::vec3)));
+				if (aimesh->HasNormals())
+					streams.emplace_back(Mesh::NORMALS, w.addData(aimesh->mNormals, nv * sizeof(glm::vec3)));
+				if (aimesh->HasTangentsAndBitangents())
+					streams.emplace_back(Mesh::TANGENTS, w.addData(aimesh->mTangents, nv * sizeof(glm::vec3)));
+				for (unsigned int i = 0; i < NUM_TEX_COORD && !pm.texCoords[i].empty(); i++)
+					streams.emplace_back(Mesh::TEX_COORD0 + i, w.addData(pm.texCoords[i].data(), nv * sizeof(glm::vec2)));
+				if (pm.skeleton) {
+					streams.emplace_back(Mesh::BONE_IDS, w.addData(pm.boneIds.data(), nv * sizeof(glm::uvec4)));
+					streams.emplace_back(Mesh::BONE_WEIGHTS, w.addData(pm.boneWeights.data(), nv * sizeof(glm::vec4)));
+				}
+				w.put(static_cast<uint32_t>(streams.size()));
+				for (auto &s : streams) {
+					w.put(s.first);
+					w.put(s.second);
+				}
+				skeleton = pm.skeleton;
+			}
+			writeSkeleton(w, skeleton);
+		}
+
+		// Grafo de escena
+		writeNode(w, *scene.getRoot(), meshIndex);
+
+		// Animaciones
+		w.put(static_cast<uint32_t>(scene.getNumAnimations()));
+		for (size_t i = 0; i < scene.getNumAnimations(); i++) {
+			auto clip = scene.getAnimation(i);
+			w.putString(clip->getName());
+			w.put(clip->getDurationInTicks());
+			w.put(clip->getTicksPerSecond());
+			auto channels = clip->getAnimationChannels();
+			w.put(static_cast<uint32_t>(channels.size()));
+			for (auto &c : channels) {
+				w.putString(c->getNodeName());
+				w.putArray(c->getPositionKeyFrames());
+				w.putArray(c->getRotationKeyFrames());
+				w.putArray(c->getScalingKeyFrames());
+			}
+		}
+
+		return w.write(cachePath, static_cast<uint32_t>(options), static_cast<uint32_t>(prepared.layout));
+	}
+	catch (std::exception &) {
+		return false;
+	}
+}
+
+
+std::shared_ptr<Scene> SceneCache::load(const std::string &cachePath) {
+	PGUPV::MicroSecStopWatch stopWatch;
+	MappedFile file;
+	if (!file.open(cachePath) || file.size() < sizeof(Header))
+		return nullptr;
+
+	Header header;
+	memcpy(&header, file.data(), sizeof(header));
+	if (memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != VERSION ||
+		header.dataOffset > file.size() || header.dataSize > file.size() - header.dataOffset) {
+		return nullptr;
+	}
+	const uint8_t *data = file.data() + header.dataOffset;
+	// Comprueba que un bloque del área de datos está dentro del fichero
+	auto checkData = [&header](uint64_t offset, uint64_t bytes) {
+		if (offset > header.dataSize || bytes > header.dataSize - offset)
+			throw std::runtime_error("Bloque de datos fuera del fichero .pgscene");
+	};
+
+	auto result = std::make_shared<Scene>();
+	try {
+		Reader r(file.data() + sizeof(Header), data);
+
+		// Materiales. Las texturas que no están en la caché se decodifican en paralelo
+		struct MaterialTexture {
+			std::shared_ptr<BaseMaterial> material;
+			uint32_t unit;
+			std::string path;
+		};
+		std::vector<MaterialTexture> textures;
+		auto nMaterials = r.get<uint32_t>();
+		for (uint32_t i = 0; i < nMaterials; i++) {
+			auto type = r.get<MaterialType>();
+			auto name = r.getString();
+			std::shared_ptr<BaseMaterial> mat;
+			if (type == REGULAR_MATERIAL) {
+				auto amb = r.get<glm::vec4>();
+				auto dif = r.get<glm::vec4>();
+				auto spe = r.get<glm::vec4>();
+				auto emi = r.get<glm::vec4>();
+				auto shininess = r.get<float>();
+				mat = std::make_shared<Material>(name, amb, dif, spe, emi, shininess);
+			}
+			else
+				mat = std::make_shared<PBRMaterial>(name);
+			auto nTextures = r.get<uint32_t>();
+			for (uint32_t t = 0; t < nTextures; t++) {
+				auto unit = r.get<uint32_t>();
+				textures.push_back(MaterialTexture{ mat, unit, r.getString() });
+			}
+			result->addMaterial(mat);
+		}
+
+		// Se buscan los ficheros desde el directorio del .pgscene, que es el del modelo
+		std::map<std::string, std::string> found;
+		for (auto &t : textures)
+			found[t.path];
+		std::vector<std::map<std::string, std::string>::iterator> toFind;
+		for (auto it = found.begin(); it != found.end(); ++it)
+			toFind.push_back(it);
+		PGUPV::ThreadPool::getInstance().parallelFor(toFind.size(), [&toFind, &cachePath](size_t i) {
+			toFind[i]->second = AssimpWrapper::findTexture(toFind[i]->first, cachePath);
+		});
+		for (auto &t : textures)
+			t.path = found[t.path];
+
+		auto &cache = TextureCache::getInstance();
+		std::map<std::string, std::shared_ptr<Texture2D>> loaded;
+		std::vector<std::string> pending;
+		for (auto &t : textures) {
+			if (loaded.count(t.path))
+				continue;
+			loaded[t.path] = cache.find(TextureCache::Key(t.path));
+			if (!loaded[t.path])
+				pending.push_back(t.path);
+		}
+		// Como en AssimpWrapper, las tareas no usan el log: los errores se avisan después
+		std::vector<std::unique_ptr<PGUPV::Image>> images(pending.size());
+		std::vector<std::string> errors(pending.size());
+		PGUPV::ThreadPool::getInstance().parallelFor(pending.size(), [&pending, &images, &errors](size_t i) {
+			if (!PGUPV::fileExists(pending[i])) {
+				errors[i] = "no existe el fichero";
+				return;
+			}
+			images[i] = PGUPV::Image::tryLoad(pending[i], &errors[i]);
+		});
+		for (size_t i = 0; i < pending.size(); i++) {
+			if (images[i])
+				loaded[pending[i]] = cache.create(TextureCache::Key(pending[i]), *images[i]);
+			else {
+				WARN("No se ha podido cargar la textura " + pending[i] + ": " + errors[i]);
+				loaded[pending[i]] = cache.getFallback();
+			}
+		}
+		for (auto &t : textures) {
+			auto mat = std::dynamic_pointer_cast<Material>(t.material);
+			if (mat)
+				mat->setTexture(t.unit, loaded[t.path]);
+			else
+				std::static_pointer_cast<PBRMaterial>(t.material)->setTexture(t.unit, loaded[t.path]);
+		}
+
+		// Vértices intercalados de todas las mallas, directamente desde la proyección del fichero
+		auto vertexRegionOffset = r.get<uint64_t>();
+		auto vertexRegionSize = r.get<uint64_t>();
+		std::shared_ptr<BufferObject> vertexBuffer;
+		if (vertexRegionSize > 0) {
+			checkData(vertexRegionOffset, vertexRegionSize);
+			vertexBuffer = BufferObject::build(static_cast<size_t>(vertexRegionSize), GL_STATIC_DRAW);
+			vertexBuffer->setGlDebugLabel("Vértices intercalados");
+			auto prev = PGUPV::gl_array_buffer.bind(vertexBuffer);
+			PGUPV::gl_array_buffer.write(data + vertexRegionOffset);
+			PGUPV::gl_array_buffer.bind(prev);
+		}
+
+		// Mallas
+		std::vector<std::shared_ptr<Mesh>> meshes;
+		auto nMeshes = r.get<uint32_t>();
+		for (uint32_t n = 0; n < nMeshes; n++) {
+			auto mesh = std::make_shared<Mesh>();
+			mesh->setName(r.getString());
+			auto material = r.get<uint32_t>();
+			auto mode = static_cast<GLenum>(r.get<uint32_t>());
+			auto nVertices = r.get<uint32_t>();
+			PGUPV::BoundingBox bb;
+			bb.min = r.get<glm::vec3>();
+			bb.max = r.get<glm::vec3>();
+			PGUPV::BoundingSphere bs;
+			bs.center = r.get<glm::vec3>();
+			bs.radius = r.get<float>();
+
+			auto indicesType = static_cast<GLenum>(r.get<uint32_t>());
+			auto indicesCount = r.get<uint32_t>();
+			auto indicesOffset = r.get<uint64_t>();
+			checkData(indicesOffset, static_cast<uint64_t>(indicesCount) * getIndexSize(indicesType));
+
+			std::vector<glm::uvec4> boneIds;
+			std::vector<glm::vec4> boneWeights;
+			bool interleaved = r.get<uint8_t>() != 0;
+			if (interleaved) {
+				if (!vertexBuffer)
+					throw std::runtime_error("Fichero .pgscene sin vértices intercalados");
+				auto offset = r.get<uint64_t>();
+				auto stride = r.get<uint32_t>();
+				checkData(vertexRegionOffset + offset, static_cast<uint64_t>(stride) * nVertices);
+				std::vector<Mesh::VertexAttribFormat> formats(r.get<uint32_t>());
+				for (auto &f : formats) {
+					f.index = r.get<uint32_t>();
+					f.size = r.get<int32_t>();
+					f.type = r.get<uint32_t>();
+					f.normalized = r.get<uint8_t>() != 0;
+					f.integer = r.get<uint8_t>() != 0;
+					f.offset = r.get<uint32_t>();
+				}
+				mesh->n_vertices = nVertices;
+				mesh->n_components_per_vertex = 3;
+				mesh->setInterleavedAttributes(vertexBuffer, static_cast<GLintptr>(offset), static_cast<GLsizei>(stride), formats);
+				mesh->bb = bb;
+				mesh->bs = bs;
+			}
+			else {
+				auto nStreams = r.get<uint32_t>();
+				for (uint32_t s = 0; s < nStreams; s++) {
+					auto attribute = r.get<uint32_t>();
+					auto offset = r.get<uint64_t>();
+					checkData(offset, getAttributeSize(attribute) * nVertices);
+					const float *src = reinterpret_cast<const float *>(data + offset);
+					switch (attribute) {
+					case Mesh::VERTICES:
+						mesh->addVertices(src, 3, nVertices);
+						break;
+					case Mesh::NORMALS:
+						mesh->addNormals(src, nVertices);
+						break;
+					case Mesh::TANGENTS:
+						mesh->addTangents(src, nVertices);
+						break;
+					case Mesh::BONE_IDS:
+					{
+						auto ids = reinterpret_cast<const glm::uvec4 *>(data + offset);
+						boneIds.assign(ids, ids + nVertices);
+					}
+					break;
+					case Mesh::BONE_WEIGHTS:
+					{
+						auto weights = reinterpret_cast<const glm::vec4 *>(data + offset);
+						boneWeights.assign(weights, weights + nVertices);
+					}
+					break;
+					default:
+						mesh->addTexCoord(attribute - Mesh::TEX_COORD0, reinterpret_cast<const glm::vec2 *>(src), nVertices);
+					}
+				}
+			}
+
+			if (indicesType == GL_UNSIGNED_SHORT)
+				mesh->addIndices(reinterpret_cast<const GLushort *>(data + indicesOffset), indicesCount);
+			else if (indicesType == GL_UNSIGNED_INT)
+				mesh->addIndices(reinterpret_cast<const GLuint *>(data + indicesOffset), indicesCount);
+
+			auto skeleton = readSkeleton(r);
+			if (skeleton) {
+				if (interleaved) {
+					mesh->setBones(PGUPV::UBOBones::build(std::vector<glm::mat4>(skeleton->getNBones(), glm::mat4(1.0f))));
+					mesh->skeleton = skeleton;
+				}
+				else
+					mesh->setSkeleton(skeleton, boneIds, boneWeights);
+			}
+
+			if (indicesType == 0)
+				mesh->addDrawCommand(new PGUPV::DrawArrays(mode, 0, nVertices));
+			else
+				mesh->addDrawCommand(new PGUPV::DrawElements(mode, static_cast<GLsizei>(indicesCount), indicesType, 0));
+			mesh->setMaterial(result->getMaterial(material));
+			meshes.push_back(mesh);
+		}
+
+		result->setRoot(readNode(r, meshes));
+
+		// Animaciones
+		auto nAnimations = r.get<uint32_t>();
+		for (uint32_t i = 0; i < nAnimations; i++) {
+			auto name = r.getString();
+			auto duration = r.get<float>();
+			auto ticksPerSecond = r.get<float>();
+			auto clip = std::make_shared<AnimationClip>(name, duration, ticksPerSecond);
+			auto nChannels = r.get<uint32_t>();
+			for (uint32_t c = 0; c < nChannels; c++) {
+				auto channel = std::make_shared<AnimationChannel>(r.getString());
+				for (auto &k : r.getArray<KeyFrameValue<glm::vec3>>())
+					channel->addPositionKeyFrame(k);
+				for (auto &k : r.getArray<KeyFrameValue<glm::quat>>())
+					channel->addRotationKeyFrame(k);
+				for (auto &k : r.getArray<KeyFrameValue<glm::vec3>>())
+					channel->addScalingKeyFrame(k);
+				clip->addChannel(channel);
+			}
+			result->addAnimation(clip);
+		}
+	}
+	catch (std::exception &e) {
+		WARN("No se ha podido leer " + cachePath + ": " + e.what());
+		return nullptr;
+	}
+
+	INFO("Escena cargada desde " + cachePath + " en " + std::to_string(stopWatch.getElapsed() / 1000) + " ms");
+	return result;
+}
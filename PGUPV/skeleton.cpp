@@ -13,17 +13,18 @@ void Skeleton::addBone(std::shared_ptr<Bone> bone) {
 	bones.push_back(bone);
 }
 
-void addWeight(std::vector<glm::uvec4> &boneIds, std::vector<glm::vec4> &boneWeights, uint32_t bone, uint32_t vertex, float weight) {
+// Devuelve false si el vértice ya tiene 4 huesos (y se ignora el peso)
+static bool addWeight(std::vector<glm::uvec4> &boneIds, std::vector<glm::vec4> &boneWeights, uint32_t bone, uint32_t vertex, float weight) {
 	assert(vertex < boneIds.size());
 
 	for (unsigned int i = 0; i < 4; i++) {
 		if (boneWeights[vertex][i] == 0.0f) {
 			boneWeights[vertex][i] = weight;
 			boneIds[vertex][i] = bone;
-			return;
+			return true;
 		}
 	}
-	WARN("The maximum number of bones per vertex is 4. Ignoring bones");
+	return false;
 }
 
 uint32_t Skeleton::getNBones() const
@@ -31,8 +32,9 @@ uint32_t Skeleton::getNBones() const
 	return gsl::narrow<uint32_t>(bones.size());
 }
 
-void Skeleton::buildArraysOfVerticesAndWeights(uint32_t size, std::vector<glm::uvec4>& boneIds, std::vector<glm::vec4>& boneWeights)
+uint32_t Skeleton::buildArraysOfVerticesAndWeights(uint32_t size, std::vector<glm::uvec4>& boneIds, std::vector<glm::vec4>& boneWeights)
 {
+	uint32_t ignored = 0;
 	boneIds.clear();
 	boneIds.resize(size, glm::uvec4(0U));
 	boneWeights.clear();
@@ -42,9 +44,11 @@ void Skeleton::buildArraysOfVerticesAndWeights(uint32_t size, std::vector<glm::u
 		const auto &bone = *bones[i];
 		for (size_t j = 0; j < bone.getNWeights(); j++) {
 			auto vw = bone.getWeight(gsl::narrow<uint32_t>(j));
-			addWeight(boneIds, boneWeights, gsl::narrow<uint32_t>(i), vw.vertexIndex, vw.weight);
+			if (!addWeight(boneIds, boneWeights, gsl::narrow<uint32_t>(i), vw.vertexIndex, vw.weight))
+				ignored++;
 		}
 	}
+	return ignored;
 }
 
 //void Skeleton::buildArrayOfMatrices(std::vector<glm::mat4>& matrices)
@@ -0,0 +1,445 @@
+#include <algorithm>
+#include <map>
+#include <unordered_map>
+
+#include "staticSceneBatch.h"
+#include "scene.h"
+#include "nodeVisitor.h"
+#include "model.h"
+#include "meshBuilder.h"
+#include "drawCommand.h"
+#include "bufferObject.h"
+#include "indexedBindingPoint.h"
+#include "glMatrices.h"
+#include "profiler.h"
+#include "log.h"
+
+using PGUPV::StaticSceneBatch;
+using PGUPV::Mesh;
+using PGUPV::BoundingBox;
+using PGUPV::GLMatrices;
+
+// Puntos de vinculación de los buffers que usa el shader de recorte (además de los datos de
+// cada dibujo, en SSBO_DRAW_DATA_BINDING_INDEX)
+static const GLuint CULL_INPUT_BINDING = 2, CULL_OUTPUT_BINDING = 3, CULL_COUNTS_BINDING = 4;
+static const GLuint CULL_GROUP_SIZE = 64;
+
+const std::string StaticSceneBatch::blockName{ "DrawData" };
+
+const Strings StaticSceneBatch::definition{
+"struct DrawData {",
+"  mat4 modelMatrix;",
+"  vec4 boundingSphere;",
+"  uint materialIndex;",
+"  uint group;",
+"  uint groupFirst;",
+"  uint padding;",
+"};",
+"layout (std430, binding=" + std::to_string(SSBO_DRAW_DATA_BINDING_INDEX) + ") readonly buffer DrawDataBlock {",
+"  DrawData drawData[];",
+"};",
+};
+
+namespace {
+	// Atributos de los vértices que se copian a la malla combinada
+	const Mesh::BufferObjectType mergedAttribs[] = { Mesh::NORMALS, Mesh::COLORS, Mesh::TANGENTS,
+		Mesh::TEX_COORD0, Mesh::TEX_COORD1, Mesh::TEX_COORD2, Mesh::TEX_COORD3 };
+
+	// Vértices e índices de las mallas que comparten los mismos atributos
+	struct ArenaData {
+		std::vector<glm::vec3> vertices, normals, tangents;
+		std::vector<glm::vec4> colors;
+		std::vector<glm::vec2> texCoords[NUM_TEX_COORD];
+		std::vector<GLuint> indices;
+	};
+
+	// Posición de una malla dentro de su malla combinada
+	struct MeshSlot {
+		size_t arena;
+		GLuint firstIndex, count;
+		GLint baseVertex;
+	};
+
+	template <typename T>
+	void append(std::vector<T> &dst, const std::vector<T> &src) {
+		dst.insert(dst.end(), src.begin(), src.end());
+	}
+
+	// Recoge las mallas visibles de la escena con su matriz del modelo
+	class Collector : public PGUPV::NodeVisitor {
+	public:
+		Collector() : world(1.0f) {}
+		void apply(PGUPV::Group &group) override {
+			if (group.isVisible())
+				traverse(group);
+		}
+		void apply(PGUPV::Transform &transform) override {
+			if (!transform.isVisible())
+				return;
+			const glm::mat4 prev = world;
+			world = world * transform.getTransform();
+			traverse(transform);
+			world = prev;
+		}
+		void apply(PGUPV::Geode &geode) override {
+			if (!geode.isVisible())
+				return;
+			auto &model = geode.getModel();
+			for (uint i = 0; i < model.getNMeshes(); i++)
+				items.push_back(std::make_pair(&model.getMesh(i), world));
+		}
+		// Las animaciones no son geometría estática
+		void apply(PGUPV::AnimationNode &) override {}
+
+		std::vector<std::pair<Mesh *, glm::mat4>> items;
+	private:
+		glm::mat4 world;
+	};
+};
+
+StaticSceneBatch::StaticSceneBatch() : gpuCulling(false) {
+}
+
+StaticSceneBatch::~StaticSceneBatch() {
+}
+
+void StaticSceneBatch::release() {
+	root.reset();
+	arenas.clear();
+	groups.clear();
+	draws.clear();
+	separate.clear();
+	materials.clear();
+	commands.reset();
+	culledCommands.reset();
+	drawData.reset();
+	drawIndices.reset();
+	groupCounts.reset();
+}
+
+bool StaticSceneBatch::canMerge(const Mesh &mesh) {
+	if (mesh.n_vertices == 0 || mesh.bones || mesh.skeleton || !mesh.staticAttrValues.empty() ||
+		mesh.drawCommands.empty())
+		return false;
+	for (size_t i = 0; i < mesh.vbos.size(); i++) {
+		if (mesh.vbos[i] && (i == Mesh::BONE_IDS || i == Mesh::BONE_WEIGHTS || i >= Mesh::_LAST_))
+			return false;
+	}
+	for (auto d : mesh.drawCommands) {
+		// build usa getTrianglesIndices, que sólo implementan DrawArrays y DrawElements
+		if (!dynamic_cast<const DrawArrays *>(d) && !dynamic_cast<const DrawElements *>(d))
+			return false;
+		const GLenum mode = d->getGLPrimitiveType();
+		if (mode != GL_TRIANGLES && mode != GL_TRIANGLE_STRIP && mode != GL_TRIANGLE_FAN)
+			return false;
+	}
+	return true;
+}
+
+void StaticSceneBatch::build(Scene &scene) {
+	build(scene.getRoot());
+}
+
+void StaticSceneBatch::build(std::shared_ptr<Node> newRoot) {
+	release();
+	if (!newRoot)
+		return;
+	root = newRoot;
+	PGUPV_PROFILE_ZONE("StaticSceneBatch::build");
+
+	Collector collector;
+	root->accept(collector);
+
+	// Copia la geometría de cada malla distinta a la malla combinada con sus mismos atributos
+	std::vector<ArenaData> arenaData;
+	std::map<unsigned int, size_t> arenaByAttribs;
+	std::unordered_map<Mesh *, MeshSlot> slots;
+	for (auto &item : collector.items) {
+		Mesh *mesh = item.first;
+		if (slots.count(mesh))
+			continue;
+		if (!canMerge(*mesh)) {
+			separate.push_back(SeparateMesh{ mesh, item.second });
+			continue;
+		}
+		unsigned int attribs = 0;
+		for (auto a : mergedAttribs) {
+			if (mesh->vbos[a])
+				attribs |= 1 << a;
+		}
+		auto it = arenaByAttribs.find(attribs);
+		if (it == arenaByAttribs.end()) {
+			it = arenaByAttribs.insert(std::make_pair(attribs, arenaData.size())).first;
+			arenaData.push_back(ArenaData());
+		}
+		ArenaData &arena = arenaData[it->second];
+
+		// Los triángulos de todas las órdenes de dibujo, como en BVHPicker
+		std::vector<GLuint> indices;
+		void *mapped = nullptr;
+		std::shared_ptr<BufferObject> prev;
+		if (mesh->n_indices > 0) {
+			prev = gl_copy_read_buffer.bind(mesh->vbos[Mesh::INDICES]);
+			mapped = gl_copy_read_buffer.map(GL_READ_ONLY);
+		}
+		for (auto d : mesh->drawCommands) {
+			for (auto &t : d->getTrianglesIndices(mapped)) {
+				// Los triángulos con el índice de reinicio de primitiva no existen
+				if (t.idx[0] < mesh->n_vertices && t.idx[1] < mesh->n_vertices && t.idx[2] < mesh->n_vertices)
+					indices.insert(indices.end(), t.idx, t.idx + 3);
+			}
+		}
+		if (mapped) {
+			gl_copy_read_buffer.unmap();
+			gl_copy_read_buffer.bind(prev);
+		}
+
+		MeshSlot slot;
+		slot.arena = it->second;
+		slot.firstIndex = static_cast<GLuint>(arena.indices.size());
+		slot.count = static_cast<GLuint>(indices.size());
+		slot.baseVertex = static_cast<GLint>(arena.vertices.size());
+		slots[mesh] = slot;
+
+		append(arena.indices, indices);
+		append(arena.vertices, mesh->getVertices());
+		if (attribs & (1 << Mesh::NORMALS))
+			append(arena.normals, mesh->getNormals());
+		if (attribs & (1 << Mesh::COLORS))
+			append(arena.colors, mesh->getColors());
+		if (attribs & (1 << Mesh::TANGENTS))
+			append(arena.tangents, mesh->getTangents());
+		for (uint t = 0; t < NUM_TEX_COORD; t++) {
+			if (attribs & (1 << (Mesh::TEX_COORD0 + t)))
+				append(arena.texCoords[t], mesh->getTexCoords(t));
+		}
+	}
+
+	// Un dibujo por cada aparición de una malla, ordenados por malla combinada y material
+	struct Draw {
+		const MeshSlot *slot;
+		GLuint material;
+		glm::mat4 modelMatrix;
+		BoundingBox bb;
+	};
+	std::vector<Draw> pending;
+	std::map<BaseMaterial *, GLuint> materialIndex;
+	for (auto &item : collector.items) {
+		auto it = slots.find(item.first);
+		if (it == slots.end() || it->second.count == 0)
+			continue;
+		auto material = item.first->getMaterial();
+		auto m = materialIndex.find(material.get());
+		if (m == materialIndex.end()) {
+			m = materialIndex.insert(std::make_pair(material.get(), static_cast<GLuint>(materials.size()))).first;
+			materials.push_back(material);
+		}
+		pending.push_back(Draw{ &it->second, m->second, item.second, item.first->getBB() });
+	}
+	std::stable_sort(pending.begin(), pending.end(), [](const Draw &a, const Draw &b) {
+		return a.slot->arena != b.slot->arena ? a.slot->arena < b.slot->arena : a.material < b.material;
+	});
+
+	std::vector<DrawElementsIndirectCommand> cmds;
+	for (auto &d : pending) {
+		if (groups.empty() || groups.back().arena != d.slot->arena || groups.back().material != materials[d.material]) {
+			Group g;
+			g.arena = d.slot->arena;
+			g.material = materials[d.material];
+			g.first = static_cast<GLuint>(cmds.size());
+			g.count = 0;
+			groups.push_back(g);
+		}
+		groups.back().count++;
+
+		DrawElementsIndirectCommand cmd;
+		cmd.count = d.slot->count;
+		cmd.instanceCount = 1;
+		cmd.firstIndex = d.slot->firstIndex;
+		cmd.baseVertex = d.slot->baseVertex;
+		// El atributo DRAW_INDEX_ATTRIB (con divisor 1) vale baseInstance
+		cmd.baseInstance = static_cast<GLuint>(cmds.size());
+		cmds.push_back(cmd);
+
+		DrawData data;
+		data.modelMatrix = d.modelMatrix;
+		BoundingBox bb = d.bb;
+		bb.transform(d.modelMatrix);
+		// Una esfera con radio negativo no se recorta
+		data.boundingSphere = bb.isValid() ? glm::vec4(bb.getCenter(), glm::length(bb.max - bb.getCenter())) :
+			glm::vec4(0.0f, 0.0f, 0.0f, -1.0f);
+		data.materialIndex = d.material;
+		data.group = static_cast<GLuint>(groups.size() - 1);
+		data.groupFirst = groups.back().first;
+		data.padding = 0;
+		draws.push_back(data);
+	}
+	if (draws.empty())
+		return;
+
+	// Índice de cada dibujo, compartido por las VAO de todas las mallas combinadas
+	std::vector<GLuint> ids(draws.size());
+	for (size_t i = 0; i < ids.size(); i++)
+		ids[i] = static_cast<GLuint>(i);
+	drawIndices = BufferObject::build(ids.size() * sizeof(GLuint), GL_STATIC_DRAW);
+	auto prevArray = gl_array_buffer.bind(drawIndices);
+	gl_array_buffer.write(ids.data());
+	gl_array_buffer.bind(prevArray);
+
+	for (auto &data : arenaData) {
+		MeshBuilder builder;
+		builder.setVertices(data.vertices);
+		if (!data.normals.empty())
+			builder.setNormals(data.normals);
+		if (!data.colors.empty())
+			builder.setColors(data.colors);
+		if (!data.tangents.empty())
+			builder.setTangents(data.tangents);
+		for (uint t = 0; t < NUM_TEX_COORD; t++) {
+			if (!data.texCoords[t].empty())
+				builder.setTexCoords(t, data.texCoords[t]);
+		}
+		builder.setIndices(data.indices);
+		Arena arena;
+		arena.mesh = builder.build();
+		arena.indicesType = builder.getIndicesType();
+		arena.mesh->setIntegerAttribute(DRAW_INDEX_ATTRIB, drawIndices, GL_UNSIGNED_INT, 1);
+		arena.mesh->vao.bind();
+		glVertexAttribDivisor(DRAW_INDEX_ATTRIB, 1);
+		arenas.push_back(arena);
+	}
+
+	commands = BufferObject::build(cmds.size() * sizeof(DrawElementsIndirectCommand), GL_STATIC_DRAW);
+	auto prevIndirect = gl_draw_indirect_buffer.bind(commands);
+	gl_draw_indirect_buffer.write(cmds.data());
+	gl_draw_indirect_buffer.bind(prevIndirect);
+
+	drawData = BufferObject::build(draws.size() * sizeof(DrawData), GL_STATIC_DRAW);
+	gl_shader_storage_buffer.bindBufferBase(drawData, SSBO_DRAW_DATA_BINDING_INDEX);
+	gl_shader_storage_buffer.write(draws.data());
+
+	// Los escribe el shader de recorte
+	culledCommands = BufferObject::build(commands->getSize(), GL_DYNAMIC_COPY);
+	groupCounts = BufferObject::build(groups.size() * sizeof(GLuint), GL_DYNAMIC_COPY);
+	CHECK_GL();
+}
+
+void StaticSceneBatch::cull() {
+	if (!cullProgram) {
+		cullProgram.reset(new Program());
+		cullProgram->replaceString("$" + blockName, definition);
+		cullProgram->loadComputeStrings({
+			"#version 430",
+			"layout (local_size_x = " + std::to_string(CULL_GROUP_SIZE) + ") in;",
+			"$DrawData",
+			"struct Command {",
+			"  uint count;",
+			"  uint instanceCount;",
+			"  uint firstIndex;",
+			"  int baseVertex;",
+			"  uint baseInstance;",
+			"};",
+			"layout (std430, binding=" + std::to_string(CULL_INPUT_BINDING) + ") readonly buffer InputCommands {",
+			"  Command inputCommands[];",
+			"};",
+			"layout (std430, binding=" + std::to_string(CULL_OUTPUT_BINDING) + ") writeonly buffer OutputCommands {",
+			"  Command outputCommands[];",
+			"};",
+			"layout (std430, binding=" + std::to_string(CULL_COUNTS_BINDING) + ") buffer GroupCounts {",
+			"  uint groupCounts[];",
+			"};",
+			"uniform vec4 planes[6];",
+			"uniform uint numDraws;",
+			"void main() {",
+			"  uint i = gl_GlobalInvocationID.x;",
+			"  if (i >= numDraws) return;",
+			"  vec4 s = drawData[i].boundingSphere;",
+			"  if (s.w >= 0.0) {",
+			"    for (int p = 0; p < 6; p++)",
+			"      if (dot(planes[p].xyz, s.xyz) + planes[p].w < -s.w) return;",
+			"  }",
+			"  uint slot = atomicAdd(groupCounts[drawData[i].group], 1u);",
+			"  outputCommands[drawData[i].groupFirst + slot] = inputCommands[i];",
+			"}"
+		});
+		cullProgram->compile();
+		cullPlanes = cullProgram->getUniform<glm::vec4>("planes");
+		cullNumDraws = cullProgram->getUniform<GLuint>("numDraws");
+	}
+
+	// Los planos en el sistema de coordenadas de la escena
+	auto mats = std::static_pointer_cast<GLMatrices>(gl_uniform_buffer.getBound(UBO_GL_MATRICES_BINDING_INDEX));
+	const Frustum frustum(mats->getMatrix(GLMatrices::MODELVIEWPROJ_MATRIX));
+	cullPlanes.set(frustum.planes, 6);
+	cullNumDraws = static_cast<GLuint>(draws.size());
+
+	// Los comandos que no se escriban tendrán 0 instancias
+	gl_shader_storage_buffer.bindBufferBase(culledCommands, CULL_OUTPUT_BINDING);
+	glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+	gl_shader_storage_buffer.bindBufferBase(groupCounts, CULL_COUNTS_BINDING);
+	glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+	gl_shader_storage_buffer.bindBufferBase(commands, CULL_INPUT_BINDING);
+	gl_shader_storage_buffer.bindBufferBase(drawData, SSBO_DRAW_DATA_BINDING_INDEX);
+
+	Program *prev = cullProgram->use();
+	glDispatchCompute((static_cast<GLuint>(draws.size()) + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1, 1);
+	glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+	if (prev)
+		prev->use();
+	else
+		cullProgram->unUse();
+}
+
+void StaticSceneBatch::render() {
+	PGUPV_PROFILE_ZONE("StaticSceneBatch::render");
+	if (!draws.empty()) {
+		GLMatrices::flushPending();
+		if (gpuCulling)
+			cull();
+		gl_shader_storage_buffer.bindBufferBase(drawData, SSBO_DRAW_DATA_BINDING_INDEX);
+		auto prevIndirect = gl_draw_indirect_buffer.bind(gpuCulling ? culledCommands : commands);
+		// Con GL_ARB_indirect_parameters se dibujan sólo los comandos que ha escrito el recorte
+		const bool drawCount = gpuCulling && GLEW_ARB_indirect_parameters;
+		if (drawCount)
+			glBindBuffer(GL_PARAMETER_BUFFER_ARB, groupCounts->getId());
+
+		size_t currentArena = arenas.size();
+		BaseMaterial *currentMaterial = nullptr;
+		for (size_t g = 0; g < groups.size(); g++) {
+			const Group &group = groups[g];
+			const Arena &arena = arenas[group.arena];
+			if (group.arena != currentArena) {
+				arena.mesh->vao.bind();
+				currentArena = group.arena;
+			}
+			// Como en Mesh::render, una malla sin material usa el último establecido
+			if (group.material && group.material.get() != currentMaterial) {
+				group.material->use();
+				currentMaterial = group.material.get();
+			}
+			const void *offset = reinterpret_cast<const void *>(group.first * sizeof(DrawElementsIndirectCommand));
+			if (drawCount)
+				glMultiDrawElementsIndirectCountARB(GL_TRIANGLES, arena.indicesType, offset,
+					static_cast<GLintptr>(g * sizeof(GLuint)), group.count, 0);
+			else
+				glMultiDrawElementsIndirect(GL_TRIANGLES, arena.indicesType, offset, group.count, 0);
+		}
+		if (drawCount)
+			glBindBuffer(GL_PARAMETER_BUFFER_ARB, 0);
+		gl_draw_indirect_buffer.bind(prevIndirect);
+	}
+	CHECK_GL();
+}
+
+void StaticSceneBatch::renderSeparateMeshes() {
+	if (!separate.empty()) {
+		auto mats = std::static_pointer_cast<GLMatrices>(gl_uniform_buffer.getBound(UBO_GL_MATRICES_BINDING_INDEX));
+		for (auto &s : separate) {
+			mats->pushMatrix(GLMatrices::MODEL_MATRIX);
+			mats->multMatrix(GLMatrices::MODEL_MATRIX, s.modelMatrix);
+			s.mesh->render();
+			mats->popMatrix(GLMatrices::MODEL_MATRIX);
+		}
+	}
+	CHECK_GL();
+}
@@ -3,6 +3,8 @@
 #include "program.h"
 #include "mesh.h"
 #include "glMatrices.h"
+#include "instancedModel.h"
+#include "staticSceneBatch.h"
 
 using namespace PGUPV;
 
@@ -32,6 +34,113 @@ void PGUPV::buildConstantShading(Program &program) {
 	program.loadStrings(vtxShaderSrc, frgShaderSrc);
 }
 
+void PGUPV::buildConstantShadingInstanced(Program &program) {
+	program.addAttributeLocation(Mesh::VERTICES, "position");
+	program.addAttributeLocation(Mesh::COLORS, "vertcolor");
+	program.replaceString("$" + PGUPV::GLMatrices::blockName, PGUPV::GLMatrices::definition);
+	program.replaceString("$" + PGUPV::InstancedModel::blockName, PGUPV::InstancedModel::definition);
+	std::vector<std::string> vtxShaderSrc{
+	  "#version 430",
+	  "$GLMatrices",
+	  "$Instances",
+	  "in vec4 position;",
+	  "in vec4 vertcolor;",
+	  "out vec4 fragcolor;",
+	  "void main() {",
+	  "  fragcolor = vertcolor * instances[gl_InstanceID].data;",
+	  "  gl_Position = modelviewprojMatrix * instances[gl_InstanceID].modelMatrix * position;",
+	  "}"
+	};
+	std::vector<std::string> frgShaderSrc{
+	  "#version 430",
+	  "in vec4 fragcolor;",
+	  "out vec4 final_color;",
+	  "void main() {",
+	  "  final_color = fragcolor;",
+	  "}"
+	};
+	program.loadStrings(vtxShaderSrc, frgShaderSrc);
+}
+
+void PGUPV::buildConstantShadingBatch(Program &program) {
+	program.addAttributeLocation(Mesh::VERTICES, "position");
+	program.addAttributeLocation(Mesh::COLORS, "vertcolor");
+	program.addAttributeLocation(StaticSceneBatch::DRAW_INDEX_ATTRIB, "drawIndex");
+	program.replaceString("$" + PGUPV::GLMatrices::blockName, PGUPV::GLMatrices::definition);
+	program.replaceString("$" + PGUPV::StaticSceneBatch::blockName, PGUPV::StaticSceneBatch::definition);
+	std::vector<std::string> vtxShaderSrc{
+	  "#version 430",
+	  "$GLMatrices",
+	  "$DrawData",
+	  "in vec4 position;",
+	  "in vec4 vertcolor;",
+	  "in uint drawIndex;",
+	  "out vec4 fragcolor;",
+	  "void main() {",
+	  "  fragcolor = vertcolor;",
+	  "  gl_Position = modelviewprojMatrix * drawData[drawIndex].modelMatrix * position;",
+	  "}"
+	};
+	std::vector<std::string> frgShaderSrc{
+	  "#version 430",
+	  "in vec4 fragcolor;",
+	  "out vec4 final_color;",
+	  "void main() {",
+	  "  final_color = fragcolor;",
+	  "}"
+	};
+	program.loadStrings(vtxShaderSrc, frgShaderSrc);
+}
+
+void PGUPV::buildTextBatch(Program &program) {
+	program.addAttributeLocation(Mesh::VERTICES, "anchor");
+	program.addAttributeLocation(Mesh::TEX_COORD1, "offset");
+	program.addAttributeLocation(Mesh::TEX_COORD0, "texCoord");
+	program.addAttributeLocation(Mesh::COLORS, "color");
+	program.replaceString("$" + PGUPV::GLMatrices::blockName, PGUPV::GLMatrices::definition);
+	std::vector<std::string> vtxShaderSrc{
+	  "#version 420 core",
+	  "$GLMatrices",
+	  "in vec4 anchor;",
+	  "in vec2 offset;",
+	  "in vec2 texCoord;",
+	  "in vec4 color;",
+	  "uniform vec2 viewportSize;",
+	  "uniform sampler2D atlas;",
+	  "out vec2 texCoordFrag;",
+	  "out vec4 colorFrag;",
+	  "void main() {",
+	  "  texCoordFrag = texCoord / vec2(textureSize(atlas, 0));",
+	  "  colorFrag = color;",
+	  "  vec2 toNDC = 2.0 / viewportSize;",
+	  "  if (anchor.w == 0.0)",
+	  "    gl_Position = vec4((anchor.xy + offset) * toNDC - 1.0, 0.0, 1.0);",
+	  "  else {",
+	  "    gl_Position = modelviewprojMatrix * vec4(anchor.xyz, 1.0);",
+	  "    gl_Position.xy += offset * toNDC * gl_Position.w;",
+	  "  }",
+	  "}"
+	};
+	std::vector<std::string> frgShaderSrc{
+	  "#version 420 core",
+	  "uniform sampler2D atlas;",
+	  "uniform bool sdf;",
+	  "in vec2 texCoordFrag;",
+	  "in vec4 colorFrag;",
+	  "out vec4 fragColor;",
+	  "void main() {",
+	  "  float a = texture(atlas, texCoordFrag).r;",
+	  "  if (sdf) {",
+	  "    float w = max(fwidth(a), 0.0001);",
+	  "    a = smoothstep(0.5 - w, 0.5 + w, a);",
+	  "  }",
+	  "  if (a == 0.0) discard;",
+	  "  fragColor = vec4(colorFrag.rgb, colorFrag.a * a);",
+	  "}"
+	};
+	program.loadStrings(vtxShaderSrc, frgShaderSrc);
+}
+
 int TextureReplaceProgram::currentTexUnit;
 
 int TextureReplaceProgram::setTextureUnit(int texUnit) {
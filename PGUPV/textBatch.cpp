@@ -0,0 +1,158 @@
+#include <cstddef>
+
+#include "textBatch.h"
+#include "mesh.h"
+#include "font.h"
+#include "texture2D.h"
+#include "bufferObject.h"
+#include "bindingPoint.h"
+#include "glMatrices.h"
+#include "glStateCache.h"
+#include "stockPrograms.h"
+#include "program.h"
+#include "app.h"
+#include "profiler.h"
+#include "utils.h"
+#include "log.h"
+
+using PGUPV::TextBatch;
+using PGUPV::GlyphAtlas;
+
+TextBatch::TextBatch(std::shared_ptr<GlyphAtlas> atlas) :
+	atlas(atlas ? atlas : GlyphAtlas::get(Font::getDefaultFont())), dirty(false) {
+}
+
+TextBatch::~TextBatch() {
+}
+
+glm::vec2 TextBatch::addText(const std::string &text, const glm::vec2 &pos, const glm::vec4 &color,
+	float scale, uint wrapWidth) {
+	quads.clear();
+	const glm::vec2 size = atlas->layout(text, quads, wrapWidth, scale);
+	addQuads(glm::vec4(pos, 0.0f, 0.0f), glm::vec2(0.0f), color);
+	return size;
+}
+
+glm::vec2 TextBatch::addLabel(const std::string &text, const glm::vec3 &anchor, const glm::vec4 &color,
+	const glm::vec2 &offset, float scale) {
+	quads.clear();
+	const glm::vec2 size = atlas->layout(text, quads, 0, scale);
+	// La esquina superior izquierda, para que la base del texto quede centrada sobre el punto
+	addQuads(glm::vec4(anchor, 1.0f), offset + glm::vec2(-0.5f * size.x, size.y), color);
+	return size;
+}
+
+void TextBatch::addQuads(const glm::vec4 &anchor, const glm::vec2 &origin, const glm::vec4 &color) {
+	for (const auto &q : quads) {
+		// El layout tiene la y hacia abajo, y la ventana hacia arriba
+		const glm::vec2 corners[4][2] = {
+			{ glm::vec2(q.min.x, -q.min.y), glm::vec2(q.uvMin.x, q.uvMin.y) },
+			{ glm::vec2(q.min.x, -q.max.y), glm::vec2(q.uvMin.x, q.uvMax.y) },
+			{ glm::vec2(q.max.x, -q.max.y), glm::vec2(q.uvMax.x, q.uvMax.y) },
+			{ glm::vec2(q.max.x, -q.min.y), glm::vec2(q.uvMax.x, q.uvMin.y) },
+		};
+		for (const auto &c : corners) {
+			Vertex v;
+			v.anchor = anchor;
+			v.offset = origin + c[0];
+			v.texCoord = c[1];
+			v.color = color;
+			vertices.push_back(v);
+		}
+	}
+	dirty = true;
+}
+
+void TextBatch::clear() {
+	vertices.clear();
+	dirty = true;
+}
+
+void TextBatch::upload() {
+	if (!dirty)
+		return;
+	const size_t size = vertices.size() * sizeof(Vertex);
+	bool newBuffer = false;
+	if (!vbo || vbo->getSize() < size) {
+		// Como en InstancedModel, se reserva el doble para los textos que crecen
+		vbo = BufferObject::build(2 * size, GL_DYNAMIC_DRAW);
+		newBuffer = true;
+	}
+	auto prev = gl_array_buffer.bind(vbo);
+	// Se abandona el contenido anterior, para no esperar a que termine el dibujo que lo usa.
+	// glBufferData con nullptr, y no glInvalidateBufferData, que necesita OpenGL 4.3 (y
+	// TextOverlay, que usa esta clase, funciona con contextos más antiguos)
+	if (!newBuffer)
+		glBufferData(GL_ARRAY_BUFFER, vbo->getSize(), nullptr, GL_DYNAMIC_DRAW);
+	gl_array_buffer.write(vertices.data(), static_cast<ulong>(size), 0);
+
+	vao.bind();
+	if (newBuffer) {
+		glEnableVertexAttribArray(Mesh::VERTICES);
+		glVertexAttribPointer(Mesh::VERTICES, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+			reinterpret_cast<const void *>(offsetof(Vertex, anchor)));
+		glEnableVertexAttribArray(Mesh::TEX_COORD1);
+		glVertexAttribPointer(Mesh::TEX_COORD1, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+			reinterpret_cast<const void *>(offsetof(Vertex, offset)));
+		glEnableVertexAttribArray(Mesh::TEX_COORD0);
+		glVertexAttribPointer(Mesh::TEX_COORD0, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+			reinterpret_cast<const void *>(offsetof(Vertex, texCoord)));
+		glEnableVertexAttribArray(Mesh::COLORS);
+		glVertexAttribPointer(Mesh::COLORS, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+			reinterpret_cast<const void *>(offsetof(Vertex, color)));
+	}
+	// Los índices sólo dependen del número de rectángulos que caben en el buffer de vértices
+	const size_t maxQuads = vbo->getSize() / (4 * sizeof(Vertex));
+	if (!ibo || ibo->getSize() < maxQuads * 6 * sizeof(GLuint)) {
+		std::vector<GLuint> indices;
+		indices.reserve(maxQuads * 6);
+		for (GLuint q = 0; q < maxQuads; q++) {
+			const GLuint quad[] = { 4 * q, 4 * q + 1, 4 * q + 2, 4 * q, 4 * q + 2, 4 * q + 3 };
+			indices.insert(indices.end(), quad, quad + 6);
+		}
+		ibo = BufferObject::build(indices.size() * sizeof(GLuint), GL_STATIC_DRAW);
+		gl_element_array_buffer.bind(ibo);
+		gl_element_array_buffer.write(indices.data());
+	}
+	gl_array_buffer.bind(prev);
+	dirty = false;
+}
+
+void TextBatch::render() {
+	if (vertices.empty())
+		return;
+	PGUPV_PROFILE_ZONE("TextBatch::render");
+	upload();
+	auto texture = atlas->getTexture();
+	GLMatrices::flushPending();
+
+	PGUPV::GLStateCapturer<PGUPV::BlendingState> blendSt;
+	PGUPV::GLStateCapturer<PGUPV::PolygonModeState> polygonMode;
+	PGUPV::GLStateCapturer<PGUPV::ActiveTextureUnitState> activeTextureUnit;
+	PGUPV::DepthTestState depthTest;
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	glDisable(GL_DEPTH_TEST);
+	glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+
+	GLint viewport[4];
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	const GLint texUnit = App::getScratchUnitTextureNumber();
+	texture->bind(GL_TEXTURE0 + texUnit);
+
+	Program &program = TextBatchProgram::getProgram();
+	Program *prevProg = program.use();
+	program.getUniform<glm::vec2>("viewportSize") = glm::vec2(viewport[2], viewport[3]);
+	program.getUniform<GLint>("atlas") = texUnit;
+	program.getUniform<GLint>("sdf") = atlas->getMode() == GlyphAtlas::Mode::SDF ? 1 : 0;
+
+	vao.bind();
+	glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(getNumGlyphs() * 6), GL_UNSIGNED_INT, nullptr);
+
+	if (prevProg != nullptr)
+		prevProg->use();
+	else
+		program.unUse();
+	depthTest.restore();
+	CHECK_GL();
+}
@@ -1,5 +1,6 @@
 
 
+#include <algorithm>
 #include <glm/gtc/matrix_transform.hpp>
 #include <GL/glew.h>
 
@@ -8,7 +9,8 @@
 #include "indexedBindingPoint.h"
 #include "glMatrices.h"
 #include "glStateCache.h"
-#include "textureText.h"
+#include "textBatch.h"
+#include "font.h"
 #include "stockModels.h"
 #include "stockPrograms.h"
 #include "program.h"
@@ -16,20 +18,23 @@
 using PGUPV::TextOverlay;
 
 
-TextOverlay::TextOverlay(const std::string &text) : maxWidth(0) {
+// Ancho mximo de las lneas, en pxeles de la fuente
+static const uint WRAP_WIDTH = 400;
+
+TextOverlay::TextOverlay(const std::string &text) : maxWidth(0), layoutScale(0.0f) {
+  textHelp = std::make_shared<TextBatch>(GlyphAtlas::get(Font::loadFont(DEFAULT_FONT, 14)));
+  background = std::make_shared<Rect>(1.1f, 1.1f, glm::vec4(.2f, .2f, .2f, 0.7f));
   setText(text);
 }
 
 void TextOverlay::setText(const std::string &text) {
-  PGUPV::TextureTextBuilder tb;
-  textHelp = tb.text(text).font(Font::loadFont("../recursos/fuentes/FreeSans.ttf", 14)).wrapWidth(400).
-    foregroundColor(glm::vec4(.9f, .9f, .9f, 1.0f)).build();
-  float invAspectRatio = float(textHelp->getHeight()) / textHelp->getWidth();
-  textWidth = textHelp->getWidth();
-  textHeight = textHelp->getHeight();
-  overlay = std::unique_ptr<Rect>(new Rect(1.0f, invAspectRatio));
-  background = std::unique_ptr<Rect>(new Rect(1.1f, 1.1f * invAspectRatio, glm::vec4(.2f, .2f, .2f, 0.7f)));
-
+  // Los glifos ya estn en el atlas: slo hay que medir el texto, y colocarlo en el siguiente render
+  this->text = text;
+  std::vector<GlyphAtlas::Quad> quads;
+  glm::vec2 size = textHelp->getAtlas()->layout(text, quads, WRAP_WIDTH);
+  textWidth = std::max(1u, static_cast<uint>(size.x));
+  textHeight = std::max(1u, static_cast<uint>(size.y));
+  layoutScale = 0.0f;
 }
 
 void TextOverlay::setMaxWidth(unsigned int maxW) {
@@ -72,16 +77,18 @@ void TextOverlay::render() {
   auto prevProg = PGUPV::ConstantIllumProgram::use();
   background->render();
 
-  PGUPV::TextureReplaceProgram::use();
-  int prevTU = PGUPV::TextureReplaceProgram::setTextureUnit(App::getScratchUnitTextureNumber());
-  textHelp->bind(GL_TEXTURE0 + App::getScratchUnitTextureNumber());
-
-  mats->pushMatrix(GLMatrices::MODEL_MATRIX);
-  mats->translate(GLMatrices::MODEL_MATRIX, 0.0f, 0.0f, 0.0001f);
-  overlay->render();
-  mats->popMatrix(GLMatrices::MODEL_MATRIX);
-
-  PGUPV::TextureReplaceProgram::setTextureUnit(prevTU);
+  // El texto ocupa el centro del viewport (1/1.2 de su tamao, por la proyeccin). Slo se
+  // vuelve a colocar si cambia el tamao de la ventana o el texto
+  GLint vp[4];
+  glGetIntegerv(GL_VIEWPORT, vp);
+  const float scale = vp[2] / (1.2f * textWidth);
+  if (scale != layoutScale) {
+    textHelp->clear();
+    const glm::vec2 topLeft(vp[2] * (0.5f - 0.5f / 1.2f), vp[3] * (0.5f + 0.5f / 1.2f));
+    textHelp->addText(text, topLeft, glm::vec4(.9f, .9f, .9f, 1.0f), scale, WRAP_WIDTH);
+    layoutScale = scale;
+  }
+  textHelp->render();
 
   if (prevProg != nullptr) 
     prevProg->use();
@@ -0,0 +1,97 @@
+#include <algorithm>
+
+#include "textureCache.h"
+#include "texture2D.h"
+#include "textureGenerator.h"
+#include "image.h"
+#include "utils.h"
+#include "log.h"
+
+using PGUPV::TextureCache;
+using PGUPV::Texture2D;
+
+// std::max recibe referencias, así que necesita una definición (C++14)
+const size_t TextureCache::MIN_PURGE_THRESHOLD;
+
+TextureCache &TextureCache::getInstance()
+{
+	static TextureCache cache;
+	return cache;
+}
+
+std::shared_ptr<Texture2D> TextureCache::find(const Key &key)
+{
+	std::lock_guard<std::mutex> lock{ m };
+	auto it = textures.find(key);
+	if (it == textures.end())
+		return nullptr;
+	return it->second.lock();
+}
+
+void TextureCache::insert(const Key &key, std::shared_ptr<Texture2D> texture)
+{
+	std::lock_guard<std::mutex> lock{ m };
+	textures[key] = texture;
+	if (textures.size() >= purgeThreshold) {
+		purge();
+		purgeThreshold = std::max(MIN_PURGE_THRESHOLD, 2 * textures.size());
+	}
+}
+
+std::shared_ptr<Texture2D> TextureCache::load(const Key &key)
+{
+	auto texture = find(key);
+	if (texture)
+		return texture;
+
+	if (!PGUPV::fileExists(key.path))
+		return nullptr;
+	PGUPV::Image image(key.path);
+	return create(key, image);
+}
+
+std::shared_ptr<Texture2D> TextureCache::create(const Key &key, const Image &image)
+{
+	auto texture = std::make_shared<Texture2D>(key.minFilter, key.magFilter, key.wrapS, key.wrapT);
+	texture->loadImage(image, key.internalFormat);
+	texture->setName(PGUPV::getFilenameFromPath(key.path));
+	if (key.minFilter != GL_NEAREST && key.minFilter != GL_LINEAR)
+		texture->generateMipmap();
+	insert(key, texture);
+	return texture;
+}
+
+std::shared_ptr<Texture2D> TextureCache::getFallback()
+{
+	std::lock_guard<std::mutex> lock{ m };
+	auto texture = fallback.lock();
+	if (!texture) {
+		texture.reset(PGUPV::TextureGenerator::makeChecker(glm::vec4(1.0f, 1.0f, 1.0f, 1.0f), glm::vec4(1.0f, 0.0f, 1.0f, 1.0f)));
+		fallback = texture;
+	}
+	return texture;
+}
+
+size_t TextureCache::size()
+{
+	std::lock_guard<std::mutex> lock{ m };
+	purge();
+	return textures.size();
+}
+
+void TextureCache::clear()
+{
+	std::lock_guard<std::mutex> lock{ m };
+	textures.clear();
+	purgeThreshold = MIN_PURGE_THRESHOLD;
+}
+
+void TextureCache::purge()
+{
+	for (auto it = textures.begin(); it != textures.end(); ) {
+		if (it->second.expired())
+			it = textures.erase(it);
+		else
+			++it;
+	}
+}
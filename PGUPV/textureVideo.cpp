@@ -1,9 +1,11 @@
 #include "textureVideo.h"
+#include "bindingPoint.h"
 #include "videoFile.h"
 #include "videoDevice.h"
 #include "utils.h"
 #include "app.h"
 #include "log.h"
+#include "profiler.h"
 
 using PGUPV::TextureVideo;
 using media::Media;
@@ -11,7 +13,8 @@ using media::VideoFile;
 using media::VideoDevice;
 
 
-TextureVideo::TextureVideo(const std::string &path) : status(Status::PLAYING), updateCallbackId(static_cast<size_t>(-1)) {
+TextureVideo::TextureVideo(const std::string &path) : status(Status::PLAYING), updateCallbackId(static_cast<size_t>(-1)),
+	frameInUse(nullptr), uploadFence(nullptr) {
 	media = std::unique_ptr<VideoFile>(new VideoFile(path));
   media->setAutoLoop(true);
 	init();
@@ -20,7 +23,8 @@ TextureVideo::TextureVideo(const std::string &path) : status(Status::PLAYING), u
 }
 
 
-TextureVideo::TextureVideo(int camId, int confId, float fps) : status(Status::PLAYING), updateCallbackId(static_cast<size_t>(-1)) {
+TextureVideo::TextureVideo(int camId, int confId, float fps) : status(Status::PLAYING), updateCallbackId(static_cast<size_t>(-1)),
+	frameInUse(nullptr), uploadFence(nullptr) {
 	media = std::unique_ptr<VideoDevice>(new VideoDevice(camId, confId, fps));
 	init();
 	INFO("Nuevo TextureVideo (Cámara " + std::to_string(camId) + ") " + std::to_string(reinterpret_cast<std::uint64_t>(this)));
@@ -28,20 +32,41 @@ TextureVideo::TextureVideo(int camId, int confId, float fps) : status(Status::PL
 
 TextureVideo::~TextureVideo() {
 	unregisterCallback();
+	if (media) {
+		// El hilo decodificador puede estar escribiendo en los PBOs
+		releaseFrame();
+		media->stopDecodingThread();
+	}
+	destroyPBOs();
 	INFO("TextureVideo destruido " + std::to_string(reinterpret_cast<std::uint64_t>(this)));
 }
 
 TextureVideo::TextureVideo(TextureVideo &&other) :
-	media(std::move(other.media)), status(other.status)
+	media(std::move(other.media)), status(other.status), updateCallbackId(static_cast<size_t>(-1)),
+	pbos(std::move(other.pbos)), pboMemory(std::move(other.pboMemory)), frameInUse(other.frameInUse),
+	uploadFence(other.uploadFence)
 {
 	other.unregisterCallback();
+	other.frameInUse = nullptr;
+	other.uploadFence = nullptr;
 	init();
 }
 
 TextureVideo &TextureVideo::operator=(TextureVideo &&other) {
 	other.unregisterCallback();
+	if (media) {
+		releaseFrame();
+		media->stopDecodingThread();
+	}
+	destroyPBOs();
 	media = std::move(other.media);
 	status = other.status;
+	pbos = std::move(other.pbos);
+	pboMemory = std::move(other.pboMemory);
+	frameInUse = other.frameInUse;
+	uploadFence = other.uploadFence;
+	other.frameInUse = nullptr;
+	other.uploadFence = nullptr;
 	init();
 	return *this;
 }
@@ -50,20 +75,105 @@ TextureVideo &TextureVideo::operator=(TextureVideo &&other) {
 void PGUPV::TextureVideo::update()
 {
 	assert(status == Status::PLAYING);
-	auto bytes = media->getNextFrame(true);
-	if (bytes != nullptr) {
-		bind();
+	PGUPV_PROFILE_ZONE("TextureVideo::update");
+	uploadFrame();
+}
+
+void TextureVideo::uploadFrame() {
+	// Normalmente, la GPU ya habrá terminado de copiar el fotograma anterior
+	releaseFrame();
+
+	// El hilo de media decodifica los fotogramas: aquí sólo se sube el último que toca mostrar
+	auto bytes = media->lockFrame();
+	if (bytes == nullptr)
+		return;
+
+	bind();
+	// Las filas de los fotogramas RGB24 no están alineadas a 4 bytes
+	GLint alignment;
+	glGetIntegerv(GL_UNPACK_ALIGNMENT, &alignment);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	if (pbos.empty()) {
 		glTexSubImage2D(_texture_type, 0, 0, 0, _width, _height, GL_RGB, GL_UNSIGNED_BYTE, bytes);
+		media->unlockFrame();
+	}
+	else {
+		size_t i = 0;
+		while (pboMemory[i] != bytes)
+			i++;
+		auto prev = gl_pixel_unpack_buffer.bind(pbos[i]);
+		glTexSubImage2D(_texture_type, 0, 0, 0, _width, _height, GL_RGB, GL_UNSIGNED_BYTE, nullptr);
+		gl_pixel_unpack_buffer.bind(prev);
+		// El decodificador no puede reutilizar el buffer hasta que la GPU lo haya leído
+		frameInUse = bytes;
+		uploadFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
 	}
+	glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
+}
+
+void TextureVideo::releaseFrame() {
+	if (!frameInUse)
+		return;
+	if (uploadFence) {
+		while (glClientWaitSync(uploadFence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED)
+			;
+		glDeleteSync(uploadFence);
+		uploadFence = nullptr;
+	}
+	media->unlockFrame();
+	frameInUse = nullptr;
+}
+
+void TextureVideo::startDecoding() {
+	if (!GLEW_ARB_buffer_storage) {
+		media->startDecodingThread(true, NUM_FRAMES);
+		return;
+	}
+
+	const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	const ulong size = 3UL * media->getWidth() * media->getHeight();
+	auto prev = gl_pixel_unpack_buffer.unbind();
+	for (unsigned int i = 0; i < NUM_FRAMES; i++) {
+		auto pbo = BufferObject::buildImmutable(size, flags);
+		gl_pixel_unpack_buffer.bind(pbo);
+		auto ptr = static_cast<uint8_t *>(gl_pixel_unpack_buffer.map(0, size, flags));
+		if (ptr == nullptr) {
+			WARN("No se han podido mapear los PBOs del vídeo. Se usará memoria de la CPU");
+			gl_pixel_unpack_buffer.bind(prev);
+			destroyPBOs();
+			media->startDecodingThread(true, NUM_FRAMES);
+			return;
+		}
+		pbos.push_back(pbo);
+		pboMemory.push_back(ptr);
+	}
+	gl_pixel_unpack_buffer.bind(prev);
+	media->startDecodingThread(true, pboMemory);
+}
+
+void TextureVideo::destroyPBOs() {
+	if (pbos.empty())
+		return;
+	auto prev = gl_pixel_unpack_buffer.unbind();
+	for (size_t i = 0; i < pboMemory.size(); i++) {
+		gl_pixel_unpack_buffer.bind(pbos[i]);
+		gl_pixel_unpack_buffer.unmap();
+	}
+	gl_pixel_unpack_buffer.bind(prev);
+	pbos.clear();
+	pboMemory.clear();
 }
 
 void TextureVideo::init() {
 	allocate(media->getWidth(), media->getHeight(), GL_RGBA);
+	if (!media->isDecodingThreadRunning())
+		startDecoding();
 	registerCallback();
 	update();
 }
 
 void TextureVideo::pause(bool pause) {
+	media->setPaused(pause);
 	if (pause) {
 		unregisterCallback();
 		status = Status::PAUSE;
@@ -80,8 +190,27 @@ bool TextureVideo::isPaused() {
 void PGUPV::TextureVideo::rewind()
 {
 	auto videoFile = dynamic_cast<VideoFile *>(media.get());
-	if (videoFile)
+	if (videoFile) {
+		releaseFrame();
 		videoFile->rewind();
+	}
+}
+
+void TextureVideo::seek(double seconds) {
+	if (!dynamic_cast<VideoFile *>(media.get()))
+		return;
+	// Al saltar se reinicia el hilo decodificador, que no debe tener ningún fotograma bloqueado
+	releaseFrame();
+	media->seek(seconds);
+	// En pausa no se llama a update, así que mostramos aquí el fotograma al que hemos saltado
+	if (status == Status::PAUSE)
+		uploadFrame();
+}
+
+void TextureVideo::step() {
+	media->step();
+	if (status == Status::PAUSE)
+		uploadFrame();
 }
 
 void TextureVideo::registerCallback() {
@@ -0,0 +1,135 @@
+#include <algorithm>
+#include <atomic>
+#include <exception>
+
+#include "threadPool.h"
+
+using PGUPV::ThreadPool;
+
+ThreadPool::ThreadPool(unsigned int numThreads) : done(false)
+{
+	start(numThreads);
+}
+
+ThreadPool::~ThreadPool()
+{
+	stop();
+}
+
+ThreadPool & ThreadPool::getInstance()
+{
+	static ThreadPool pool;
+	return pool;
+}
+
+void ThreadPool::resize(unsigned int numThreads)
+{
+	stop();
+	start(numThreads);
+}
+
+void ThreadPool::start(unsigned int numThreads)
+{
+	if (numThreads == 0)
+		numThreads = std::max(1U, std::thread::hardware_concurrency());
+	done = false;
+	for (unsigned int i = 0; i < numThreads; i++) {
+		workers.emplace_back(&ThreadPool::workerLoop, this);
+	}
+}
+
+void ThreadPool::stop()
+{
+	{
+		std::lock_guard<std::mutex> lock{ m };
+		done = true;
+	}
+	cv.notify_all();
+	for (auto &w : workers) {
+		w.join();
+	}
+	workers.clear();
+}
+
+void ThreadPool::enqueue(std::function<void()> task)
+{
+	{
+		std::lock_guard<std::mutex> lock{ m };
+		tasks.push_back(std::move(task));
+	}
+	cv.notify_one();
+}
+
+void ThreadPool::workerLoop()
+{
+	for (;;) {
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> lock{ m };
+			cv.wait(lock, [this]() { return done || !tasks.empty(); });
+			// Se terminan las tareas pendientes antes de salir
+			if (tasks.empty())
+				return;
+			task = std::move(tasks.front());
+			tasks.pop_front();
+		}
+		task();
+	}
+}
+
+namespace {
+	// Estado compartido de un parallelFor. Los ayudantes pueden empezar después de que
+	// haya terminado la llamada, así que no pueden usar variables de su pila
+	struct ParallelForState {
+		ParallelForState(size_t count, const std::function<void(size_t)> &f) : n(count), op(f), next(0), finished(0) {}
+		const size_t n;
+		const std::function<void(size_t)> op;
+		std::atomic<size_t> next, finished;
+		std::mutex m;
+		std::condition_variable cv;
+		std::exception_ptr error;
+
+		void run() {
+			size_t i;
+			while ((i = next++) < n) {
+				try {
+					op(i);
+				}
+				catch (...) {
+					std::lock_guard<std::mutex> lock{ m };
+					if (!error)
+						error = std::current_exception();
+				}
+				if (++finished == n) {
+					std::lock_guard<std::mutex> lock{ m };
+					cv.notify_all();
+				}
+			}
+		}
+	};
+};
+
+void ThreadPool::parallelFor(size_t n, const std::function<void(size_t)>& op)
+{
+	if (n == 0)
+		return;
+	if (n == 1 || workers.empty()) {
+		for (size_t i = 0; i < n; i++)
+			op(i);
+		return;
+	}
+
+	auto state = std::make_shared<ParallelForState>(n, op);
+	const size_t helpers = std::min(n - 1, workers.size());
+	for (size_t i = 0; i < helpers; i++) {
+		enqueue([state]() { state->run(); });
+	}
+	// El hilo que llama también trabaja, así que esto termina aunque todos los
+	// trabajadores estén ocupados (p.e., si se llama desde una tarea)
+	state->run();
+
+	std::unique_lock<std::mutex> lock{ state->m };
+	state->cv.wait(lock, [&state]() { return state->finished == state->n; });
+	if (state->error)
+		std::rethrow_exception(state->error);
+}
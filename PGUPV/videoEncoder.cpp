@@ -0,0 +1,214 @@
+extern "C" {
+#include <libavformat/avformat.h>
+#include <libavcodec/avcodec.h>
+#include <libavutil/imgutils.h>
+#include <libswscale/swscale.h>
+}
+
+#include <cstring>
+#include <stdexcept>
+
+#include "videoEncoder.h"
+#include "log.h"
+
+using media::VideoEncoder;
+
+static std::string avError(int code) {
+	char buf[AV_ERROR_MAX_STRING_SIZE] = {};
+	av_strerror(code, buf, sizeof(buf));
+	return buf;
+}
+
+VideoEncoder::VideoEncoder(const std::string &path, unsigned int width, unsigned int height, unsigned int fps) :
+	path(path), width(width), height(height), numFrames(0), formatCtx(nullptr), codecCtx(nullptr),
+	stream(nullptr), frame(nullptr), swsCtx(nullptr), nextPts(0), done(false), finished(false) {
+	av_register_all();
+
+	if (avformat_alloc_output_context2(&formatCtx, nullptr, nullptr, path.c_str()) < 0 || !formatCtx)
+		throw std::runtime_error("No se reconoce el formato de vídeo del fichero " + path);
+	AVCodec *codec = avcodec_find_encoder(formatCtx->oformat->video_codec);
+	if (!codec) {
+		release();
+		throw std::runtime_error("No hay un codificador de vídeo para el fichero " + path);
+	}
+	stream = avformat_new_stream(formatCtx, nullptr);
+	codecCtx = avcodec_alloc_context3(codec);
+	if (!stream || !codecCtx) {
+		release();
+		throw std::runtime_error("No se ha podido crear el codificador de vídeo");
+	}
+
+	// La mayoría de los formatos de color submuestreados necesitan dimensiones pares (sws_scale
+	// reescala la última fila o columna)
+	codecCtx->width = static_cast<int>(width & ~1U);
+	codecCtx->height = static_cast<int>(height & ~1U);
+	codecCtx->time_base = AVRational{ 1, static_cast<int>(fps) };
+	codecCtx->framerate = AVRational{ static_cast<int>(fps), 1 };
+	codecCtx->gop_size = 12;
+	codecCtx->pix_fmt = codec->pix_fmts ? codec->pix_fmts[0] : AV_PIX_FMT_YUV420P;
+	codecCtx->bit_rate = static_cast<int64_t>(codecCtx->width) * codecCtx->height * fps / 4;
+	stream->time_base = codecCtx->time_base;
+	if (formatCtx->oformat->flags & AVFMT_GLOBALHEADER)
+		codecCtx->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+
+	int ret = avcodec_open2(codecCtx, codec, nullptr);
+	if (ret < 0) {
+		release();
+		throw std::runtime_error("No se ha podido abrir el codificador de vídeo: " + avError(ret));
+	}
+	avcodec_parameters_from_context(stream->codecpar, codecCtx);
+
+	if (!(formatCtx->oformat->flags & AVFMT_NOFILE)) {
+		ret = avio_open(&formatCtx->pb, path.c_str(), AVIO_FLAG_WRITE);
+		if (ret < 0) {
+			release();
+			throw std::runtime_error("No se ha podido crear el fichero " + path + ": " + avError(ret));
+		}
+	}
+	ret = avformat_write_header(formatCtx, nullptr);
+	if (ret < 0) {
+		release();
+		throw std::runtime_error("No se ha podido escribir la cabecera del vídeo " + path + ": " + avError(ret));
+	}
+
+	frame = av_frame_alloc();
+	frame->format = codecCtx->pix_fmt;
+	frame->width = codecCtx->width;
+	frame->height = codecCtx->height;
+	av_frame_get_buffer(frame, 32);
+	swsCtx = sws_getContext(width, height, AV_PIX_FMT_RGB24, codecCtx->width, codecCtx->height,
+		codecCtx->pix_fmt, SWS_BICUBIC, nullptr, nullptr, nullptr);
+
+	thread = std::thread(&VideoEncoder::encoderThread, this);
+	INFO("Grabando el vídeo " + path + " (" + codec->name + ")");
+}
+
+VideoEncoder::~VideoEncoder() {
+	finish();
+}
+
+void VideoEncoder::addFrame(const uint8_t *rgb) {
+	const size_t size = 3UL * width * height;
+	std::unique_lock<std::mutex> lock{ m };
+	if (finished)
+		return;
+	cv.wait(lock, [this]() { return queue.size() < MAX_QUEUED_FRAMES; });
+	std::vector<uint8_t> buffer;
+	if (!spare.empty()) {
+		buffer = std::move(spare.back());
+		spare.pop_back();
+	}
+	buffer.resize(size);
+	memcpy(buffer.data(), rgb, size);
+	queue.push_back(std::move(buffer));
+	numFrames++;
+	cv.notify_all();
+}
+
+bool VideoEncoder::finish() {
+	{
+		std::lock_guard<std::mutex> lock{ m };
+		if (finished)
+			return error.empty();
+		finished = done = true;
+	}
+	cv.notify_all();
+	if (thread.joinable())
+		thread.join();
+
+	if (error.empty()) {
+		try {
+			writePackets(nullptr);
+			av_write_trailer(formatCtx);
+		}
+		catch (std::runtime_error &e) {
+			error = e.what();
+		}
+	}
+	release();
+	if (!error.empty()) {
+		ERR("Error grabando el vídeo " + path + ": " + error);
+		return false;
+	}
+	INFO("Vídeo " + path + " terminado (" + std::to_string(numFrames) + " fotogramas)");
+	return true;
+}
+
+void VideoEncoder::encoderThread() {
+	for (;;) {
+		std::vector<uint8_t> rgb;
+		{
+			std::unique_lock<std::mutex> lock{ m };
+			cv.wait(lock, [this]() { return done || !queue.empty(); });
+			if (queue.empty())
+				return;
+			rgb = std::move(queue.front());
+			queue.pop_front();
+		}
+		cv.notify_all();
+		// Después de un error, se descartan los fotogramas (finish lo notifica)
+		if (error.empty()) {
+			try {
+				encode(rgb);
+			}
+			catch (std::runtime_error &e) {
+				error = e.what();
+			}
+		}
+		std::lock_guard<std::mutex> lock{ m };
+		spare.push_back(std::move(rgb));
+	}
+}
+
+void VideoEncoder::encode(const std::vector<uint8_t> &rgb) {
+	if (av_frame_make_writable(frame) < 0)
+		throw std::runtime_error("No se puede escribir en el fotograma");
+	// Las filas vienen de abajo a arriba: se empieza por la última, con el paso negativo
+	const int stride = 3 * static_cast<int>(width);
+	const uint8_t *srcData[4] = { rgb.data() + static_cast<ptrdiff_t>(stride) * (height - 1), nullptr, nullptr, nullptr };
+	int srcLinesize[4] = { -stride, 0, 0, 0 };
+	sws_scale(swsCtx, srcData, srcLinesize, 0, static_cast<int>(height), frame->data, frame->linesize);
+	frame->pts = nextPts++;
+	writePackets(frame);
+}
+
+void VideoEncoder::writePackets(AVFrame *f) {
+	int ret = avcodec_send_frame(codecCtx, f);
+	if (ret < 0)
+		throw std::runtime_error("avcodec_send_frame: " + avError(ret));
+	for (;;) {
+		AVPacket packet;
+		av_init_packet(&packet);
+		packet.data = nullptr;
+		packet.size = 0;
+		ret = avcodec_receive_packet(codecCtx, &packet);
+		if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF)
+			return;
+		if (ret < 0)
+			throw std::runtime_error("avcodec_receive_packet: " + avError(ret));
+		av_packet_rescale_ts(&packet, codecCtx->time_base, stream->time_base);
+		packet.stream_index = stream->index;
+		// av_interleaved_write_frame se queda con el contenido del paquete
+		ret = av_interleaved_write_frame(formatCtx, &packet);
+		if (ret < 0)
+			throw std::runtime_error("av_interleaved_write_frame: " + avError(ret));
+	}
+}
+
+void VideoEncoder::release() {
+	if (swsCtx) {
+		sws_freeContext(swsCtx);
+		swsCtx = nullptr;
+	}
+	if (frame)
+		av_frame_free(&frame);
+	if (codecCtx)
+		avcodec_free_context(&codecCtx);
+	if (formatCtx) {
+		if (formatCtx->pb && !(formatCtx->oformat->flags & AVFMT_NOFILE))
+			avio_closep(&formatCtx->pb);
+		avformat_free_context(formatCtx);
+		formatCtx = nullptr;
+	}
+	stream = nullptr;
+}
@@ -27,12 +27,5 @@ VideoFile::~VideoFile() {
 }
 
 void VideoFile::rewind() {
-
-	int err = av_seek_frame(pFormatCtx, firstVideoStream, pFormatCtx->start_time, AVSEEK_FLAG_BACKWARD); 
-	if (err < 0) {
-		ERR("No se ha podido saltar al principio del vídeo " + filepath + " (" + ffmpegError(err) + ")");
-	}
-	else {
-		avcodec_flush_buffers(pCodecCtx);
-	}
+	seek(0.0);
 }
\ No newline at end of file
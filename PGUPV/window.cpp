@@ -16,9 +16,13 @@
 #include "utils.h"
 #include "logConsole.h"
 #include "guipg.h"
+#include "profiler.h"
+#include "frameCapture.h"
 
 using PGUPV::Window;
 using PGUPV::Renderer;
+using PGUPV::ProfilerWidget;
+using PGUPV::FrameCapture;
 using PGUPV::CameraHandler;
 using PGUPV::Image;
 using PGUPV::TextureRectangle;
@@ -48,6 +52,8 @@ Window::~Window() {
 
 void Window::destroy() {
 	deregisterEventHandlers();
+	// Las capturas pendientes necesitan el contexto de OpenGL
+	_frameCapture.reset();
 	renderers.clear();
 	window.reset();
 }
@@ -255,7 +261,10 @@ void Window::draw() {
 
 	glstats.beginFrame();
 
+	// Con el profiler desactivado no se construyen los nombres de las zonas
+	const bool profiling = PGUPV::Profiler::getInstance().isEnabled();
 	for (auto r : renderers) {
+		PGUPV_PROFILE_ZONE(profiling ? "Renderer " + std::to_string(r.first) : std::string());
 		r.second->preRender();
 		r.second->render();
 		r.second->postRender();
@@ -276,6 +285,7 @@ void Window::draw() {
 }
 
 void Window::drawGUIandStats() {
+	PGUPV_PROFILE_ZONE("GUI");
 	GLStateCapturer<PolygonModeState> prevPolygonMode;
 	ColorMasksState colorMask;
 	StencilTestEnabledState stencilEnabled;
@@ -366,6 +376,8 @@ void Window::buildStatsPanel() {
 	statspanel = std::shared_ptr<Panel>(new Panel("Stats"));
 	fpsWidget = std::make_shared<LineChartWidget>("FPS", 100, 80, 1);
 	msPerFrameWidget = std::make_shared<LineChartWidget>("ms/frame", 100, 80, 1);
+	gpuMsPerFrameWidget = std::make_shared<LineChartWidget>("GPU ms/frame", 100, 80, 1);
+	gpuLatencyWidget = std::make_shared<Label>("");
 	samplesPassedWidget = std::make_shared<LineChartWidget>("samples", 100, 80, 1);
 	primitivesGeneratedWidget = std::make_shared<LineChartWidget>("primitives", 100, 80, 1);
 	auto extendedStatsCB = std::make_shared<CheckBoxWidget>("Collect extended stats");
@@ -404,6 +416,8 @@ void Window::buildStatsPanel() {
 
 	statspanel->addWidget(fpsWidget);
 	statspanel->addWidget(msPerFrameWidget);
+	statspanel->addWidget(gpuMsPerFrameWidget);
+	statspanel->addWidget(gpuLatencyWidget);
 	statspanel->addWidget(samplesPassedWidget);
 	statspanel->addWidget(primitivesGeneratedWidget);
 	statspanel->addWidget(extendedStatsCB);
@@ -415,6 +429,7 @@ void Window::buildStatsPanel() {
 	statspanel->addWidget(computeShaderInvWidget);
 	statspanel->addWidget(clippingInWidget);
 	statspanel->addWidget(clippingOutWidget);
+	statspanel->addWidget(std::make_shared<ProfilerWidget>());
 }
 
 
@@ -422,11 +437,12 @@ void Window::update(uint ms) {
 	static uint elapsed = 0, nframes = 0;
 	static uint64_t samplesPassedAccum = 0, primitivesGeneratedAccum = 0, verticesSubmittedAccum = 0, primitivesSubmittedAccum = 0, fragmentShaderInvAccum = 0;
 	static uint64_t clippingInAccum = 0, clippingOutAccum = 0;
-	static float renderElapsed = 0.0f;
+	static float renderElapsed = 0.0f, gpuRenderElapsed = 0.0f;
 
 	elapsed += ms;
 	nframes++;
 	renderElapsed += glstats.getFrameDuration();
+	gpuRenderElapsed += glstats.getGPUFrameDuration();
 	samplesPassedAccum += glstats.getValue(GLStats::Query::SamplesPassed);
 	primitivesGeneratedAccum += glstats.getValue(GLStats::Query::PrimitivesGenerated);
 	verticesSubmittedAccum += glstats.getValue(GLStats::Query::VerticesSubmittedExt);
@@ -441,6 +457,10 @@ void Window::update(uint ms) {
 		if (fpsWidget) {
 			fpsWidget->pushValue(fps);
 			msPerFrameWidget->pushValue(renderElapsed / nframes);
+			gpuMsPerFrameWidget->pushValue(gpuRenderElapsed / nframes);
+			// Los valores de GLStats son de fotogramas anteriores (no se espera a la GPU)
+			gpuLatencyWidget->setText("GPU latency: " + std::to_string(glstats.getLatency(GLStats::Query::GPUTimeElapsed)) +
+				" frames, " + std::to_string(glstats.getGPULatency()) + " ms (" + std::to_string(glstats.getDroppedFrames()) + " frames not measured)");
 			samplesPassedWidget->pushValue(static_cast<float>(samplesPassedAccum) / nframes);
 			primitivesGeneratedWidget->pushValue(static_cast<float>(primitivesGeneratedAccum) / nframes);
 			verticesSubmittedWidget->pushValue(static_cast<float>(verticesSubmittedAccum) / nframes);
@@ -458,7 +478,7 @@ void Window::update(uint ms) {
 		nframes = 0;
 		samplesPassedAccum = primitivesGeneratedAccum = verticesSubmittedAccum = primitivesSubmittedAccum = fragmentShaderInvAccum = 0;
 		clippingInAccum = clippingOutAccum = 0;
-		renderElapsed = 0.0f;
+		renderElapsed = gpuRenderElapsed = 0.0f;
 	}
 
 	for (auto r : renderers) {
@@ -498,6 +518,26 @@ bool Window::saveColorBuffer(const std::string &filename, GLint framebuffer) {
 	return true;
 }
 
+bool Window::captureColorBuffer(const std::string &filename, GLint framebuffer) {
+	return getFrameCapture().capture(filename, framebuffer);
+}
+
+PGUPV::FrameCapture &Window::getFrameCapture() {
+	if (!_frameCapture || _frameCapture->getWidth() != _width || _frameCapture->getHeight() != _height) {
+		bool recording = _frameCapture && _frameCapture->isRecordingVideo();
+		if (recording)
+			WARN("La ventana ha cambiado de tamaño: se termina el vídeo que se estaba grabando");
+		_frameCapture.reset();
+		_frameCapture = std::make_unique<FrameCapture>(_width, _height);
+	}
+	return *_frameCapture;
+}
+
+void Window::pollFrameCapture() {
+	if (_frameCapture)
+		_frameCapture->poll();
+}
+
 uint Window::getStencilSize() {
 	assert(window != nullptr);
 	int bpp;
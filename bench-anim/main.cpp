@@ -0,0 +1,171 @@
+#include <glm/gtc/matrix_transform.hpp>
+#include <cmath>
+#include <sstream>
+
+#include "PGUPV.h"
+#include "GUI3.h"
+#include "animationNode.h"
+#include "animatorController.h"
+#include "threadPool.h"
+#include "stopWatch.h"
+
+using namespace PGUPV;
+
+using glm::vec3;
+using glm::vec4;
+using glm::mat4;
+
+/*
+Banco de pruebas de la animación esquelética: dibuja una multitud de personajes animados
+y mide el tiempo que se tarda en calcular las matrices de sus huesos. Scene::update reparte
+ese cálculo entre los hilos de ThreadPool::getInstance(), así que cambiando el número de hilos
+desde el panel se puede ver cómo escala con el número de núcleos.
+*/
+
+#define NUM_CHARACTERS 200
+
+class MyRender : public Renderer {
+public:
+  void setup(void) override;
+  void render(void) override;
+  void reshape(uint w, uint h) override;
+  void update(uint ms) override;
+private:
+  void buildCrowd();
+  void buildGUI();
+  std::shared_ptr<GLMatrices> mats;
+  Program skinShader;
+  std::shared_ptr<Scene> model, crowd;
+  std::shared_ptr<Label> updateTime;
+  MicroSecStopWatch stopWatch;
+  int64_t accumUs = 0;
+  uint accumMs = 0, numUpdates = 0;
+};
+
+void MyRender::setup() {
+  glClearColor(.1f, .1f, .1f, 1.0f);
+  glEnable(GL_DEPTH_TEST);
+
+  model = FileLoader::load("../recursos/modelos/Wuson.ms3d");
+  if (model->getNumAnimations() == 0)
+    ERRT("El modelo no tiene animaciones");
+  auto gold = PGUPV::getMaterial(PredefinedMaterial::GOLD);
+  model->processMeshes([gold](Mesh &m) { m.setMaterial(gold); });
+
+  mats = GLMatrices::build();
+  // Cada personaje hace varias operaciones con la matriz de modelo antes de dibujarse
+  mats->setDeferredUpdates(true);
+  skinShader.addAttributeLocation(Mesh::VERTICES, "position");
+  skinShader.addAttributeLocation(Mesh::NORMALS, "normal");
+  skinShader.addAttributeLocation(Mesh::BONE_IDS, "boneIds");
+  skinShader.addAttributeLocation(Mesh::BONE_WEIGHTS, "boneWeights");
+  skinShader.connectUniformBlock(mats, UBO_GL_MATRICES_BINDING_INDEX);
+  skinShader.replaceString("$" + UBOMaterial::blockName, UBOMaterial::definition);
+  skinShader.replaceString("$" + UBOBones::blockName, UBOBones::definition);
+  skinShader.loadFiles("../bench-anim/skin");
+  skinShader.compile();
+  skinShader.bindBlockToBindingPoint(UBOBones::blockName, UBO_BONES_BINDING_INDEX);
+
+  skinShader.use();
+  glUniform4f(skinShader.getUniformLocation("lightpos"), 0.0f, 0.0f, 0.0f, 1.0f);
+
+  buildCrowd();
+  buildGUI();
+
+  App::getInstance().getWindow().showGUI();
+  setCameraHandler(std::make_shared<OrbitCameraHandler>(20.0f));
+}
+
+/*
+Todos los personajes comparten el mismo subgrafo (y por tanto, las mallas), pero cada uno
+tiene su propio AnimatorController, con una velocidad y un desfase distintos
+*/
+void MyRender::buildCrowd() {
+  auto clip = model->getAnimation(0);
+  clip->setWrapMode(AnimationClip::WrapMode::LOOP);
+
+  const int side = static_cast<int>(std::ceil(std::sqrt(NUM_CHARACTERS)));
+  const float scale = 1.0f / model->maxDimension();
+  auto root = Group::build();
+  for (int i = 0; i < NUM_CHARACTERS; i++) {
+    auto state = std::make_shared<AnimatorState>("anim");
+    state->setAnimationClip(clip);
+    state->setSpeed(0.75f + 0.5f * (i % 7) / 6.0f);
+    auto controller = std::make_shared<AnimatorController>("personaje " + std::to_string(i));
+    controller->addState(state);
+    controller->start();
+    state->update(i * 137);
+
+    auto character = std::make_shared<AnimationNode>(model->getRoot());
+    character->setAnimatorController(controller);
+
+    auto xform = Transform::build(
+      glm::translate(mat4(1.0f), vec3(i % side - side / 2.0f, 0.0f, i / side - side / 2.0f)) *
+      glm::scale(mat4(1.0f), vec3(scale)));
+    xform->addChild(character);
+    root->addChild(xform);
+  }
+  crowd = std::make_shared<Scene>();
+  crowd->setRoot(root);
+  // Los personajes que quedan fuera de la vista no se dibujan
+  crowd->setFrustumCulling(true);
+}
+
+void MyRender::render() {
+  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+  mats->setMatrix(GLMatrices::VIEW_MATRIX, getCamera().getViewMatrix());
+
+  skinShader.use();
+  crowd->render();
+  CHECK_GL();
+}
+
+void MyRender::reshape(uint w, uint h) {
+  glViewport(0, 0, w, h);
+  mats->setMatrix(GLMatrices::PROJ_MATRIX, getCamera().getProjMatrix());
+}
+
+void MyRender::update(uint ms) {
+  stopWatch.restart();
+  crowd->update(ms);
+  accumUs += stopWatch.getElapsed();
+  accumMs += ms;
+  numUpdates++;
+
+  // Actualizamos la media una vez por segundo
+  if (accumMs >= 1000) {
+    std::ostringstream os;
+    os << NUM_CHARACTERS << " personajes: " << accumUs / numUpdates << " us por fotograma\n";
+    os << crowd->getNumCulledNodes() << " de " << crowd->getNumVisitedNodes() << " nodos descartados";
+    updateTime->setText(os.str());
+    accumUs = 0;
+    accumMs = 0;
+    numUpdates = 0;
+  }
+}
+
+void MyRender::buildGUI() {
+  auto panel = addPanel("Animación");
+  panel->setPosition(10, 10);
+  panel->setSize(320, 120);
+
+  auto &pool = ThreadPool::getInstance();
+  auto threads = std::make_shared<IntSliderWidget>("Hilos", pool.getNumThreads(), 1,
+    std::max(1U, std::thread::hardware_concurrency()));
+  threads->getValue().addListener([](const int &n) {
+    ThreadPool::getInstance().resize(n);
+  });
+  panel->addWidget(threads);
+
+  updateTime = std::make_shared<Label>("Midiendo...");
+  panel->addWidget(updateTime);
+}
+
+int main(int argc, char *argv[]) {
+  App &myApp = App::getInstance();
+  myApp.setInitWindowSize(800, 600);
+  myApp.initApp(argc, argv, PGUPV::DOUBLE_BUFFER | PGUPV::DEPTH_BUFFER |
+    PGUPV::MULTISAMPLE);
+  myApp.getWindow().setRenderer(std::make_shared<MyRender>());
+  return myApp.run();
+}
@@ -0,0 +1,22 @@
+#version 420 core
+
+$GLMatrices
+$Bones
+
+in vec4 position;
+in vec3 normal;
+in uvec4 boneIds;
+in vec4 boneWeights;
+
+out vec4 vertexPos;
+out vec3 Normal;
+
+void main()
+{
+	mat4 skin = boneWeights.x * bones[boneIds.x] + boneWeights.y * bones[boneIds.y] +
+		boneWeights.z * bones[boneIds.z] + boneWeights.w * bones[boneIds.w];
+
+	Normal = normalize(normalMatrix * mat3(skin) * normal);
+	vertexPos = modelviewMatrix * skin * position;
+	gl_Position = projMatrix * vertexPos;
+}
@@ -0,0 +1,355 @@
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "boundingVolumes.h"
+#include "stopWatch.h"
+#include "pingPongBuffers.h"
+#include "frameRing.h"
+#include "image.h"
+#include "pixelKernels.h"
+
+using namespace PGUPV;
+
+using glm::vec3;
+using glm::vec4;
+using glm::mat4;
+
+/*
+Microbancos de pruebas de algunas operaciones de la biblioteca que se ejecutan en la CPU.
+Cada prueba repite la operación sobre un conjunto de datos aleatorios y muestra el tiempo
+medio por llamada. Las funciones del espacio de nombres "anterior" son copias de las
+implementaciones que se han sustituido, para poder comparar.
+
+No abre ninguna ventana: conviene ejecutarlo compilado en modo Release.
+*/
+
+namespace anterior {
+  glm::bvec3 and3(const glm::bvec3& a, const glm::bvec3& b) {
+    return glm::bvec3{ a.x && b.x, a.y && b.y, a.z && b.z };
+  }
+
+  bool overlapsViewVolume(const BoundingBox& bb, const glm::mat4& mvp) {
+    if (!bb.isValid())
+      return false;
+
+    auto vtcs = bb.getVertices();
+    glm::bvec3 lt{ true }, gt{ true };
+    for (size_t i = 0; i < vtcs.size(); i++) {
+      auto v4 = mvp * vtcs[i];
+      auto v3 = glm::vec3(v4 / v4.w);
+      lt = and3(lt, glm::lessThan(v3, glm::vec3(-v4.w)));
+      gt = and3(gt, glm::greaterThan(v3, glm::vec3(v4.w)));
+      if (!(glm::any(lt) || glm::any(gt)))
+        return true;
+    }
+    return false;
+  }
+
+  void transform(BoundingBox &bb, const glm::mat4 & xform) {
+    if (!bb.isValid())
+      return;
+
+    auto corners = bb.getVertices();
+    bb.reset();
+    for (auto &vtx : corners) {
+      auto vp = xform * vtx;
+      if (vp.w) vp = vp / vp.w;
+      auto tmp = glm::vec3(vp);
+      bb.min = glm::min(bb.min, tmp);
+      bb.max = glm::max(bb.max, tmp);
+    }
+  }
+
+  // Image::swapRB
+  void swapRB(uchar *data, uint width, uint height, uint stride, uint bpp) {
+    for (uint j = 0; j < height; j++) {
+      unsigned char *first = data + stride * j;
+      for (uint i = 0; i < width; i++) {
+        std::swap(*first, *(first + 2));
+        first += bpp / 8;
+      }
+    }
+  }
+
+  void flipVImage(uchar *data, uint stride, uint height) {
+    uchar *tmp = new uchar[stride];
+    for (uint i = 0; i < height / 2; i++) {
+      memcpy(tmp, data + stride * i, stride);
+      memcpy(data + stride * i, data + (height - i - 1) * stride, stride);
+      memcpy(data + (height - i - 1) * stride, tmp, stride);
+    }
+    delete[] tmp;
+  }
+
+  uint maxDiffPixelRow(uchar *first, uchar *second, uint width, uint bppFirst, uint bppSecond) {
+    int maxDiff = 0;
+    int extraByteFirst = 0, extraByteSecond = 0;
+    if (bppFirst == 32) extraByteFirst = 1;
+    if (bppSecond == 32) extraByteSecond = 1;
+
+    int alpha1 = 255, alpha2 = 255;
+    for (uint i = 0; i < width; i++) {
+      if (bppFirst == 32) alpha1 = first[3];
+      if (bppSecond == 32) alpha2 = second[3];
+      for (uint j = 0; j < 3; j++) {
+        int d = abs(((int)*first)*alpha1 - ((int)*second)*alpha2) / 255;
+        maxDiff = std::max(maxDiff, d);
+        first++;
+        second++;
+      }
+      first += extraByteFirst;
+      second += extraByteSecond;
+    }
+    return maxDiff;
+  }
+
+  bool equals(Image &a, Image &b, uint maxDifference) {
+    for (uint y = 0; y < a.getHeight(); y++) {
+      uint d = maxDiffPixelRow(static_cast<uchar *>(a.getPixels(0, y)), static_cast<uchar *>(b.getPixels(0, y)),
+        a.getWidth(), a.getBPP(), b.getBPP());
+      if (d > maxDifference)
+        return false;
+    }
+    return true;
+  }
+
+  Image *difference(Image &a, Image &b) {
+    Image *diff = new Image(a.getWidth(), a.getHeight(), 24);
+    const uint numChannels = 3;
+    for (uint y = 0; y < a.getHeight(); y++) {
+      uchar *output = static_cast<uchar *>(diff->getPixels(0, y));
+      uchar *in1 = static_cast<uchar *>(a.getPixels(0, y));
+      uchar *in2 = static_cast<uchar *>(b.getPixels(0, y));
+      for (uint x = 0; x < a.getWidth(); x++) {
+        for (uint o = 0; o < numChannels; o++) {
+          *output = static_cast<uint8_t>(abs(*in1 - *in2));
+          output++;
+          in1++;
+          in2++;
+        }
+        if (a.getBPP() == 32) in1++;
+        if (b.getBPP() == 32) in2++;
+      }
+    }
+    return diff;
+  }
+
+  // Como Image::convert8BPPGrayTo24BPPGray, pero de RGB a RGBA
+  Image convert24BPPTo32BPP(const Image &src) {
+    Image dst(src.getWidth(), src.getHeight(), 32);
+    for (uint y = 0; y < src.getHeight(); y++) {
+      uint8_t *dst_row = static_cast<uint8_t *>(dst.getPixels(0, y));
+      uint8_t *src_row = static_cast<uint8_t *>(src.getPixels(0, y));
+      for (uint x = 0; x < src.getWidth(); x++) {
+        *dst_row++ = *src_row++;
+        *dst_row++ = *src_row++;
+        *dst_row++ = *src_row++;
+        *dst_row++ = 255;
+      }
+    }
+    return dst;
+  }
+};
+
+// Ejecuta op(i) para i en [0, n) tantas veces como quepan en unos 200 ms, y muestra el tiempo por llamada
+void measure(const char *name, size_t n, const std::function<void(size_t)> &op) {
+  MicroSecStopWatch stopWatch;
+  size_t calls = 0;
+  do {
+    for (size_t i = 0; i < n; i++)
+      op(i);
+    calls += n;
+  } while (stopWatch.getElapsed() < 200000);
+  printf("%-40s %10.2f ns/llamada\n", name, stopWatch.getElapsed() * 1000.0 / calls);
+}
+
+void benchBoundingVolumes() {
+  const size_t N = 4096;
+  std::mt19937 rng(1);
+  std::uniform_real_distribution<float> pos(-100.0f, 100.0f), size(0.1f, 10.0f);
+  std::vector<BoundingBox> boxes;
+  std::vector<BoundingSphere> spheres;
+  for (size_t i = 0; i < N; i++) {
+    vec3 c(pos(rng), pos(rng), pos(rng));
+    vec3 e(size(rng), size(rng), size(rng));
+    boxes.emplace_back(c - e, c + e);
+    spheres.emplace_back(c, glm::length(e));
+  }
+  const mat4 xform = glm::translate(mat4(1.0f), vec3(1.0f, 2.0f, 3.0f)) *
+    glm::rotate(mat4(1.0f), 0.7f, glm::normalize(vec3(1.0f, 1.0f, 0.0f))) *
+    glm::scale(mat4(1.0f), vec3(2.0f));
+  const mat4 mvp = glm::perspective(glm::radians(60.0f), 1.0f, 0.1f, 100.0f) *
+    glm::lookAt(vec3(0.0f, 0.0f, 50.0f), vec3(0.0f), vec3(0.0f, 1.0f, 0.0f));
+
+  // Acumulamos los resultados para que el compilador no elimine las llamadas
+  volatile size_t sink = 0;
+  std::vector<BoundingBox> tmp(boxes);
+
+  printf("Volúmenes de inclusión (%zu cajas)\n", N);
+  measure("BoundingBox::transform (anterior)", N, [&](size_t i) {
+    tmp[i] = boxes[i];
+    anterior::transform(tmp[i], xform);
+  });
+  measure("BoundingBox::transform", N, [&](size_t i) {
+    tmp[i] = boxes[i];
+    tmp[i].transform(xform);
+  });
+  measure("overlapsViewVolume (anterior)", N, [&](size_t i) {
+    sink = sink + anterior::overlapsViewVolume(boxes[i], mvp);
+  });
+  measure("overlapsViewVolume", N, [&](size_t i) {
+    sink = sink + overlapsViewVolume(boxes[i], mvp);
+  });
+  const Frustum frustum(mvp);
+  measure("Frustum::classify(BoundingBox)", N, [&](size_t i) {
+    sink = sink + static_cast<size_t>(frustum.classify(boxes[i]));
+  });
+  measure("Frustum::classify(BoundingSphere)", N, [&](size_t i) {
+    sink = sink + static_cast<size_t>(frustum.classify(spheres[i]));
+  });
+  printf("\n");
+}
+
+/*
+Un hilo productor pasa N fotogramas al hilo principal a través del anillo. Los dos hilos
+esperan activamente (cediendo el procesador, por si sólo hay uno), así que compiten todo el
+rato por el anillo. Muestra el tiempo por fotograma producido y el porcentaje de fotogramas
+que llegan al consumidor
+*/
+template <typename Ring>
+void measureRing(const char *name, Ring &ring) {
+  const uint64_t N = 200000;
+  std::atomic<bool> done{ false };
+  MicroSecStopWatch stopWatch;
+  std::thread producer([&]() {
+    for (uint64_t i = 1; i <= N; i++) {
+      unsigned char *b;
+      while ((b = ring.lockForWrite()) == nullptr)
+        std::this_thread::yield();
+      memcpy(b, &i, sizeof(i));
+      ring.unlockForWrite(static_cast<int64_t>(i));
+    }
+    done = true;
+  });
+  uint64_t received = 0, last = 0;
+  bool ordered = true;
+  for (;;) {
+    int64_t timestamp;
+    unsigned char *b = ring.lockForRead(&timestamp);
+    if (!b) {
+      if (done && ring.isEmpty())
+        break;
+      std::this_thread::yield();
+      continue;
+    }
+    uint64_t id;
+    memcpy(&id, b, sizeof(id));
+    ordered = ordered && id > last && static_cast<int64_t>(id) == timestamp;
+    last = id;
+    received++;
+    ring.unlockForRead();
+  }
+  producer.join();
+  printf("%-40s %10.2f ns/fotograma %7.2f%% recibidos%s\n", name, stopWatch.getElapsed() * 1000.0 / N,
+    100.0 * received / N, ordered ? "" : " (¡desordenados!)");
+}
+
+void benchFrameRings() {
+  const unsigned int numBuffers = 4;
+  const struct {
+    PingPongBuffers::Policy policy;
+    const char *name;
+  } policies[] = {
+    { PingPongBuffers::Policy::OnlyNewest, "OnlyNewest" },
+    { PingPongBuffers::Policy::DiscardOldest, "DiscardOldest" },
+    { PingPongBuffers::Policy::NoDiscard, "NoDiscard" },
+  };
+  printf("Anillos productor/consumidor (%u buffers de 64x64 RGB)\n", numBuffers);
+  for (auto &p : policies) {
+    PingPongBuffers pingPong(64, 64, 24, p.policy, numBuffers);
+    measureRing((std::string("PingPongBuffers ") + p.name).c_str(), pingPong);
+    FrameRing ring(64, 64, 24, p.policy, numBuffers);
+    measureRing((std::string("FrameRing ") + p.name).c_str(), ring);
+  }
+  printf("\n");
+}
+
+/*
+Operaciones de Image sobre imágenes 4K que se usan al cargar texturas y al comparar capturas.
+Las imágenes comparadas difieren en, como mucho, 2 en cada canal, así que equals recorre
+toda la imagen (con alfa, la diferencia premultiplicada puede llegar a 4)
+*/
+void benchImages() {
+  const uint W = 3840, H = 2160;
+  std::mt19937 rng(1);
+  std::uniform_int_distribution<int> byte(0, 255), delta(-2, 2);
+  printf("Imágenes (%ux%u)\n", W, H);
+  for (uint bpp : { 24u, 32u }) {
+    Image a(W, H, bpp), b(W, H, bpp), result(W, H, 24);
+    uint8_t *pa = static_cast<uint8_t *>(a.getPixels()), *pb = static_cast<uint8_t *>(b.getPixels());
+    for (size_t i = 0; i < static_cast<size_t>(a.getStride()) * H; i++) {
+      pa[i] = static_cast<uint8_t>(byte(rng));
+      pb[i] = static_cast<uint8_t>(glm::clamp(pa[i] + delta(rng), 0, 255));
+    }
+    const std::string suffix = " " + std::to_string(bpp) + " bpp";
+    volatile size_t sink = 0;
+
+    // swapRB y flipV modifican la imagen un número variable de veces, así que trabajan sobre una
+    // copia para que a y b sigan difiriendo en 2 como mucho
+    Image scratch(W, H, bpp, pa);
+    uint8_t *ps = static_cast<uint8_t *>(scratch.getPixels());
+    measure(("swapRB (anterior)" + suffix).c_str(), 1, [&](size_t) {
+      anterior::swapRB(ps, W, H, scratch.getStride(), bpp);
+    });
+    measure(("swapRB" + suffix).c_str(), 1, [&](size_t) {
+      const uint stride = scratch.getStride();
+      PixelKernels::parallelRows(H, stride, [&](uint begin, uint end) {
+        for (uint y = begin; y < end; y++)
+          PixelKernels::swapRB(ps + stride * y, W, bpp / 8);
+      });
+    });
+    measure(("flipV (anterior)" + suffix).c_str(), 1, [&](size_t) {
+      anterior::flipVImage(ps, scratch.getStride(), H);
+    });
+    measure(("Image::flipV" + suffix).c_str(), 1, [&](size_t) {
+      scratch.flipV();
+    });
+    measure(("equals (anterior)" + suffix).c_str(), 1, [&](size_t) {
+      sink = sink + anterior::equals(a, b, 4);
+    });
+    measure(("Image::equals" + suffix).c_str(), 1, [&](size_t) {
+      sink = sink + a.equals(b, 4);
+    });
+    measure(("difference (anterior)" + suffix).c_str(), 1, [&](size_t) {
+      delete anterior::difference(a, b);
+    });
+    measure(("Image::difference (reutilizando)" + suffix).c_str(), 1, [&](size_t) {
+      a.difference(b, result);
+    });
+    if (bpp == 24) {
+      measure("24 a 32 bpp (anterior)", 1, [&](size_t) {
+        Image c = anterior::convert24BPPTo32BPP(a);
+        sink = sink + c.getBPP();
+      });
+      measure("Image::convert24BPPTo32BPP", 1, [&](size_t) {
+        Image c = Image::convert24BPPTo32BPP(a);
+        sink = sink + c.getBPP();
+      });
+    }
+  }
+  printf("\n");
+}
+
+int main(int, char *[]) {
+  benchBoundingVolumes();
+  benchFrameRings();
+  benchImages();
+  return 0;
+}
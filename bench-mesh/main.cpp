@@ -0,0 +1,190 @@
+#include <glm/gtc/matrix_transform.hpp>
+#include <cmath>
+#include <set>
+#include <sstream>
+
+#include "PGUPV.h"
+#include "GUI3.h"
+#include "glQuery.h"
+
+using namespace PGUPV;
+
+using glm::vec3;
+using glm::vec4;
+using glm::mat4;
+
+/*
+Banco de pruebas de la organización de los vértices en la GPU: dibuja muchas copias del mismo
+modelo, cargado de tres formas distintas (ver AssimpWrapper::VertexLayout):
+
+- con un VBO por atributo (lo que hacían siempre los métodos Mesh::add*),
+- con todos los atributos intercalados en un único buffer (MeshBuilder),
+- intercalados y en formatos compactos (half float, 2_10_10_10 y bytes).
+
+Desde el panel se elige la versión a dibujar, y se muestra el tiempo de GPU que se tarda en
+dibujar todas las copias (medido con GL_TIME_ELAPSED) y la memoria que ocupan sus vértices.
+
+Los modelos se cargan en segundo plano (FileLoader::loadAsync): la ventana responde desde
+el principio, y cada versión se puede dibujar en cuanto termina su carga.
+*/
+
+#define GRID_SIDE 24
+
+class MyRender : public Renderer {
+public:
+  MyRender() : timers{ GLQuery(GL_TIME_ELAPSED), GLQuery(GL_TIME_ELAPSED) } {}
+  void setup(void) override;
+  void render(void) override;
+  void reshape(uint w, uint h) override;
+  void update(uint ms) override;
+private:
+  void buildGUI();
+  std::string describeMemory(Scene &scene);
+  std::shared_ptr<GLMatrices> mats;
+  Program shader;
+  std::shared_ptr<PendingScene> pending[3];
+  std::shared_ptr<Scene> models[3];
+  std::string memory[3];
+  std::shared_ptr<ListBoxWidget<>> layout;
+  std::shared_ptr<Label> stats;
+  // Se alternan para no esperar al resultado de la medida del fotograma actual
+  GLQuery timers[2];
+  unsigned int frame = 0;
+  uint64_t accumNs = 0;
+  uint accumMs = 0, numFrames = 0;
+};
+
+// Número de buffer objects distintos que usan las mallas de la escena, y su tamaño total
+std::string MyRender::describeMemory(Scene &scene) {
+  std::set<std::shared_ptr<BufferObject>> buffers;
+  scene.processMeshes([&buffers](Mesh &m) {
+    for (int i = 0; i < Mesh::_LAST_; i++) {
+      auto bo = m.getBufferObject(i);
+      if (bo)
+        buffers.insert(bo);
+    }
+  });
+  size_t bytes = 0;
+  for (auto &bo : buffers)
+    bytes += bo->getSize();
+  std::ostringstream os;
+  os << buffers.size() << " buffers, " << bytes / 1024 << " KB";
+  return os.str();
+}
+
+void MyRender::setup() {
+  glClearColor(.1f, .1f, .1f, 1.0f);
+  glEnable(GL_DEPTH_TEST);
+
+  const AssimpWrapper::VertexLayout layouts[] = { AssimpWrapper::VertexLayout::SEPARATE,
+    AssimpWrapper::VertexLayout::INTERLEAVED, AssimpWrapper::VertexLayout::COMPACT };
+  for (int i = 0; i < 3; i++)
+    pending[i] = FileLoader::loadAsync("../recursos/modelos/teapot.3ds", AssimpWrapper::LoadOptions::MEDIUM, layouts[i]);
+
+  mats = GLMatrices::build();
+  shader.addAttributeLocation(Mesh::VERTICES, "position");
+  shader.addAttributeLocation(Mesh::NORMALS, "normal");
+  shader.addAttributeLocation(Mesh::TEX_COORD0, "texCoord");
+  shader.connectUniformBlock(mats, UBO_GL_MATRICES_BINDING_INDEX);
+  shader.replaceString("$" + UBOMaterial::blockName, UBOMaterial::definition);
+  shader.loadFiles("../bench-mesh/mesh");
+  shader.compile();
+
+  shader.use();
+  glUniform4f(shader.getUniformLocation("lightpos"), 0.0f, 0.0f, 0.0f, 1.0f);
+
+  buildGUI();
+
+  App::getInstance().getWindow().showGUI();
+  setCameraHandler(std::make_shared<OrbitCameraHandler>(GRID_SIDE * 1.2f));
+}
+
+void MyRender::render() {
+  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+  mats->setMatrix(GLMatrices::VIEW_MATRIX, getCamera().getViewMatrix());
+
+  // Resultado de la medida del fotograma anterior
+  if (frame > 0) {
+    accumNs += timers[(frame - 1) % 2].getValueU64();
+    numFrames++;
+  }
+
+  // Todavía se está cargando
+  if (!models[layout->getSelected()])
+    return;
+
+  auto &model = *models[layout->getSelected()];
+  const float scale = 1.0f / model.maxDimension();
+  shader.use();
+  timers[frame % 2].begin();
+  for (int z = 0; z < GRID_SIDE; z++) {
+    for (int x = 0; x < GRID_SIDE; x++) {
+      mats->pushMatrix(GLMatrices::MODEL_MATRIX);
+      mats->translate(GLMatrices::MODEL_MATRIX, x - GRID_SIDE / 2.0f, 0.0f, z - GRID_SIDE / 2.0f);
+      mats->scale(GLMatrices::MODEL_MATRIX, scale);
+      model.render();
+      mats->popMatrix(GLMatrices::MODEL_MATRIX);
+    }
+  }
+  timers[frame % 2].end();
+  frame++;
+  CHECK_GL();
+}
+
+void MyRender::reshape(uint w, uint h) {
+  glViewport(0, 0, w, h);
+  mats->setMatrix(GLMatrices::PROJ_MATRIX, getCamera().getProjMatrix());
+}
+
+void MyRender::update(uint ms) {
+  // Terminamos (en este hilo, que tiene el contexto de OpenGL) las cargas que estén listas
+  for (int i = 0; i < 3; i++) {
+    if (pending[i] && pending[i]->isReady()) {
+      models[i] = pending[i]->get();
+      auto gold = PGUPV::getMaterial(PredefinedMaterial::GOLD);
+      models[i]->processMeshes([gold](Mesh &m) { m.setMaterial(gold); });
+      memory[i] = describeMemory(*models[i]);
+      pending[i].reset();
+    }
+  }
+
+  accumMs += ms;
+  // Actualizamos la media una vez por segundo
+  if (accumMs >= 1000 && numFrames > 0) {
+    std::ostringstream os;
+    os << GRID_SIDE * GRID_SIDE << " modelos: " << accumNs / numFrames / 1000 << " us de GPU por fotograma\n";
+    os << memory[layout->getSelected()];
+    stats->setText(os.str());
+    accumNs = 0;
+    accumMs = 0;
+    numFrames = 0;
+  }
+}
+
+void MyRender::buildGUI() {
+  auto panel = addPanel("Vértices");
+  panel->setPosition(10, 10);
+  panel->setSize(360, 160);
+
+  layout = std::make_shared<ListBoxWidget<>>("Organización",
+    std::vector<std::string>{ "Un VBO por atributo", "Intercalados", "Intercalados compactos" });
+  // Empezamos a medir de nuevo al cambiar de versión
+  layout->getValue().addListener([this](int) {
+    accumNs = 0;
+    accumMs = 0;
+    numFrames = 0;
+  });
+  panel->addWidget(layout);
+
+  stats = std::make_shared<Label>("Cargando...");
+  panel->addWidget(stats);
+}
+
+int main(int argc, char *argv[]) {
+  App &myApp = App::getInstance();
+  myApp.setInitWindowSize(800, 600);
+  myApp.initApp(argc, argv, PGUPV::DOUBLE_BUFFER | PGUPV::DEPTH_BUFFER |
+    PGUPV::MULTISAMPLE);
+  myApp.getWindow().setRenderer(std::make_shared<MyRender>());
+  return myApp.run();
+}
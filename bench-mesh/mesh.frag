@@ -0,0 +1,24 @@
+#version 420 core
+
+$Material
+$GLMatrices
+
+uniform vec4 lightpos; // lightpos (in eye space)
+
+in vec3 Normal;
+in vec4 vertexPos; // interpolated vertexPos (in eye space)
+in vec2 TexCoord;
+
+out vec4 final_color;
+
+void main()
+{
+	vec3 lightDir = normalize(vec3(lightpos - vertexPos));
+	float intensity = max(dot(lightDir, normalize(Normal)), 0.0);
+
+	// Un damero con las coordenadas de textura, para que se vean los errores de precisión
+	vec2 checker = floor(fract(TexCoord * 8.0) * 2.0);
+	float shade = mix(0.8, 1.0, mod(checker.x + checker.y, 2.0));
+
+	final_color = diffuse * intensity * shade + ambient;
+}
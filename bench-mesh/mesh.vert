@@ -0,0 +1,19 @@
+#version 420 core
+
+$GLMatrices
+
+in vec4 position;
+in vec3 normal;
+in vec2 texCoord;
+
+out vec4 vertexPos;
+out vec3 Normal;
+out vec2 TexCoord;
+
+void main()
+{
+	Normal = normalize(normalMatrix * normal);
+	TexCoord = texCoord;
+	vertexPos = modelviewMatrix * position;
+	gl_Position = projMatrix * vertexPos;
+}
@@ -22,6 +22,7 @@
 #include <glm/gtc/quaternion.hpp>
 #include <gsl/gsl>
 #include <sstream>
+#include <algorithm>
 
 using PGUPV::GUILib;
 
@@ -196,6 +197,40 @@ void GUILib::PlotLines(const std::string &label, float *values, size_t count, si
 	ImGui::PlotLines(label.c_str(), values, static_cast<int>(count), static_cast<int>(offset), overlay_text.c_str(), scale_min, scale_max, ImVec2(size.x, size.y));
 }
 
+void GUILib::FlameGraph(const std::string &label, const std::vector<FlameGraphItem> &items, float span, float rowHeight) {
+	unsigned int levels = 1;
+	for (auto &item : items)
+		levels = std::max(levels, item.depth + 1);
+
+	ImGui::TextUnformatted(label.c_str(), ImGui::FindRenderedTextEnd(label.c_str()));
+	const ImVec2 origin = ImGui::GetCursorScreenPos();
+	const ImVec2 size(ImGui::GetContentRegionAvail().x, levels * rowHeight);
+	ImGui::InvisibleButton(label.c_str(), ImVec2(std::max(size.x, 1.0f), size.y));
+	const bool hovered = ImGui::IsItemHovered();
+	const ImVec2 mouse = ImGui::GetIO().MousePos;
+	if (span <= 0.0f)
+		return;
+
+	ImDrawList *drawList = ImGui::GetWindowDrawList();
+	drawList->AddRectFilled(origin, ImVec2(origin.x + size.x, origin.y + size.y), ImGui::GetColorU32(ImGuiCol_FrameBg));
+	const float scale = size.x / span;
+	for (auto &item : items) {
+		ImVec2 p0(origin.x + item.start * scale, origin.y + item.depth * rowHeight);
+		ImVec2 p1(p0.x + std::max(item.duration * scale, 1.0f), p0.y + rowHeight - 1.0f);
+		// The color only depends on the name, so a zone keeps its color from frame to frame
+		const ImU32 hash = ImHashStr(item.name.c_str());
+		const ImU32 color = IM_COL32(100 + (hash & 0x7F), 100 + ((hash >> 8) & 0x7F), 100 + ((hash >> 16) & 0x7F), 255);
+		drawList->AddRectFilled(p0, p1, color);
+		if (p1.x - p0.x > 20.0f) {
+			drawList->PushClipRect(p0, p1, true);
+			drawList->AddText(ImVec2(p0.x + 2.0f, p0.y), IM_COL32(0, 0, 0, 255), item.name.c_str());
+			drawList->PopClipRect();
+		}
+		if (hovered && mouse.x >= p0.x && mouse.x < p1.x && mouse.y >= p0.y && mouse.y < p1.y)
+			ImGui::SetTooltip("%s: %.3f ms", item.name.c_str(), item.duration);
+	}
+}
+
 static ImGuiCond toImGUI(GUILib::WindowPosSizeFlags flag) {
 	switch (flag) {
 	case GUILib::WindowPosSizeFlags::Always:
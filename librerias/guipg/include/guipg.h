@@ -50,6 +50,15 @@ namespace PGUPV {
 
 		static void PlotLines(const std::string &label, float *values, size_t count, size_t offset, const std::string &overlay_text, float scale_min, float scale_max, const glm::vec2 &size);
 
+		// One bar of a FlameGraph. start and duration use the same units as the total span of the graph
+		struct FlameGraphItem {
+			std::string name;
+			float start, duration;
+			unsigned int depth;
+		};
+		// Draws the items as nested bars (one row per depth level) over the span [0, span]. Hovering a bar shows its name and duration in ms
+		static void FlameGraph(const std::string &label, const std::vector<FlameGraphItem> &items, float span, float rowHeight);
+
 		// Panel
 		enum class WindowPosSizeFlags {
 			Always,   // Set the variable